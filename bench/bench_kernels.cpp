@@ -0,0 +1,307 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <opencv2/opencv.hpp>
+#include <openvino/openvino.hpp>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "allocation_counter.hpp"
+#include "postprocess.hpp"
+#include "preprocess.hpp"
+
+// モデルファイルを使わず、合成した入力・出力テンソルで前処理と後処理の時間を計測する
+
+/**
+ * @brief 計測ループ内の1回あたりのメモリ確保回数をカウンタとして出力する
+ *
+ * @param state ベンチマークの状態
+ * @param allocations_before 計測ループ開始前のメモリ確保回数
+ */
+static void report_allocations(benchmark::State& state, const std::size_t allocations_before) {
+    state.counters["allocs_per_iter"] =
+        benchmark::Counter(static_cast<double>(get_num_allocations() - allocations_before),
+                           benchmark::Counter::kAvgIterations);
+}
+
+/**
+ * @brief ランダムなBGR画像を作る
+ *
+ * @param width 幅
+ * @param height 高さ
+ * @param type 画像の型
+ * @return cv::Mat 画像
+ */
+static cv::Mat make_image(const int width, const int height, const int type = CV_8UC3) {
+    cv::Mat image(height, width, CV_8UC3);
+    std::mt19937 engine(0);
+    std::uniform_int_distribution<int> dist(0, 255);
+    for (int y = 0; y < height; y++) {
+        std::uint8_t* row = image.ptr<std::uint8_t>(y);
+        for (int x = 0; x < width * 3; x++) {
+            row[x] = static_cast<std::uint8_t>(dist(engine));
+        }
+    }
+    if (type != CV_8UC3) {
+        image.convertTo(image, type);
+    }
+    return image;
+}
+
+/**
+ * @brief ランダムな値で埋めたfloat型のテンソルを作る
+ *
+ * @param shape テンソルのサイズ
+ * @param min 最小値
+ * @param max 最大値
+ * @return ov::Tensor テンソル
+ */
+static ov::Tensor make_float_tensor(const ov::Shape& shape, const float min, const float max) {
+    ov::Tensor tensor(ov::element::f32, shape);
+    std::mt19937 engine(0);
+    std::uniform_real_distribution<float> dist(min, max);
+    float* data = tensor.data<float>();
+    for (std::size_t i = 0; i < tensor.get_size(); i++) {
+        data[i] = dist(engine);
+    }
+    return tensor;
+}
+
+// 入力フレームのサイズ（720p/1080p/4K）と、モデルの入力サイズの組み合わせ
+static void frame_and_model_sizes(benchmark::Benchmark* bench) {
+    bench->ArgNames({"frame_w", "frame_h", "model_w", "model_h"});
+    const std::vector<std::pair<int, int>> frames = {{1280, 720}, {1920, 1080}, {3840, 2160}};
+    for (const auto& frame : frames) {
+        bench->Args({frame.first, frame.second, 512, 512});    // vehicle-detection-0202
+        bench->Args({frame.first, frame.second, 1280, 720});   // person-detection-0303
+    }
+}
+
+// 画像サイズ（720p/1080p/4K）
+static void frame_sizes(benchmark::Benchmark* bench) {
+    bench->ArgNames({"w", "h"});
+    bench->Args({1280, 720});
+    bench->Args({1920, 1080});
+    bench->Args({3840, 2160});
+}
+
+static void BM_FloatCHW_preprocess(benchmark::State& state) {
+    const cv::Mat image = make_image(state.range(0), state.range(1));
+    const ov::Shape input_shape = {1, 3, static_cast<std::size_t>(state.range(3)),
+                                   static_cast<std::size_t>(state.range(2))};
+    FloatCHW preprocessor;
+    for (auto _ : state) {
+        ov::Tensor input_tensor = preprocessor.preprocess(input_shape, image);
+        benchmark::DoNotOptimize(input_tensor.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_FloatCHW_preprocess)->Apply(frame_and_model_sizes)->Unit(benchmark::kMicrosecond);
+
+static void BM_FloatCHW_preprocess_into(benchmark::State& state) {
+    // 推論リクエストの入力テンソルを使い回す場合
+    const cv::Mat image = make_image(state.range(0), state.range(1));
+    ov::Tensor input_tensor(ov::element::f32, {1, 3, static_cast<std::size_t>(state.range(3)),
+                                               static_cast<std::size_t>(state.range(2))});
+    FloatCHW preprocessor;
+    preprocessor.preprocess_into(image, input_tensor);
+    const std::size_t allocations_before = get_num_allocations();
+    for (auto _ : state) {
+        preprocessor.preprocess_into(image, input_tensor);
+        benchmark::DoNotOptimize(input_tensor.data());
+    }
+    report_allocations(state, allocations_before);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_FloatCHW_preprocess_into)
+    ->Apply(frame_and_model_sizes)
+    ->Unit(benchmark::kMicrosecond);
+
+static void BM_convert_hwc2chw(benchmark::State& state) {
+    // 従来の実装（float型のHWC画像を入力し、新しいcv::Matを返す）
+    const cv::Mat image = make_image(state.range(0), state.range(1), CV_32FC3);
+    for (auto _ : state) {
+        cv::Mat chw_image = convert_hwc2chw(image);
+        benchmark::DoNotOptimize(chw_image.data);
+    }
+    state.SetBytesProcessed(state.iterations() * image.total() * image.elemSize());
+}
+BENCHMARK(BM_convert_hwc2chw)->Apply(frame_sizes)->Unit(benchmark::kMicrosecond);
+
+static void BM_convert_hwc2chw_simd(benchmark::State& state) {
+    // u8型のHWC画像から、確保済みのメモリへ直接書き込む実装
+    const cv::Mat image = make_image(state.range(0), state.range(1));
+    std::vector<float> chw_data(image.total() * 3);
+    for (auto _ : state) {
+        convert_hwc2chw(image, chw_data.data());
+        benchmark::DoNotOptimize(chw_data.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * image.total() * image.elemSize());
+}
+BENCHMARK(BM_convert_hwc2chw_simd)->Apply(frame_sizes)->Unit(benchmark::kMicrosecond);
+
+static void BM_convert_hwc2chw_simd_normalize(benchmark::State& state) {
+    // BGR->RGBの入れ替えと正規化を含む場合
+    const cv::Mat image = make_image(state.range(0), state.range(1));
+    std::vector<float> chw_data(image.total() * 3);
+    const cv::Scalar mean(123.675, 116.28, 103.53);
+    const cv::Scalar scale(58.395, 57.12, 57.375);
+    for (auto _ : state) {
+        convert_hwc2chw(image, chw_data.data(), true, mean, scale);
+        benchmark::DoNotOptimize(chw_data.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * image.total() * image.elemSize());
+}
+BENCHMARK(BM_convert_hwc2chw_simd_normalize)->Apply(frame_sizes)->Unit(benchmark::kMicrosecond);
+
+static void BM_BBox5Label1_postprocess(benchmark::State& state) {
+    const std::size_t num_boxes = static_cast<std::size_t>(state.range(0));
+    const ov::Shape input_shape = {1, 3, 720, 1280};
+    const ov::Tensor boxes_tensor = make_float_tensor({num_boxes, 5}, 0.0f, 720.0f);
+    ov::Tensor labels_tensor(ov::element::i64, {num_boxes});
+    std::fill_n(labels_tensor.data<std::int64_t>(), num_boxes, 0);
+
+    BBox5Label1 postprocessor;
+    for (auto _ : state) {
+        std::vector<BBox> bboxes =
+            postprocessor.postprocess(input_shape, boxes_tensor, labels_tensor);
+        benchmark::DoNotOptimize(bboxes.data());
+    }
+    state.SetItemsProcessed(state.iterations() * num_boxes);
+}
+BENCHMARK(BM_BBox5Label1_postprocess)->ArgName("detections")->Arg(100)->Arg(200);
+
+static void BM_BBox5Label1_postprocess_buffer(benchmark::State& state) {
+    // 出力先のバッファをフレーム間で使い回す場合
+    const std::size_t num_boxes = static_cast<std::size_t>(state.range(0));
+    const ov::Shape input_shape = {1, 3, 720, 1280};
+    const ov::Tensor boxes_tensor = make_float_tensor({num_boxes, 5}, 0.0f, 720.0f);
+    ov::Tensor labels_tensor(ov::element::i64, {num_boxes});
+    std::fill_n(labels_tensor.data<std::int64_t>(), num_boxes, 0);
+
+    BBox5Label1 postprocessor;
+    BBoxList bboxes;
+    postprocessor.postprocess(input_shape, boxes_tensor, labels_tensor, bboxes);
+    const std::size_t allocations_before = get_num_allocations();
+    for (auto _ : state) {
+        postprocessor.postprocess(input_shape, boxes_tensor, labels_tensor, bboxes);
+        benchmark::DoNotOptimize(bboxes.get_rects().data());
+    }
+    report_allocations(state, allocations_before);
+    state.SetItemsProcessed(state.iterations() * num_boxes);
+}
+BENCHMARK(BM_BBox5Label1_postprocess_buffer)->ArgName("detections")->Arg(100)->Arg(200);
+
+static void BM_BBox7_postprocess(benchmark::State& state) {
+    const std::size_t num_boxes = static_cast<std::size_t>(state.range(0));
+    ov::Tensor boxes_tensor = make_float_tensor({1, 1, num_boxes, 7}, 0.0f, 1.0f);
+    float* boxes = boxes_tensor.data<float>();
+    for (std::size_t i = 0; i < num_boxes; i++) {
+        boxes[i * 7 + 0] = 0.0f;  // 画像ID
+        boxes[i * 7 + 1] = 1.0f;  // ラベル
+    }
+
+    BBox7 postprocessor;
+    for (auto _ : state) {
+        std::vector<BBox> bboxes = postprocessor.postprocess(boxes_tensor);
+        benchmark::DoNotOptimize(bboxes.data());
+    }
+    state.SetItemsProcessed(state.iterations() * num_boxes);
+}
+BENCHMARK(BM_BBox7_postprocess)->ArgName("detections")->Arg(100)->Arg(200);
+
+static void BM_BBox7_postprocess_buffer(benchmark::State& state) {
+    // 出力先のバッファをフレーム間で使い回し、確信度で絞り込んで並べ替える場合
+    const std::size_t num_boxes = static_cast<std::size_t>(state.range(0));
+    ov::Tensor boxes_tensor = make_float_tensor({1, 1, num_boxes, 7}, 0.0f, 1.0f);
+    float* boxes = boxes_tensor.data<float>();
+    for (std::size_t i = 0; i < num_boxes; i++) {
+        boxes[i * 7 + 0] = 0.0f;  // 画像ID
+        boxes[i * 7 + 1] = 1.0f;  // ラベル
+    }
+
+    BBox7 postprocessor;
+    BBoxList bboxes;
+    postprocessor.postprocess(boxes_tensor, bboxes);
+    bboxes.sort_by_confidence();
+    const std::size_t allocations_before = get_num_allocations();
+    for (auto _ : state) {
+        postprocessor.postprocess(boxes_tensor, bboxes);
+        bboxes.filter(0.5f);
+        bboxes.sort_by_confidence();
+        benchmark::DoNotOptimize(bboxes.get_rects().data());
+    }
+    report_allocations(state, allocations_before);
+    state.SetItemsProcessed(state.iterations() * num_boxes);
+}
+BENCHMARK(BM_BBox7_postprocess_buffer)->ArgName("detections")->Arg(100)->Arg(200);
+
+static void BM_BBox7_postprocess_filter(benchmark::State& state) {
+    // BM_BBox7_postprocess_bufferと同じ絞り込みを後処理の中で行い、さらにNMSをかける場合
+    const std::size_t num_boxes = static_cast<std::size_t>(state.range(0));
+    ov::Tensor boxes_tensor = make_float_tensor({1, 1, num_boxes, 7}, 0.0f, 1.0f);
+    float* boxes = boxes_tensor.data<float>();
+    for (std::size_t i = 0; i < num_boxes; i++) {
+        boxes[i * 7 + 0] = 0.0f;                       // 画像ID
+        boxes[i * 7 + 1] = static_cast<float>(i % 2);  // ラベル
+        boxes[i * 7 + 3] *= 0.8f;                      // xmin
+        boxes[i * 7 + 4] *= 0.8f;                      // ymin
+        boxes[i * 7 + 5] = boxes[i * 7 + 3] + 0.2f;    // xmax
+        boxes[i * 7 + 6] = boxes[i * 7 + 4] + 0.2f;    // ymax
+    }
+
+    BBox7 postprocessor;
+    DetectionFilter filter = postprocessor.get_filter();
+    filter.confidence_threshold = 0.5f;
+    filter.nms_threshold = 0.5f;
+    postprocessor.set_filter(filter);
+    BBoxList bboxes;
+    postprocessor.postprocess(boxes_tensor, bboxes);
+    const std::size_t allocations_before = get_num_allocations();
+    for (auto _ : state) {
+        postprocessor.postprocess(boxes_tensor, bboxes);
+        benchmark::DoNotOptimize(bboxes.get_rects().data());
+    }
+    report_allocations(state, allocations_before);
+    state.SetItemsProcessed(state.iterations() * num_boxes);
+    state.counters["kept"] = static_cast<double>(bboxes.size());
+}
+BENCHMARK(BM_BBox7_postprocess_filter)->ArgName("detections")->Arg(100)->Arg(200);
+
+static void BM_KeyPoints_postprocess(benchmark::State& state) {
+    const std::size_t size = static_cast<std::size_t>(state.range(0));
+    const ov::Tensor heatmaps_tensor = make_float_tensor({1, 17, size, size}, 0.0f, 1.0f);
+
+    KeyPoints postprocessor;
+    for (auto _ : state) {
+        std::vector<KeyPoint> keypoints = postprocessor.postprocess(heatmaps_tensor);
+        benchmark::DoNotOptimize(keypoints.data());
+    }
+    state.SetBytesProcessed(state.iterations() * heatmaps_tensor.get_byte_size());
+}
+BENCHMARK(BM_KeyPoints_postprocess)->ArgName("heatmap")->Arg(56)->Arg(224);
+
+static void BM_KeyPoints_postprocess_buffer(benchmark::State& state) {
+    // 出力先のバッファをフレーム間で使い回す場合
+    const std::size_t size = static_cast<std::size_t>(state.range(0));
+    const ov::Tensor heatmaps_tensor = make_float_tensor({1, 17, size, size}, 0.0f, 1.0f);
+
+    KeyPoints postprocessor;
+    KeyPointList keypoints;
+    postprocessor.postprocess(heatmaps_tensor, keypoints);
+    const std::size_t allocations_before = get_num_allocations();
+    for (auto _ : state) {
+        postprocessor.postprocess(heatmaps_tensor, keypoints);
+        benchmark::DoNotOptimize(keypoints.get_xs().data());
+    }
+    report_allocations(state, allocations_before);
+    state.SetBytesProcessed(state.iterations() * heatmaps_tensor.get_byte_size());
+}
+BENCHMARK(BM_KeyPoints_postprocess_buffer)->ArgName("heatmap")->Arg(56)->Arg(224);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,136 @@
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+
+#include "cpu_topology.hpp"
+#include "openvino_task.hpp"
+#include "sharded_task.hpp"
+
+// CPUグループ（既定はNUMAノード）を1つずつ増やしながら、シャードごとにモデルを分けた場合と
+// 1つのモデルで同じCPUをすべて使う場合のスループットを比べる
+
+// 1回の計測で流すフレーム数（全シャードのキューが埋まる数より多くする）
+const std::size_t FRAMES_PER_ITERATION = 64;
+
+// 計測の繰り返し回数（シャードの作成は計測ごとに1回だけ行う）
+const std::int64_t NUM_ITERATIONS = 20;
+
+/**
+ * @brief フレームをまとめて非同期に流し、すべての完了を待つ
+ *
+ * @param state ベンチマークの状態
+ * @param model_path モデルのパス
+ * @param config シャードごとの読み込み設定
+ * @param groups CPUグループ
+ */
+static void run_sharded(benchmark::State& state, const std::string& model_path,
+                        const ModelConfig& config, const std::vector<CpuGroup>& groups) {
+    ShardedTask<DetectorBBox7> detector(model_path, config, groups);
+    cv::Mat image(720, 1280, CV_8UC3);
+    cv::randu(image, cv::Scalar::all(0), cv::Scalar::all(255));
+
+    // 最初の推論はメモリ確保などを含むため計測しない
+    detector.task(image);
+
+    std::vector<std::future<DetectorBBox7::Output>> futures(FRAMES_PER_ITERATION);
+    for (auto _ : state) {
+        for (auto& future : futures) {
+            future = detector.task_async(image);
+        }
+        for (auto& future : futures) {
+            benchmark::DoNotOptimize(future.get());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * FRAMES_PER_ITERATION);
+    state.counters["shards"] = static_cast<double>(detector.get_num_shards());
+}
+
+/**
+ * @brief CPUグループ数ごとに、シャードに分けた場合と分けない場合のベンチマークを登録する
+ *
+ * @param model_path モデルのパス
+ * @param config シャードごとの読み込み設定
+ * @param groups CPUグループ
+ */
+static void register_benchmarks(const std::string& model_path, const ModelConfig& config,
+                                const std::vector<CpuGroup>& groups) {
+    for (std::size_t n = 1; n <= groups.size(); n++) {
+        const std::vector<CpuGroup> sharded(groups.begin(), groups.begin() + n);
+
+        // 同じCPUを1つのグループにまとめ、1つのモデルで推論する場合と比べる
+        CpuGroup merged;
+        for (const CpuGroup& group : sharded) {
+            merged.cpus.insert(merged.cpus.end(), group.cpus.begin(), group.cpus.end());
+        }
+        ModelConfig merged_config = config;
+        merged_config.num_requests = config.num_requests * n;
+
+        const std::string suffix = "/groups:" + std::to_string(n);
+        benchmark::RegisterBenchmark(("BM_Sharded" + suffix).c_str(),
+                                     [=](benchmark::State& state) {
+                                         run_sharded(state, model_path, config, sharded);
+                                     })
+            ->Iterations(NUM_ITERATIONS)
+            ->UseRealTime()
+            ->Unit(benchmark::kMillisecond);
+        benchmark::RegisterBenchmark(("BM_Unsharded" + suffix).c_str(),
+                                     [=](benchmark::State& state) {
+                                         run_sharded(state, model_path, merged_config, {merged});
+                                     })
+            ->Iterations(NUM_ITERATIONS)
+            ->UseRealTime()
+            ->Unit(benchmark::kMillisecond);
+    }
+}
+
+int main(int argc, char** argv) {
+    // Google Benchmarkの引数（--benchmark_filter=など）を先に取り除く
+    benchmark::Initialize(&argc, argv);
+
+    // 残りの引数からCPUグループ（--cpu-groups=0-7;8-15）と読み込み設定を取り出す
+    ModelConfig config;
+    std::vector<CpuGroup> groups;
+    try {
+        int num_remaining = 1;
+        for (int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            if (arg.rfind("--cpu-groups=", 0) == 0) {
+                groups = parse_cpu_groups(arg.substr(13));
+            } else {
+                argv[num_remaining++] = argv[i];
+            }
+        }
+        argc = num_remaining;
+        config = parse_model_config_args(argc, argv);
+        if (groups.empty()) {
+            groups = get_numa_nodes();
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (argc != 2) {
+        std::cerr << "Usage: " << argv[0]
+                  << " [--cpu-groups=<list>;<list>...] [benchmark options] <bbox7_model_path>"
+                  << std::endl
+                  << get_model_config_usage();
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Model config: " << config << std::endl;
+    for (const CpuGroup& group : groups) {
+        std::cout << "CPU group: node " << group.node << ", cpus " << format_cpu_list(group.cpus)
+                  << std::endl;
+    }
+
+    register_benchmarks(argv[1], config, groups);
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return EXIT_SUCCESS;
+}
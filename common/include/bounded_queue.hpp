@@ -0,0 +1,101 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+
+/**
+ * @brief 容量に上限があるスレッドセーフなキュー
+ *
+ * 満杯のときpush()は空きができるまで待機し、空のときpop()は要素が来るまで待機する。
+ * close()すると待機中のスレッドをすべて起こし、以降のpush()は失敗する
+ *
+ * @tparam T 要素の型
+ */
+template <typename T>
+class BoundedQueue {
+   private:
+    std::deque<T> items;
+    std::size_t capacity;
+    bool closed = false;
+    mutable std::mutex mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+
+   public:
+    /**
+     * @brief キューを作る
+     *
+     * @param capacity 容量（1以上）
+     */
+    explicit BoundedQueue(const std::size_t capacity) : capacity(capacity) {
+        if (capacity == 0) {
+            throw std::invalid_argument("Queue capacity must be at least 1");
+        }
+    }
+
+    /**
+     * @brief 要素を追加する（満杯なら空きができるまで待機する）
+     *
+     * @param item 要素
+     * @return true 追加した
+     * @return false キューが閉じられている
+     */
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_full.wait(lock, [this]() { return closed || items.size() < capacity; });
+        if (closed) {
+            return false;
+        }
+        items.push_back(std::move(item));
+        lock.unlock();
+        not_empty.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief 要素を取り出す（空なら要素が来るまで待機する）
+     *
+     * @param item 取り出した要素の格納先
+     * @return true 取り出した
+     * @return false キューが閉じられ、かつ空になった
+     */
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_empty.wait(lock, [this]() { return closed || !items.empty(); });
+        if (items.empty()) {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        lock.unlock();
+        not_full.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief キューを閉じる
+     *
+     * 残っている要素はpop()で取り出せる
+     */
+    void close(void) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        not_empty.notify_all();
+        not_full.notify_all();
+    }
+
+    /**
+     * @brief 現在の要素数を返す
+     *
+     * @return std::size_t 要素数
+     */
+    std::size_t size(void) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return items.size();
+    }
+};
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * @brief 推論インスタンスを割り当てるCPUコアのグループ（NUMAノードまたは利用者が指定したコアの組）
+ *
+ */
+struct CpuGroup {
+    /**
+     * @brief NUMAノード番号（利用者が指定したグループやNUMA情報がない場合は-1）
+     *
+     */
+    int node = -1;
+
+    /**
+     * @brief 論理CPU番号（昇順）
+     *
+     */
+    std::vector<int> cpus;
+};
+
+/**
+ * @brief CPUリスト（「0-3,8-11」の形式、sysfsのcpulistと同じ）を論理CPU番号へ展開する
+ *
+ * @param cpu_list CPUリスト
+ * @return std::vector<int> 論理CPU番号（昇順、重複なし）
+ */
+std::vector<int> parse_cpu_list(const std::string& cpu_list);
+
+/**
+ * @brief 論理CPU番号をCPUリスト（「0-3,8-11」の形式）にまとめる
+ *
+ * @param cpus 論理CPU番号
+ * @return std::string CPUリスト
+ */
+std::string format_cpu_list(const std::vector<int>& cpus);
+
+/**
+ * @brief 「;」で区切った複数のCPUリスト（「0-7;8-15」など）をグループに分ける
+ *
+ * @param cpu_groups CPUリストを「;」で区切った文字列
+ * @return std::vector<CpuGroup> グループ（NUMAノード番号は-1）
+ */
+std::vector<CpuGroup> parse_cpu_groups(const std::string& cpu_groups);
+
+/**
+ * @brief 呼び出し元スレッドが実行を許可されている論理CPU番号を返す
+ *
+ * @return std::vector<int> 論理CPU番号（昇順）
+ */
+std::vector<int> get_allowed_cpus(void);
+
+/**
+ * @brief NUMAノードごとのCPUグループを返す
+ *
+ * /sys/devices/system/node から読み取り、実行を許可されていないCPUを除く。
+ * NUMA情報がない環境では、許可されたすべてのCPUを1つのグループとして返す
+ *
+ * @return std::vector<CpuGroup> NUMAノードごとのCPUグループ（CPUがないノードは含まない）
+ */
+std::vector<CpuGroup> get_numa_nodes(void);
+
+/**
+ * @brief 呼び出し元スレッドを指定したCPUへ固定する
+ *
+ * 以降にこのスレッドが作るスレッドも同じCPUへ固定される
+ *
+ * @param cpus 論理CPU番号
+ */
+void bind_current_thread(const std::vector<int>& cpus);
+
+/**
+ * @brief 指定したCPUへ固定した一時スレッドで処理を実行し、完了を待つ
+ *
+ * 処理中に作られたスレッド（推論ライブラリのワーカーなど）も同じCPUへ固定される。
+ * 処理で発生した例外は呼び出し元へ再送出する
+ *
+ * @param cpus 論理CPU番号
+ * @param function 処理
+ */
+void run_on_cpus(const std::vector<int>& cpus, const std::function<void(void)>& function);
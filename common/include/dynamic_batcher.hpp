@@ -0,0 +1,282 @@
+#pragma once
+
+#include <pthread.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <opencv2/opencv.hpp>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief 動的バッチングの設定
+ *
+ */
+struct BatchingConfig {
+    /**
+     * @brief 1回の推論にまとめる最大画像数
+     *
+     */
+    std::size_t max_batch_size = 8;
+
+    /**
+     * @brief 最も古い要求が届いてから、バッチが埋まるのを待つ最大時間
+     *
+     */
+    std::chrono::microseconds max_wait{2000};
+
+    /**
+     * @brief 同時に推論するバッチ数（ワーカースレッド数、推論リクエスト数に合わせる）
+     *
+     */
+    std::size_t num_workers = 1;
+
+    /**
+     * @brief 処理待ちの要求数の上限（超えるとsubmit()が待機する）
+     *
+     */
+    std::size_t queue_capacity = 64;
+};
+
+/**
+ * @brief 動的バッチングの統計
+ *
+ */
+struct BatchingStats {
+    std::uint64_t num_requests = 0;  // 処理した要求数
+    std::uint64_t num_batches = 0;   // 推論したバッチ数
+    std::size_t num_pending = 0;     // 処理待ちの要求数
+
+    /**
+     * @brief バッチの平均画像数を返す
+     *
+     * @return double 平均画像数（推論していなければ0）
+     */
+    double get_average_batch_size(void) const {
+        return num_batches > 0 ? static_cast<double>(num_requests) / num_batches : 0.0;
+    }
+};
+
+/**
+ * @brief 複数の呼び出し元から届いた画像をまとめてバッチ推論する
+ *
+ * 最も古い要求が届いてからmax_waitが経つか、それと同じ大きさ・型の画像がmax_batch_size個たまった時点で
+ * バッチを作り、タスクの複数画像版task()で推論する。バッチを集めるのは一度に1つのワーカースレッドだけで、
+ * 集め終えたワーカーが推論している間に次のワーカーが次のバッチを集める
+ *
+ * @tparam Task タスク（DetectorBBox7など、画像のリストからBufferのリストへ出力できること）
+ */
+template <typename Task>
+class DynamicBatcher {
+   public:
+    /**
+     * @brief タスクの出力を書き込むバッファの型
+     *
+     */
+    using Buffer = typename Task::Buffer;
+
+    /**
+     * @brief 要求の完了時に呼ばれるコールバック（ワーカースレッドから呼ばれ、例外を投げないこと）
+     *
+     * 第1引数は画像の出力（コールバックの中でだけ有効）、第2引数は発生した例外（正常終了時はnullptr）
+     */
+    using Callback = std::function<void(const Buffer&, std::exception_ptr)>;
+
+   private:
+    struct Job {
+        cv::Mat image;
+        Callback callback;
+        std::chrono::steady_clock::time_point arrived_at;
+    };
+
+    Task& task;
+    BatchingConfig config;
+
+    std::deque<Job> jobs;
+    bool stopped = false;
+    std::mutex mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+
+    // バッチを集めるワーカーを1つに限る
+    std::mutex collect_mutex;
+
+    std::vector<std::thread> workers;
+    std::atomic<std::uint64_t> num_requests{0};
+    std::atomic<std::uint64_t> num_batches{0};
+
+    /**
+     * @brief 次のバッチを集める
+     *
+     * バッチ推論は同じ大きさ・型の画像しかまとめられないため、最も古い要求と同じ大きさ・型の要求だけを
+     * 届いた順に集める。異なる要求は順序を保って残し、次のバッチで処理する
+     *
+     * @param batch バッチの格納先
+     * @return true 集めた
+     * @return false 停止され、処理待ちの要求がない
+     */
+    bool collect(std::vector<Job>& batch) {
+        batch.clear();
+        std::lock_guard<std::mutex> collect_lock(collect_mutex);
+        std::unique_lock<std::mutex> lock(mutex);
+        not_empty.wait(lock, [this]() { return stopped || !jobs.empty(); });
+        if (jobs.empty()) {
+            return false;
+        }
+
+        const cv::Size size = jobs.front().image.size();
+        const int type = jobs.front().image.type();
+        const auto is_batchable = [&size, type](const Job& job) {
+            return job.image.size() == size && job.image.type() == type;
+        };
+
+        // 停止後は待たずに残りを処理する
+        const auto deadline = jobs.front().arrived_at + config.max_wait;
+        not_empty.wait_until(lock, deadline, [this, &is_batchable]() {
+            const auto num_batchable = std::count_if(jobs.begin(), jobs.end(), is_batchable);
+            return stopped || static_cast<std::size_t>(num_batchable) >= config.max_batch_size;
+        });
+
+        for (auto it = jobs.begin(); it != jobs.end() && batch.size() < config.max_batch_size;) {
+            if (is_batchable(*it)) {
+                batch.push_back(std::move(*it));
+                it = jobs.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        lock.unlock();
+        not_full.notify_all();
+        return true;
+    }
+
+    /**
+     * @brief ワーカースレッドの処理
+     *
+     * @param name スレッド名
+     */
+    void run_worker(const std::string& name) {
+        pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+
+        std::vector<Job> batch;
+        std::vector<cv::Mat> images;
+        std::vector<Buffer> outputs;
+        const Buffer empty_output{};
+        while (collect(batch)) {
+            images.clear();
+            for (const Job& job : batch) {
+                images.push_back(job.image);
+            }
+
+            std::exception_ptr exception = nullptr;
+            try {
+                task.task(images, outputs);
+            } catch (...) {
+                exception = std::current_exception();
+            }
+
+            for (std::size_t i = 0; i < batch.size(); i++) {
+                try {
+                    batch[i].callback(exception ? empty_output : outputs[i], exception);
+                } catch (...) {
+                    // コールバックの例外で他の要求の応答を止めない
+                }
+            }
+            num_requests += batch.size();
+            num_batches++;
+        }
+    }
+
+    /**
+     * @brief ワーカースレッドを止める
+     *
+     */
+    void stop(void) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopped = true;
+        }
+        not_empty.notify_all();
+        not_full.notify_all();
+        for (std::thread& worker : workers) {
+            if (worker.joinable()) {
+                worker.join();
+            }
+        }
+    }
+
+   public:
+    /**
+     * @brief ワーカースレッドを起動する
+     *
+     * @param task タスク（推論リクエスト数をnum_workers以上、最大バッチサイズをmax_batch_size以上にする）
+     * @param config 動的バッチングの設定
+     */
+    DynamicBatcher(Task& task, const BatchingConfig& config = BatchingConfig())
+        : task(task), config(config) {
+        if (config.max_batch_size == 0) {
+            throw std::invalid_argument("max_batch_size must be greater than 0");
+        }
+        if (config.num_workers == 0) {
+            throw std::invalid_argument("DynamicBatcher needs at least one worker");
+        }
+        if (config.queue_capacity == 0) {
+            throw std::invalid_argument("Queue capacity must be at least 1");
+        }
+        for (std::size_t i = 0; i < config.num_workers; i++) {
+            workers.emplace_back(&DynamicBatcher::run_worker, this, "batch" + std::to_string(i));
+        }
+    }
+
+    /**
+     * @brief 処理待ちの要求をすべて処理してからワーカースレッドを止める
+     *
+     */
+    ~DynamicBatcher(void) { stop(); }
+
+    DynamicBatcher(const DynamicBatcher&) = delete;
+    DynamicBatcher& operator=(const DynamicBatcher&) = delete;
+
+    /**
+     * @brief 画像の推論を要求する（処理待ちが上限に達していれば空きができるまで待機する）
+     *
+     * @param image 入力画像（推論が終わるまで書き換えないこと）
+     * @param callback 完了時の処理
+     */
+    void submit(const cv::Mat& image, Callback callback) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            not_full.wait(lock,
+                          [this]() { return stopped || jobs.size() < config.queue_capacity; });
+            if (stopped) {
+                throw std::runtime_error("DynamicBatcher is stopped");
+            }
+            jobs.push_back(Job{image, std::move(callback), std::chrono::steady_clock::now()});
+        }
+        not_empty.notify_one();
+    }
+
+    /**
+     * @brief 統計を返す
+     *
+     * @return BatchingStats 統計
+     */
+    BatchingStats get_stats(void) {
+        BatchingStats stats;
+        stats.num_requests = num_requests.load();
+        stats.num_batches = num_batches.load();
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.num_pending = jobs.size();
+        return stats;
+    }
+};
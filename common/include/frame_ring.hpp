@@ -0,0 +1,317 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+
+/**
+ * @brief フレームリングの設定（すべてのスロットが同じ大きさ・型の画像を持つ）
+ *
+ */
+struct FrameRingConfig {
+    /**
+     * @brief スロット数（取り込みと推論の間にためられる最大フレーム数）
+     *
+     */
+    std::size_t num_slots = 8;
+
+    /**
+     * @brief 画像の幅
+     *
+     */
+    int width = 0;
+
+    /**
+     * @brief 画像の高さ
+     *
+     */
+    int height = 0;
+
+    /**
+     * @brief 画像の型（cv::Matの型）
+     *
+     */
+    int type = CV_8UC3;
+};
+
+/**
+ * @brief 共有メモリの先頭（インデックスや待機用の値を持つ、frame_ring.cppで定義）
+ *
+ */
+struct FrameRingHeader;
+
+/**
+ * @brief リングから取り出したフレーム
+ *
+ */
+struct RingFrame {
+    /**
+     * @brief スロットを参照する画像（FrameRingConsumer::release()まで有効）
+     *
+     */
+    cv::Mat image;
+
+    /**
+     * @brief 書き込み側が付けたフレーム番号
+     *
+     */
+    std::uint64_t frame_index = 0;
+
+    /**
+     * @brief 書き込んだ時刻（steady_clockの値[ns]、同じホストのプロセス間で比較できる）
+     *
+     */
+    std::int64_t timestamp_ns = 0;
+};
+
+/**
+ * @brief POSIX共有メモリ上に固定サイズのフレームのスロットを並べたリングバッファ
+ *
+ * 書き込み側1プロセスと読み出し側1プロセスの間で、画像をエンコード・コピーせずに受け渡す。
+ * 読み書きのインデックスはロックを使わずに更新し、待機はfutexで行う
+ */
+class FrameRing {
+   protected:
+    std::string name;
+    FrameRingConfig config;
+    void* address = nullptr;
+    std::size_t length = 0;
+    FrameRingHeader* header = nullptr;
+
+    FrameRing(void) = default;
+
+    /**
+     * @brief 共有メモリをメモリマップする
+     *
+     * @param fd 共有メモリのファイルディスクリプタ
+     * @param size 共有メモリのサイズ[byte]
+     */
+    void map(const int fd, const std::size_t size);
+
+    /**
+     * @brief インデックスのスロットを参照する画像を返す
+     *
+     * @param index 読み書きのインデックス
+     * @return cv::Mat 画像
+     */
+    cv::Mat get_slot_image(const std::uint64_t index) const;
+
+   public:
+    /**
+     * @brief メモリマップを解除する
+     *
+     */
+    virtual ~FrameRing(void);
+
+    FrameRing(const FrameRing&) = delete;
+    FrameRing& operator=(const FrameRing&) = delete;
+
+    /**
+     * @brief 共有メモリの名前を返す
+     *
+     * @return const std::string& 名前（"/camera0"など）
+     */
+    const std::string& get_name(void) const;
+
+    /**
+     * @brief リングの設定を返す
+     *
+     * @return const FrameRingConfig& 設定
+     */
+    const FrameRingConfig& get_config(void) const;
+};
+
+/**
+ * @brief フレームリングの書き込み側（取り込みプロセスで1つだけ使う）
+ *
+ * acquire()で空いたスロットを参照する画像を受け取り、そこへ直接デコード・書き込みしてからcommit()する
+ */
+class FrameRingProducer : public FrameRing {
+   private:
+    std::uint64_t write_index = 0;
+    bool acquired = false;
+
+   public:
+    /**
+     * @brief 共有メモリを作ってリングを初期化する（同じ名前の共有メモリがあれば作り直す）
+     *
+     * @param name 共有メモリの名前（"/camera0"など、"/"で始まる）
+     * @param config リングの設定
+     */
+    FrameRingProducer(const std::string& name, const FrameRingConfig& config);
+
+    /**
+     * @brief リングを閉じて共有メモリの名前を削除する（読み出し側は残りのフレームを読める）
+     *
+     */
+    ~FrameRingProducer(void) override;
+
+    /**
+     * @brief 空いたスロットを受け取る（空きがなければ読み出されるまで待機する）
+     *
+     * @param timeout 待機する最大時間
+     * @return cv::Mat スロットを参照する画像（タイムアウトした場合は空）
+     */
+    cv::Mat acquire(const std::chrono::milliseconds timeout);
+
+    /**
+     * @brief 空いたスロットを待たずに受け取る
+     *
+     * @return cv::Mat スロットを参照する画像（空きがなければ空、呼び出し元はフレームを捨てる）
+     */
+    cv::Mat try_acquire(void);
+
+    /**
+     * @brief acquire()で受け取ったスロットを書き終え、読み出し側へ渡す
+     *
+     * @param frame_index フレーム番号
+     */
+    void commit(const std::uint64_t frame_index);
+
+    /**
+     * @brief 画像をスロットへコピーして書き込む（画像を直接スロットへ書けない場合に使う）
+     *
+     * @param image 画像（リングと同じ大きさ・型であること）
+     * @param frame_index フレーム番号
+     * @param timeout 空きを待つ最大時間
+     * @return true 書き込んだ
+     * @return false タイムアウトした
+     */
+    bool push(const cv::Mat& image, const std::uint64_t frame_index,
+              const std::chrono::milliseconds timeout);
+
+    /**
+     * @brief リングを閉じる（読み出し側は残りのフレームを読み終えるとacquire()がfalseを返す）
+     *
+     */
+    void close(void);
+};
+
+/**
+ * @brief フレームリングの読み出し側（推論プロセスで1つだけ使う）
+ *
+ * acquire()で書き込み済みのフレームをまとめて参照し、使い終えたらrelease()でスロットを返す
+ */
+class FrameRingConsumer : public FrameRing {
+   private:
+    std::uint64_t read_index = 0;
+    std::size_t num_acquired = 0;
+
+   public:
+    /**
+     * @brief 書き込み側が作った共有メモリを開く
+     *
+     * @param name 共有メモリの名前
+     */
+    explicit FrameRingConsumer(const std::string& name);
+
+    /**
+     * @brief 書き込み済みのフレームを受け取る（なければ書き込まれるまで待機する）
+     *
+     * @param frames 受け取ったフレームの格納先（スロットを参照する）
+     * @param max_count 一度に受け取る最大フレーム数
+     * @param timeout 待機する最大時間
+     * @return true 1つ以上受け取った
+     * @return false タイムアウトした、またはリングが閉じられて残りのフレームがない
+     */
+    bool acquire(std::vector<RingFrame>& frames, const std::size_t max_count,
+                 const std::chrono::milliseconds timeout);
+
+    /**
+     * @brief acquire()で受け取ったフレームのスロットを書き込み側へ返す
+     *
+     */
+    void release(void);
+
+    /**
+     * @brief リングが閉じられ、残りのフレームをすべて受け取ったかどうかを返す
+     *
+     * @return true 終了した
+     * @return false 終了していない
+     */
+    bool is_finished(void) const;
+};
+
+/**
+ * @brief フレームリングから受け取ったフレームをコピーせずにタスクの複数画像版task()で推論する
+ *
+ * @tparam Task タスク（DetectorBBox7など、画像のリストからBufferのリストへ出力できること）
+ */
+template <typename Task>
+class RingInference {
+   public:
+    /**
+     * @brief タスクの出力を書き込むバッファの型
+     *
+     */
+    using Buffer = typename Task::Buffer;
+
+   private:
+    FrameRingConsumer& consumer;
+    Task& task;
+    std::size_t max_batch_size;
+
+    std::vector<RingFrame> frames;
+    std::vector<cv::Mat> images;
+    std::vector<Buffer> outputs;
+
+   public:
+    /**
+     * @brief 推論の準備をする
+     *
+     * @param consumer フレームリングの読み出し側
+     * @param task タスク
+     * @param max_batch_size 1回に推論する最大フレーム数
+     */
+    RingInference(FrameRingConsumer& consumer, Task& task, const std::size_t max_batch_size)
+        : consumer(consumer), task(task), max_batch_size(max_batch_size) {}
+
+    /**
+     * @brief 前回のフレームを返し、次のフレームをまとめて推論する
+     *
+     * 推論したフレームのスロットは次のnext()またはrelease()まで参照できる
+     *
+     * @param timeout フレームを待つ最大時間
+     * @return true 推論した
+     * @return false タイムアウトした、またはリングが終了した
+     */
+    bool next(const std::chrono::milliseconds timeout) {
+        release();
+        if (!consumer.acquire(frames, max_batch_size, timeout)) {
+            return false;
+        }
+        images.clear();
+        for (const RingFrame& frame : frames) {
+            images.push_back(frame.image);
+        }
+        task.task(images, outputs);
+        return true;
+    }
+
+    /**
+     * @brief 推論したフレームのスロットを返す
+     *
+     */
+    void release(void) {
+        frames.clear();
+        images.clear();
+        consumer.release();
+    }
+
+    /**
+     * @brief 推論したフレームを返す
+     *
+     * @return const std::vector<RingFrame>& フレーム
+     */
+    const std::vector<RingFrame>& get_frames(void) const { return frames; }
+
+    /**
+     * @brief フレームごとの出力を返す
+     *
+     * @return const std::vector<Buffer>& 出力
+     */
+    const std::vector<Buffer>& get_outputs(void) const { return outputs; }
+};
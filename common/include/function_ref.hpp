@@ -0,0 +1,46 @@
+#pragma once
+
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+/**
+ * @brief 呼び出し可能なオブジェクトを所有せずに参照する関数オブジェクト
+ *
+ * std::functionと異なり、ラムダ式をコピーせずメモリも確保しない。
+ * 呼び出しの間だけ使うコールバックの引数に使い、参照先は呼び出しが終わるまで破棄しないこと
+ *
+ * @tparam Signature 関数の型（void(ov::InferRequest&)など）
+ */
+template <typename Signature>
+class FunctionRef;
+
+template <typename Result, typename... Args>
+class FunctionRef<Result(Args...)> {
+   private:
+    void* callable = nullptr;
+    Result (*invoke)(void*, Args...) = nullptr;
+
+   public:
+    /**
+     * @brief 呼び出し可能なオブジェクトを参照する
+     *
+     * @tparam Callable ラムダ式・関数オブジェクト・std::functionなど
+     * @param callable 参照するオブジェクト
+     */
+    template <typename Callable,
+              typename = std::enable_if_t<!std::is_same_v<std::decay_t<Callable>, FunctionRef> &&
+                                          std::is_invocable_r_v<Result, Callable&, Args...>>>
+    FunctionRef(Callable&& callable)
+        : callable(const_cast<void*>(static_cast<const void*>(std::addressof(callable)))),
+          invoke([](void* callable, Args... args) -> Result {
+              return (*static_cast<std::remove_reference_t<Callable>*>(callable))(
+                  std::forward<Args>(args)...);
+          }) {}
+
+    /**
+     * @brief 参照先を呼び出す
+     *
+     */
+    Result operator()(Args... args) const { return invoke(callable, std::forward<Args>(args)...); }
+};
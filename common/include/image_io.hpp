@@ -0,0 +1,250 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bounded_queue.hpp"
+
+/**
+ * @brief 読み取り専用でメモリマップしたファイル
+ *
+ */
+class MappedFile {
+   private:
+    void* address = nullptr;
+    std::size_t length = 0;
+
+   public:
+    /**
+     * @brief ファイルをメモリマップする
+     *
+     * @param path ファイルパス
+     */
+    explicit MappedFile(const std::string& path);
+
+    /**
+     * @brief メモリマップを解除する
+     *
+     */
+    ~MappedFile(void);
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+     * @brief ファイルの内容を返す
+     *
+     * @return const unsigned char* 先頭アドレス（空ファイルならnullptr）
+     */
+    const unsigned char* data(void) const;
+
+    /**
+     * @brief ファイルサイズを返す
+     *
+     * @return std::size_t ファイルサイズ[byte]
+     */
+    std::size_t size(void) const;
+};
+
+/**
+ * @brief 画像ファイルをメモリマップしてデコードする
+ *
+ * ファイルの内容をコピーせずにcv::imdecode()へ渡す
+ *
+ * @param path ファイルパス
+ * @param flags cv::imdecode()のフラグ
+ * @return cv::Mat 画像
+ */
+cv::Mat read_image(const std::string& path, const int flags = cv::IMREAD_COLOR);
+
+/**
+ * @brief 画像を拡張子に応じた形式でエンコードしてファイルへ書き込む
+ *
+ * @param path ファイルパス
+ * @param image 画像
+ * @param params cv::imencode()のパラメータ
+ */
+void write_image(const std::string& path, const cv::Mat& image,
+                 const std::vector<int>& params = std::vector<int>());
+
+/**
+ * @brief デコードした画像
+ *
+ */
+struct DecodedImage {
+    /**
+     * @brief ファイルパス
+     *
+     */
+    std::string path;
+
+    /**
+     * @brief 画像（デコードに失敗した場合は空）
+     *
+     */
+    cv::Mat image;
+
+    /**
+     * @brief 読み込み・デコードで発生した例外（正常終了時はnullptr）
+     *
+     */
+    std::exception_ptr exception = nullptr;
+};
+
+/**
+ * @brief 画像ファイルを複数スレッドで先読みしてデコードする
+ *
+ * 呼び出し元が取り出した位置から最大readahead枚先までをワーカースレッドでデコードし、
+ * next()で入力順に返す
+ */
+class ImageReader {
+   private:
+    std::vector<std::string> paths;
+    int flags;
+    std::size_t readahead;
+
+    std::vector<std::thread> workers;
+    std::map<std::size_t, DecodedImage> decoded;
+    std::size_t next_decode = 0;
+    std::size_t next_output = 0;
+    bool stopped = false;
+    std::mutex mutex;
+    std::condition_variable worker_cv;
+    std::condition_variable output_cv;
+
+    /**
+     * @brief ワーカースレッドの処理
+     *
+     */
+    void run_worker(void);
+
+   public:
+    /**
+     * @brief ワーカースレッドを起動してデコードを始める
+     *
+     * @param paths 画像ファイルのパスのリスト
+     * @param num_workers ワーカースレッド数
+     * @param readahead 先読みする画像数
+     * @param flags cv::imdecode()のフラグ
+     */
+    ImageReader(std::vector<std::string> paths, const std::size_t num_workers,
+                const std::size_t readahead, const int flags = cv::IMREAD_COLOR);
+
+    /**
+     * @brief デコードを中断してワーカースレッドを終了する
+     *
+     */
+    ~ImageReader(void);
+
+    ImageReader(const ImageReader&) = delete;
+    ImageReader& operator=(const ImageReader&) = delete;
+
+    /**
+     * @brief 次の画像を取り出す（デコードが終わっていなければ待機する）
+     *
+     * @param image 取り出した画像の格納先
+     * @return true 取り出した
+     * @return false すべての画像を取り出し終えた
+     */
+    bool next(DecodedImage& image);
+
+    /**
+     * @brief 画像ファイルの数を返す
+     *
+     * @return std::size_t 画像ファイルの数
+     */
+    std::size_t size(void) const;
+};
+
+/**
+ * @brief 画像のエンコードとファイルへの書き込みを複数スレッドで非同期に行う
+ *
+ */
+class ImageWriter {
+   public:
+    /**
+     * @brief 書き込みに失敗したときに呼ばれるコールバック（ワーカースレッドから呼ばれる）
+     *
+     */
+    using ErrorCallback = std::function<void(const std::string&, std::exception_ptr)>;
+
+   private:
+    struct Request {
+        std::string path;
+        cv::Mat image;
+        std::vector<int> params;
+    };
+
+    BoundedQueue<Request> requests;
+    std::vector<std::thread> workers;
+    ErrorCallback on_error;
+    std::atomic<std::size_t> num_written{0};
+    std::atomic<std::size_t> num_failed{0};
+
+    /**
+     * @brief ワーカースレッドの処理
+     *
+     */
+    void run_worker(void);
+
+   public:
+    /**
+     * @brief ワーカースレッドを起動する
+     *
+     * @param num_workers ワーカースレッド数
+     * @param queue_capacity 書き込み待ちの画像数の上限（超えるとwrite()が待機する）
+     * @param on_error 書き込みに失敗したときの処理
+     */
+    ImageWriter(const std::size_t num_workers, const std::size_t queue_capacity = 16,
+                ErrorCallback on_error = nullptr);
+
+    /**
+     * @brief 書き込み待ちの画像をすべて書き込んでから終了する
+     *
+     */
+    ~ImageWriter(void);
+
+    ImageWriter(const ImageWriter&) = delete;
+    ImageWriter& operator=(const ImageWriter&) = delete;
+
+    /**
+     * @brief 画像の書き込みを予約する
+     *
+     * 画像のデータは書き込みが終わるまで参照されるため、呼び出し後に書き換えないこと
+     *
+     * @param path ファイルパス（拡張子でエンコード形式を決める）
+     * @param image 画像
+     * @param params cv::imencode()のパラメータ
+     */
+    void write(const std::string& path, const cv::Mat& image,
+               const std::vector<int>& params = std::vector<int>());
+
+    /**
+     * @brief 予約済みの画像をすべて書き込み、ワーカースレッドを終了する
+     *
+     */
+    void wait(void);
+
+    /**
+     * @brief 書き込んだ画像数を返す
+     *
+     * @return std::size_t 書き込んだ画像数
+     */
+    std::size_t get_num_written(void) const;
+
+    /**
+     * @brief 書き込みに失敗した画像数を返す
+     *
+     * @return std::size_t 書き込みに失敗した画像数
+     */
+    std::size_t get_num_failed(void) const;
+};
@@ -0,0 +1,260 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "result_objects.hpp"
+
+/**
+ * @brief 推論サーバーとクライアントの間のメッセージの種類
+ *
+ */
+enum class MessageType : std::uint32_t {
+    Infer = 1,   // 推論の要求（ImageHeaderと画像のデータ）
+    Result = 2,  // 推論の結果（statusが0なら結果、それ以外はエラーメッセージ）
+};
+
+/**
+ * @brief 要求する画像のデータ形式
+ *
+ */
+enum class ImageEncoding : std::uint32_t {
+    Raw = 0,      // 連続した画素値（幅・高さ・cv::Matの型で解釈する）
+    Encoded = 1,  // JPEG・PNGなどのファイルの内容（サーバーでデコードする）
+};
+
+/**
+ * @brief メッセージの先頭（続いてpayload_sizeバイトのデータ）
+ *
+ * ホストのバイトオーダーで送る（同じホスト内のUnixドメインソケットでだけ使う）
+ */
+struct MessageHeader {
+    std::uint32_t magic;         // MESSAGE_MAGIC
+    std::uint32_t type;          // MessageType
+    std::uint64_t request_id;    // 要求ごとの番号（結果は同じ番号で返す）
+    std::uint32_t payload_size;  // データのサイズ[byte]
+    std::uint32_t status;        // 結果の状態（0なら成功）
+};
+
+/**
+ * @brief 推論の要求のデータの先頭（続いて画像のデータ）
+ *
+ */
+struct ImageHeader {
+    std::uint32_t encoding;  // ImageEncoding
+    std::int32_t width;      // 幅（Encodedでは0）
+    std::int32_t height;     // 高さ（Encodedでは0）
+    std::int32_t type;       // cv::Matの型（Encodedでは0）
+};
+
+constexpr std::uint32_t MESSAGE_MAGIC = 0x4d52564f;  // "OVRM"
+
+/**
+ * @brief 1メッセージのデータの上限[byte]（壊れたヘッダで巨大なメモリを確保しないようにする）
+ *
+ */
+constexpr std::uint32_t MAX_PAYLOAD_SIZE = 256 * 1024 * 1024;
+
+/**
+ * @brief 推論の結果
+ *
+ */
+struct InferenceResult {
+    BBoxList bboxes;                  // 検知枠（正規化座標）
+    std::vector<KeyPointList> poses;  // 人物ごとの骨格（正規化座標）
+};
+
+/**
+ * @brief サーバーで推論の要求が失敗したことを表す例外（接続は引き続き使える）
+ *
+ */
+class InferenceError : public std::runtime_error {
+   private:
+    std::uint64_t request_id;
+
+   public:
+    /**
+     * @brief 例外を作る
+     *
+     * @param request_id 失敗した要求の番号
+     * @param message サーバーから届いたエラーメッセージ
+     */
+    InferenceError(const std::uint64_t request_id, const std::string& message);
+
+    /**
+     * @brief 失敗した要求の番号を返す
+     *
+     * @return std::uint64_t 要求の番号
+     */
+    std::uint64_t get_request_id(void) const;
+};
+
+/**
+ * @brief Unixドメインソケットで待ち受ける（同じパスのソケットファイルがあれば削除する）
+ *
+ * @param path ソケットファイルのパス
+ * @param backlog 接続待ちの上限
+ * @return int 待ち受けソケットのファイルディスクリプタ
+ */
+int listen_unix_socket(const std::string& path, const int backlog = 64);
+
+/**
+ * @brief Unixドメインソケットで接続する
+ *
+ * @param path ソケットファイルのパス
+ * @return int ソケットのファイルディスクリプタ
+ */
+int connect_unix_socket(const std::string& path);
+
+/**
+ * @brief メッセージを送る（データが分割されて届かないよう、先頭とデータをまとめて送る）
+ *
+ * @param fd ソケット
+ * @param header メッセージの先頭（payload_sizeとmagicは上書きする）
+ * @param payload データ
+ * @param payload_size データのサイズ[byte]
+ */
+void send_message(const int fd, MessageHeader header, const void* payload,
+                  const std::size_t payload_size);
+
+/**
+ * @brief メッセージを受け取る
+ *
+ * @param fd ソケット
+ * @param header メッセージの先頭の格納先
+ * @param payload データの格納先（確保済みのメモリを使い回す）
+ * @return true 受け取った
+ * @return false メッセージの境界で接続が閉じられた
+ */
+bool receive_message(const int fd, MessageHeader& header, std::vector<char>& payload);
+
+/**
+ * @brief 推論の要求のデータを作る
+ *
+ * @param image 画像（8bitの画素値の配列、連続していなければコピーする）
+ * @param payload データの格納先
+ */
+void encode_image(const cv::Mat& image, std::vector<char>& payload);
+
+/**
+ * @brief エンコード済みの画像から推論の要求のデータを作る
+ *
+ * @param data JPEG・PNGなどのファイルの内容
+ * @param payload データの格納先
+ */
+void encode_image(const std::vector<unsigned char>& data, std::vector<char>& payload);
+
+/**
+ * @brief 推論の要求のデータから画像を取り出す
+ *
+ * Rawの場合はデータを参照するだけでコピーしないため、画像を使い終わるまでpayloadを書き換えないこと
+ *
+ * @param payload データ
+ * @return cv::Mat 画像
+ */
+cv::Mat decode_image(const std::vector<char>& payload);
+
+/**
+ * @brief 検知結果から推論の結果のデータを作る
+ *
+ * @param bboxes 検知枠
+ * @param payload データの格納先
+ */
+void encode_result(const BBoxList& bboxes, std::vector<char>& payload);
+
+/**
+ * @brief 1人分の骨格から推論の結果のデータを作る
+ *
+ * @param keypoints 骨格
+ * @param payload データの格納先
+ */
+void encode_result(const KeyPointList& keypoints, std::vector<char>& payload);
+
+/**
+ * @brief 複数人の骨格から推論の結果のデータを作る
+ *
+ * @param poses 人物ごとの骨格
+ * @param payload データの格納先
+ */
+void encode_result(const std::vector<Pose>& poses, std::vector<char>& payload);
+
+/**
+ * @brief 推論の結果のデータを読む
+ *
+ * @param payload データ
+ * @param result 結果の格納先（確保済みのメモリを使い回す）
+ */
+void decode_result(const std::vector<char>& payload, InferenceResult& result);
+
+/**
+ * @brief 推論サーバーのクライアント
+ *
+ * 結果を待たずに複数の要求を送れる（結果は要求の順に届くとは限らないため、番号で対応付ける）
+ */
+class InferenceClient {
+   private:
+    int fd = -1;
+    std::uint64_t next_request_id = 0;
+    std::vector<char> request;
+    std::vector<char> response;
+
+    /**
+     * @brief 作成済みの要求を送る
+     *
+     * @return std::uint64_t 要求の番号
+     */
+    std::uint64_t send_request(void);
+
+   public:
+    /**
+     * @brief サーバーへ接続する
+     *
+     * @param socket_path ソケットファイルのパス
+     */
+    explicit InferenceClient(const std::string& socket_path);
+
+    /**
+     * @brief 接続を閉じる
+     *
+     */
+    ~InferenceClient(void);
+
+    InferenceClient(const InferenceClient&) = delete;
+    InferenceClient& operator=(const InferenceClient&) = delete;
+
+    /**
+     * @brief 画像の画素値を送って推論を要求する
+     *
+     * @param image 画像
+     * @return std::uint64_t 要求の番号
+     */
+    std::uint64_t send(const cv::Mat& image);
+
+    /**
+     * @brief エンコード済みの画像を送って推論を要求する
+     *
+     * @param data JPEG・PNGなどのファイルの内容
+     * @return std::uint64_t 要求の番号
+     */
+    std::uint64_t send(const std::vector<unsigned char>& data);
+
+    /**
+     * @brief 次に届いた結果を受け取る（サーバーで推論に失敗した場合はInferenceErrorを投げる）
+     *
+     * @param result 結果の格納先
+     * @return std::uint64_t 結果に対応する要求の番号
+     */
+    std::uint64_t receive(InferenceResult& result);
+
+    /**
+     * @brief 画像を送って結果を待つ（結果を待っている要求がないときに使う）
+     *
+     * @param image 画像
+     * @param result 結果の格納先
+     */
+    void infer(const cv::Mat& image, InferenceResult& result);
+};
@@ -0,0 +1,228 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <ostream>
+#include <string>
+
+/**
+ * @brief 推論デバイスへ指示する性能の方針（ov::hint::performance_mode）
+ *
+ */
+enum class PerformanceMode {
+    Default,               // デバイスの既定値
+    Latency,               // 1回の推論のレイテンシを優先する
+    Throughput,            // 複数の推論を並列に実行し、スループットを優先する
+    CumulativeThroughput,  // 複数デバイスを合わせたスループットを優先する（AUTOデバイス向け）
+};
+
+/**
+ * @brief 性能の方針の名前を返す
+ *
+ * @param mode 性能の方針
+ * @return const char* 名前（"default"、"latency"、"throughput"、"cumulative_throughput"）
+ */
+const char* get_performance_mode_name(const PerformanceMode mode);
+
+/**
+ * @brief モデルの読み込み設定
+ *
+ */
+struct ModelConfig {
+    /**
+     * @brief 推論デバイス
+     *
+     */
+    std::string device = "CPU";
+
+    /**
+     * @brief 同時に実行できる推論リクエスト数
+     *
+     * 非同期実行（task_async()）で前処理と推論を重ねるには2以上にする
+     */
+    std::size_t num_requests = 1;
+
+    /**
+     * @brief 1回の推論で入力できる最大バッチサイズ（2以上の場合、バッチ次元を動的にする）
+     *
+     */
+    std::size_t max_batch_size = 1;
+
+    /**
+     * @brief 入力の高さを変更する場合の高さ（0ならモデルのまま）
+     *
+     * dynamic_input_sizeがtrueの場合は高さの上限になる
+     */
+    std::size_t input_height = 0;
+
+    /**
+     * @brief 入力の幅を変更する場合の幅（0ならモデルのまま）
+     *
+     * dynamic_input_sizeがtrueの場合は幅の上限になる
+     */
+    std::size_t input_width = 0;
+
+    /**
+     * @brief 入力の高さと幅を動的にするかどうか
+     *
+     * ホスト側で前処理するタスク（FloatCHW）は、画像をリサイズせずにそのままの解像度で入力する。
+     * 前処理を組み込むタスクではリサイズ先が決まらないため使えない
+     */
+    bool dynamic_input_size = false;
+
+    /**
+     * @brief コンパイル済みモデルのキャッシュを保存するディレクトリ（空ならキャッシュしない）
+     *
+     * キャッシュはモデルの内容・デバイス・設定・OpenVINOのバージョンから求めたキーで管理され、
+     * いずれかが変わると自動的に再コンパイルされる
+     */
+    std::string cache_dir = "";
+
+    /**
+     * @brief 性能の方針
+     *
+     * Default以外の場合、num_requestsも同時実行数の目安としてデバイスへ伝える
+     */
+    PerformanceMode performance_mode = PerformanceMode::Default;
+
+    /**
+     * @brief ストリーム数（並列に推論を実行する単位）、0ならデバイスの既定値、-1ならAUTO
+     *
+     */
+    int num_streams = 0;
+
+    /**
+     * @brief 推論に使うスレッド数（0ならデバイスの既定値）
+     *
+     */
+    int inference_num_threads = 0;
+
+    /**
+     * @brief 推論スレッドをCPUコアへ固定するかどうか（未設定ならデバイスの既定値）
+     *
+     */
+    std::optional<bool> enable_cpu_pinning;
+
+    /**
+     * @brief 推論に使うCPU（「0-15,32-47」の形式、空なら制限しない）
+     *
+     * 指定したCPUへ固定したスレッドでコンパイルと推論リクエストの作成を行い、推論スレッドを
+     * それらのCPUに閉じ込める（ShardedTaskがNUMAノードごとに設定する）。
+     * enable_cpu_pinningが未設定ならOpenVINO自身のCPU固定を無効にし、
+     * inference_num_threadsが0ならCPU数をスレッド数にする
+     */
+    std::string cpu_affinity = "";
+
+    /**
+     * @brief 推論の精度（"f32"、"bf16"、"f16"、空ならデバイスの既定値）
+     *
+     */
+    std::string inference_precision = "";
+};
+
+/**
+ * @brief 設定ファイル（YAML・JSON・XML）から読み込み設定を読み込む
+ *
+ * キーはModelConfigのメンバ名と同じ。例（YAML）:
+ *
+ *     %YAML:1.0
+ *     device: CPU
+ *     performance_mode: latency
+ *     num_requests: 1
+ *     max_batch_size: 4
+ *     num_streams: 1
+ *     inference_num_threads: 4
+ *     enable_cpu_pinning: "on"
+ *     inference_precision: bf16
+ *
+ * @param path 設定ファイルのパス
+ * @param base ファイルに書かれていない項目の値
+ * @return ModelConfig 読み込み設定
+ */
+ModelConfig load_model_config(const std::string& path, const ModelConfig& base = ModelConfig());
+
+/**
+ * @brief コマンドライン引数から読み込み設定を取り出す
+ *
+ * 「--<キー>=<値>」の形式の引数を左から順に適用し、argvから取り除く（残りの引数は順序を保つ）。
+ * キーはModelConfigのメンバ名の「_」を「-」に置き換えたもの（--num-streams=2など）。
+ * 「--model-config=<パス>」は設定ファイルを読み込む。読み込み設定のキーでない引数
+ * （各プログラムの「--results=<パス>」など）はそのまま残すため、呼び出しの前後どちらでも解析できる
+ *
+ * @param argc 引数の数（取り除いた後の数で上書きする）
+ * @param argv 引数
+ * @param base 指定されていない項目の値
+ * @return ModelConfig 読み込み設定
+ */
+ModelConfig parse_model_config_args(int& argc, char** argv,
+                                    const ModelConfig& base = ModelConfig());
+
+/**
+ * @brief コマンドライン引数で指定できる読み込み設定の説明を返す（Usageの表示用）
+ *
+ * @return std::string 説明
+ */
+std::string get_model_config_usage(void);
+
+/**
+ * @brief 読み込み設定を「device CPU, requests 2, mode latency, streams 1」の形式で出力する
+ *
+ * 既定値のままの項目は出力しない
+ *
+ * @param os 出力先
+ * @param config 読み込み設定
+ * @return std::ostream& 出力先
+ */
+std::ostream& operator<<(std::ostream& os, const ModelConfig& config);
+
+/**
+ * @brief モデルの読み込みにかかった時間
+ *
+ */
+struct ModelLoadReport {
+    /**
+     * @brief モデルファイルの読み込み時間[ms]
+     *
+     */
+    double read_time_ms = 0.0;
+
+    /**
+     * @brief コンパイル（またはキャッシュからの読み込み）時間[ms]
+     *
+     */
+    double compile_time_ms = 0.0;
+
+    /**
+     * @brief キャッシュから読み込んだかどうか
+     *
+     */
+    bool loaded_from_cache = false;
+
+    /**
+     * @brief 同じ設定でコンパイル済みのモデルを共有したかどうか（共有時は読み込み時間が0）
+     *
+     */
+    bool shared = false;
+
+    /**
+     * @brief デバイスが選んだストリーム数（取得できない場合は0）
+     *
+     */
+    int num_streams = 0;
+
+    /**
+     * @brief デバイスが推奨する推論リクエスト数（取得できない場合は0）
+     *
+     */
+    std::size_t optimal_num_requests = 0;
+};
+
+/**
+ * @brief 読み込み時間を「read 12.3 ms, compile 456.7 ms (from cache), streams 4, optimal requests 4」
+ * または「shared」の形式で出力する
+ *
+ * @param os 出力先
+ * @param report 読み込み時間
+ * @return std::ostream& 出力先
+ */
+std::ostream& operator<<(std::ostream& os, const ModelLoadReport& report);
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <openvino/openvino.hpp>
+#include <string>
+
+#include "model_config.hpp"
+
+/**
+ * @brief コンパイル済みモデルと、コンパイル時の情報
+ *
+ */
+struct CompiledModelEntry {
+    /**
+     * @brief コンパイル済みモデル
+     *
+     */
+    ov::CompiledModel compiled_model;
+
+    /**
+     * @brief 組み込み前処理を適用する前のモデルの入力サイズ
+     *
+     */
+    ov::PartialShape network_input_shape;
+
+    /**
+     * @brief コンパイルにかかった時間
+     *
+     */
+    ModelLoadReport load_report;
+};
+
+/**
+ * @brief プロセス全体で1つのov::Coreを共有し、同じ設定のコンパイル済みモデルを共有する
+ *
+ * コンパイル済みモデルは利用者がいなくなると解放される
+ */
+class ModelRegistry {
+   public:
+    /**
+     * @brief 共有のov::Coreでモデルをコンパイルする関数
+     *
+     */
+    using Factory = std::function<CompiledModelEntry(ov::Core&)>;
+
+   private:
+    /**
+     * @brief キーごとの登録情報（同じキーの同時コンパイルを防ぐためのロックを持つ）
+     *
+     */
+    struct Entry {
+        std::mutex mutex;
+        std::weak_ptr<CompiledModelEntry> compiled;
+    };
+
+    ov::Core core;
+    std::mutex entries_mutex;
+    std::map<std::string, std::shared_ptr<Entry>> entries;
+
+    ModelRegistry(void) = default;
+
+   public:
+    ModelRegistry(const ModelRegistry&) = delete;
+    ModelRegistry& operator=(const ModelRegistry&) = delete;
+
+    /**
+     * @brief プロセス全体で共有するインスタンスを返す
+     *
+     * @return ModelRegistry& インスタンス
+     */
+    static ModelRegistry& get_instance(void);
+
+    /**
+     * @brief 共有のov::Coreを返す
+     *
+     * @return ov::Core& 共有のov::Core
+     */
+    ov::Core& get_core(void);
+
+    /**
+     * @brief キーに対応するコンパイル済みモデルを返す（なければコンパイルして登録する）
+     *
+     * @param key モデルのパス・デバイス・設定などから作ったキー（空なら共有せず毎回コンパイルする）
+     * @param factory コンパイルする関数
+     * @param shared 登録済みのモデルを共有した場合はtrueが設定される
+     * @return std::shared_ptr<CompiledModelEntry> コンパイル済みモデル
+     */
+    std::shared_ptr<CompiledModelEntry> get_or_compile(const std::string& key,
+                                                       const Factory& factory, bool& shared);
+
+    /**
+     * @brief 現在共有されているコンパイル済みモデルの数を返す
+     *
+     * @return std::size_t コンパイル済みモデルの数
+     */
+    std::size_t get_num_models(void);
+};
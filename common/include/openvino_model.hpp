@@ -1,9 +1,19 @@
 #pragma once
 
+#include <chrono>
+#include <condition_variable>
 #include <exception>
 #include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <openvino/openvino.hpp>
 #include <string>
+#include <vector>
+
+#include "function_ref.hpp"
+#include "model_config.hpp"
+#include "model_registry.hpp"
 
 /**
  * @brief OpenVINOのモデルを管理する
@@ -11,32 +21,135 @@
  */
 class OpenVINOModel {
    private:
-    ov::Core core;
-    std::shared_ptr<ov::Model> model = nullptr;
-    ov::CompiledModel compiled_model;
-    ov::InferRequest infer_request;
+    /**
+     * @brief コンパイル済みモデル（同じ設定の他のインスタンスと共有する）
+     *
+     */
+    std::shared_ptr<CompiledModelEntry> compiled = nullptr;
+    std::size_t max_batch_size = 1;
+    ModelLoadReport load_report;
+
+    /**
+     * @brief 推論リクエストのプール
+     *
+     */
+    std::vector<ov::InferRequest> infer_requests;
+
+    /**
+     * @brief 空いている推論リクエストのインデックス
+     *
+     * 推論リクエスト数分を確保済みのスタックとして使い、取得・返却でメモリを確保しない
+     */
+    std::vector<std::size_t> idle_requests;
+    std::mutex idle_mutex;
+    std::condition_variable idle_cv;
+
+    /**
+     * @brief 非同期推論のコールバックが投げた最初の例外（推論スレッドへは伝えない）
+     *
+     */
+    std::exception_ptr callback_exception = nullptr;
+
+    /**
+     * @brief 空いている推論リクエストを取得する（空きがなければ待機する）
+     *
+     * @return std::size_t 推論リクエストのインデックス
+     */
+    std::size_t acquire_request(void);
+
+    /**
+     * @brief 推論リクエストをプールへ返却する
+     *
+     * @param index 推論リクエストのインデックス
+     */
+    void release_request(const std::size_t index);
 
    public:
+    /**
+     * @brief モデルへ前処理を組み込む関数
+     *
+     * コンパイル前に呼ばれ、PrePostProcessorへ入力テンソルの形式と前処理を設定する
+     */
+    using EmbedPreprocess = std::function<void(ov::preprocess::PrePostProcessor&)>;
+
+    /**
+     * @brief 推論完了時に呼ばれるコールバック
+     *
+     * 第1引数は推論を実行したリクエスト、第2引数は推論中に発生した例外（正常終了時はnullptr）
+     * コールバックが戻るまでリクエストはプールへ返却されない。
+     * コールバックが投げた例外は推論スレッドへ伝えず、take_callback_exception()で取り出す
+     */
+    using InferCallback = std::function<void(ov::InferRequest&, std::exception_ptr)>;
+
+    /**
+     * @brief 推論前に推論リクエストの入力を準備する処理
+     *
+     * 推論リクエストの入力テンソルへ直接書き込むか、set_input_tensor()でテンソルを設定する。
+     * 呼び出しの間だけ参照するため、ラムダ式をコピー・メモリ確保せずに渡せる
+     */
+    using PrepareInput = FunctionRef<void(ov::InferRequest&)>;
+
+    /**
+     * @brief 同期推論の完了後に呼ばれる処理（呼び出しの間だけ参照する）
+     *
+     */
+    using InferDone = FunctionRef<void(ov::InferRequest&)>;
+
     /**
      * @brief モデルを読み込んで推論可能な状態にする
      *
+     * 共有のov::Coreを使用し、同じモデル・設定・組み込み前処理のコンパイル済みモデルが
+     * 既にあれば共有する（推論リクエストはインスタンスごとに作成する）
+     *
      * @param model_path モデルのパス
+     * @param config 読み込み設定
+     * @param embed_preprocess モデルへ組み込む前処理（nullptrなら組み込まない）
+     * @param embed_key 組み込む前処理を識別する文字列（空の場合、前処理を組み込むモデルは共有しない）
      */
-    OpenVINOModel(const std::string model_path, const std::string device = "CPU");
+    OpenVINOModel(const std::string model_path, const ModelConfig& config = ModelConfig(),
+                  const EmbedPreprocess& embed_preprocess = nullptr,
+                  const std::string& embed_key = "");
 
     /**
-     * @brief 読み込んだモデルを解放する
+     * @brief 実行中の推論の完了を待ち、読み込んだモデルを解放する
      *
+     * すべての推論リクエストが返却され、完了時のコールバックが推論スレッドで戻りきるまで待機する
      */
     ~OpenVINOModel(void);
 
     /**
      * @brief モデルの入力サイズを返す
      *
-     * @return ov::Shape モデルの入力サイズ
+     * 前処理を組み込んだ場合も、組み込み前のネットワークの入力サイズを返す
+     *
+     * @return ov::Shape モデルの入力サイズ（バッチ次元は1、動的な次元は0）
      */
     ov::Shape get_input_shape(void) const;
 
+    /**
+     * @brief 動的な次元を含むモデルの入力サイズを返す
+     *
+     * 前処理を組み込んだ場合も、組み込み前のネットワークの入力サイズを返す
+     *
+     * @return ov::PartialShape モデルの入力サイズ（上限がある次元は範囲として返す）
+     */
+    ov::PartialShape get_input_partial_shape(void) const;
+
+    /**
+     * @brief 入力の高さと幅が動的かどうかを返す
+     *
+     * @return true 入力の高さまたは幅が動的
+     * @return false 入力の高さと幅が固定
+     */
+    bool has_dynamic_input_size(void) const;
+
+    /**
+     * @brief 1回の推論で入力できる最大バッチサイズを返す
+     *
+     * @return std::size_t 最大バッチサイズ
+     */
+    std::size_t get_max_batch_size(void) const;
+
     /**
      * @brief 入力の型情報を返す
      *
@@ -45,17 +158,72 @@ class OpenVINOModel {
     ov::element::Type get_elementtype(void) const;
 
     /**
-     * @brief 推論を実行する
+     * @brief 推論リクエスト数を返す
+     *
+     * @return std::size_t 推論リクエスト数
+     */
+    std::size_t get_num_requests(void) const;
+
+    /**
+     * @brief モデルの読み込みにかかった時間を返す
+     *
+     * @return ModelLoadReport 読み込み時間
+     */
+    ModelLoadReport get_load_report(void) const;
+
+    /**
+     * @brief 非同期推論のコールバックが投げた最初の例外を取り出す（取り出した例外は消える）
+     *
+     * @return std::exception_ptr 例外（発生していなければnullptr）
+     */
+    std::exception_ptr take_callback_exception(void);
+
+    /**
+     * @brief キャッシュディレクトリ内のコンパイル済みモデルを削除する
+     *
+     * @param cache_dir キャッシュディレクトリ
+     * @return std::size_t 削除したファイル数
+     */
+    static std::size_t clear_cache(const std::string& cache_dir);
+
+    /**
+     * @brief 推論を同期実行し、完了後にコールバックを呼び出す
+     *
+     * 空いている推論リクエストを1つ使用するため、複数スレッドから同時に呼び出せる
      *
      * @param input_tensor 入力テンソル
+     * @param callback 推論完了時の処理
      */
-    void infer(ov::Tensor& input_tensor);
+    void infer(const ov::Tensor& input_tensor, const InferDone callback);
 
     /**
-     * @brief 推論結果を取得する
+     * @brief 推論を非同期実行する
+     *
+     * 空いている推論リクエストがなければ空くまで待機する。
+     * 入力テンソルのメモリは推論完了（コールバック呼び出し）まで保持すること
+     *
+     * @param input_tensor 入力テンソル
+     * @param callback 推論完了時の処理（推論スレッドから呼ばれる）
+     */
+    void infer_async(const ov::Tensor& input_tensor, InferCallback callback);
+
+    /**
+     * @brief 空いている推論リクエストの入力を準備してから推論を同期実行し、完了後にコールバックを呼び出す
+     *
+     * 入力の準備は推論リクエストを確保した後に呼び出し元スレッドで行う
+     *
+     * @param prepare 入力の準備
+     * @param callback 推論完了時の処理
+     */
+    void infer(const PrepareInput prepare, const InferDone callback);
+
+    /**
+     * @brief 空いている推論リクエストの入力を準備してから推論を非同期実行する
+     *
+     * 空いている推論リクエストがなければ空くまで待機する。入力の準備は呼び出し元スレッドで行う
      *
-     * @param index 取得する属性インデックス
-     * @return ov::Tensor 出力テンソル
+     * @param prepare 入力の準備
+     * @param callback 推論完了時の処理（推論スレッドから呼ばれる）
      */
-    ov::Tensor get_output_tensor(const int index);
+    void infer_async(const PrepareInput prepare, InferCallback callback);
 };
@@ -1,13 +1,18 @@
 #pragma once
 
+#include <exception>
+#include <functional>
+#include <future>
 #include <memory>
 #include <opencv2/opencv.hpp>
 #include <openvino/openvino.hpp>
 #include <string>
+#include <vector>
 
 #include "openvino_model.hpp"
 #include "postprocess.hpp"
 #include "preprocess.hpp"
+#include "task_profiler.hpp"
 
 /**
  * @brief タスクの規程クラス
@@ -17,82 +22,236 @@
  */
 template <typename Preprocess, typename Postprocess>
 class OpenVINOTask {
+   public:
+    /**
+     * @brief タスクの出力の型
+     *
+     */
+    using Output = typename Postprocess::Output;
+
+    /**
+     * @brief タスクの出力を書き込む再利用可能なバッファの型
+     *
+     */
+    using Buffer = typename Postprocess::Buffer;
+
+    /**
+     * @brief 非同期タスク完了時に呼ばれるコールバック
+     *
+     * 第1引数はタスクの出力、第2引数は発生した例外（正常終了時はnullptr）
+     */
+    using TaskCallback = std::function<void(Output, std::exception_ptr)>;
+
    protected:
     std::unique_ptr<OpenVINOModel> model = nullptr;
     Preprocess preprocessor;
     Postprocess postprocessor;
+    TaskProfiler profiler;
 
    public:
     /**
      * @brief モデルを読み込む
      *
+     * 前処理がモデルへの組み込みに対応している場合は、コンパイル前に組み込む
+     *
      * @param model_path モデルファイルのパス
+     * @param config モデルの読み込み設定
      */
-    OpenVINOTask(const std::string model_path);
-};
+    OpenVINOTask(const std::string model_path, const ModelConfig& config = ModelConfig());
 
-/**
- * @brief 物体検知タスク（BBox5Label1）
- *
- */
-class DetectorBBox5Label1 : public OpenVINOTask<FloatCHW, BBox5Label1> {
-   public:
     /**
-     * @brief モデルを読み込む
+     * @brief 実行中の非同期タスクの完了を待ってから解放する
      *
-     * @param model_path モデルファイルのパス
      */
-    DetectorBBox5Label1(const std::string model_path);
+    ~OpenVINOTask(void);
+
+    /**
+     * @brief モデルの読み込みにかかった時間を返す
+     *
+     * @return ModelLoadReport 読み込み時間
+     */
+    ModelLoadReport get_load_report(void) const;
+
+    /**
+     * @brief 処理段階ごとのレイテンシとスループットの統計を返す
+     *
+     * @return TaskProfile 統計
+     */
+    TaskProfile get_profile(void) const;
+
+    /**
+     * @brief レイテンシの計測器を返す（統計のリセットやファイルへの定期出力に使う）
+     *
+     * @return TaskProfiler& 計測器
+     */
+    TaskProfiler& get_profiler(void);
+
+    /**
+     * @brief 後処理を返す（検知結果の絞り込みなどの設定に使う、推論中には変更しないこと）
+     *
+     * @return Postprocess& 後処理
+     */
+    Postprocess& get_postprocessor(void);
 
     /**
-     * @brief 物体検知タスクを実行する
+     * @brief タスクを実行する
+     *
+     * 推論リクエストに空きがあれば複数スレッドから同時に呼び出せる
+     *
+     * @param image 入力画像
+     * @return Output タスクの出力
+     */
+    Output task(const cv::Mat& image);
+
+    /**
+     * @brief タスクを実行し、出力をバッファへ書き込む
+     *
+     * 同じバッファを繰り返し渡せば、後処理は確保済みのメモリを使い回す。推論リクエストの取得と
+     * 前処理・後処理の呼び出しもメモリを確保しないため、定常状態で残る確保はOpenVINOのAPIの内部
+     * （値で返るov::Tensor::get_shape()や推論の実行）だけになる
      *
      * @param image 入力画像
-     * @return std::vector<BBox> 検知結果のベクトル
+     * @param output 出力の書き込み先（内容は上書きする）
+     */
+    void task(const cv::Mat& image, Buffer& output);
+
+    /**
+     * @brief 複数画像のタスクをバッチ推論で実行する
+     *
+     * 画像数が最大バッチサイズ（ModelConfig::max_batch_size）を超える場合は、
+     * 最大バッチサイズごとに分割して推論する
+     *
+     * @param images 入力画像のリスト（複数カメラのフレームや人物の切り出し画像など）
+     * @return std::vector<Output> 画像ごとのタスクの出力
      */
-    std::vector<BBox> task(const cv::Mat& image);
+    std::vector<Output> task(const std::vector<cv::Mat>& images);
+
+    /**
+     * @brief 複数画像のタスクをバッチ推論で実行し、出力をバッファへ書き込む
+     *
+     * @param images 入力画像のリスト
+     * @param outputs 画像ごとの出力の書き込み先（要素数は画像数に合わせる）
+     */
+    void task(const std::vector<cv::Mat>& images, std::vector<Buffer>& outputs);
+
+    /**
+     * @brief タスクを非同期実行する
+     *
+     * 推論リクエストに空きがなければ空くまで待機し、取得した推論リクエストの入力テンソルへ
+     * 呼び出し元スレッドで前処理を書き込んでから推論を始める。推論と後処理は推論スレッドで行う。
+     * 前処理が推論と重なるのは他の推論リクエストが推論中の場合だけのため、num_requestsが1では
+     * 前の推論が終わるまで次の前処理を始めない（重ねるにはnum_requestsを2以上にする）
+     *
+     * @param image 入力画像
+     * @return std::future<Output> タスクの出力
+     */
+    std::future<Output> task_async(const cv::Mat& image);
+
+    /**
+     * @brief タスクを非同期実行し、完了時にコールバックを呼び出す
+     *
+     * 前処理と推論の順序はtask_async(image)と同じ。
+     * コールバックが投げた例外は推論スレッドへ伝えず、take_callback_exception()で取り出す
+     *
+     * @param image 入力画像
+     * @param callback 完了時の処理（推論スレッドから呼ばれる）
+     */
+    void task_async(const cv::Mat& image, TaskCallback callback);
+
+    /**
+     * @brief 非同期タスクのコールバックが投げた最初の例外を取り出す（取り出した例外は消える）
+     *
+     * @return std::exception_ptr 例外（発生していなければnullptr）
+     */
+    std::exception_ptr take_callback_exception(void);
 };
 
 /**
- * @brief 物体検知タスク（BBox7）
+ * @brief 物体検知タスク（BBox5Label1）
  *
+ * task()は検知結果のベクトル（std::vector<BBox>）を返す。出力先にBBoxListを渡すこともできる
+ *
+ * @tparam Preprocess 前処理
  */
-class DetectorBBox7 : public OpenVINOTask<FloatCHW, BBox7> {
+template <typename Preprocess>
+class BasicDetectorBBox5Label1 : public OpenVINOTask<Preprocess, BBox5Label1> {
    public:
     /**
      * @brief モデルを読み込む
      *
      * @param model_path モデルファイルのパス
+     * @param config モデルの読み込み設定
      */
-    DetectorBBox7(const std::string model_path);
+    BasicDetectorBBox5Label1(const std::string model_path,
+                             const ModelConfig& config = ModelConfig());
+};
 
+/**
+ * @brief 物体検知タスク（BBox7）
+ *
+ * task()は検知結果のベクトル（std::vector<BBox>）を返す。出力先にBBoxListを渡すこともできる
+ *
+ * @tparam Preprocess 前処理
+ */
+template <typename Preprocess>
+class BasicDetectorBBox7 : public OpenVINOTask<Preprocess, BBox7> {
+   public:
     /**
-     * @brief 物体検知タスクを実行する
+     * @brief モデルを読み込む
      *
-     * @param image 入力画像
-     * @return std::vector<BBox> 検知結果のベクトル
+     * @param model_path モデルファイルのパス
+     * @param config モデルの読み込み設定
      */
-    std::vector<BBox> task(const cv::Mat& image);
+    BasicDetectorBBox7(const std::string model_path, const ModelConfig& config = ModelConfig());
 };
 
 /**
  * @brief 骨格検出タスク
  *
+ * task()はキーポイントのベクトル（std::vector<KeyPoint>）を返す。出力先にKeyPointListを渡すこともできる
+ *
+ * @tparam Preprocess 前処理
  */
-class PoseDetector : public OpenVINOTask<FloatCHW, KeyPoints> {
+template <typename Preprocess>
+class BasicPoseDetector : public OpenVINOTask<Preprocess, KeyPoints> {
    public:
     /**
      * @brief モデルを読み込む
      *
      * @param model_path モデルファイルのパス
+     * @param config モデルの読み込み設定（max_batch_sizeは1回の推論でまとめて処理する最大画像数）
      */
-    PoseDetector(const std::string model_path);
+    BasicPoseDetector(const std::string model_path, const ModelConfig& config = ModelConfig());
+};
 
+/**
+ * @brief 複数人の骨格検出タスク（OpenPose）
+ *
+ * 1回の推論で画像内の全員の骨格を検出する。task()は人物ごとの骨格（std::vector<Pose>）を返す
+ *
+ * @tparam Preprocess 前処理
+ */
+template <typename Preprocess>
+class BasicMultiPoseDetector : public OpenVINOTask<Preprocess, OpenPoseDecoder> {
+   public:
     /**
-     * @brief 骨格検出タスクを実行する
+     * @brief モデルを読み込む
      *
-     * @param image 入力画像
-     * @return std::vector<KeyPoint> キーポイントのベクトル
+     * @param model_path モデルファイルのパス
+     * @param config モデルの読み込み設定
      */
-    std::vector<KeyPoint> task(const cv::Mat& image);
+    BasicMultiPoseDetector(const std::string model_path,
+                           const ModelConfig& config = ModelConfig());
 };
+
+// ホスト側で前処理するタスク
+using DetectorBBox5Label1 = BasicDetectorBBox5Label1<FloatCHW>;
+using DetectorBBox7 = BasicDetectorBBox7<FloatCHW>;
+using PoseDetector = BasicPoseDetector<FloatCHW>;
+using MultiPoseDetector = BasicMultiPoseDetector<FloatCHW>;
+
+// 前処理をモデルへ組み込んだタスク
+using EmbeddedDetectorBBox5Label1 = BasicDetectorBBox5Label1<U8NHWCEmbedded>;
+using EmbeddedDetectorBBox7 = BasicDetectorBBox7<U8NHWCEmbedded>;
+using EmbeddedPoseDetector = BasicPoseDetector<U8NHWCEmbedded>;
+using EmbeddedMultiPoseDetector = BasicMultiPoseDetector<U8NHWCEmbedded>;
@@ -0,0 +1,359 @@
+#pragma once
+
+#include <pthread.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bounded_queue.hpp"
+
+/**
+ * @brief 複数の処理段階を容量付きキューでつなぎ、段階ごとに複数スレッドで並列実行する
+ *
+ * 各段階は同じ要素（1画像分の入力・中間結果・出力をまとめた構造体など）を順に書き換える。
+ * キューが満杯になると前の段階が待機するため、遅い段階に合わせて全体の流量が抑えられる。
+ * 最後に出力処理（sink）を1つのスレッドで呼び出す。ordered=trueなら入力順に呼び出す
+ *
+ * @tparam Item 要素の型（デフォルト構築とムーブができること）
+ */
+template <typename Item>
+class Pipeline {
+   public:
+    /**
+     * @brief 処理段階で要素に対して行う処理
+     *
+     */
+    using StageFunction = std::function<void(Item&)>;
+
+    /**
+     * @brief 出力処理
+     *
+     * 第1引数は要素、第2引数はいずれかの段階で発生した例外（正常終了時はnullptr）。
+     * 例外が発生した要素は、それ以降の段階を実行せずに出力処理へ渡される
+     */
+    using SinkFunction = std::function<void(Item&, std::exception_ptr)>;
+
+   private:
+    // 入力順を復元するための通し番号を付けた要素
+    struct Slot {
+        std::size_t sequence = 0;
+        Item item;
+        std::exception_ptr exception = nullptr;
+    };
+
+    struct Stage {
+        std::string name;
+        StageFunction function;
+        std::size_t num_workers;
+        std::atomic<std::size_t> active_workers{0};
+    };
+
+    std::size_t queue_capacity;
+    bool ordered;
+
+    std::vector<std::unique_ptr<Stage>> stages;
+    std::vector<std::unique_ptr<BoundedQueue<Slot>>> queues;
+    std::vector<std::thread> workers;
+    std::thread output_thread;
+    SinkFunction sink;
+    std::exception_ptr sink_exception = nullptr;
+
+    // パイプライン内の要素数の上限（順序を復元するバッファが際限なく増えないようにする）
+    std::size_t max_in_flight = 0;
+    std::size_t num_in_flight = 0;
+    std::size_t next_sequence = 0;
+    bool started = false;
+    bool closed = false;
+    mutable std::mutex in_flight_mutex;
+    std::condition_variable in_flight_cv;
+
+    /**
+     * @brief 処理段階のワーカースレッドの処理
+     *
+     * @param index 処理段階の番号
+     */
+    void run_stage(const std::size_t index) {
+        Stage& stage = *stages[index];
+        BoundedQueue<Slot>& input = *queues[index];
+        BoundedQueue<Slot>& output = *queues[index + 1];
+
+        Slot slot;
+        while (input.pop(slot)) {
+            if (!slot.exception) {
+                try {
+                    stage.function(slot.item);
+                } catch (...) {
+                    slot.exception = std::current_exception();
+                }
+            }
+            if (!output.push(std::move(slot))) {
+                break;
+            }
+        }
+
+        // 最後のワーカーが終了したら次の段階へ入力の終わりを伝える
+        if (stage.active_workers.fetch_sub(1) == 1) {
+            output.close();
+        }
+    }
+
+    /**
+     * @brief 出力スレッドの処理
+     *
+     */
+    void run_output(void) {
+        BoundedQueue<Slot>& input = *queues.back();
+        std::map<std::size_t, Slot> pending;
+        std::size_t next_output = 0;
+
+        Slot slot;
+        while (input.pop(slot)) {
+            if (!ordered) {
+                emit(slot);
+                continue;
+            }
+
+            // 入力順で次に出力すべき要素が揃うまで保留する
+            const std::size_t sequence = slot.sequence;
+            pending.emplace(sequence, std::move(slot));
+            for (auto it = pending.begin(); it != pending.end() && it->first == next_output;
+                 it = pending.erase(it)) {
+                emit(it->second);
+                next_output++;
+            }
+        }
+
+        // 後の番号が先に投入された後で締め切られると、戻せなかった番号が欠けて保留が残るため、
+        // 入力の終わりで残りを入力順に出力する
+        for (auto& entry : pending) {
+            emit(entry.second);
+        }
+    }
+
+    /**
+     * @brief 出力処理を呼び出し、パイプライン内の要素数を減らす
+     *
+     * @param slot 要素
+     */
+    void emit(Slot& slot) {
+        try {
+            sink(slot.item, slot.exception);
+        } catch (...) {
+            if (!sink_exception) {
+                sink_exception = std::current_exception();
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(in_flight_mutex);
+            num_in_flight--;
+        }
+        in_flight_cv.notify_all();
+    }
+
+    /**
+     * @brief 現在のスレッドに名前を付ける（topやperfで段階ごとの負荷を見分けるため）
+     *
+     * @param name 名前（15文字を超える部分は切り捨てる）
+     */
+    static void set_thread_name(const std::string& name) {
+        pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+    }
+
+   public:
+    /**
+     * @brief パイプラインを作る
+     *
+     * @param queue_capacity 段階間のキューの容量
+     * @param ordered 出力処理を入力順に呼び出すかどうか
+     */
+    explicit Pipeline(const std::size_t queue_capacity = 8, const bool ordered = true)
+        : queue_capacity(queue_capacity), ordered(ordered) {
+        if (queue_capacity == 0) {
+            throw std::invalid_argument("Queue capacity must be at least 1");
+        }
+    }
+
+    /**
+     * @brief 入力を締め切り、すべての要素の処理が終わるまで待つ
+     *
+     */
+    ~Pipeline(void) {
+        try {
+            wait();
+        } catch (...) {
+        }
+    }
+
+    Pipeline(const Pipeline&) = delete;
+    Pipeline& operator=(const Pipeline&) = delete;
+
+    /**
+     * @brief 処理段階を末尾に追加する
+     *
+     * @param name 段階の名前（スレッド名に使う）
+     * @param function 要素に対して行う処理（複数スレッドから同時に呼ばれる）
+     * @param num_workers ワーカースレッド数
+     */
+    void add_stage(const std::string& name, StageFunction function,
+                   const std::size_t num_workers = 1) {
+        if (started) {
+            throw std::logic_error("Cannot add a stage after the pipeline has started");
+        }
+        if (num_workers == 0) {
+            throw std::invalid_argument("Stage must have at least one worker: " + name);
+        }
+        auto stage = std::make_unique<Stage>();
+        stage->name = name;
+        stage->function = std::move(function);
+        stage->num_workers = num_workers;
+        stages.push_back(std::move(stage));
+    }
+
+    /**
+     * @brief ワーカースレッドを起動する
+     *
+     * @param sink 出力処理（1つのスレッドから呼ばれる）
+     */
+    void start(SinkFunction sink) {
+        if (started) {
+            throw std::logic_error("Pipeline has already started");
+        }
+        this->sink = std::move(sink);
+        started = true;
+
+        for (std::size_t i = 0; i < stages.size() + 1; i++) {
+            queues.push_back(std::make_unique<BoundedQueue<Slot>>(queue_capacity));
+        }
+
+        // 各キューとワーカーが保持できる数を合計した分だけ同時に流す
+        max_in_flight = queue_capacity * queues.size();
+        for (std::size_t i = 0; i < stages.size(); i++) {
+            Stage& stage = *stages[i];
+            max_in_flight += stage.num_workers;
+            stage.active_workers = stage.num_workers;
+            for (std::size_t j = 0; j < stage.num_workers; j++) {
+                workers.emplace_back([this, i]() {
+                    set_thread_name(stages[i]->name);
+                    run_stage(i);
+                });
+            }
+        }
+        output_thread = std::thread([this]() {
+            set_thread_name("sink");
+            run_output();
+        });
+    }
+
+    /**
+     * @brief 要素を投入する
+     *
+     * パイプラインが詰まっている場合は空きができるまで待機する
+     *
+     * @param item 要素
+     * @return true 投入した
+     * @return false 入力を締め切っている（空き待ちの間に締め切られた場合を含む）
+     */
+    bool push(Item item) {
+        if (!started) {
+            throw std::logic_error("Pipeline has not started");
+        }
+
+        Slot slot;
+        {
+            std::unique_lock<std::mutex> lock(in_flight_mutex);
+            in_flight_cv.wait(lock, [this]() { return closed || num_in_flight < max_in_flight; });
+            if (closed) {
+                return false;
+            }
+            slot.sequence = next_sequence++;
+            num_in_flight++;
+        }
+        slot.item = std::move(item);
+        const std::size_t sequence = slot.sequence;
+        if (queues.front()->push(std::move(slot))) {
+            return true;
+        }
+
+        // キューの空き待ちの間に締め切られた場合は、予約した要素数と通し番号を戻す
+        {
+            std::lock_guard<std::mutex> lock(in_flight_mutex);
+            num_in_flight--;
+            if (next_sequence == sequence + 1) {
+                next_sequence--;
+            }
+        }
+        in_flight_cv.notify_all();
+        return false;
+    }
+
+    /**
+     * @brief 入力を締め切る
+     *
+     * 投入済みの要素は引き続き処理される
+     */
+    void close(void) {
+        {
+            std::lock_guard<std::mutex> lock(in_flight_mutex);
+            closed = true;
+        }
+        in_flight_cv.notify_all();
+        if (!queues.empty()) {
+            queues.front()->close();
+        }
+    }
+
+    /**
+     * @brief 入力を締め切り、すべての要素の処理が終わるまで待つ
+     *
+     * 出力処理で例外が発生していた場合は、最初の例外を再送出する
+     */
+    void wait(void) {
+        close();
+        for (auto& worker : workers) {
+            if (worker.joinable()) {
+                worker.join();
+            }
+        }
+        if (output_thread.joinable()) {
+            output_thread.join();
+        }
+        if (sink_exception) {
+            std::exception_ptr exception = sink_exception;
+            sink_exception = nullptr;
+            std::rethrow_exception(exception);
+        }
+    }
+
+    /**
+     * @brief 処理段階ごとの入力キューに溜まっている要素数を返す（末尾は出力処理の入力キュー）
+     *
+     * @return std::vector<std::size_t> 要素数
+     */
+    std::vector<std::size_t> get_queue_sizes(void) const {
+        std::vector<std::size_t> sizes;
+        for (const auto& queue : queues) {
+            sizes.push_back(queue->size());
+        }
+        return sizes;
+    }
+
+    /**
+     * @brief パイプライン内で処理中の要素数を返す
+     *
+     * @return std::size_t 要素数
+     */
+    std::size_t get_num_in_flight(void) const {
+        std::lock_guard<std::mutex> lock(in_flight_mutex);
+        return num_in_flight;
+    }
+};
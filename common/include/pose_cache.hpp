@@ -0,0 +1,201 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+#include <unordered_map>
+#include <vector>
+
+#include "result_objects.hpp"
+
+/**
+ * @brief 骨格の再利用の設定
+ *
+ * 閾値を大きくするほど骨格検出の回数が減る代わりに、動いた人物の骨格が遅れて更新される
+ */
+struct PoseCacheConfig {
+    /**
+     * @brief 骨格を再利用できる最大フレーム数（最後に推論してからの経過フレーム数、0なら再利用しない）
+     *
+     */
+    std::size_t max_age = 15;
+
+    /**
+     * @brief 再利用できる枠の中心の移動量の上限（推論時の枠の幅・高さに対する割合）
+     *
+     */
+    float max_shift = 0.05f;
+
+    /**
+     * @brief 再利用できる枠の幅・高さの変化の上限（推論時の枠の幅・高さに対する割合）
+     *
+     */
+    float max_scale_change = 0.1f;
+
+    /**
+     * @brief 再利用できる切り出し画像の変化の上限（縮小したグレースケール画像の画素値の差の平均、0〜255）
+     *
+     */
+    double max_crop_difference = 6.0;
+
+    /**
+     * @brief 切り出し画像を比べるときの縮小画像の大きさ（辺の長さ）
+     *
+     */
+    int thumbnail_size = 16;
+
+    /**
+     * @brief 見えなくなった人物の骨格を破棄するまでのフレーム数
+     *
+     */
+    std::size_t max_unseen = 30;
+};
+
+/**
+ * @brief 追跡IDごとに骨格検出の結果を保持し、人物がほとんど動いていなければ再利用する
+ *
+ * 骨格は切り出し画像に対する正規化座標のため、再利用すると新しい枠へ平行移動・拡大縮小される
+ */
+class PoseCache {
+   private:
+    struct Entry {
+        cv::Rect rect;           // 推論したときの枠
+        cv::Mat thumbnail;       // 推論したときの切り出し画像の縮小画像
+        cv::Mat candidate;       // 現在のフレームの切り出し画像の縮小画像
+        KeyPointList keypoints;  // 骨格
+        bool valid = false;      // 骨格を保持しているかどうか
+        std::uint64_t inferred_frame = 0;
+        std::uint64_t seen_frame = 0;
+    };
+
+    PoseCacheConfig config;
+    std::unordered_map<std::uint64_t, Entry> entries;
+    std::uint64_t frame = 0;
+    std::uint64_t num_hits = 0;
+    std::uint64_t num_misses = 0;
+    cv::Mat resized_crop;
+
+    /**
+     * @brief 切り出し画像を比較用の縮小画像にする
+     *
+     * @param crop 切り出し画像
+     * @param thumbnail 縮小画像の格納先
+     */
+    void make_thumbnail(const cv::Mat& crop, cv::Mat& thumbnail);
+
+   public:
+    /**
+     * @brief 空のキャッシュを作る
+     *
+     * @param config 骨格の再利用の設定
+     */
+    explicit PoseCache(const PoseCacheConfig& config = PoseCacheConfig());
+
+    /**
+     * @brief 次のフレームの処理を始める（しばらく見えていない人物の骨格を破棄する）
+     *
+     */
+    void begin_frame(void);
+
+    /**
+     * @brief 人物の骨格を再利用できるか調べ、できればコピーする
+     *
+     * @param track_id 追跡ID
+     * @param image フレーム
+     * @param rect 人物の枠（画像内に収まっていること）
+     * @param keypoints 再利用する骨格の格納先
+     * @return true 再利用した
+     * @return false 推論が必要（推論後にstore()を呼ぶ）
+     */
+    bool find(const std::uint64_t track_id, const cv::Mat& image, const cv::Rect& rect,
+              KeyPointList& keypoints);
+
+    /**
+     * @brief 推論した骨格を保持する（同じフレームで先にfind()を呼んでいること）
+     *
+     * @param track_id 追跡ID
+     * @param rect 人物の枠
+     * @param keypoints 骨格
+     */
+    void store(const std::uint64_t track_id, const cv::Rect& rect, const KeyPointList& keypoints);
+
+    /**
+     * @brief 骨格をすべて破棄する
+     *
+     */
+    void clear(void);
+
+    /**
+     * @brief find()で骨格を再利用した割合を返す
+     *
+     * @return double 割合（find()を呼んでいなければ0）
+     */
+    double get_hit_ratio(void) const;
+};
+
+/**
+ * @brief 追跡IDごとに骨格を再利用し、推論が必要な人物だけをバッチ推論する骨格検出器
+ *
+ * @tparam Detector 骨格検出タスク（PoseDetectorなど、画像のリストからKeyPointListへ出力できること）
+ */
+template <typename Detector>
+class CachedPoseDetector {
+   private:
+    Detector& detector;
+    PoseCache cache;
+    std::vector<cv::Mat> crops;
+    std::vector<std::size_t> inferred_indices;
+    std::vector<KeyPointList> outputs;
+
+   public:
+    /**
+     * @brief 骨格検出器を作る
+     *
+     * @param detector 骨格検出タスク（複数のCachedPoseDetectorで共有できる）
+     * @param config 骨格の再利用の設定
+     */
+    CachedPoseDetector(Detector& detector, const PoseCacheConfig& config = PoseCacheConfig())
+        : detector(detector), cache(config) {}
+
+    /**
+     * @brief 1フレーム分の人物の骨格を求める
+     *
+     * @param image フレーム
+     * @param rects 人物の枠（画像内に収まっていること）
+     * @param track_ids 人物の追跡ID（rectsと同じ順）
+     * @param keypoints_list 人物ごとの骨格の格納先（切り出し画像に対する正規化座標）
+     */
+    void task(const cv::Mat& image, const std::vector<cv::Rect>& rects,
+              const std::vector<std::uint64_t>& track_ids,
+              std::vector<KeyPointList>& keypoints_list) {
+        cache.begin_frame();
+        keypoints_list.resize(rects.size());
+        crops.clear();
+        inferred_indices.clear();
+        for (std::size_t i = 0; i < rects.size(); i++) {
+            if (!cache.find(track_ids[i], image, rects[i], keypoints_list[i])) {
+                crops.push_back(image(rects[i]));
+                inferred_indices.push_back(i);
+            }
+        }
+        if (crops.empty()) {
+            return;
+        }
+
+        // 再利用できなかった人物だけをまとめて推論する
+        outputs.resize(crops.size());
+        detector.task(crops, outputs);
+        for (std::size_t j = 0; j < inferred_indices.size(); j++) {
+            const std::size_t i = inferred_indices[j];
+            keypoints_list[i] = outputs[j];
+            cache.store(track_ids[i], rects[i], outputs[j]);
+        }
+    }
+
+    /**
+     * @brief 骨格を再利用した割合を返す
+     *
+     * @return double 割合
+     */
+    double get_hit_ratio(void) const { return cache.get_hit_ratio(); }
+};
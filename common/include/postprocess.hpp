@@ -11,66 +11,595 @@
  * @brief 後処理のインタフェース
  *
  * @tparam OutputType 出力の型
+ * @tparam BufferType 出力を書き込む再利用可能なバッファの型
  */
-template <typename OutputType>
+template <typename OutputType, typename BufferType = OutputType>
 class PostprocessInterface {
    public:
+    /**
+     * @brief 後処理の出力の型
+     *
+     */
+    using Output = OutputType;
+
+    /**
+     * @brief 後処理の出力を書き込む再利用可能なバッファの型
+     *
+     */
+    using Buffer = BufferType;
+
     /**
      * @brief 後処理の純仮想関数
      *
      * @param model モデル
+     * @param infer_request 推論を実行したリクエスト
      * @return OutputType 出力
      */
-    virtual OutputType postprocess(OpenVINOModel& model) = 0;
+    virtual OutputType postprocess(const OpenVINOModel& model, ov::InferRequest& infer_request) = 0;
+
+    /**
+     * @brief 後処理の出力をバッファへ書き込む純仮想関数
+     *
+     * バッファの内容は上書きする。確保済みのメモリを使い回すため、同じバッファを繰り返し渡せば
+     * 定常状態では検知数によらず、出力テンソルの形状の取得（ov::Shapeを値で返す）以外に
+     * メモリを確保しない
+     *
+     * @param model モデル
+     * @param infer_request 推論を実行したリクエスト
+     * @param output 出力の書き込み先
+     */
+    virtual void postprocess(const OpenVINOModel& model, ov::InferRequest& infer_request,
+                             BufferType& output) = 0;
+
+    /**
+     * @brief バッチ推論の出力を画像ごとにバッファへ書き込む純仮想関数
+     *
+     * バッチサイズは推論リクエストの入力テンソルのバッチ次元から求める
+     *
+     * @param model モデル
+     * @param infer_request 推論を実行したリクエスト
+     * @param outputs 画像ごとの出力の書き込み先（バッチサイズ分の要素）
+     */
+    virtual void postprocess_batch(const OpenVINOModel& model, ov::InferRequest& infer_request,
+                                   BufferType* outputs) = 0;
+};
+
+/**
+ * @brief 検知結果の絞り込みの設定
+ *
+ * 確信度の閾値は出力テンソルを読むときに適用し、閾値未満の検知枠は作らない。
+ * 既定値では閾値・NMS・ラベルごとの上限を適用せず、出力テンソルの先頭からmax_detections個を返す
+ */
+struct DetectionFilter {
+    /**
+     * @brief 確信度の閾値（これ未満の検知枠は捨てる）
+     *
+     */
+    float confidence_threshold = 0.0f;
+
+    /**
+     * @brief ラベルごとの確信度の閾値（添字がラベル、範囲外のラベルはconfidence_thresholdを使う）
+     *
+     */
+    std::vector<float> class_thresholds;
+
+    /**
+     * @brief NMSで重なりとみなすIoUの閾値（1以上ならNMSしない）
+     *
+     */
+    float nms_threshold = 1.0f;
+
+    /**
+     * @brief NMSをラベルごとに行うかどうか（falseなら異なるラベルの検知枠どうしも抑制する）
+     *
+     */
+    bool class_aware_nms = true;
+
+    /**
+     * @brief ラベルごとに残す検知枠の上限（確信度の高い順、0なら制限しない）
+     *
+     */
+    std::size_t top_k_per_class = 0;
+
+    /**
+     * @brief 画像ごとに残す検知枠の上限（0なら制限しない）
+     *
+     * NMSもラベルごとの上限も使わない場合は出力テンソルの順に、それ以外は確信度の高い順に残す
+     */
+    std::size_t max_detections = 0;
+
+    /**
+     * @brief ラベルの確信度の閾値を返す
+     *
+     * @param label ラベル
+     * @return float 確信度の閾値
+     */
+    float get_threshold(const int label) const;
+
+    /**
+     * @brief 確信度の順に並べ替えて絞り込む必要があるかどうかを返す
+     *
+     * @return true NMSまたはラベルごとの上限を使う
+     * @return false 出力テンソルを読むときの閾値と上限だけで済む
+     */
+    bool needs_suppression(void) const;
 };
 
+/**
+ * @brief 検知結果を確信度の降順に並べ替え、NMS・ラベルごとの上限・画像ごとの上限を適用する
+ *
+ * 確信度の閾値はここでは適用しない（出力テンソルを読むときに適用する）。
+ * IoUは残した検知枠の座標の配列に対して分岐のないループで求めるため、コンパイラがベクトル化できる。
+ * ラベルごとのNMSは、ラベルごとに座標をずらして異なるラベルの検知枠が重ならないようにして1回で行う
+ *
+ * @param bboxes 検知結果（絞り込んだ結果で上書きする）
+ * @param filter 絞り込みの設定
+ */
+void suppress_detections(BBoxList& bboxes, const DetectionFilter& filter);
+
 /**
  * @brief 検知枠[N,5]とラベル[N]を返す後処理
  *
  */
-class BBox5Label1 : public PostprocessInterface<std::vector<BBox>> {
+class BBox5Label1 : public PostprocessInterface<std::vector<BBox>, BBoxList> {
    private:
-    static const std::size_t MAX_DETECTION = 100;
+    static const std::size_t DEFAULT_MAX_DETECTION = 100;
+
+    DetectionFilter filter;
 
    public:
+    /**
+     * @brief 画像ごとの上限を100個とした後処理を作る
+     *
+     */
+    BBox5Label1(void);
+
+    /**
+     * @brief 検知結果の絞り込みを設定する
+     *
+     * @param filter 絞り込みの設定
+     */
+    void set_filter(const DetectionFilter& filter);
+
+    /**
+     * @brief 検知結果の絞り込みの設定を返す
+     *
+     * @return const DetectionFilter& 絞り込みの設定
+     */
+    const DetectionFilter& get_filter(void) const;
+
     /**
      * @brief 検知枠[N,5]とラベル[N]を返す後処理
      *
      * @param model モデル
+     * @param infer_request 推論を実行したリクエスト
+     * @return std::vector<BBox> BBoxのリスト
+     */
+    std::vector<BBox> postprocess(const OpenVINOModel& model,
+                                  ov::InferRequest& infer_request) override;
+
+    /**
+     * @brief 出力テンソルから検知枠を取得する
+     *
+     * @param input_shape モデルの入力サイズ（座標の正規化に使用）
+     * @param boxes_tensor 検知枠[N,5]
+     * @param labels_tensor ラベル[N]
      * @return std::vector<BBox> BBoxのリスト
      */
-    std::vector<BBox> postprocess(OpenVINOModel& model) override;
+    std::vector<BBox> postprocess(const ov::Shape& input_shape, const ov::Tensor& boxes_tensor,
+                                  const ov::Tensor& labels_tensor);
+
+    /**
+     * @brief 検知枠[N,5]とラベル[N]をバッファへ書き込む後処理
+     *
+     * @param model モデル
+     * @param infer_request 推論を実行したリクエスト
+     * @param bboxes BBoxのリストの書き込み先
+     */
+    void postprocess(const OpenVINOModel& model, ov::InferRequest& infer_request,
+                     BBoxList& bboxes) override;
+
+    /**
+     * @brief 出力テンソルから検知枠を取得し、バッファへ書き込む
+     *
+     * @param input_shape モデルの入力サイズ（座標の正規化に使用）
+     * @param boxes_tensor 検知枠[N,5]
+     * @param labels_tensor ラベル[N]
+     * @param bboxes BBoxのリストの書き込み先
+     */
+    void postprocess(const ov::Shape& input_shape, const ov::Tensor& boxes_tensor,
+                     const ov::Tensor& labels_tensor, BBoxList& bboxes);
+
+    /**
+     * @brief バッチ推論の出力を画像ごとにバッファへ書き込む
+     *
+     * 出力に画像の番号が含まれないため、バッチサイズ1の推論のみ対応する（2以上は例外を送出する）
+     *
+     * @param model モデル
+     * @param infer_request 推論を実行したリクエスト
+     * @param bboxes_list 画像ごとのBBoxのリストの書き込み先（1要素）
+     */
+    void postprocess_batch(const OpenVINOModel& model, ov::InferRequest& infer_request,
+                           BBoxList* bboxes_list) override;
 };
 
 /**
  * @brief 検知枠[N,7]を返す後処理
  *
  */
-class BBox7 : public PostprocessInterface<std::vector<BBox>> {
+class BBox7 : public PostprocessInterface<std::vector<BBox>, BBoxList> {
    private:
-    static const std::size_t MAX_DETECTION = 200;
+    static const std::size_t DEFAULT_MAX_DETECTION = 200;
+
+    DetectionFilter filter;
 
    public:
+    /**
+     * @brief 画像ごとの上限を200個とした後処理を作る
+     *
+     */
+    BBox7(void);
+
+    /**
+     * @brief 検知結果の絞り込みを設定する
+     *
+     * @param filter 絞り込みの設定
+     */
+    void set_filter(const DetectionFilter& filter);
+
+    /**
+     * @brief 検知結果の絞り込みの設定を返す
+     *
+     * @return const DetectionFilter& 絞り込みの設定
+     */
+    const DetectionFilter& get_filter(void) const;
+
     /**
      * @brief 検知枠[N,7]を返す後処理
      *
      * @param model モデル
+     * @param infer_request 推論を実行したリクエスト
+     * @return std::vector<BBox> BBoxのリスト
+     */
+    std::vector<BBox> postprocess(const OpenVINOModel& model,
+                                  ov::InferRequest& infer_request) override;
+
+    /**
+     * @brief 出力テンソルから検知枠を取得する
+     *
+     * @param boxes_tensor 検知枠[1,1,N,7]
      * @return std::vector<BBox> BBoxのリスト
      */
-    std::vector<BBox> postprocess(OpenVINOModel& model) override;
+    std::vector<BBox> postprocess(const ov::Tensor& boxes_tensor);
+
+    /**
+     * @brief 検知枠[N,7]をバッファへ書き込む後処理
+     *
+     * @param model モデル
+     * @param infer_request 推論を実行したリクエスト
+     * @param bboxes BBoxのリストの書き込み先
+     */
+    void postprocess(const OpenVINOModel& model, ov::InferRequest& infer_request,
+                     BBoxList& bboxes) override;
+
+    /**
+     * @brief 出力テンソルから検知枠を取得し、バッファへ書き込む（画像IDが0の検知枠のみ）
+     *
+     * @param boxes_tensor 検知枠[1,1,N,7]
+     * @param bboxes BBoxのリストの書き込み先
+     */
+    void postprocess(const ov::Tensor& boxes_tensor, BBoxList& bboxes);
+
+    /**
+     * @brief バッチ推論の検知枠[N,7]を画像IDごとにバッファへ書き込む
+     *
+     * @param model モデル
+     * @param infer_request 推論を実行したリクエスト
+     * @param bboxes_list 画像ごとのBBoxのリストの書き込み先（バッチサイズ分の要素）
+     */
+    void postprocess_batch(const OpenVINOModel& model, ov::InferRequest& infer_request,
+                           BBoxList* bboxes_list) override;
+
+    /**
+     * @brief 出力テンソルから検知枠を取得し、画像IDごとにバッファへ書き込む
+     *
+     * 画像ごとに絞り込みの設定を適用し、画像IDがバッチサイズ以上の検知枠は無視する
+     *
+     * @param boxes_tensor 検知枠[1,1,N,7]
+     * @param batch_size バッチサイズ
+     * @param bboxes_list 画像ごとのBBoxのリストの書き込み先（バッチサイズ分の要素）
+     */
+    void postprocess_batch(const ov::Tensor& boxes_tensor, const std::size_t batch_size,
+                           BBoxList* bboxes_list);
+};
+
+/**
+ * @brief チャンネルごとに最大値とその位置を求める（SIMDで全チャンネルを先頭から1回だけ走査する）
+ *
+ * 最大値が複数ある場合は最も前の位置を返す
+ *
+ * @param data データ[C, plane_size]の先頭
+ * @param num_channels チャンネル数C
+ * @param plane_size 1チャンネルの要素数
+ * @param max_indices チャンネルごとの最大値の位置の格納先（C要素）
+ * @param max_values チャンネルごとの最大値の格納先（C要素）
+ */
+void argmax_channels(const float* data, const std::size_t num_channels,
+                     const std::size_t plane_size, std::size_t* max_indices, float* max_values);
+
+/**
+ * @brief ヒートマップの最大値の位置をサブピクセル精度へ補正する方法
+ *
+ */
+enum class KeyPointRefine {
+    None,           // 補正しない（格子点の座標）
+    QuarterOffset,  // 隣接画素の大小に応じて0.25画素ずらす（OpenPoseDecoder.refineと同じ）
+    Taylor,         // 周囲3x3画素の2次のテイラー展開から極値の位置を求める
 };
 
 /**
  * @brief キーポイント[1, 17, 224, 224]を返す後処理
  *
  */
-class KeyPoints : public PostprocessInterface<std::vector<KeyPoint>> {
+class KeyPoints : public PostprocessInterface<std::vector<KeyPoint>, KeyPointList> {
+   private:
+    KeyPointRefine refine = KeyPointRefine::QuarterOffset;
+    bool parallel_batch = true;
+
+    /**
+     * @brief 1枚分のヒートマップ[17, H, W]からキーポイントを検出する
+     *
+     * @param heatmaps ヒートマップの先頭
+     * @param output_shape 出力サイズ[N, 17, H, W]
+     * @param refine サブピクセル補正の方法
+     * @param keypoints キーポイントのリストの書き込み先
+     */
+    static void decode(const float* heatmaps, const ov::Shape& output_shape,
+                       const KeyPointRefine refine, KeyPointList& keypoints);
+
    public:
+    /**
+     * @brief サブピクセル補正の方法を設定する（既定はQuarterOffset）
+     *
+     * @param refine サブピクセル補正の方法
+     */
+    void set_refine(const KeyPointRefine refine);
+
+    /**
+     * @brief バッチ推論の結果を複数スレッドで後処理するかどうかを設定する（既定はtrue）
+     *
+     * @param parallel_batch 複数スレッドで後処理するかどうか
+     */
+    void set_parallel_batch(const bool parallel_batch);
+
     /**
      * @brief キーポイント[1, 17, 224, 224]を返す後処理
      *
      * @param model モデル
+     * @param infer_request 推論を実行したリクエスト
      * @return std::vector<cv::Point2f> キーポイントのリスト
      */
-    std::vector<KeyPoint> postprocess(OpenVINOModel& model) override;
+    std::vector<KeyPoint> postprocess(const OpenVINOModel& model,
+                                      ov::InferRequest& infer_request) override;
+
+    /**
+     * @brief ヒートマップのテンソルからキーポイントを取得する（バッチの先頭要素のみ）
+     *
+     * @param heatmaps_tensor ヒートマップ[N, 17, H, W]
+     * @return std::vector<KeyPoint> キーポイントのリスト
+     */
+    std::vector<KeyPoint> postprocess(const ov::Tensor& heatmaps_tensor);
+
+    /**
+     * @brief キーポイント[N, 17, 224, 224]をバッチ要素ごとに返す後処理
+     *
+     * @param model モデル
+     * @param infer_request 推論を実行したリクエスト
+     * @return std::vector<std::vector<KeyPoint>> バッチ要素ごとのキーポイントのリスト
+     */
+    std::vector<std::vector<KeyPoint>> postprocess_batch(const OpenVINOModel& model,
+                                                         ov::InferRequest& infer_request);
+
+    /**
+     * @brief ヒートマップのテンソルからバッチ要素ごとのキーポイントを取得する
+     *
+     * @param heatmaps_tensor ヒートマップ[N, 17, H, W]
+     * @return std::vector<std::vector<KeyPoint>> バッチ要素ごとのキーポイントのリスト
+     */
+    std::vector<std::vector<KeyPoint>> postprocess_batch(const ov::Tensor& heatmaps_tensor);
+
+    /**
+     * @brief キーポイント[1, 17, 224, 224]をバッファへ書き込む後処理
+     *
+     * @param model モデル
+     * @param infer_request 推論を実行したリクエスト
+     * @param keypoints キーポイントのリストの書き込み先
+     */
+    void postprocess(const OpenVINOModel& model, ov::InferRequest& infer_request,
+                     KeyPointList& keypoints) override;
+
+    /**
+     * @brief ヒートマップのテンソルからキーポイントを取得し、バッファへ書き込む（バッチの先頭要素のみ）
+     *
+     * @param heatmaps_tensor ヒートマップ[N, 17, H, W]
+     * @param keypoints キーポイントのリストの書き込み先
+     */
+    void postprocess(const ov::Tensor& heatmaps_tensor, KeyPointList& keypoints);
+
+    /**
+     * @brief キーポイント[N, 17, 224, 224]をバッチ要素ごとにバッファへ書き込む後処理
+     *
+     * @param model モデル
+     * @param infer_request 推論を実行したリクエスト
+     * @param keypoints_list バッチ要素ごとのキーポイントのリストの書き込み先（要素数はNに合わせる）
+     */
+    void postprocess_batch(const OpenVINOModel& model, ov::InferRequest& infer_request,
+                           std::vector<KeyPointList>& keypoints_list);
+
+    /**
+     * @brief ヒートマップのテンソルからバッチ要素ごとのキーポイントを取得し、バッファへ書き込む
+     *
+     * @param heatmaps_tensor ヒートマップ[N, 17, H, W]
+     * @param keypoints_list バッチ要素ごとのキーポイントのリストの書き込み先（要素数はNに合わせる）
+     */
+    void postprocess_batch(const ov::Tensor& heatmaps_tensor,
+                           std::vector<KeyPointList>& keypoints_list);
+
+    /**
+     * @brief キーポイント[N, 17, 224, 224]をバッチ要素ごとに配列へ書き込む後処理
+     *
+     * @param model モデル
+     * @param infer_request 推論を実行したリクエスト
+     * @param keypoints_list バッチ要素ごとのキーポイントのリストの書き込み先（N要素）
+     */
+    void postprocess_batch(const OpenVINOModel& model, ov::InferRequest& infer_request,
+                           KeyPointList* keypoints_list) override;
+
+    /**
+     * @brief ヒートマップのテンソルからバッチ要素ごとのキーポイントを取得し、配列へ書き込む
+     *
+     * @param heatmaps_tensor ヒートマップ[N, 17, H, W]
+     * @param keypoints_list バッチ要素ごとのキーポイントのリストの書き込み先（N要素）
+     */
+    void postprocess_batch(const ov::Tensor& heatmaps_tensor, KeyPointList* keypoints_list);
+};
+
+/**
+ * @brief 複数人の骨格[heatmaps: 1, 19, H, W、pafs: 1, 38, H, W]を返す後処理（OpenPose）
+ *
+ * ヒートマップから関節候補を抽出し、PAF（Part Affinity Fields）で関節どうしをつないで人物ごとに
+ * まとめる。python/human-pose-estimation-0001/decoder.pyのOpenPoseDecoderを移植したもの
+ */
+class OpenPoseDecoder : public PostprocessInterface<std::vector<Pose>> {
+   public:
+    /**
+     * @brief 関節の種類数（OpenPoseの18点）
+     *
+     */
+    static constexpr std::size_t NUM_JOINTS = 18;
+
+    /**
+     * @brief 肢（関節のペア）の数
+     *
+     */
+    static constexpr std::size_t NUM_LIMBS = 19;
+
+   private:
+    /**
+     * @brief 関節候補
+     *
+     */
+    struct Candidate {
+        float x;
+        float y;
+        float score;
+        int id;  // 全関節候補の通し番号
+    };
+
+    std::size_t max_points;
+    float score_threshold;
+    float min_paf_alignment_score;
+    float delta;
+
+    /**
+     * @brief ヒートマップから関節の種類ごとに候補を抽出する
+     *
+     * @param heatmaps ヒートマップ[C, H, W]の先頭
+     * @param height 高さH
+     * @param width 幅W
+     * @return std::vector<std::vector<Candidate>> 関節の種類ごとの候補
+     */
+    std::vector<std::vector<Candidate>> extract_points(const float* heatmaps,
+                                                       const std::size_t height,
+                                                       const std::size_t width) const;
+
+    /**
+     * @brief PAFで関節候補をつなぎ、人物ごとにまとめる
+     *
+     * @param candidates 関節の種類ごとの候補
+     * @param pafs PAF[38, H, W]の先頭
+     * @param height 高さH
+     * @param width 幅W
+     * @return std::vector<std::vector<float>> 人物ごとの関節候補の通し番号（なければ-1）、
+     * 末尾の2要素はスコアと関節数
+     */
+    std::vector<std::vector<float>> group_keypoints(
+        const std::vector<std::vector<Candidate>>& candidates, const float* pafs,
+        const std::size_t height, const std::size_t width) const;
+
+    /**
+     * @brief 1枚分のヒートマップとPAFから複数人の骨格を求める
+     *
+     * @param heatmaps ヒートマップ[C, H, W]の先頭
+     * @param pafs PAF[38, H, W]の先頭
+     * @param height 高さH
+     * @param width 幅W
+     * @return std::vector<Pose> 人物ごとの骨格（座標は0〜1に正規化）
+     */
+    std::vector<Pose> decode(const float* heatmaps, const float* pafs, const std::size_t height,
+                             const std::size_t width) const;
+
+    /**
+     * @brief 推論リクエストからヒートマップとPAFのテンソルを取得する（チャンネル数で見分ける）
+     *
+     * @param infer_request 推論を実行したリクエスト
+     * @param heatmaps_tensor ヒートマップ[N, 19, H, W]の格納先
+     * @param pafs_tensor PAF[N, 38, H, W]の格納先
+     */
+    static void get_output_tensors(ov::InferRequest& infer_request, ov::Tensor& heatmaps_tensor,
+                                   ov::Tensor& pafs_tensor);
+
+   public:
+    /**
+     * @brief コンストラクタ
+     *
+     * @param max_points 関節の種類ごとに抽出する候補の最大数
+     * @param score_threshold 関節候補とみなすヒートマップの値の閾値
+     * @param min_paf_alignment_score 肢の向きとPAFが一致しているとみなす閾値
+     * @param delta 関節候補の座標に加えるオフセット[画素]
+     */
+    OpenPoseDecoder(const std::size_t max_points = 100, const float score_threshold = 0.1f,
+                    const float min_paf_alignment_score = 0.05f, const float delta = 0.5f);
+
+    /**
+     * @brief 複数人の骨格を返す後処理
+     *
+     * @param model モデル
+     * @param infer_request 推論を実行したリクエスト
+     * @return std::vector<Pose> 人物ごとの骨格（座標は0〜1に正規化）
+     */
+    std::vector<Pose> postprocess(const OpenVINOModel& model,
+                                  ov::InferRequest& infer_request) override;
+
+    /**
+     * @brief 複数人の骨格をバッファへ書き込む後処理
+     *
+     * 関節候補のグループ化で作業用のメモリを確保するため、他の後処理と異なりメモリ確保は避けられない
+     *
+     * @param model モデル
+     * @param infer_request 推論を実行したリクエスト
+     * @param poses 人物ごとの骨格の書き込み先
+     */
+    void postprocess(const OpenVINOModel& model, ov::InferRequest& infer_request,
+                     std::vector<Pose>& poses) override;
+
+    /**
+     * @brief ヒートマップとPAFのテンソルから複数人の骨格を取得する（バッチの先頭要素のみ）
+     *
+     * @param heatmaps_tensor ヒートマップ[N, 19, H, W]
+     * @param pafs_tensor PAF[N, 38, H, W]
+     * @return std::vector<Pose> 人物ごとの骨格（座標は0〜1に正規化）
+     */
+    std::vector<Pose> postprocess(const ov::Tensor& heatmaps_tensor,
+                                  const ov::Tensor& pafs_tensor);
+
+    /**
+     * @brief バッチ推論の出力から画像ごとに複数人の骨格を求め、バッファへ書き込む
+     *
+     * @param model モデル
+     * @param infer_request 推論を実行したリクエスト
+     * @param poses_list 画像ごとの骨格の書き込み先（バッチサイズ分の要素）
+     */
+    void postprocess_batch(const OpenVINOModel& model, ov::InferRequest& infer_request,
+                           std::vector<Pose>* poses_list) override;
 };
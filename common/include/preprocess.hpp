@@ -2,6 +2,7 @@
 
 #include <opencv2/opencv.hpp>
 #include <openvino/openvino.hpp>
+#include <vector>
 
 #include "openvino_model.hpp"
 
@@ -11,6 +12,15 @@
  */
 class PreprocessInterface {
    public:
+    /**
+     * @brief モデルのコンパイル前に、前処理をモデルへ組み込む
+     *
+     * 既定では何も組み込まない
+     *
+     * @param ppp 組み込み先のPrePostProcessor
+     */
+    virtual void embed(ov::preprocess::PrePostProcessor& ppp) const {}
+
     /**
      * @brief 前処理の純仮想関数
      *
@@ -19,6 +29,43 @@ class PreprocessInterface {
      * @return ov::Tensor モデルへ入力するテンソル
      */
     virtual ov::Tensor preprocess(const OpenVINOModel& model, const cv::Mat& image) = 0;
+
+    /**
+     * @brief 複数画像を1つのバッチへまとめる前処理の純仮想関数
+     *
+     * @param model モデル
+     * @param images 入力画像のリスト（要素数はモデルの最大バッチサイズ以下）
+     * @return ov::Tensor モデルへ入力するテンソル
+     */
+    virtual ov::Tensor preprocess(const OpenVINOModel& model,
+                                  const std::vector<cv::Mat>& images) = 0;
+
+    /**
+     * @brief 前処理の結果を推論リクエストの入力として設定する
+     *
+     * 既定ではpreprocess()で作ったテンソルをset_input_tensor()で設定する。
+     * 推論リクエストの入力テンソルへ直接書き込める前処理はオーバーライドする
+     *
+     * @param model モデル
+     * @param image 入力画像
+     * @param infer_request 入力を設定する推論リクエスト
+     */
+    virtual void preprocess_into(const OpenVINOModel& model, const cv::Mat& image,
+                                 ov::InferRequest& infer_request) {
+        infer_request.set_input_tensor(preprocess(model, image));
+    }
+
+    /**
+     * @brief 複数画像をまとめた前処理の結果を推論リクエストの入力として設定する
+     *
+     * @param model モデル
+     * @param images 入力画像のリスト（要素数はモデルの最大バッチサイズ以下）
+     * @param infer_request 入力を設定する推論リクエスト
+     */
+    virtual void preprocess_into(const OpenVINOModel& model, const std::vector<cv::Mat>& images,
+                                 ov::InferRequest& infer_request) {
+        infer_request.set_input_tensor(preprocess(model, images));
+    }
 };
 
 /**
@@ -26,22 +73,108 @@ class PreprocessInterface {
  *
  */
 class FloatCHW : public PreprocessInterface {
-   private:
+   public:
     /**
-     * @brief Tensorが示す画像のメモリが解放されないように保持しておく変数
+     * @brief float型のCHW配列へ変換する前処理
+     *
+     * 返却するテンソルは自身でメモリを保持するため、非同期推論中も有効
      *
+     * @param model モデル
+     * @param image 入力画像
+     * @return ov::Tensor モデルへ入力するテンソル
      */
-    cv::Mat allocated_image;
+    ov::Tensor preprocess(const OpenVINOModel& model, const cv::Mat& image) override;
 
-   public:
     /**
-     * @brief float型のCHW配列へ変換する前処理
+     * @brief 入力サイズを指定してfloat型のCHW配列へ変換する前処理
+     *
+     * @param input_shape モデルの入力サイズ[1, C, H, W]
+     * @param image 入力画像
+     * @return ov::Tensor モデルへ入力するテンソル
+     */
+    ov::Tensor preprocess(const ov::Shape& input_shape, const cv::Mat& image);
+
+    /**
+     * @brief 複数画像をfloat型のNCHW配列へまとめる前処理
+     *
+     * @param model モデル
+     * @param images 入力画像のリスト
+     * @return ov::Tensor モデルへ入力するテンソル
+     */
+    ov::Tensor preprocess(const OpenVINOModel& model, const std::vector<cv::Mat>& images) override;
+
+    /**
+     * @brief 推論リクエストが保持する入力テンソルへ直接書き込む前処理
+     *
+     * フレームごとにテンソルを確保しない。高さ・幅が動的なモデルでは入力テンソルのサイズを変更する
      *
      * @param model モデル
      * @param image 入力画像
+     * @param infer_request 入力を設定する推論リクエスト
+     */
+    void preprocess_into(const OpenVINOModel& model, const cv::Mat& image,
+                         ov::InferRequest& infer_request) override;
+
+    /**
+     * @brief 推論リクエストが保持する入力テンソルへ複数画像をまとめて書き込む前処理
+     *
+     * @param model モデル
+     * @param images 入力画像のリスト
+     * @param infer_request 入力を設定する推論リクエスト
+     */
+    void preprocess_into(const OpenVINOModel& model, const std::vector<cv::Mat>& images,
+                         ov::InferRequest& infer_request) override;
+
+    /**
+     * @brief 確保済みのテンソルへfloat型のCHW配列として書き込む
+     *
+     * @param images 入力画像のリスト（要素数はテンソルのバッチサイズN）
+     * @param input_tensor 書き込み先のテンソル[N, C, H, W]（サイズはそのまま）
+     */
+    void preprocess_into(const std::vector<cv::Mat>& images, ov::Tensor& input_tensor);
+
+    /**
+     * @brief 確保済みのテンソルへfloat型のCHW配列として書き込む
+     *
+     * @param image 入力画像
+     * @param input_tensor 書き込み先のテンソル[1, C, H, W]（サイズはそのまま）
+     */
+    void preprocess_into(const cv::Mat& image, ov::Tensor& input_tensor);
+};
+
+/**
+ * @brief u8型のNHWC画像をそのまま入力し、リサイズ・型変換・レイアウト変換をモデルへ組み込む前処理
+ *
+ * 任意の解像度のBGR画像を受け付ける。連続メモリの画像はコピーせずにテンソルへ渡すため、
+ * 非同期推論では推論完了まで画像の内容を変更しないこと
+ *
+ */
+class U8NHWCEmbedded : public PreprocessInterface {
+   public:
+    /**
+     * @brief u8型NHWCのBGR画像を入力とし、リサイズ・float変換・NCHW変換をモデルへ組み込む
+     *
+     * @param ppp 組み込み先のPrePostProcessor
+     */
+    void embed(ov::preprocess::PrePostProcessor& ppp) const override;
+
+    /**
+     * @brief 画像のメモリをu8型のNHWCテンソルとして渡す前処理
+     *
+     * @param model モデル
+     * @param image 入力画像（CV_8UC3のBGR画像。それ以外はstd::invalid_argumentを投げる）
      * @return ov::Tensor モデルへ入力するテンソル
      */
     ov::Tensor preprocess(const OpenVINOModel& model, const cv::Mat& image) override;
+
+    /**
+     * @brief 同じ解像度の複数画像をu8型のNHWCテンソルへまとめる前処理
+     *
+     * @param model モデル
+     * @param images 入力画像のリスト（すべて同じ解像度のCV_8UC3画像であること）
+     * @return ov::Tensor モデルへ入力するテンソル
+     */
+    ov::Tensor preprocess(const OpenVINOModel& model, const std::vector<cv::Mat>& images) override;
 };
 
 /**
@@ -51,3 +184,55 @@ class FloatCHW : public PreprocessInterface {
  * @return cv::Mat 変換後の画像
  */
 cv::Mat convert_hwc2chw(const cv::Mat& image);
+
+/**
+ * @brief u8型HWC形式の画像を、float型CHW形式で指定のメモリへ1パスで書き込む
+ *
+ * 実行環境のCPUに応じてAVX-512/AVX2/SSE4.1/スカラー実装を自動で選択する。
+ * 各画素は (x - mean) / scale で正規化する（mean・scaleは出力チャンネルの順）
+ *
+ * @param image 変換前の画像（CV_8UC3）
+ * @param chw_data 書き込み先（3 * H * W要素）
+ * @param swap_rb trueならBとRを入れ替えて出力する
+ * @param mean チャンネルごとの平均値
+ * @param scale チャンネルごとのスケール
+ */
+void convert_hwc2chw(const cv::Mat& image, float* chw_data, const bool swap_rb = false,
+                     const cv::Scalar& mean = cv::Scalar::all(0),
+                     const cv::Scalar& scale = cv::Scalar::all(1));
+
+/**
+ * @brief convert_hwc2chw()の命令セットごとの実装（値が大きいほど新しい命令セット）
+ *
+ * どの実装もスカラー実装とビット単位で同じ値を出力する
+ */
+enum class SimdLevel { Scalar, SSE41, AVX2, AVX512 };
+
+/**
+ * @brief 実装の名前を返す
+ *
+ * @param level 実装
+ * @return const char* 名前（"avx2"など）
+ */
+const char* get_simd_level_name(const SimdLevel level);
+
+/**
+ * @brief 実行環境のCPUが対応する最速の実装を返す
+ *
+ * @return SimdLevel 実装
+ */
+SimdLevel get_supported_simd_level(void);
+
+/**
+ * @brief 実装を指定してconvert_hwc2chw()を実行する（テスト・ベンチマークで実装を比べるために使う）
+ *
+ * @param image 変換前の画像（CV_8UC3）
+ * @param chw_data 書き込み先（3 * H * W要素）
+ * @param level 実装（get_supported_simd_level()以下であること）
+ * @param swap_rb trueならBとRを入れ替えて出力する
+ * @param mean チャンネルごとの平均値
+ * @param scale チャンネルごとのスケール
+ */
+void convert_hwc2chw(const cv::Mat& image, float* chw_data, const SimdLevel level,
+                     const bool swap_rb = false, const cv::Scalar& mean = cv::Scalar::all(0),
+                     const cv::Scalar& scale = cv::Scalar::all(1));
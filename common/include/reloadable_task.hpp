@@ -0,0 +1,424 @@
+#pragma once
+
+#include <pthread.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "model_config.hpp"
+#include "task_profiler.hpp"
+
+/**
+ * @brief モデルの入れ替えの設定
+ *
+ */
+struct ReloadConfig {
+    /**
+     * @brief モデルファイルの更新を確かめる間隔（0なら監視せず、reload()でだけ入れ替える）
+     *
+     * 書き込み途中のファイルを読まないよう、更新日時とサイズが2回続けて同じになってから読み込む
+     */
+    std::chrono::milliseconds watch_interval{0};
+
+    /**
+     * @brief 入れ替える前に行う暖機の推論回数（0なら推論リクエスト数と同じ回数）
+     *
+     * 推論リクエストは空いた順に使われるため、推論リクエスト数と同じ回数で全リクエストを一度ずつ使う
+     */
+    std::size_t num_warmup = 0;
+
+    /**
+     * @brief 暖機に使う画像（空なら1280x720の灰色の画像）
+     *
+     */
+    cv::Mat warmup_image;
+};
+
+/**
+ * @brief モデルの入れ替えの結果
+ *
+ */
+struct ReloadResult {
+    std::string model_path;        // 読み込んだモデルのパス
+    ModelLoadReport load_report;   // 読み込み・コンパイルにかかった時間
+    double warmup_time_ms = 0.0;   // 暖機にかかった時間[ms]
+    std::exception_ptr exception;  // 失敗した場合の例外（成功時はnullptr、古いモデルを使い続ける）
+};
+
+/**
+ * @brief 推論を止めずにモデルを入れ替えられるタスク
+ *
+ * 新しいモデルは専用スレッドで読み込み・コンパイルし、暖機の推論を済ませてから現在のモデルと入れ替える。
+ * 入れ替え前に始まった推論は古いモデルで最後まで実行され、古いモデルはすべての推論が終わってから
+ * 専用スレッドで解放される
+ *
+ * @tparam Task タスク（DetectorBBox7など。モデルのパスと読み込み設定から構築できること）
+ */
+template <typename Task>
+class ReloadableTask {
+   public:
+    /**
+     * @brief タスクの出力の型
+     *
+     */
+    using Output = typename Task::Output;
+
+    /**
+     * @brief タスクの出力を書き込むバッファの型
+     *
+     */
+    using Buffer = typename Task::Buffer;
+
+    /**
+     * @brief 読み込んだタスクを推論に使う前に設定する関数（検知結果の絞り込みなど）
+     *
+     */
+    using Configure = std::function<void(Task&)>;
+
+    /**
+     * @brief 入れ替えを試みるたびに呼ばれるコールバック（専用スレッドから呼ばれる）
+     *
+     */
+    using ReloadCallback = std::function<void(const ReloadResult&)>;
+
+   private:
+    /**
+     * @brief モデルファイルと重みファイルの更新日時とサイズ（ファイルの更新の検知に使う）
+     *
+     */
+    struct ModelStamp {
+        std::filesystem::file_time_type model_time;
+        std::uintmax_t model_size = 0;
+        std::filesystem::file_time_type weights_time;
+        std::uintmax_t weights_size = 0;
+
+        bool operator==(const ModelStamp& other) const {
+            return model_time == other.model_time && model_size == other.model_size &&
+                   weights_time == other.weights_time && weights_size == other.weights_size;
+        }
+
+        bool operator!=(const ModelStamp& other) const { return !(*this == other); }
+    };
+
+    ModelConfig config;
+    ReloadConfig reload_config;
+    Configure configure;
+    ReloadCallback on_reload;
+
+    // 推論に使うタスク（入れ替え中も推論できるよう、参照を取り出す間だけロックする）
+    std::shared_ptr<Task> current;
+    std::string model_path;
+    mutable std::mutex current_mutex;
+
+    // 専用スレッドへの入れ替えの要求
+    std::string requested_path;
+    bool stopped = false;
+    std::mutex reload_mutex;
+    std::condition_variable reload_cv;
+
+    // 入れ替え前のタスク（推論中の参照がなくなったら専用スレッドで解放する）
+    std::vector<std::shared_ptr<Task>> retired;
+
+    ModelStamp loaded_stamp;
+    ModelStamp pending_stamp;
+    std::uint64_t num_reloads = 0;
+    std::thread reloader;
+
+    /**
+     * @brief 推論中の参照がなくなった古いタスクを確かめる間隔
+     *
+     */
+    static constexpr std::chrono::milliseconds RETIRE_INTERVAL{100};
+
+    /**
+     * @brief モデルファイルと重みファイル（IRの.bin）の更新日時とサイズを返す
+     *
+     * @param path モデルのパス
+     * @return ModelStamp 更新日時とサイズ（ファイルがなければ既定値）
+     */
+    static ModelStamp get_stamp(const std::string& path) {
+        ModelStamp stamp;
+        std::error_code error;
+        std::filesystem::path weights_path(path);
+        weights_path.replace_extension(".bin");
+        stamp.model_time = std::filesystem::last_write_time(path, error);
+        stamp.model_size = std::filesystem::file_size(path, error);
+        if (weights_path != std::filesystem::path(path)) {
+            stamp.weights_time = std::filesystem::last_write_time(weights_path, error);
+            stamp.weights_size = std::filesystem::file_size(weights_path, error);
+        }
+        return stamp;
+    }
+
+    /**
+     * @brief 新しいタスクを読み込み、設定と暖機を済ませる
+     *
+     * @param path モデルのパス
+     * @param result 結果の格納先
+     * @return std::shared_ptr<Task> タスク
+     */
+    std::shared_ptr<Task> load(const std::string& path, ReloadResult& result) {
+        result.model_path = path;
+        auto task = std::make_shared<Task>(path, config);
+        result.load_report = task->get_load_report();
+        if (configure) {
+            configure(*task);
+        }
+
+        // 最初の推論で発生する初期化を入れ替え前に済ませる（最大バッチサイズの入力で全リクエストを使う）
+        const auto started = std::chrono::steady_clock::now();
+        cv::Mat image = reload_config.warmup_image;
+        if (image.empty()) {
+            image = cv::Mat(720, 1280, CV_8UC3, cv::Scalar::all(128));
+        }
+        const std::vector<cv::Mat> images(config.max_batch_size, image);
+        std::vector<Buffer> outputs;
+        const std::size_t num_warmup =
+            reload_config.num_warmup > 0 ? reload_config.num_warmup : config.num_requests;
+        for (std::size_t i = 0; i < num_warmup; i++) {
+            task->task(images, outputs);
+        }
+        // 暖機の推論は統計に含めない
+        task->get_profiler().reset();
+        result.warmup_time_ms =
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started)
+                .count();
+        return task;
+    }
+
+    /**
+     * @brief 新しいモデルを読み込んで入れ替える（失敗した場合は現在のモデルを使い続ける）
+     *
+     * @param path モデルのパス
+     */
+    void reload_now(const std::string& path) {
+        const ModelStamp stamp = get_stamp(path);
+        ReloadResult result;
+        try {
+            std::shared_ptr<Task> task = load(path, result);
+            std::lock_guard<std::mutex> lock(current_mutex);
+            retired.push_back(std::move(current));
+            current = std::move(task);
+            model_path = path;
+            num_reloads++;
+        } catch (...) {
+            result.exception = std::current_exception();
+        }
+        // 監視しているファイルは、読み込みに失敗した場合も再び更新されるまで読み直さない
+        if (path == get_model_path()) {
+            loaded_stamp = stamp;
+            pending_stamp = stamp;
+        }
+        if (on_reload) {
+            try {
+                on_reload(result);
+            } catch (...) {
+                // コールバックの例外で専用スレッドを止めない
+            }
+        }
+    }
+
+    /**
+     * @brief 推論中の参照がなくなった古いタスクを解放する
+     *
+     */
+    void release_retired(void) {
+        for (auto it = retired.begin(); it != retired.end();) {
+            // currentから外したため、参照が1つなら新たに参照されることはない
+            if (it->use_count() == 1) {
+                it = retired.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    /**
+     * @brief 専用スレッドの処理（要求やファイルの更新を待ってモデルを入れ替える）
+     *
+     */
+    void run_reloader(void) {
+        pthread_setname_np(pthread_self(), "reloader");
+
+        std::unique_lock<std::mutex> lock(reload_mutex);
+        while (!stopped) {
+            lock.unlock();
+            release_retired();
+            lock.lock();
+
+            // 監視しない場合も、古いタスクが残っていれば解放できるまで定期的に起きる
+            const auto has_request = [this]() { return stopped || !requested_path.empty(); };
+            std::chrono::milliseconds interval = reload_config.watch_interval;
+            if (!retired.empty() && (interval.count() == 0 || interval > RETIRE_INTERVAL)) {
+                interval = RETIRE_INTERVAL;
+            }
+            if (interval.count() > 0) {
+                reload_cv.wait_for(lock, interval, has_request);
+            } else {
+                reload_cv.wait(lock, has_request);
+            }
+            if (stopped) {
+                break;
+            }
+
+            std::string path;
+            if (!requested_path.empty()) {
+                std::swap(path, requested_path);
+            } else if (reload_config.watch_interval.count() > 0) {
+                const ModelStamp stamp = get_stamp(get_model_path());
+                if (stamp != loaded_stamp) {
+                    if (stamp == pending_stamp) {
+                        path = get_model_path();
+                    } else {
+                        // 書き込み途中かもしれないため、次に確かめるまで待つ
+                        pending_stamp = stamp;
+                    }
+                }
+            }
+            if (path.empty()) {
+                continue;
+            }
+
+            lock.unlock();
+            reload_now(path);
+            lock.lock();
+        }
+    }
+
+   public:
+    /**
+     * @brief モデルを読み込み、暖機を済ませてから監視を始める
+     *
+     * @param model_path モデルのパス
+     * @param config 読み込み設定（入れ替え後のモデルも同じ設定で読み込む）
+     * @param reload_config 入れ替えの設定
+     * @param configure 読み込んだタスクを推論に使う前に設定する関数
+     * @param on_reload 入れ替えを試みるたびに呼ばれるコールバック（最初の読み込みでは呼ばれない）
+     */
+    ReloadableTask(const std::string& model_path, const ModelConfig& config = ModelConfig(),
+                   const ReloadConfig& reload_config = ReloadConfig(),
+                   Configure configure = nullptr, ReloadCallback on_reload = nullptr)
+        : config(config),
+          reload_config(reload_config),
+          configure(std::move(configure)),
+          on_reload(std::move(on_reload)),
+          model_path(model_path) {
+        loaded_stamp = get_stamp(model_path);
+        pending_stamp = loaded_stamp;
+        ReloadResult result;
+        current = load(model_path, result);
+        reloader = std::thread(&ReloadableTask::run_reloader, this);
+    }
+
+    /**
+     * @brief 専用スレッドを止める（読み込み中のモデルがあれば読み込みが終わるまで待つ）
+     *
+     */
+    ~ReloadableTask(void) {
+        {
+            std::lock_guard<std::mutex> lock(reload_mutex);
+            stopped = true;
+        }
+        reload_cv.notify_all();
+        reloader.join();
+    }
+
+    ReloadableTask(const ReloadableTask&) = delete;
+    ReloadableTask& operator=(const ReloadableTask&) = delete;
+
+    /**
+     * @brief モデルの入れ替えを要求する（読み込みは専用スレッドで行い、すぐに戻る）
+     *
+     * @param path 新しいモデルのパス（空なら現在のパスのファイルを読み直す）
+     */
+    void reload(const std::string& path = "") {
+        {
+            std::lock_guard<std::mutex> lock(reload_mutex);
+            requested_path = path.empty() ? get_model_path() : path;
+        }
+        reload_cv.notify_all();
+    }
+
+    /**
+     * @brief 現在のタスクを返す（返したタスクは入れ替え後も参照している間は解放されない）
+     *
+     * @return std::shared_ptr<Task> タスク
+     */
+    std::shared_ptr<Task> acquire(void) const {
+        std::lock_guard<std::mutex> lock(current_mutex);
+        return current;
+    }
+
+    /**
+     * @brief 現在のモデルのパスを返す
+     *
+     * @return std::string モデルのパス
+     */
+    std::string get_model_path(void) const {
+        std::lock_guard<std::mutex> lock(current_mutex);
+        return model_path;
+    }
+
+    /**
+     * @brief モデルを入れ替えた回数を返す
+     *
+     * @return std::uint64_t 入れ替えた回数
+     */
+    std::uint64_t get_num_reloads(void) const {
+        std::lock_guard<std::mutex> lock(current_mutex);
+        return num_reloads;
+    }
+
+    /**
+     * @brief 現在のモデルの読み込みにかかった時間を返す
+     *
+     * @return ModelLoadReport 読み込み時間
+     */
+    ModelLoadReport get_load_report(void) const { return acquire()->get_load_report(); }
+
+    /**
+     * @brief 現在のモデルの処理段階ごとのレイテンシとスループットの統計を返す（入れ替えるとリセットされる）
+     *
+     * @return TaskProfile 統計
+     */
+    TaskProfile get_profile(void) const { return acquire()->get_profile(); }
+
+    /**
+     * @brief タスクを実行する（複数スレッドから同時に呼び出せる）
+     *
+     * @param image 入力画像
+     * @return Output タスクの出力
+     */
+    Output task(const cv::Mat& image) { return acquire()->task(image); }
+
+    /**
+     * @brief タスクを実行し、出力をバッファへ書き込む
+     *
+     * @param image 入力画像
+     * @param output 出力の書き込み先
+     */
+    void task(const cv::Mat& image, Buffer& output) { acquire()->task(image, output); }
+
+    /**
+     * @brief 複数画像のタスクをバッチ推論で実行し、出力をバッファへ書き込む
+     *
+     * @param images 入力画像のリスト
+     * @param outputs 画像ごとの出力の書き込み先
+     */
+    void task(const std::vector<cv::Mat>& images, std::vector<Buffer>& outputs) {
+        acquire()->task(images, outputs);
+    }
+};
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <cstddef>
 #include <opencv2/opencv.hpp>
 #include <openvino/openvino.hpp>
+#include <vector>
 
 /**
  * @brief バウンディングボックスのオブジェクトクラス
@@ -86,3 +88,246 @@ class KeyPoint {
      */
     float get_confidence(void) const;
 };
+
+/**
+ * @brief 1人分の骨格のオブジェクトクラス
+ *
+ */
+class Pose {
+   private:
+    const std::vector<KeyPoint> keypoints;
+    const float score;
+
+   public:
+    /**
+     * @brief コンストラクタ
+     *
+     * @param keypoints キーポイントのリスト（COCO形式の17点、検出できなかった点は確信度0）
+     * @param score 人物としての確信度
+     */
+    Pose(std::vector<KeyPoint> keypoints, const float score);
+
+    /**
+     * @brief キーポイントのリストを返す
+     *
+     * @return const std::vector<KeyPoint>& キーポイントのリスト
+     */
+    const std::vector<KeyPoint>& get_keypoints(void) const;
+
+    /**
+     * @brief 人物としての確信度を返す
+     *
+     * @return float 確信度
+     */
+    float get_score(void) const;
+};
+
+/**
+ * @brief バウンディングボックスのリスト（座標・ラベル・確信度をそれぞれ連続した配列で保持する）
+ *
+ * clear()しても確保済みのメモリは解放しないため、フレームごとに同じインスタンスへ書き込めば
+ * 定常状態ではメモリを確保しない
+ */
+class BBoxList {
+   private:
+    std::vector<cv::Rect2f> rects;
+    std::vector<int> labels;
+    std::vector<float> confidences;
+
+    // 並べ替えの作業領域
+    std::vector<std::size_t> order;
+    std::vector<cv::Rect2f> sorted_rects;
+    std::vector<int> sorted_labels;
+    std::vector<float> sorted_confidences;
+
+   public:
+    /**
+     * @brief 要素をすべて削除する（確保済みのメモリは保持する）
+     *
+     */
+    void clear(void);
+
+    /**
+     * @brief 指定した要素数分のメモリを確保する
+     *
+     * @param capacity 要素数
+     */
+    void reserve(const std::size_t capacity);
+
+    /**
+     * @brief 末尾に追加する
+     *
+     * @param rect 座標
+     * @param label ラベル
+     * @param confidence 確信度
+     */
+    void push_back(const cv::Rect2f& rect, const int label, const float confidence);
+
+    /**
+     * @brief 要素数を返す
+     *
+     * @return std::size_t 要素数
+     */
+    std::size_t size(void) const;
+
+    /**
+     * @brief 空かどうかを返す
+     *
+     * @return true 空
+     * @return false 要素がある
+     */
+    bool empty(void) const;
+
+    /**
+     * @brief 指定した位置の要素をBBoxとして返す
+     *
+     * @param index 位置
+     * @return BBox バウンディングボックス
+     */
+    BBox get(const std::size_t index) const;
+
+    /**
+     * @brief 座標の配列を返す
+     *
+     * @return const std::vector<cv::Rect2f>& 座標の配列
+     */
+    const std::vector<cv::Rect2f>& get_rects(void) const;
+
+    /**
+     * @brief ラベルの配列を返す
+     *
+     * @return const std::vector<int>& ラベルの配列
+     */
+    const std::vector<int>& get_labels(void) const;
+
+    /**
+     * @brief 確信度の配列を返す
+     *
+     * @return const std::vector<float>& 確信度の配列
+     */
+    const std::vector<float>& get_confidences(void) const;
+
+    /**
+     * @brief 確信度が閾値未満の要素を削除する（残った要素の順序は保つ）
+     *
+     * @param confidence_thr 確信度の閾値
+     */
+    void filter(const float confidence_thr);
+
+    /**
+     * @brief 指定した添字の要素だけを残す
+     *
+     * @param indices 残す要素の添字（昇順）
+     */
+    void retain(const std::vector<std::size_t>& indices);
+
+    /**
+     * @brief 確信度の降順に並べ替える（確信度が同じ要素の順序は保つ）
+     *
+     */
+    void sort_by_confidence(void);
+
+    /**
+     * @brief BBoxのベクトルへ変換する
+     *
+     * @return std::vector<BBox> BBoxのリスト
+     */
+    std::vector<BBox> to_vector(void) const;
+};
+
+/**
+ * @brief キーポイントのリスト（x座標・y座標・確信度をそれぞれ連続した配列で保持する）
+ *
+ * clear()やresize()しても確保済みのメモリは解放しないため、同じインスタンスへ書き込めば
+ * 定常状態ではメモリを確保しない
+ */
+class KeyPointList {
+   private:
+    std::vector<float> xs;
+    std::vector<float> ys;
+    std::vector<float> confidences;
+
+   public:
+    /**
+     * @brief 要素をすべて削除する（確保済みのメモリは保持する）
+     *
+     */
+    void clear(void);
+
+    /**
+     * @brief 要素数を変更する
+     *
+     * @param size 要素数
+     */
+    void resize(const std::size_t size);
+
+    /**
+     * @brief 末尾に追加する
+     *
+     * @param x x座標
+     * @param y y座標
+     * @param confidence 確信度
+     */
+    void push_back(const float x, const float y, const float confidence);
+
+    /**
+     * @brief 指定した位置の要素を書き換える
+     *
+     * @param index 位置
+     * @param x x座標
+     * @param y y座標
+     * @param confidence 確信度
+     */
+    void set(const std::size_t index, const float x, const float y, const float confidence);
+
+    /**
+     * @brief 要素数を返す
+     *
+     * @return std::size_t 要素数
+     */
+    std::size_t size(void) const;
+
+    /**
+     * @brief 空かどうかを返す
+     *
+     * @return true 空
+     * @return false 要素がある
+     */
+    bool empty(void) const;
+
+    /**
+     * @brief 指定した位置の要素をKeyPointとして返す
+     *
+     * @param index 位置
+     * @return KeyPoint キーポイント
+     */
+    KeyPoint get(const std::size_t index) const;
+
+    /**
+     * @brief x座標の配列を返す
+     *
+     * @return const std::vector<float>& x座標の配列
+     */
+    const std::vector<float>& get_xs(void) const;
+
+    /**
+     * @brief y座標の配列を返す
+     *
+     * @return const std::vector<float>& y座標の配列
+     */
+    const std::vector<float>& get_ys(void) const;
+
+    /**
+     * @brief 確信度の配列を返す
+     *
+     * @return const std::vector<float>& 確信度の配列
+     */
+    const std::vector<float>& get_confidences(void) const;
+
+    /**
+     * @brief KeyPointのベクトルへ変換する
+     *
+     * @return std::vector<KeyPoint> キーポイントのリスト
+     */
+    std::vector<KeyPoint> to_vector(void) const;
+};
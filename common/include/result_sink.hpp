@@ -0,0 +1,253 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "image_io.hpp"
+#include "result_objects.hpp"
+
+/**
+ * @brief 推論結果の出力形式
+ *
+ */
+enum class ResultFormat {
+    JSONL,   // 1フレーム1行のJSON
+    Binary,  // 追記できる固定レイアウトのバイナリ（ResultReaderでメモリマップして読む）
+};
+
+/**
+ * @brief ファイルの拡張子から出力形式を決める
+ *
+ * @param path ファイルパス（.jsonlならJSONL、それ以外はバイナリ）
+ * @return ResultFormat 出力形式
+ */
+ResultFormat get_result_format(const std::string& path);
+
+/**
+ * @brief フレームごとの推論結果（検知枠・追跡ID・骨格）をファイルへ追記する
+ *
+ * 座標はすべて画像の幅・高さで正規化した値（0〜1）で書き込む。
+ * 結果はメモリ上にまとめてから1回のwrite()で追記するため、途中で異常終了しても
+ * 書き込み済みのフレームは壊れない。
+ *
+ * バイナリ形式はホストのバイトオーダーで、ファイルの先頭にFileHeader（8byte）、
+ * 続いてフレームごとに次のレコードを並べる（レコードの先頭は8byte境界に揃える）
+ *
+ * | 内容 | 型 |
+ * |:--|:--|
+ * | RecordHeader | 40byte |
+ * | 追跡ID（flagsにHAS_TRACK_IDSがある場合のみ） | uint64[N] |
+ * | 検知枠のx・y・幅・高さ | float[N]×4 |
+ * | ラベル | int32[N] |
+ * | 確信度 | float[N] |
+ * | 人物ごとのキーポイントの開始位置（最後は総数） | uint32[M+1] |
+ * | キーポイントのx・y・確信度 | float[T]×3 |
+ * | 入力名 | char[L]（終端文字なし） |
+ * | 8byte境界までの詰め物 | |
+ */
+class ResultSink {
+   public:
+    /**
+     * @brief バイナリ形式のファイルの先頭
+     *
+     */
+    struct FileHeader {
+        char magic[4];          // "OVRS"
+        std::uint32_t version;  // 形式のバージョン
+    };
+
+    /**
+     * @brief バイナリ形式のレコードの先頭
+     *
+     */
+    struct RecordHeader {
+        std::uint32_t magic;          // RECORD_MAGIC
+        std::uint32_t size;           // 詰め物を含むレコード全体のサイズ[byte]
+        std::uint64_t frame_index;    // フレームの通し番号
+        std::uint32_t width;          // 画像の幅
+        std::uint32_t height;         // 画像の高さ
+        std::uint32_t source_length;  // 入力名の長さL
+        std::uint32_t num_bboxes;     // 検知枠の数N
+        std::uint32_t num_poses;      // 人物の数M
+        std::uint32_t flags;          // HAS_TRACK_IDSなど
+    };
+
+    static constexpr std::uint32_t VERSION = 1;
+    static constexpr std::uint32_t RECORD_MAGIC = 0x4652564f;  // "OVRF"
+    static constexpr std::uint32_t HAS_TRACK_IDS = 1;
+
+   private:
+    // これ以上たまったらファイルへ書き出す
+    static const std::size_t FLUSH_SIZE = 64 * 1024;
+
+    std::string path;
+    ResultFormat format;
+    int fd = -1;
+    std::vector<char> buffer;
+    std::size_t num_written = 0;
+    std::mutex mutex;
+
+    /**
+     * @brief 1フレーム分の結果をJSONLの1行としてバッファへ追加する
+     *
+     */
+    void encode_jsonl(const std::string& source, const std::uint64_t frame_index,
+                      const cv::Size& image_size, const BBoxList& bboxes,
+                      const std::vector<std::uint64_t>& track_ids,
+                      const std::vector<KeyPointList>& poses);
+
+    /**
+     * @brief 1フレーム分の結果をバイナリのレコードとしてバッファへ追加する
+     *
+     */
+    void encode_binary(const std::string& source, const std::uint64_t frame_index,
+                       const cv::Size& image_size, const BBoxList& bboxes,
+                       const std::vector<std::uint64_t>& track_ids,
+                       const std::vector<KeyPointList>& poses);
+
+    /**
+     * @brief バッファの内容をファイルへ書き出す（mutexを取得した状態で呼ぶ）
+     *
+     */
+    void flush_buffer(void);
+
+   public:
+    /**
+     * @brief 出力ファイルを追記モードで開く
+     *
+     * バイナリ形式で既存のファイルへ追記する場合は、ファイルの先頭を検証し、
+     * 異常終了などで途中まで書かれた末尾のレコードを切り詰めてから追記する
+     *
+     * @param path ファイルパス
+     * @param format 出力形式
+     */
+    ResultSink(const std::string& path, const ResultFormat format);
+
+    /**
+     * @brief 残りの結果を書き出してファイルを閉じる
+     *
+     */
+    ~ResultSink(void);
+
+    ResultSink(const ResultSink&) = delete;
+    ResultSink& operator=(const ResultSink&) = delete;
+
+    /**
+     * @brief 1フレーム分の結果を追記する（複数スレッドから呼べる）
+     *
+     * @param source 入力名（画像ファイルのパスや動画のURLなど）
+     * @param frame_index フレームの通し番号
+     * @param image_size 画像のサイズ
+     * @param bboxes 検知枠（正規化座標）
+     * @param track_ids 検知枠ごとの追跡ID（空なら書き込まない）
+     * @param poses 人物ごとの骨格（画像に対する正規化座標）
+     */
+    void write(const std::string& source, const std::uint64_t frame_index,
+               const cv::Size& image_size, const BBoxList& bboxes,
+               const std::vector<std::uint64_t>& track_ids = std::vector<std::uint64_t>(),
+               const std::vector<KeyPointList>& poses = std::vector<KeyPointList>());
+
+    /**
+     * @brief たまっている結果をファイルへ書き出す
+     *
+     */
+    void flush(void);
+
+    /**
+     * @brief 追記したフレーム数を返す
+     *
+     * @return std::size_t フレーム数
+     */
+    std::size_t get_num_written(void);
+};
+
+/**
+ * @brief バイナリ形式の1フレーム分の結果（メモリマップしたファイルを直接指す）
+ *
+ * 配列はResultReaderが破棄されるまで有効
+ */
+struct ResultRecordView {
+    std::uint64_t frame_index = 0;
+    cv::Size image_size;
+    std::string_view source;
+
+    std::size_t num_bboxes = 0;
+    const float* xs = nullptr;
+    const float* ys = nullptr;
+    const float* widths = nullptr;
+    const float* heights = nullptr;
+    const std::int32_t* labels = nullptr;
+    const float* confidences = nullptr;
+    const std::uint64_t* track_ids = nullptr;  // 追跡IDがなければnullptr
+
+    std::size_t num_poses = 0;
+    const std::uint32_t* keypoint_offsets = nullptr;  // 人物iのキーポイントは[offsets[i], offsets[i+1])
+    const float* keypoint_xs = nullptr;
+    const float* keypoint_ys = nullptr;
+    const float* keypoint_confidences = nullptr;
+
+    /**
+     * @brief 検知枠をBBoxListへコピーする
+     *
+     * @param bboxes 格納先
+     */
+    void get_bboxes(BBoxList& bboxes) const;
+
+    /**
+     * @brief 人物の骨格をKeyPointListへコピーする
+     *
+     * @param index 人物の位置
+     * @param keypoints 格納先
+     */
+    void get_keypoints(const std::size_t index, KeyPointList& keypoints) const;
+};
+
+/**
+ * @brief ResultSinkがバイナリ形式で書いたファイルをメモリマップして読む
+ *
+ * 開いた時点でレコードの位置を調べる。途中まで書かれた末尾のレコードは読まない
+ */
+class ResultReader {
+   private:
+    MappedFile file;
+    std::vector<std::size_t> offsets;
+    std::size_t valid_size = 0;
+
+   public:
+    /**
+     * @brief ファイルを開いてレコードの位置を調べる
+     *
+     * @param path ファイルパス
+     */
+    explicit ResultReader(const std::string& path);
+
+    ResultReader(const ResultReader&) = delete;
+    ResultReader& operator=(const ResultReader&) = delete;
+
+    /**
+     * @brief レコード数を返す
+     *
+     * @return std::size_t レコード数
+     */
+    std::size_t size(void) const;
+
+    /**
+     * @brief レコードを返す
+     *
+     * @param index レコードの位置
+     * @return ResultRecordView レコード
+     */
+    ResultRecordView get(const std::size_t index) const;
+
+    /**
+     * @brief 読み込めたレコードの末尾までのサイズを返す（追記を再開する位置）
+     *
+     * @return std::size_t サイズ[byte]
+     */
+    std::size_t get_valid_size(void) const;
+};
@@ -0,0 +1,247 @@
+#pragma once
+
+#include <pthread.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <opencv2/opencv.hpp>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bounded_queue.hpp"
+#include "cpu_topology.hpp"
+#include "model_config.hpp"
+#include "task_profiler.hpp"
+
+/**
+ * @brief シャード（CPUグループごとのタスクのインスタンス）の状態
+ *
+ */
+struct ShardStats {
+    int node = -1;                    // NUMAノード番号（利用者が指定したグループは-1）
+    std::string cpu_list;             // 割り当てたCPU（「0-15,32-47」の形式）
+    std::size_t num_pending = 0;      // 処理待ちと処理中のフレーム数
+    std::uint64_t num_processed = 0;  // 処理したフレーム数
+    TaskProfile profile;              // 処理段階ごとのレイテンシとスループット
+};
+
+/**
+ * @brief CPUグループ（既定はNUMAノード）ごとにタスクのインスタンスを作り、フレームを振り分ける
+ *
+ * 各シャードはModelConfig::cpu_affinityでグループのCPUへ閉じ込めたモデルと、同じCPUへ固定した
+ * ワーカースレッド（推論リクエスト数と同数）を持つ。前処理は推論リクエストの入力テンソルへ
+ * ワーカースレッドが直接書き込むため、入力バッファはファーストタッチでそのノードのメモリに置かれる。
+ * フレームは処理待ちが最も少ないシャードへ渡す
+ *
+ * @tparam Task タスク（DetectorBBox7など。モデルのパスと読み込み設定から構築できること）
+ */
+template <typename Task>
+class ShardedTask {
+   public:
+    /**
+     * @brief タスクの出力の型
+     *
+     */
+    using Output = typename Task::Output;
+
+   private:
+    struct Job {
+        cv::Mat image;
+        std::promise<Output> promise;
+    };
+
+    struct Shard {
+        CpuGroup group;
+        std::unique_ptr<Task> task;
+        std::unique_ptr<BoundedQueue<Job>> queue;
+        std::vector<std::thread> workers;
+        std::atomic<std::size_t> num_pending{0};
+        std::atomic<std::uint64_t> num_processed{0};
+    };
+
+    std::vector<std::unique_ptr<Shard>> shards;
+
+    /**
+     * @brief 処理待ちが同数のシャードを順番に選ぶための通し番号
+     *
+     */
+    std::atomic<std::size_t> next_shard{0};
+
+    /**
+     * @brief ワーカースレッドの処理
+     *
+     * @param shard 担当するシャード
+     * @param name スレッド名
+     */
+    static void run_worker(Shard& shard, const std::string& name) {
+        bind_current_thread(shard.group.cpus);
+        pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+
+        Job job;
+        while (shard.queue->pop(job)) {
+            try {
+                job.promise.set_value(shard.task->task(job.image));
+            } catch (...) {
+                job.promise.set_exception(std::current_exception());
+            }
+            shard.num_processed++;
+            shard.num_pending--;
+        }
+    }
+
+    /**
+     * @brief 処理待ちが最も少ないシャードを選ぶ
+     *
+     * @return Shard& シャード
+     */
+    Shard& select_shard(void) {
+        const std::size_t offset = next_shard.fetch_add(1, std::memory_order_relaxed);
+        Shard* selected = nullptr;
+        std::size_t min_pending = 0;
+        for (std::size_t i = 0; i < shards.size(); i++) {
+            Shard& shard = *shards[(offset + i) % shards.size()];
+            const std::size_t num_pending = shard.num_pending.load();
+            if (selected == nullptr || num_pending < min_pending) {
+                selected = &shard;
+                min_pending = num_pending;
+            }
+        }
+        return *selected;
+    }
+
+    /**
+     * @brief ワーカースレッドを止める
+     *
+     */
+    void stop(void) {
+        for (auto& shard : shards) {
+            shard->queue->close();
+        }
+        for (auto& shard : shards) {
+            for (std::thread& worker : shard->workers) {
+                if (worker.joinable()) {
+                    worker.join();
+                }
+            }
+        }
+    }
+
+   public:
+    /**
+     * @brief CPUグループごとにモデルを読み込み、ワーカースレッドを起動する
+     *
+     * @param model_path モデルファイルのパス
+     * @param config シャードごとの読み込み設定（cpu_affinityはグループのCPUで上書きする。
+     *               num_requestsはシャードごとの推論リクエスト数とワーカースレッド数）
+     * @param groups CPUグループ（既定はNUMAノードごと）
+     */
+    ShardedTask(const std::string model_path, const ModelConfig& config = ModelConfig(),
+                const std::vector<CpuGroup>& groups = get_numa_nodes()) {
+        if (groups.empty()) {
+            throw std::invalid_argument("ShardedTask needs at least one CPU group");
+        }
+
+        try {
+            for (const CpuGroup& group : groups) {
+                auto shard = std::make_unique<Shard>();
+                shard->group = group;
+                ModelConfig shard_config = config;
+                shard_config.cpu_affinity = format_cpu_list(group.cpus);
+                shard->task = std::make_unique<Task>(model_path, shard_config);
+                shard->queue = std::make_unique<BoundedQueue<Job>>(2 * config.num_requests);
+                shards.push_back(std::move(shard));
+            }
+            for (std::size_t i = 0; i < shards.size(); i++) {
+                Shard& shard = *shards[i];
+                for (std::size_t w = 0; w < config.num_requests; w++) {
+                    const std::string name = "shard" + std::to_string(i) + "-" + std::to_string(w);
+                    shard.workers.emplace_back(&ShardedTask::run_worker, std::ref(shard), name);
+                }
+            }
+        } catch (...) {
+            stop();
+            throw;
+        }
+    }
+
+    /**
+     * @brief 処理待ちのフレームをすべて処理してからワーカースレッドを止める
+     *
+     */
+    ~ShardedTask(void) { stop(); }
+
+    ShardedTask(const ShardedTask&) = delete;
+    ShardedTask& operator=(const ShardedTask&) = delete;
+
+    /**
+     * @brief 処理待ちが最も少ないシャードでタスクを非同期実行する
+     *
+     * 選んだシャードのキューが満杯なら空きができるまで待機する
+     *
+     * @param image 入力画像
+     * @return std::future<Output> タスクの出力
+     */
+    std::future<Output> task_async(const cv::Mat& image) {
+        Shard& shard = select_shard();
+        Job job;
+        job.image = image;
+        std::future<Output> future = job.promise.get_future();
+        shard.num_pending++;
+        if (!shard.queue->push(std::move(job))) {
+            shard.num_pending--;
+            throw std::runtime_error("ShardedTask is stopped");
+        }
+        return future;
+    }
+
+    /**
+     * @brief 処理待ちが最も少ないシャードでタスクを実行し、完了を待つ
+     *
+     * @param image 入力画像
+     * @return Output タスクの出力
+     */
+    Output task(const cv::Mat& image) { return task_async(image).get(); }
+
+    /**
+     * @brief シャード数を返す
+     *
+     * @return std::size_t シャード数
+     */
+    std::size_t get_num_shards(void) const { return shards.size(); }
+
+    /**
+     * @brief シャードの読み込み時間を返す
+     *
+     * @param index シャードの番号
+     * @return ModelLoadReport 読み込み時間
+     */
+    ModelLoadReport get_load_report(const std::size_t index) const {
+        return shards.at(index)->task->get_load_report();
+    }
+
+    /**
+     * @brief シャードごとの状態を返す
+     *
+     * @return std::vector<ShardStats> シャードごとの状態
+     */
+    std::vector<ShardStats> get_stats(void) const {
+        std::vector<ShardStats> stats;
+        for (const auto& shard : shards) {
+            ShardStats shard_stats;
+            shard_stats.node = shard->group.node;
+            shard_stats.cpu_list = format_cpu_list(shard->group.cpus);
+            shard_stats.num_pending = shard->num_pending.load();
+            shard_stats.num_processed = shard->num_processed.load();
+            shard_stats.profile = shard->task->get_profile();
+            stats.push_back(std::move(shard_stats));
+        }
+        return stats;
+    }
+};
@@ -0,0 +1,328 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+
+/**
+ * @brief タスクの処理段階
+ *
+ */
+enum class TaskStage : std::size_t {
+    Preprocess = 0,   // 前処理（推論リクエストの空き待ちと、リサイズ・レイアウト変換など）
+    Infer = 1,        // 推論
+    Postprocess = 2,  // 後処理（結果の組み立て）
+    Total = 3,        // タスク全体
+};
+
+/**
+ * @brief 処理段階の数
+ *
+ */
+constexpr std::size_t NUM_TASK_STAGES = 4;
+
+/**
+ * @brief 処理段階の名前を返す
+ *
+ * @param stage 処理段階
+ * @return const char* 名前
+ */
+const char* get_stage_name(const TaskStage stage);
+
+#ifdef OPENVINO_TASK_PROFILING
+/**
+ * @brief 計測用の時刻
+ *
+ */
+using ProfileTimePoint = std::chrono::steady_clock::time_point;
+
+/**
+ * @brief 計測用の現在時刻を返す
+ *
+ * @return ProfileTimePoint 現在時刻
+ */
+inline ProfileTimePoint profile_now(void) { return std::chrono::steady_clock::now(); }
+#else
+// 計測を無効にしてビルドした場合は時刻を取得しない
+struct ProfileTimePoint {};
+inline ProfileTimePoint profile_now(void) { return ProfileTimePoint(); }
+#endif
+
+/**
+ * @brief ロックフリーのレイテンシヒストグラム
+ *
+ * 2のべき乗ごとの区間をさらに8分割したビンにナノ秒単位で記録する（相対誤差12.5%以下）。
+ * record()は複数スレッドから同時に呼び出せる
+ */
+class LatencyHistogram {
+   public:
+    /**
+     * @brief 2のべき乗の区間あたりのビン数（2^SUB_BUCKET_BITS）
+     *
+     */
+    static constexpr std::size_t SUB_BUCKET_BITS = 3;
+
+    /**
+     * @brief 記録できる最大値のビット数（2^40 ns ≒ 18分、超えた値は最後のビンに入る）
+     *
+     */
+    static constexpr std::size_t MAX_VALUE_BITS = 40;
+
+    /**
+     * @brief ビン数
+     *
+     */
+    static constexpr std::size_t NUM_BUCKETS =
+        (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS;
+
+   private:
+    std::array<std::atomic<std::uint64_t>, NUM_BUCKETS> buckets;
+    std::atomic<std::uint64_t> count;
+    std::atomic<std::uint64_t> sum_ns;
+    std::atomic<std::uint64_t> max_ns;
+
+    /**
+     * @brief 値を記録するビンの番号を返す
+     *
+     * @param value_ns 値[ns]
+     * @return std::size_t ビンの番号
+     */
+    static std::size_t get_bucket_index(const std::uint64_t value_ns);
+
+    /**
+     * @brief ビンの下限値を返す
+     *
+     * @param index ビンの番号
+     * @return std::uint64_t 下限値[ns]
+     */
+    static std::uint64_t get_bucket_lower(const std::size_t index);
+
+   public:
+    LatencyHistogram(void);
+
+    /**
+     * @brief 値を記録する
+     *
+     * @param value_ns 値[ns]
+     */
+    void record(const std::uint64_t value_ns);
+
+    /**
+     * @brief 記録をすべて消去する
+     *
+     * record()と同時に呼び出した場合、その記録が消えるかどうかは不定
+     */
+    void reset(void);
+
+    /**
+     * @brief 記録数を返す
+     *
+     * @return std::uint64_t 記録数
+     */
+    std::uint64_t get_count(void) const;
+
+    /**
+     * @brief 平均値を返す
+     *
+     * @return double 平均値[ms]（記録がなければ0）
+     */
+    double get_mean_ms(void) const;
+
+    /**
+     * @brief 最大値を返す
+     *
+     * @return double 最大値[ms]（記録がなければ0）
+     */
+    double get_max_ms(void) const;
+
+    /**
+     * @brief パーセンタイル値を返す
+     *
+     * 該当するビンの中央値で近似する
+     *
+     * @param percentile パーセンタイル（0〜100）
+     * @return double パーセンタイル値[ms]（記録がなければ0）
+     */
+    double get_percentile_ms(const double percentile) const;
+};
+
+/**
+ * @brief 処理段階ごとのレイテンシの統計
+ *
+ */
+struct StageStats {
+    std::uint64_t count = 0;
+    double mean_ms = 0.0;
+    double p50_ms = 0.0;
+    double p90_ms = 0.0;
+    double p99_ms = 0.0;
+    double max_ms = 0.0;
+};
+
+/**
+ * @brief タスクのレイテンシとスループットの統計
+ *
+ */
+struct TaskProfile {
+    /**
+     * @brief 処理段階ごとの統計（TaskStageの値で参照する）
+     *
+     */
+    std::array<StageStats, NUM_TASK_STAGES> stages;
+
+    /**
+     * @brief 完了したタスク数
+     *
+     */
+    std::uint64_t num_tasks = 0;
+
+    /**
+     * @brief 処理した画像数（バッチ推論では1タスクで複数画像を処理する）
+     *
+     */
+    std::uint64_t num_images = 0;
+
+    /**
+     * @brief 計測開始（またはリセット）からの経過時間[s]
+     *
+     */
+    double elapsed_s = 0.0;
+
+    /**
+     * @brief 1秒あたりのタスク数
+     *
+     */
+    double tasks_per_second = 0.0;
+
+    /**
+     * @brief 1秒あたりの画像数
+     *
+     */
+    double images_per_second = 0.0;
+
+    /**
+     * @brief 処理段階の統計を返す
+     *
+     * @param stage 処理段階
+     * @return const StageStats& 統計
+     */
+    const StageStats& operator[](const TaskStage stage) const {
+        return stages[static_cast<std::size_t>(stage)];
+    }
+};
+
+/**
+ * @brief 統計を処理段階ごとに1行ずつ出力する
+ *
+ * @param os 出力先
+ * @param profile 統計
+ * @return std::ostream& 出力先
+ */
+std::ostream& operator<<(std::ostream& os, const TaskProfile& profile);
+
+/**
+ * @brief タスクの処理段階ごとのレイテンシを計測する
+ *
+ * OPENVINO_TASK_PROFILINGを定義せずにビルドした場合、record()は何もせず、
+ * 時刻の取得も行われないため計測のコストはかからない（統計は常に空になる）
+ */
+class TaskProfiler {
+   private:
+    std::array<LatencyHistogram, NUM_TASK_STAGES> histograms;
+    std::atomic<std::uint64_t> task_count;
+    std::atomic<std::uint64_t> image_count;
+    std::atomic<std::int64_t> start_time_ns;
+
+    std::thread dump_thread;
+    std::mutex dump_mutex;
+    std::condition_variable dump_cv;
+    bool dump_stop = false;
+
+    /**
+     * @brief 処理段階のレイテンシを記録する
+     *
+     * @param stage 処理段階
+     * @param begin 開始時刻
+     * @param end 終了時刻
+     */
+    void record_stage(const TaskStage stage, const ProfileTimePoint& begin,
+                      const ProfileTimePoint& end);
+
+   public:
+    TaskProfiler(void);
+
+    /**
+     * @brief 定期出力を停止する
+     *
+     */
+    ~TaskProfiler(void);
+
+    TaskProfiler(const TaskProfiler&) = delete;
+    TaskProfiler& operator=(const TaskProfiler&) = delete;
+
+    /**
+     * @brief 1タスク分の処理段階ごとのレイテンシを記録する
+     *
+     * 複数スレッドから同時に呼び出せる
+     *
+     * @param started 前処理の開始時刻
+     * @param preprocessed 前処理の終了時刻
+     * @param inferred 推論の終了時刻
+     * @param end 後処理の終了時刻
+     * @param num_images タスクで処理した画像数
+     */
+    void record(const ProfileTimePoint& started, const ProfileTimePoint& preprocessed,
+                const ProfileTimePoint& inferred, const ProfileTimePoint& end,
+                const std::size_t num_images = 1) {
+#ifdef OPENVINO_TASK_PROFILING
+        record_stage(TaskStage::Preprocess, started, preprocessed);
+        record_stage(TaskStage::Infer, preprocessed, inferred);
+        record_stage(TaskStage::Postprocess, inferred, end);
+        record_stage(TaskStage::Total, started, end);
+        task_count.fetch_add(1, std::memory_order_relaxed);
+        image_count.fetch_add(num_images, std::memory_order_relaxed);
+#else
+        (void)started;
+        (void)preprocessed;
+        (void)inferred;
+        (void)end;
+        (void)num_images;
+#endif
+    }
+
+    /**
+     * @brief 計測中の統計を返す
+     *
+     * @return TaskProfile 統計
+     */
+    TaskProfile get_profile(void) const;
+
+    /**
+     * @brief 統計を消去し、スループットの計測を開始し直す
+     *
+     */
+    void reset(void);
+
+    /**
+     * @brief 統計をファイルへ定期的に追記する
+     *
+     * 既に定期出力中の場合は、停止してから設定し直す
+     *
+     * @param path 出力先のファイルパス
+     * @param interval 出力間隔
+     */
+    void start_dump(const std::string& path, const std::chrono::milliseconds interval);
+
+    /**
+     * @brief 定期出力を停止する
+     *
+     */
+    void stop_dump(void);
+};
@@ -0,0 +1,292 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+#include "result_objects.hpp"
+
+/**
+ * @brief 追跡の設定
+ *
+ * detection_intervalを大きくするほど検知の回数が減り、1台で処理できるストリーム数が増える代わりに、
+ * 新しく現れた物体の検出が遅れ、動きの速い物体の枠がずれやすくなる
+ */
+struct TrackerConfig {
+    /**
+     * @brief 検知を実行するフレーム間隔（1なら毎フレーム検知する）
+     *
+     */
+    std::size_t detection_interval = 5;
+
+    /**
+     * @brief 追跡の確信度が検知時の確信度に対してこの割合を下回ると、間隔を待たずに次のフレームで検知する
+     *
+     */
+    float min_confidence_ratio = 0.5f;
+
+    /**
+     * @brief 追跡を始める検知結果の確信度の閾値
+     *
+     */
+    float detection_threshold = 0.5f;
+
+    /**
+     * @brief 検知結果を追跡中の物体と対応付けるIoUの閾値
+     *
+     */
+    float iou_threshold = 0.3f;
+
+    /**
+     * @brief 検知で見つからなくても追跡IDを保持する検知の回数（一時的な隠れに対応する）
+     *
+     */
+    std::size_t max_missed = 2;
+
+    /**
+     * @brief 検知しないフレームごとに追跡の確信度へ掛ける係数
+     *
+     */
+    float confidence_decay = 0.95f;
+
+    /**
+     * @brief オプティカルフローで移動量を求められなかったフレームで、追跡の確信度へさらに掛ける係数
+     *
+     */
+    float flow_failure_decay = 0.7f;
+
+    /**
+     * @brief 検知しないフレームで、縮小画像のオプティカルフローから物体の移動量を求めるかどうか
+     *
+     * 無効の場合は等速運動のカルマンフィルタの予測だけで枠を動かす
+     */
+    bool optical_flow = true;
+
+    /**
+     * @brief オプティカルフローを求める縮小画像の幅
+     *
+     */
+    int flow_width = 320;
+};
+
+/**
+ * @brief 追跡中の物体
+ *
+ */
+struct Track {
+    /**
+     * @brief 状態の成分（枠の中心x・中心y・幅・高さ、正規化座標）ごとの位置と速度の推定
+     *
+     * 成分ごとに独立した等速運動のカルマンフィルタとして扱う
+     */
+    struct Axis {
+        float value = 0.0f;
+        float velocity = 0.0f;
+        float var_value = 0.0f;     // valueの分散
+        float cov = 0.0f;           // valueとvelocityの共分散
+        float var_velocity = 0.0f;  // velocityの分散
+    };
+
+    std::uint64_t id = 0;
+    int label = 0;
+    float confidence = 0.0f;
+    float detected_confidence = 0.0f;  // 最後に検知で見つかったときの確信度
+    Axis axes[4];
+    std::size_t num_missed = 0;  // 連続して検知で見つからなかった回数
+};
+
+/**
+ * @brief 検知結果（BBox）をフレーム間で追跡し、検知しないフレームの枠を推定する
+ *
+ * 検知したフレームではIoUで検知結果と追跡中の物体を対応付けてIDを引き継ぎ、
+ * 検知しないフレームでは縮小画像のオプティカルフローとカルマンフィルタで枠を動かす。
+ * 枠はDetectorBBox7・DetectorBBox5Label1と同じ正規化座標（0〜1）で扱う
+ */
+class BBoxTracker {
+   private:
+    TrackerConfig config;
+    std::vector<Track> tracks;
+    std::uint64_t next_id = 1;
+    std::size_t frames_since_detection = 0;
+
+    // オプティカルフロー用の縮小画像
+    cv::Mat resized_image;
+    cv::Mat previous_gray;
+    cv::Mat current_gray;
+
+    // 出力（get_bboxes()・get_track_ids()で返す）
+    BBoxList bboxes;
+    std::vector<std::uint64_t> track_ids;
+
+    // 検知結果と物体の対応付けの候補
+    struct Candidate {
+        float iou;
+        std::size_t track;
+        std::size_t detection;
+    };
+
+    // 対応付けとオプティカルフローで使う作業領域
+    std::vector<Candidate> candidates;
+    std::vector<bool> track_matched;
+    std::vector<bool> detection_matched;
+    std::vector<cv::Point2f> flow_points;
+    std::vector<cv::Point2f> flow_next_points;
+    std::vector<unsigned char> flow_status;
+    std::vector<float> flow_errors;
+    std::vector<float> shifts_x;
+    std::vector<float> shifts_y;
+    std::vector<cv::Rect2f> previous_rects;
+    std::vector<cv::Point2f> track_shifts;
+    std::vector<bool> track_shift_valid;
+
+    /**
+     * @brief 縮小したグレースケール画像を作る
+     *
+     * @param image 入力画像
+     */
+    void update_gray(const cv::Mat& image);
+
+    /**
+     * @brief 全物体の状態を1フレーム分進める
+     *
+     */
+    void predict_tracks(void);
+
+    /**
+     * @brief 前フレームから現在のフレームへのオプティカルフローで、見えている物体の移動量を求める
+     *
+     * 結果はtrack_shifts・track_shift_validへ物体の順に格納する
+     */
+    void estimate_flow(void);
+
+    /**
+     * @brief 出力を作り直す
+     *
+     */
+    void update_output(void);
+
+   public:
+    /**
+     * @brief 追跡器を作る
+     *
+     * @param config 追跡の設定
+     */
+    explicit BBoxTracker(const TrackerConfig& config = TrackerConfig());
+
+    /**
+     * @brief 次のフレームで検知を実行すべきかどうかを返す
+     *
+     * @return true 検知の間隔に達したか、追跡の確信度が閾値を下回った
+     * @return false 追跡だけでよい
+     */
+    bool needs_detection(void) const;
+
+    /**
+     * @brief 検知したフレームの結果で追跡を更新する
+     *
+     * @param image フレーム
+     * @param detections フレームの検知結果
+     */
+    void update(const cv::Mat& image, const BBoxList& detections);
+
+    /**
+     * @brief 検知しないフレームで物体の枠を推定する
+     *
+     * @param image フレーム
+     */
+    void predict(const cv::Mat& image);
+
+    /**
+     * @brief 追跡をすべて破棄する（シーンが切り替わった場合など）
+     *
+     */
+    void reset(void);
+
+    /**
+     * @brief 現在のフレームの枠を返す（確信度は追跡の確信度）
+     *
+     * @return const BBoxList& 枠
+     */
+    const BBoxList& get_bboxes(void) const;
+
+    /**
+     * @brief 現在のフレームの枠ごとの追跡IDを返す（get_bboxes()と同じ順）
+     *
+     * @return const std::vector<std::uint64_t>& 追跡ID
+     */
+    const std::vector<std::uint64_t>& get_track_ids(void) const;
+};
+
+/**
+ * @brief 数フレームごとに検知し、間のフレームは追跡で枠を推定する検知器
+ *
+ * @tparam Detector 検知タスク（DetectorBBox7・DetectorBBox5Label1など、BBoxListへ出力できること）
+ */
+template <typename Detector>
+class TrackingDetector {
+   private:
+    Detector& detector;
+    BBoxTracker tracker;
+    BBoxList detections;
+    std::uint64_t num_frames = 0;
+    std::uint64_t num_detections = 0;
+
+   public:
+    /**
+     * @brief 検知器を作る
+     *
+     * @param detector 検知タスク（複数のTrackingDetectorで共有できる）
+     * @param config 追跡の設定
+     */
+    TrackingDetector(Detector& detector, const TrackerConfig& config = TrackerConfig())
+        : detector(detector), tracker(config) {}
+
+    /**
+     * @brief 1フレームを処理する
+     *
+     * @param image フレーム
+     * @return true 検知を実行した
+     * @return false 追跡だけで枠を推定した
+     */
+    bool process(const cv::Mat& image) {
+        num_frames++;
+        if (!tracker.needs_detection()) {
+            tracker.predict(image);
+            return false;
+        }
+        detector.task(image, detections);
+        tracker.update(image, detections);
+        num_detections++;
+        return true;
+    }
+
+    /**
+     * @brief 現在のフレームの枠を返す
+     *
+     * @return const BBoxList& 枠
+     */
+    const BBoxList& get_bboxes(void) const { return tracker.get_bboxes(); }
+
+    /**
+     * @brief 現在のフレームの枠ごとの追跡IDを返す
+     *
+     * @return const std::vector<std::uint64_t>& 追跡ID
+     */
+    const std::vector<std::uint64_t>& get_track_ids(void) const { return tracker.get_track_ids(); }
+
+    /**
+     * @brief 処理したフレームのうち検知を実行した割合を返す
+     *
+     * @return double 割合（処理していなければ0）
+     */
+    double get_detection_ratio(void) const {
+        return num_frames > 0 ? static_cast<double>(num_detections) / num_frames : 0.0;
+    }
+
+    /**
+     * @brief 追跡をすべて破棄し、次のフレームで検知する
+     *
+     */
+    void reset(void) { tracker.reset(); }
+};
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <opencv2/opencv.hpp>
+#include <ostream>
+#include <string>
+#include <thread>
+
+/**
+ * @brief 取り出しが追いつかないときのフレームの扱い
+ *
+ */
+enum class DropPolicy {
+    LatestFrame,  // 最新の1フレームだけを保持し、古いフレームは捨てる
+    DropOldest,   // キューが満杯なら最も古いフレームを捨てる
+    Block,        // キューが満杯なら取り込みを待機する（フレームを捨てない）
+};
+
+/**
+ * @brief 映像入力の設定
+ *
+ */
+struct VideoSourceConfig {
+    /**
+     * @brief 取り出しが追いつかないときのフレームの扱い
+     *
+     */
+    DropPolicy drop_policy = DropPolicy::LatestFrame;
+
+    /**
+     * @brief キューの容量（LatestFrameでは無視され、常に1）
+     *
+     */
+    std::size_t queue_capacity = 4;
+
+    /**
+     * @brief 動画ファイルを映像のFPSに合わせて取り込むかどうか
+     *
+     * 録画したファイルをライブ映像の代わりに使うときに有効にする。無効の場合はデコードできる速さで取り込む
+     */
+    bool realtime = false;
+};
+
+/**
+ * @brief 取り込んだフレーム
+ *
+ */
+struct VideoFrame {
+    /**
+     * @brief 画像
+     *
+     */
+    cv::Mat image;
+
+    /**
+     * @brief 取り込んだ順の通し番号（捨てたフレームも数える）
+     *
+     */
+    std::uint64_t index = 0;
+
+    /**
+     * @brief 取り込んだ時刻
+     *
+     */
+    std::chrono::steady_clock::time_point captured_at;
+};
+
+/**
+ * @brief 映像入力の統計
+ *
+ */
+struct VideoSourceStats {
+    std::uint64_t num_captured = 0;   // 取り込んだフレーム数
+    std::uint64_t num_delivered = 0;  // read()で取り出したフレーム数
+    std::uint64_t num_dropped = 0;    // 捨てたフレーム数
+    double capture_fps = 0.0;         // 取り込みのFPS
+    double delivered_fps = 0.0;       // 取り出しのFPS（処理できたFPS）
+};
+
+/**
+ * @brief 統計を「captured 300 (30.0 fps), delivered 150 (15.0 fps), dropped 150」の形式で出力する
+ *
+ * @param os 出力先
+ * @param stats 統計
+ * @return std::ostream& 出力先
+ */
+std::ostream& operator<<(std::ostream& os, const VideoSourceStats& stats);
+
+/**
+ * @brief 動画ファイル・カメラ・ストリームから専用スレッドでフレームを取り込む
+ *
+ * 推論が遅くても、ドロップポリシーに従って古いフレームを捨てることで遅延が際限なく伸びないようにする
+ */
+class VideoSource {
+   private:
+    cv::VideoCapture capture;
+    VideoSourceConfig config;
+    double source_fps = 0.0;
+    cv::Size frame_size;
+
+    std::thread capture_thread;
+    std::deque<VideoFrame> frames;
+    bool finished = false;
+    bool stopped = false;
+    mutable std::mutex mutex;
+    std::condition_variable frame_cv;
+    std::condition_variable space_cv;
+
+    std::atomic<std::uint64_t> num_captured{0};
+    std::atomic<std::uint64_t> num_delivered{0};
+    std::atomic<std::uint64_t> num_dropped{0};
+    std::chrono::steady_clock::time_point start_time;
+
+    /**
+     * @brief 取り込みスレッドの処理
+     *
+     */
+    void run_capture(void);
+
+   public:
+    /**
+     * @brief 入力を開いて取り込みを始める
+     *
+     * @param source 動画ファイルのパス、ストリームのURL、またはカメラ番号（"0"など）
+     * @param config 映像入力の設定
+     */
+    VideoSource(const std::string& source, const VideoSourceConfig& config = VideoSourceConfig());
+
+    /**
+     * @brief 取り込みを止めて入力を閉じる
+     *
+     */
+    ~VideoSource(void);
+
+    VideoSource(const VideoSource&) = delete;
+    VideoSource& operator=(const VideoSource&) = delete;
+
+    /**
+     * @brief 次のフレームを取り出す（フレームがなければ取り込まれるまで待機する）
+     *
+     * @param frame 取り出したフレームの格納先
+     * @return true 取り出した
+     * @return false 入力が終わった（または停止した）
+     */
+    bool read(VideoFrame& frame);
+
+    /**
+     * @brief 取り込みを停止する（待機中のread()はfalseを返す）
+     *
+     */
+    void stop(void);
+
+    /**
+     * @brief 入力のFPSを返す
+     *
+     * @return double FPS（取得できない場合は0）
+     */
+    double get_source_fps(void) const;
+
+    /**
+     * @brief 入力のフレームサイズを返す
+     *
+     * @return cv::Size フレームサイズ
+     */
+    cv::Size get_frame_size(void) const;
+
+    /**
+     * @brief 取り込みの統計を返す
+     *
+     * @return VideoSourceStats 統計
+     */
+    VideoSourceStats get_stats(void) const;
+};
@@ -0,0 +1,195 @@
+#include "cpu_topology.hpp"
+
+#include <sched.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+int parse_cpu_number(const std::string& value, const std::string& cpu_list) {
+    std::size_t pos = 0;
+    int cpu = -1;
+    try {
+        cpu = std::stoi(value, &pos);
+    } catch (const std::exception&) {
+        pos = 0;
+    }
+    if (pos == 0 || pos != value.size() || cpu < 0 || cpu >= CPU_SETSIZE) {
+        throw std::invalid_argument("Invalid CPU list: " + cpu_list);
+    }
+    return cpu;
+}
+
+std::string trim(const std::string& value) {
+    const std::size_t begin = value.find_first_not_of(" \t\r\n");
+    if (begin == std::string::npos) {
+        return "";
+    }
+    const std::size_t end = value.find_last_not_of(" \t\r\n");
+    return value.substr(begin, end - begin + 1);
+}
+
+}  // namespace
+
+std::vector<int> parse_cpu_list(const std::string& cpu_list) {
+    std::vector<int> cpus;
+    std::istringstream stream(cpu_list);
+    std::string range;
+    while (std::getline(stream, range, ',')) {
+        range = trim(range);
+        if (range.empty()) {
+            continue;
+        }
+        const std::size_t dash = range.find('-');
+        const int first = parse_cpu_number(range.substr(0, dash), cpu_list);
+        const int last = dash == std::string::npos
+                             ? first
+                             : parse_cpu_number(range.substr(dash + 1), cpu_list);
+        if (last < first) {
+            throw std::invalid_argument("Invalid CPU list: " + cpu_list);
+        }
+        for (int cpu = first; cpu <= last; cpu++) {
+            cpus.push_back(cpu);
+        }
+    }
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    return cpus;
+}
+
+std::string format_cpu_list(const std::vector<int>& cpus) {
+    std::vector<int> sorted = cpus;
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+    std::ostringstream cpu_list;
+    for (std::size_t i = 0; i < sorted.size();) {
+        // 連続する番号を「first-last」にまとめる
+        std::size_t j = i;
+        while (j + 1 < sorted.size() && sorted[j + 1] == sorted[j] + 1) {
+            j++;
+        }
+        cpu_list << (i > 0 ? "," : "") << sorted[i];
+        if (j > i) {
+            cpu_list << '-' << sorted[j];
+        }
+        i = j + 1;
+    }
+    return cpu_list.str();
+}
+
+std::vector<CpuGroup> parse_cpu_groups(const std::string& cpu_groups) {
+    std::vector<CpuGroup> groups;
+    std::istringstream stream(cpu_groups);
+    std::string cpu_list;
+    while (std::getline(stream, cpu_list, ';')) {
+        CpuGroup group;
+        group.cpus = parse_cpu_list(cpu_list);
+        if (group.cpus.empty()) {
+            throw std::invalid_argument("Empty CPU group: " + cpu_groups);
+        }
+        groups.push_back(std::move(group));
+    }
+    return groups;
+}
+
+std::vector<int> get_allowed_cpus(void) {
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    if (sched_getaffinity(0, sizeof(mask), &mask) != 0) {
+        throw std::runtime_error(std::string("sched_getaffinity failed: ") + std::strerror(errno));
+    }
+
+    std::vector<int> cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &mask)) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+std::vector<CpuGroup> get_numa_nodes(void) {
+    const std::vector<int> allowed = get_allowed_cpus();
+
+    std::vector<CpuGroup> nodes;
+    const std::filesystem::path node_dir = "/sys/devices/system/node";
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(node_dir, error)) {
+        const std::string name = entry.path().filename().string();
+        if (name.rfind("node", 0) != 0 || name.size() == 4 ||
+            name.find_first_not_of("0123456789", 4) != std::string::npos) {
+            continue;
+        }
+
+        std::ifstream file(entry.path() / "cpulist");
+        std::string cpu_list;
+        if (!file || !std::getline(file, cpu_list)) {
+            continue;
+        }
+
+        // 実行を許可されたCPUだけを残す（taskset・cgroupで制限されている場合）
+        CpuGroup node;
+        node.node = std::stoi(name.substr(4));
+        for (const int cpu : parse_cpu_list(cpu_list)) {
+            if (std::binary_search(allowed.begin(), allowed.end(), cpu)) {
+                node.cpus.push_back(cpu);
+            }
+        }
+        if (!node.cpus.empty()) {
+            nodes.push_back(std::move(node));
+        }
+    }
+
+    if (nodes.empty()) {
+        CpuGroup group;
+        group.cpus = allowed;
+        nodes.push_back(std::move(group));
+    }
+    std::sort(nodes.begin(), nodes.end(),
+              [](const CpuGroup& a, const CpuGroup& b) { return a.node < b.node; });
+    return nodes;
+}
+
+void bind_current_thread(const std::vector<int>& cpus) {
+    if (cpus.empty()) {
+        throw std::invalid_argument("No CPUs to bind the thread to");
+    }
+
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    for (const int cpu : cpus) {
+        if (cpu < 0 || cpu >= CPU_SETSIZE) {
+            throw std::invalid_argument("Invalid CPU number: " + std::to_string(cpu));
+        }
+        CPU_SET(cpu, &mask);
+    }
+    if (sched_setaffinity(0, sizeof(mask), &mask) != 0) {
+        throw std::runtime_error("Could not bind thread to CPUs " + format_cpu_list(cpus) + ": " +
+                                 std::strerror(errno));
+    }
+}
+
+void run_on_cpus(const std::vector<int>& cpus, const std::function<void(void)>& function) {
+    std::exception_ptr exception = nullptr;
+    std::thread thread([&]() {
+        try {
+            bind_current_thread(cpus);
+            function();
+        } catch (...) {
+            exception = std::current_exception();
+        }
+    });
+    thread.join();
+    if (exception) {
+        std::rethrow_exception(exception);
+    }
+}
@@ -0,0 +1,384 @@
+#include "frame_ring.hpp"
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <ctime>
+#include <new>
+#include <stdexcept>
+
+/**
+ * @brief スロットごとのフレームの情報
+ *
+ */
+struct FrameSlot {
+    std::uint64_t frame_index;
+    std::int64_t timestamp_ns;
+};
+
+/**
+ * @brief 共有メモリの先頭（続いてFrameSlotの配列、画像のスロットの配列）
+ *
+ * 書き込み側と読み出し側が更新する値は、互いのキャッシュラインを奪い合わないよう分けて置く
+ */
+struct FrameRingHeader {
+    std::atomic<std::uint32_t> magic;  // FRAME_RING_MAGIC（初期化が終わってから書く）
+    std::uint32_t version;
+    std::uint64_t num_slots;
+    std::int32_t width;
+    std::int32_t height;
+    std::int32_t type;
+    std::uint32_t reserved;
+    std::uint64_t slot_size;    // 1スロットのサイズ[byte]
+    std::uint64_t data_offset;  // 最初のスロットの位置[byte]
+
+    // 書き込み側が更新する
+    alignas(64) std::atomic<std::uint64_t> write_index;  // 次に書き込むインデックス
+    std::atomic<std::uint32_t> data_sequence;            // 書き込むたびに増やす（futexで待つ値）
+    std::atomic<std::uint32_t> num_data_waiters;         // 書き込みを待っている読み出し側の数
+    std::atomic<std::uint32_t> closed;                   // 書き込み側が閉じたら1
+
+    // 読み出し側が更新する
+    alignas(64) std::atomic<std::uint64_t> read_index;  // 次に読み出すインデックス
+    std::atomic<std::uint32_t> space_sequence;          // 返すたびに増やす（futexで待つ値）
+    std::atomic<std::uint32_t> num_space_waiters;       // 空きを待っている書き込み側の数
+};
+
+namespace {
+
+constexpr std::uint32_t FRAME_RING_MAGIC = 0x4652464f;  // "OFRF"
+constexpr std::uint32_t FRAME_RING_VERSION = 1;
+constexpr std::size_t SLOT_ALIGNMENT = 4096;
+
+// プロセス間で共有するため、アドレスに依存しないロックフリーのアトミック変数だけを使う
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "");
+static_assert(std::atomic<std::uint32_t>::is_always_lock_free, "");
+static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t), "");
+
+std::runtime_error make_system_error(const std::string& message, const std::string& name) {
+    return std::runtime_error(message + ": " + name + " (" + std::strerror(errno) + ")");
+}
+
+std::size_t align_up(const std::size_t size, const std::size_t alignment) {
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+/**
+ * @brief 最初のスロットの情報の位置[byte]
+ *
+ */
+std::size_t get_slots_offset(void) { return align_up(sizeof(FrameRingHeader), 64); }
+
+FrameSlot* get_frame_slots(FrameRingHeader* header) {
+    return reinterpret_cast<FrameSlot*>(reinterpret_cast<char*>(header) + get_slots_offset());
+}
+
+/**
+ * @brief 値がexpectedのままであれば、変わるか起こされるまで待機する（他のプロセスからも起こせる）
+ *
+ */
+void futex_wait(std::atomic<std::uint32_t>& word, const std::uint32_t expected,
+                const std::chrono::nanoseconds timeout) {
+    timespec time;
+    time.tv_sec = static_cast<time_t>(timeout.count() / 1000000000);
+    time.tv_nsec = static_cast<long>(timeout.count() % 1000000000);
+    ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAIT, expected, &time,
+              nullptr, 0);
+}
+
+void futex_wake(std::atomic<std::uint32_t>& word) {
+    ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAKE, INT_MAX, nullptr,
+              nullptr, 0);
+}
+
+/**
+ * @brief 条件を満たすまで待機する
+ *
+ * 待機する側は待機数を増やしてから値を読み、相手は条件を変えてから値を増やして待機数を確かめるため、
+ * 待機している相手がいないときはシステムコールを呼ばずに済み、起こし損ねることもない
+ *
+ * @param sequence 相手が条件を変えるたびに増やす値
+ * @param num_waiters 待機数
+ * @param timeout 待機する最大時間
+ * @param ready 条件
+ * @return true 条件を満たした
+ * @return false タイムアウトした
+ */
+template <typename Ready>
+bool wait_for(std::atomic<std::uint32_t>& sequence, std::atomic<std::uint32_t>& num_waiters,
+              const std::chrono::milliseconds timeout, const Ready& ready) {
+    if (ready()) {
+        return true;
+    }
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (true) {
+        num_waiters.fetch_add(1);
+        const std::uint32_t value = sequence.load();
+        const bool satisfied = ready();
+        const auto remaining = deadline - std::chrono::steady_clock::now();
+        if (!satisfied && remaining > std::chrono::nanoseconds::zero()) {
+            futex_wait(sequence, value, remaining);
+        }
+        num_waiters.fetch_sub(1);
+        if (satisfied || ready()) {
+            return true;
+        }
+        if (remaining <= std::chrono::nanoseconds::zero()) {
+            return false;
+        }
+    }
+}
+
+/**
+ * @brief 条件を変えたことを待機している相手へ知らせる
+ *
+ */
+void notify(std::atomic<std::uint32_t>& sequence, std::atomic<std::uint32_t>& num_waiters) {
+    sequence.fetch_add(1);
+    if (num_waiters.load() > 0) {
+        futex_wake(sequence);
+    }
+}
+
+}  // namespace
+
+void FrameRing::map(const int fd, const std::size_t size) {
+    address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (address == MAP_FAILED) {
+        address = nullptr;
+        throw make_system_error("Could not map shared memory", name);
+    }
+    length = size;
+    header = static_cast<FrameRingHeader*>(address);
+}
+
+cv::Mat FrameRing::get_slot_image(const std::uint64_t index) const {
+    unsigned char* data = static_cast<unsigned char*>(address) + header->data_offset +
+                          (index % header->num_slots) * header->slot_size;
+    return cv::Mat(config.height, config.width, config.type, data);
+}
+
+FrameRing::~FrameRing(void) {
+    if (address != nullptr) {
+        ::munmap(address, length);
+    }
+}
+
+const std::string& FrameRing::get_name(void) const { return name; }
+
+const FrameRingConfig& FrameRing::get_config(void) const { return config; }
+
+FrameRingProducer::FrameRingProducer(const std::string& name, const FrameRingConfig& config) {
+    if (config.num_slots == 0 || config.width <= 0 || config.height <= 0) {
+        throw std::invalid_argument("Frame ring needs at least one slot and a positive size");
+    }
+    this->name = name;
+    this->config = config;
+
+    // スロットはページ境界に揃え、画像の行が隙間なく並ぶ（連続した）cv::Matとして参照できるようにする
+    const std::size_t image_size = static_cast<std::size_t>(config.width) * config.height *
+                                   CV_ELEM_SIZE(config.type);
+    const std::size_t slot_size = align_up(image_size, SLOT_ALIGNMENT);
+    const std::size_t data_offset =
+        align_up(get_slots_offset() + config.num_slots * sizeof(FrameSlot), SLOT_ALIGNMENT);
+    const std::size_t size = data_offset + config.num_slots * slot_size;
+
+    // 前回異常終了して残った共有メモリは作り直す（開いている読み出し側は古い方を参照し続ける）
+    ::shm_unlink(name.c_str());
+    const int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        throw make_system_error("Could not create shared memory", name);
+    }
+    if (::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        const auto error = make_system_error("Could not resize shared memory", name);
+        ::close(fd);
+        ::shm_unlink(name.c_str());
+        throw error;
+    }
+    try {
+        map(fd, size);
+    } catch (...) {
+        ::close(fd);
+        ::shm_unlink(name.c_str());
+        throw;
+    }
+    ::close(fd);
+
+    // ftruncate()で0埋めされた領域に先頭を作り、最後にmagicを書いて読み出し側へ公開する
+    header = new (address) FrameRingHeader();
+    header->version = FRAME_RING_VERSION;
+    header->num_slots = config.num_slots;
+    header->width = config.width;
+    header->height = config.height;
+    header->type = config.type;
+    header->slot_size = slot_size;
+    header->data_offset = data_offset;
+    header->magic.store(FRAME_RING_MAGIC, std::memory_order_release);
+}
+
+FrameRingProducer::~FrameRingProducer(void) {
+    close();
+    ::shm_unlink(name.c_str());
+}
+
+cv::Mat FrameRingProducer::acquire(const std::chrono::milliseconds timeout) {
+    if (acquired) {
+        throw std::runtime_error("The acquired slot must be committed before acquiring another");
+    }
+    const auto has_space = [this]() {
+        return write_index - header->read_index.load(std::memory_order_acquire) <
+               config.num_slots;
+    };
+    if (!wait_for(header->space_sequence, header->num_space_waiters, timeout, has_space)) {
+        return cv::Mat();
+    }
+    acquired = true;
+    return get_slot_image(write_index);
+}
+
+cv::Mat FrameRingProducer::try_acquire(void) { return acquire(std::chrono::milliseconds(0)); }
+
+void FrameRingProducer::commit(const std::uint64_t frame_index) {
+    if (!acquired) {
+        throw std::runtime_error("No slot has been acquired");
+    }
+    FrameSlot& slot = get_frame_slots(header)[write_index % config.num_slots];
+    slot.frame_index = frame_index;
+    slot.timestamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now().time_since_epoch())
+                            .count();
+
+    // スロットの内容を書き終えてからインデックスを進める
+    write_index++;
+    header->write_index.store(write_index, std::memory_order_release);
+    acquired = false;
+    notify(header->data_sequence, header->num_data_waiters);
+}
+
+bool FrameRingProducer::push(const cv::Mat& image, const std::uint64_t frame_index,
+                             const std::chrono::milliseconds timeout) {
+    if (image.cols != config.width || image.rows != config.height || image.type() != config.type) {
+        throw std::invalid_argument("Image size or type does not match the frame ring");
+    }
+    cv::Mat slot = acquire(timeout);
+    if (slot.empty()) {
+        return false;
+    }
+    image.copyTo(slot);
+    commit(frame_index);
+    return true;
+}
+
+void FrameRingProducer::close(void) {
+    if (header == nullptr || header->closed.load() != 0) {
+        return;
+    }
+    header->closed.store(1, std::memory_order_release);
+    header->data_sequence.fetch_add(1);
+    futex_wake(header->data_sequence);
+}
+
+FrameRingConsumer::FrameRingConsumer(const std::string& name) {
+    this->name = name;
+    const int fd = ::shm_open(name.c_str(), O_RDWR | O_CLOEXEC, 0);
+    if (fd < 0) {
+        throw make_system_error("Could not open shared memory", name);
+    }
+    struct stat shm_stat;
+    if (::fstat(fd, &shm_stat) != 0) {
+        const auto error = make_system_error("Could not stat shared memory", name);
+        ::close(fd);
+        throw error;
+    }
+    const std::size_t size = static_cast<std::size_t>(shm_stat.st_size);
+    if (size < sizeof(FrameRingHeader)) {
+        ::close(fd);
+        throw std::runtime_error("Frame ring is not initialized: " + name);
+    }
+    try {
+        map(fd, size);
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+    ::close(fd);
+
+    if (header->magic.load(std::memory_order_acquire) != FRAME_RING_MAGIC) {
+        throw std::runtime_error("Frame ring is not initialized: " + name);
+    }
+    if (header->version != FRAME_RING_VERSION) {
+        throw std::runtime_error("Unsupported frame ring version: " +
+                                 std::to_string(header->version));
+    }
+    if (header->num_slots == 0 ||
+        header->data_offset + header->num_slots * header->slot_size > size) {
+        throw std::runtime_error("Frame ring is truncated: " + name);
+    }
+    config.num_slots = header->num_slots;
+    config.width = header->width;
+    config.height = header->height;
+    config.type = header->type;
+
+    // 前の読み出し側が返したところから読む
+    read_index = header->read_index.load(std::memory_order_acquire);
+}
+
+bool FrameRingConsumer::acquire(std::vector<RingFrame>& frames, const std::size_t max_count,
+                                const std::chrono::milliseconds timeout) {
+    if (num_acquired > 0) {
+        throw std::runtime_error("The acquired frames must be released before acquiring more");
+    }
+    if (max_count == 0) {
+        throw std::invalid_argument("max_count must be greater than 0");
+    }
+    frames.clear();
+    const auto has_frame = [this]() {
+        return header->write_index.load(std::memory_order_acquire) > read_index ||
+               header->closed.load(std::memory_order_acquire) != 0;
+    };
+    if (!wait_for(header->data_sequence, header->num_data_waiters, timeout, has_frame)) {
+        return false;
+    }
+
+    // 閉じられた場合も、閉じる前に書き込まれた残りのフレームは読む
+    const std::uint64_t available =
+        header->write_index.load(std::memory_order_acquire) - read_index;
+    const std::size_t count =
+        static_cast<std::size_t>(std::min<std::uint64_t>(available, max_count));
+    const FrameSlot* slots = get_frame_slots(header);
+    for (std::size_t i = 0; i < count; i++) {
+        const FrameSlot& slot = slots[(read_index + i) % config.num_slots];
+        RingFrame frame;
+        frame.image = get_slot_image(read_index + i);
+        frame.frame_index = slot.frame_index;
+        frame.timestamp_ns = slot.timestamp_ns;
+        frames.push_back(frame);
+    }
+    num_acquired = count;
+    return count > 0;
+}
+
+void FrameRingConsumer::release(void) {
+    if (num_acquired == 0) {
+        return;
+    }
+    // スロットを読み終えてからインデックスを進める
+    read_index += num_acquired;
+    num_acquired = 0;
+    header->read_index.store(read_index, std::memory_order_release);
+    notify(header->space_sequence, header->num_space_waiters);
+}
+
+bool FrameRingConsumer::is_finished(void) const {
+    return header->closed.load(std::memory_order_acquire) != 0 && num_acquired == 0 &&
+           header->write_index.load(std::memory_order_acquire) == read_index;
+}
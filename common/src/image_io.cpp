@@ -0,0 +1,234 @@
+#include "image_io.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+namespace {
+
+std::runtime_error make_system_error(const std::string& message, const std::string& path) {
+    return std::runtime_error(message + ": " + path + " (" + std::strerror(errno) + ")");
+}
+
+}  // namespace
+
+MappedFile::MappedFile(const std::string& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw make_system_error("Could not open file", path);
+    }
+
+    struct stat file_stat;
+    if (::fstat(fd, &file_stat) != 0) {
+        const auto error = make_system_error("Could not stat file", path);
+        ::close(fd);
+        throw error;
+    }
+
+    length = static_cast<std::size_t>(file_stat.st_size);
+    if (length > 0) {
+        address = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address == MAP_FAILED) {
+            address = nullptr;
+            const auto error = make_system_error("Could not map file", path);
+            ::close(fd);
+            throw error;
+        }
+        // デコードは先頭から順に読むため、カーネルにまとめて読み込ませる
+        ::madvise(address, length, MADV_SEQUENTIAL);
+        ::madvise(address, length, MADV_WILLNEED);
+    }
+
+    // マップ後はファイルディスクリプタが不要
+    ::close(fd);
+}
+
+MappedFile::~MappedFile(void) {
+    if (address != nullptr) {
+        ::munmap(address, length);
+    }
+}
+
+const unsigned char* MappedFile::data(void) const {
+    return static_cast<const unsigned char*>(address);
+}
+
+std::size_t MappedFile::size(void) const { return length; }
+
+cv::Mat read_image(const std::string& path, const int flags) {
+    const MappedFile file(path);
+    if (file.size() == 0) {
+        throw std::runtime_error("Image file is empty: " + path);
+    }
+
+    // マップしたメモリをそのままデコーダの入力にする（cv::imdecodeは入力を書き換えない）
+    const cv::Mat buffer(1, static_cast<int>(file.size()), CV_8UC1,
+                         const_cast<unsigned char*>(file.data()));
+    cv::Mat image = cv::imdecode(buffer, flags);
+    if (image.empty()) {
+        throw std::runtime_error("Could not decode the image: " + path);
+    }
+    return image;
+}
+
+void write_image(const std::string& path, const cv::Mat& image, const std::vector<int>& params) {
+    const std::string extension = std::filesystem::path(path).extension().string();
+    std::vector<unsigned char> buffer;
+    if (!cv::imencode(extension, image, buffer, params)) {
+        throw std::runtime_error("Could not encode the image: " + path);
+    }
+
+    const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw make_system_error("Could not open file for writing", path);
+    }
+    std::size_t written = 0;
+    while (written < buffer.size()) {
+        const ssize_t result = ::write(fd, buffer.data() + written, buffer.size() - written);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            const auto error = make_system_error("Could not write file", path);
+            ::close(fd);
+            throw error;
+        }
+        written += static_cast<std::size_t>(result);
+    }
+    if (::close(fd) != 0) {
+        throw make_system_error("Could not close file", path);
+    }
+}
+
+ImageReader::ImageReader(std::vector<std::string> paths, const std::size_t num_workers,
+                         const std::size_t readahead, const int flags)
+    : paths(std::move(paths)), flags(flags), readahead(readahead) {
+    if (num_workers == 0) {
+        throw std::invalid_argument("ImageReader needs at least one worker");
+    }
+    if (readahead == 0) {
+        throw std::invalid_argument("Readahead must be at least 1");
+    }
+    for (std::size_t i = 0; i < num_workers; i++) {
+        workers.emplace_back(&ImageReader::run_worker, this);
+    }
+}
+
+ImageReader::~ImageReader(void) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopped = true;
+    }
+    worker_cv.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ImageReader::run_worker(void) {
+    while (true) {
+        std::size_t index;
+        {
+            // 取り出し位置からreadahead枚先までに収まるまで待機する
+            std::unique_lock<std::mutex> lock(mutex);
+            worker_cv.wait(lock, [this]() {
+                return stopped || next_decode >= paths.size() ||
+                       next_decode < next_output + readahead;
+            });
+            if (stopped || next_decode >= paths.size()) {
+                return;
+            }
+            index = next_decode++;
+        }
+
+        DecodedImage image;
+        image.path = paths[index];
+        try {
+            image.image = read_image(image.path, flags);
+        } catch (...) {
+            image.exception = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            decoded.emplace(index, std::move(image));
+        }
+        output_cv.notify_all();
+    }
+}
+
+bool ImageReader::next(DecodedImage& image) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (next_output >= paths.size()) {
+        return false;
+    }
+    output_cv.wait(lock, [this]() { return decoded.count(next_output) > 0; });
+
+    auto it = decoded.find(next_output);
+    image = std::move(it->second);
+    decoded.erase(it);
+    next_output++;
+    lock.unlock();
+
+    // 先読みできる範囲が1枚進んだことを伝える
+    worker_cv.notify_one();
+    return true;
+}
+
+std::size_t ImageReader::size(void) const { return paths.size(); }
+
+ImageWriter::ImageWriter(const std::size_t num_workers, const std::size_t queue_capacity,
+                         ErrorCallback on_error)
+    : requests(queue_capacity), on_error(std::move(on_error)) {
+    if (num_workers == 0) {
+        throw std::invalid_argument("ImageWriter needs at least one worker");
+    }
+    for (std::size_t i = 0; i < num_workers; i++) {
+        workers.emplace_back(&ImageWriter::run_worker, this);
+    }
+}
+
+ImageWriter::~ImageWriter(void) { wait(); }
+
+void ImageWriter::run_worker(void) {
+    Request request;
+    while (requests.pop(request)) {
+        try {
+            write_image(request.path, request.image, request.params);
+            num_written++;
+        } catch (...) {
+            num_failed++;
+            if (on_error) {
+                on_error(request.path, std::current_exception());
+            }
+        }
+        // 次の要求を待つ間に画像のメモリを保持し続けないよう解放する
+        request.image.release();
+    }
+}
+
+void ImageWriter::write(const std::string& path, const cv::Mat& image,
+                        const std::vector<int>& params) {
+    if (!requests.push(Request{path, image, params})) {
+        throw std::logic_error("ImageWriter has already been closed");
+    }
+}
+
+void ImageWriter::wait(void) {
+    requests.close();
+    for (auto& worker : workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
+
+std::size_t ImageWriter::get_num_written(void) const { return num_written.load(); }
+
+std::size_t ImageWriter::get_num_failed(void) const { return num_failed.load(); }
@@ -0,0 +1,379 @@
+#include "inference_protocol.hpp"
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+std::runtime_error make_system_error(const std::string& message) {
+    return std::runtime_error(message + " (" + std::strerror(errno) + ")");
+}
+
+/**
+ * @brief ソケットファイルのパスからアドレスを作る
+ *
+ */
+sockaddr_un make_address(const std::string& path) {
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        throw std::invalid_argument("Invalid socket path: " + path);
+    }
+    std::memcpy(address.sun_path, path.data(), path.size());
+    return address;
+}
+
+/**
+ * @brief 指定したサイズを読み切る
+ *
+ * @return std::size_t 読んだサイズ（途中で接続が閉じられた場合はsizeより小さい）
+ */
+std::size_t read_fully(const int fd, void* data, const std::size_t size) {
+    std::size_t received = 0;
+    while (received < size) {
+        const ssize_t result = ::recv(fd, static_cast<char*>(data) + received, size - received, 0);
+        if (result == 0) {
+            break;
+        }
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw make_system_error("Could not receive message");
+        }
+        received += static_cast<std::size_t>(result);
+    }
+    return received;
+}
+
+/**
+ * @brief 値をデータの末尾へ追加する
+ *
+ */
+template <typename T>
+void append(std::vector<char>& payload, const T& value) {
+    const char* bytes = reinterpret_cast<const char*>(&value);
+    payload.insert(payload.end(), bytes, bytes + sizeof(T));
+}
+
+/**
+ * @brief データを先頭から順に読む
+ *
+ */
+class PayloadReader {
+   private:
+    const std::vector<char>& payload;
+    std::size_t offset = 0;
+
+   public:
+    explicit PayloadReader(const std::vector<char>& payload) : payload(payload) {}
+
+    template <typename T>
+    T read(void) {
+        if (payload.size() - offset < sizeof(T)) {
+            throw std::runtime_error("Result message is truncated");
+        }
+        T value;
+        std::memcpy(&value, payload.data() + offset, sizeof(T));
+        offset += sizeof(T);
+        return value;
+    }
+};
+
+/**
+ * @brief 結果のデータの先頭（検知枠の数と人物の数）を追加し、続くデータの分を確保する
+ *
+ * 検知枠は1つあたりfloat×4・int32・float、骨格は人物ごとにuint32の点数と点ごとのfloat×3
+ */
+void begin_result(std::vector<char>& payload, const std::size_t num_bboxes,
+                  const std::size_t num_poses, const std::size_t num_keypoints) {
+    payload.clear();
+    payload.reserve(2 * sizeof(std::uint32_t) + num_bboxes * 6 * sizeof(float) +
+                    num_poses * sizeof(std::uint32_t) + num_keypoints * 3 * sizeof(float));
+    append(payload, static_cast<std::uint32_t>(num_bboxes));
+    append(payload, static_cast<std::uint32_t>(num_poses));
+}
+
+}  // namespace
+
+InferenceError::InferenceError(const std::uint64_t request_id, const std::string& message)
+    : std::runtime_error("Inference failed for request " + std::to_string(request_id) + ": " +
+                         message),
+      request_id(request_id) {}
+
+std::uint64_t InferenceError::get_request_id(void) const { return request_id; }
+
+int listen_unix_socket(const std::string& path, const int backlog) {
+    const sockaddr_un address = make_address(path);
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        throw make_system_error("Could not create socket");
+    }
+    ::unlink(path.c_str());
+    if (::bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::listen(fd, backlog) != 0) {
+        const auto error = make_system_error("Could not listen on " + path);
+        ::close(fd);
+        throw error;
+    }
+    return fd;
+}
+
+int connect_unix_socket(const std::string& path) {
+    const sockaddr_un address = make_address(path);
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        throw make_system_error("Could not create socket");
+    }
+    while (::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        if (errno == EINTR) {
+            continue;
+        }
+        const auto error = make_system_error("Could not connect to " + path);
+        ::close(fd);
+        throw error;
+    }
+    return fd;
+}
+
+void send_message(const int fd, MessageHeader header, const void* payload,
+                  const std::size_t payload_size) {
+    if (payload_size > MAX_PAYLOAD_SIZE) {
+        throw std::invalid_argument("Message payload is too large");
+    }
+    header.magic = MESSAGE_MAGIC;
+    header.payload_size = static_cast<std::uint32_t>(payload_size);
+
+    iovec buffers[2];
+    buffers[0].iov_base = &header;
+    buffers[0].iov_len = sizeof(header);
+    buffers[1].iov_base = const_cast<void*>(payload);
+    buffers[1].iov_len = payload_size;
+    msghdr message;
+    std::memset(&message, 0, sizeof(message));
+    message.msg_iov = buffers;
+    message.msg_iovlen = payload_size > 0 ? 2 : 1;
+
+    // 相手が切断していてもSIGPIPEでプロセスを終了させず、例外にする
+    while (message.msg_iovlen > 0) {
+        const ssize_t result = ::sendmsg(fd, &message, MSG_NOSIGNAL);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw make_system_error("Could not send message");
+        }
+        // 送り切れなかった分から続ける
+        std::size_t sent = static_cast<std::size_t>(result);
+        while (message.msg_iovlen > 0 && sent >= message.msg_iov[0].iov_len) {
+            sent -= message.msg_iov[0].iov_len;
+            message.msg_iov++;
+            message.msg_iovlen--;
+        }
+        if (message.msg_iovlen > 0) {
+            message.msg_iov[0].iov_base = static_cast<char*>(message.msg_iov[0].iov_base) + sent;
+            message.msg_iov[0].iov_len -= sent;
+        }
+    }
+}
+
+bool receive_message(const int fd, MessageHeader& header, std::vector<char>& payload) {
+    const std::size_t received = read_fully(fd, &header, sizeof(header));
+    if (received == 0) {
+        return false;
+    }
+    if (received < sizeof(header)) {
+        throw std::runtime_error("Connection closed in the middle of a message");
+    }
+    if (header.magic != MESSAGE_MAGIC) {
+        throw std::runtime_error("Invalid message header");
+    }
+    if (header.payload_size > MAX_PAYLOAD_SIZE) {
+        throw std::runtime_error("Message payload is too large");
+    }
+    payload.resize(header.payload_size);
+    if (read_fully(fd, payload.data(), payload.size()) < payload.size()) {
+        throw std::runtime_error("Connection closed in the middle of a message");
+    }
+    return true;
+}
+
+void encode_image(const cv::Mat& image, std::vector<char>& payload) {
+    if (image.empty() || image.depth() != CV_8U) {
+        throw std::invalid_argument("Only non-empty 8-bit images can be sent");
+    }
+    const cv::Mat continuous = image.isContinuous() ? image : image.clone();
+    ImageHeader header;
+    header.encoding = static_cast<std::uint32_t>(ImageEncoding::Raw);
+    header.width = continuous.cols;
+    header.height = continuous.rows;
+    header.type = continuous.type();
+
+    const std::size_t data_size = continuous.total() * continuous.elemSize();
+    payload.resize(sizeof(header) + data_size);
+    std::memcpy(payload.data(), &header, sizeof(header));
+    std::memcpy(payload.data() + sizeof(header), continuous.data, data_size);
+}
+
+void encode_image(const std::vector<unsigned char>& data, std::vector<char>& payload) {
+    ImageHeader header;
+    header.encoding = static_cast<std::uint32_t>(ImageEncoding::Encoded);
+    header.width = 0;
+    header.height = 0;
+    header.type = 0;
+
+    payload.resize(sizeof(header) + data.size());
+    std::memcpy(payload.data(), &header, sizeof(header));
+    std::memcpy(payload.data() + sizeof(header), data.data(), data.size());
+}
+
+cv::Mat decode_image(const std::vector<char>& payload) {
+    ImageHeader header;
+    if (payload.size() < sizeof(header)) {
+        throw std::runtime_error("Image message is truncated");
+    }
+    std::memcpy(&header, payload.data(), sizeof(header));
+    char* data = const_cast<char*>(payload.data()) + sizeof(header);
+    const std::size_t data_size = payload.size() - sizeof(header);
+
+    if (header.encoding == static_cast<std::uint32_t>(ImageEncoding::Encoded)) {
+        // デコーダは入力を書き換えないため、受け取ったデータをそのまま渡す
+        const cv::Mat buffer(1, static_cast<int>(data_size), CV_8UC1, data);
+        cv::Mat image = cv::imdecode(buffer, cv::IMREAD_COLOR);
+        if (image.empty()) {
+            throw std::runtime_error("Could not decode the image");
+        }
+        return image;
+    }
+    if (header.encoding != static_cast<std::uint32_t>(ImageEncoding::Raw)) {
+        throw std::runtime_error("Unknown image encoding: " + std::to_string(header.encoding));
+    }
+    if (header.width <= 0 || header.height <= 0 || CV_MAT_DEPTH(header.type) != CV_8U) {
+        throw std::runtime_error("Invalid raw image header");
+    }
+    const std::size_t expected = static_cast<std::size_t>(header.width) * header.height *
+                                 CV_ELEM_SIZE(header.type);
+    if (data_size != expected) {
+        throw std::runtime_error("Raw image size does not match its header");
+    }
+    return cv::Mat(header.height, header.width, header.type, data);
+}
+
+void encode_result(const BBoxList& bboxes, std::vector<char>& payload) {
+    begin_result(payload, bboxes.size(), 0, 0);
+    for (std::size_t i = 0; i < bboxes.size(); i++) {
+        const cv::Rect2f& rect = bboxes.get_rects()[i];
+        append(payload, rect.x);
+        append(payload, rect.y);
+        append(payload, rect.width);
+        append(payload, rect.height);
+        append(payload, static_cast<std::int32_t>(bboxes.get_labels()[i]));
+        append(payload, bboxes.get_confidences()[i]);
+    }
+}
+
+void encode_result(const KeyPointList& keypoints, std::vector<char>& payload) {
+    begin_result(payload, 0, 1, keypoints.size());
+    append(payload, static_cast<std::uint32_t>(keypoints.size()));
+    for (std::size_t k = 0; k < keypoints.size(); k++) {
+        append(payload, keypoints.get_xs()[k]);
+        append(payload, keypoints.get_ys()[k]);
+        append(payload, keypoints.get_confidences()[k]);
+    }
+}
+
+void encode_result(const std::vector<Pose>& poses, std::vector<char>& payload) {
+    std::size_t num_keypoints = 0;
+    for (const Pose& pose : poses) {
+        num_keypoints += pose.get_keypoints().size();
+    }
+    begin_result(payload, 0, poses.size(), num_keypoints);
+    for (const Pose& pose : poses) {
+        append(payload, static_cast<std::uint32_t>(pose.get_keypoints().size()));
+        for (const KeyPoint& keypoint : pose.get_keypoints()) {
+            append(payload, keypoint.get_x());
+            append(payload, keypoint.get_y());
+            append(payload, keypoint.get_confidence());
+        }
+    }
+}
+
+void decode_result(const std::vector<char>& payload, InferenceResult& result) {
+    PayloadReader reader(payload);
+    const std::uint32_t num_bboxes = reader.read<std::uint32_t>();
+    const std::uint32_t num_poses = reader.read<std::uint32_t>();
+
+    result.bboxes.clear();
+    for (std::uint32_t i = 0; i < num_bboxes; i++) {
+        const float x = reader.read<float>();
+        const float y = reader.read<float>();
+        const float width = reader.read<float>();
+        const float height = reader.read<float>();
+        const std::int32_t label = reader.read<std::int32_t>();
+        const float confidence = reader.read<float>();
+        result.bboxes.push_back(cv::Rect2f(x, y, width, height), label, confidence);
+    }
+
+    result.poses.resize(num_poses);
+    for (KeyPointList& keypoints : result.poses) {
+        keypoints.clear();
+        const std::uint32_t num_keypoints = reader.read<std::uint32_t>();
+        for (std::uint32_t k = 0; k < num_keypoints; k++) {
+            const float x = reader.read<float>();
+            const float y = reader.read<float>();
+            const float confidence = reader.read<float>();
+            keypoints.push_back(x, y, confidence);
+        }
+    }
+}
+
+InferenceClient::InferenceClient(const std::string& socket_path)
+    : fd(connect_unix_socket(socket_path)) {}
+
+InferenceClient::~InferenceClient(void) { ::close(fd); }
+
+std::uint64_t InferenceClient::send_request(void) {
+    MessageHeader header;
+    header.type = static_cast<std::uint32_t>(MessageType::Infer);
+    header.request_id = next_request_id++;
+    header.status = 0;
+    send_message(fd, header, request.data(), request.size());
+    return header.request_id;
+}
+
+std::uint64_t InferenceClient::send(const cv::Mat& image) {
+    encode_image(image, request);
+    return send_request();
+}
+
+std::uint64_t InferenceClient::send(const std::vector<unsigned char>& data) {
+    encode_image(data, request);
+    return send_request();
+}
+
+std::uint64_t InferenceClient::receive(InferenceResult& result) {
+    MessageHeader header;
+    if (!receive_message(fd, header, response)) {
+        throw std::runtime_error("Inference server closed the connection");
+    }
+    if (header.type != static_cast<std::uint32_t>(MessageType::Result)) {
+        throw std::runtime_error("Unexpected message type: " + std::to_string(header.type));
+    }
+    if (header.status != 0) {
+        throw InferenceError(header.request_id, std::string(response.begin(), response.end()));
+    }
+    decode_result(response, result);
+    return header.request_id;
+}
+
+void InferenceClient::infer(const cv::Mat& image, InferenceResult& result) {
+    send(image);
+    receive(result);
+}
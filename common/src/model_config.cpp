@@ -0,0 +1,270 @@
+#include "model_config.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <limits>
+#include <opencv2/opencv.hpp>
+#include <stdexcept>
+#include <vector>
+
+#include "cpu_topology.hpp"
+
+namespace {
+
+std::string to_lower(std::string value) {
+    std::transform(value.begin(), value.end(), value.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return value;
+}
+
+std::invalid_argument make_value_error(const std::string& key, const std::string& value) {
+    return std::invalid_argument("Invalid value for " + key + ": " + value);
+}
+
+long long parse_integer(const std::string& key, const std::string& value) {
+    std::size_t pos = 0;
+    long long number = 0;
+    try {
+        number = std::stoll(value, &pos);
+    } catch (const std::exception&) {
+        throw make_value_error(key, value);
+    }
+    if (pos != value.size()) {
+        throw make_value_error(key, value);
+    }
+    return number;
+}
+
+std::size_t parse_size(const std::string& key, const std::string& value) {
+    const long long number = parse_integer(key, value);
+    if (number < 0) {
+        throw make_value_error(key, value);
+    }
+    return static_cast<std::size_t>(number);
+}
+
+bool parse_bool(const std::string& key, const std::string& value) {
+    const std::string lower = to_lower(value);
+    if (lower == "on" || lower == "true" || lower == "yes" || lower == "1") {
+        return true;
+    }
+    if (lower == "off" || lower == "false" || lower == "no" || lower == "0") {
+        return false;
+    }
+    throw make_value_error(key, value);
+}
+
+PerformanceMode parse_performance_mode(const std::string& value) {
+    const std::string lower = to_lower(value);
+    for (const PerformanceMode mode :
+         {PerformanceMode::Default, PerformanceMode::Latency, PerformanceMode::Throughput,
+          PerformanceMode::CumulativeThroughput}) {
+        if (lower == get_performance_mode_name(mode)) {
+            return mode;
+        }
+    }
+    throw make_value_error("performance_mode", value);
+}
+
+/**
+ * @brief 1項目分の設定を適用する
+ *
+ * @param config 適用先
+ * @param key キー（ModelConfigのメンバ名）
+ * @param value 値の文字列
+ * @return true 適用した
+ * @return false 読み込み設定のキーではない
+ */
+bool apply_option(ModelConfig& config, const std::string& key, const std::string& value) {
+    if (key == "device") {
+        config.device = value;
+    } else if (key == "num_requests") {
+        config.num_requests = parse_size(key, value);
+    } else if (key == "max_batch_size") {
+        config.max_batch_size = parse_size(key, value);
+    } else if (key == "input_height") {
+        config.input_height = parse_size(key, value);
+    } else if (key == "input_width") {
+        config.input_width = parse_size(key, value);
+    } else if (key == "dynamic_input_size") {
+        config.dynamic_input_size = parse_bool(key, value);
+    } else if (key == "cache_dir") {
+        config.cache_dir = value;
+    } else if (key == "performance_mode") {
+        config.performance_mode = parse_performance_mode(value);
+    } else if (key == "num_streams") {
+        const long long num_streams = to_lower(value) == "auto" ? -1 : parse_integer(key, value);
+        if (num_streams < -1 || num_streams > std::numeric_limits<int>::max()) {
+            throw make_value_error(key, value);
+        }
+        config.num_streams = static_cast<int>(num_streams);
+    } else if (key == "inference_num_threads") {
+        const std::size_t num_threads = parse_size(key, value);
+        if (num_threads > static_cast<std::size_t>(std::numeric_limits<int>::max())) {
+            throw make_value_error(key, value);
+        }
+        config.inference_num_threads = static_cast<int>(num_threads);
+    } else if (key == "enable_cpu_pinning") {
+        config.enable_cpu_pinning = parse_bool(key, value);
+    } else if (key == "cpu_affinity") {
+        // 書式を確認し、正規化した形で保持する（同じCPUの指定が同じ文字列になるように）
+        const std::vector<int> cpus = parse_cpu_list(value);
+        if (cpus.empty() && !value.empty()) {
+            throw make_value_error(key, value);
+        }
+        config.cpu_affinity = format_cpu_list(cpus);
+    } else if (key == "inference_precision") {
+        const std::string precision = to_lower(value);
+        if (!precision.empty() && precision != "f32" && precision != "bf16" &&
+            precision != "f16") {
+            throw make_value_error(key, value);
+        }
+        config.inference_precision = precision;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+const char* get_performance_mode_name(const PerformanceMode mode) {
+    switch (mode) {
+        case PerformanceMode::Latency:
+            return "latency";
+        case PerformanceMode::Throughput:
+            return "throughput";
+        case PerformanceMode::CumulativeThroughput:
+            return "cumulative_throughput";
+        default:
+            return "default";
+    }
+}
+
+ModelConfig load_model_config(const std::string& path, const ModelConfig& base) {
+    cv::FileStorage storage(path, cv::FileStorage::READ);
+    if (!storage.isOpened()) {
+        throw std::runtime_error("Could not open model config: " + path);
+    }
+
+    ModelConfig config = base;
+    const cv::FileNode root = storage.root();
+    for (const std::string& key : root.keys()) {
+        const cv::FileNode node = root[key];
+        std::string value;
+        if (node.isInt()) {
+            value = std::to_string(static_cast<int>(node));
+        } else if (node.isString()) {
+            value = node.string();
+        } else {
+            throw std::invalid_argument("Invalid value for " + key + " in " + path);
+        }
+        if (!apply_option(config, key, value)) {
+            throw std::invalid_argument("Unknown model config key: " + key);
+        }
+    }
+    return config;
+}
+
+ModelConfig parse_model_config_args(int& argc, char** argv, const ModelConfig& base) {
+    ModelConfig config = base;
+    int num_remaining = 1;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        const std::size_t equal = arg.find('=');
+        if (arg.rfind("--", 0) != 0 || equal == std::string::npos) {
+            // 読み込み設定以外の引数は残す
+            argv[num_remaining++] = argv[i];
+            continue;
+        }
+
+        std::string key = arg.substr(2, equal - 2);
+        const std::string value = arg.substr(equal + 1);
+        std::replace(key.begin(), key.end(), '-', '_');
+        if (key == "model_config") {
+            config = load_model_config(value, config);
+        } else if (!apply_option(config, key, value)) {
+            // 読み込み設定のキーでなければ呼び出し元の引数として残す
+            argv[num_remaining++] = argv[i];
+        }
+    }
+    argc = num_remaining;
+    argv[argc] = nullptr;
+    return config;
+}
+
+std::string get_model_config_usage(void) {
+    return "Model options:\n"
+           "  --model-config=<path>            YAML/JSON/XML file with the options below\n"
+           "  --device=<name>                  inference device (CPU, GPU, AUTO, ...)\n"
+           "  --performance-mode=<mode>        latency | throughput | cumulative_throughput\n"
+           "  --num-requests=<n>               number of concurrent infer requests\n"
+           "  --max-batch-size=<n>             upper bound of the dynamic batch dimension\n"
+           "  --input-height=<n>               reshape the input height (upper bound if dynamic)\n"
+           "  --input-width=<n>                reshape the input width (upper bound if dynamic)\n"
+           "  --dynamic-input-size=<on|off>    make the input height and width dynamic\n"
+           "  --num-streams=<n|auto>           number of execution streams\n"
+           "  --inference-num-threads=<n>      number of inference threads\n"
+           "  --enable-cpu-pinning=<on|off>    pin inference threads to CPU cores\n"
+           "  --cpu-affinity=<list>            run inference on these CPUs (e.g. 0-15,32-47)\n"
+           "  --inference-precision=<type>     f32 | bf16 | f16\n"
+           "  --cache-dir=<path>               compiled model cache directory\n";
+}
+
+std::ostream& operator<<(std::ostream& os, const ModelConfig& config) {
+    os << "device " << config.device << ", requests " << config.num_requests;
+    if (config.max_batch_size > 1) {
+        os << ", max batch " << config.max_batch_size;
+    }
+    if (config.input_height > 0 || config.input_width > 0 || config.dynamic_input_size) {
+        os << ", input " << config.input_height << "x" << config.input_width;
+        if (config.dynamic_input_size) {
+            os << " (dynamic)";
+        }
+    }
+    if (config.performance_mode != PerformanceMode::Default) {
+        os << ", mode " << get_performance_mode_name(config.performance_mode);
+    }
+    if (config.num_streams != 0) {
+        os << ", streams ";
+        if (config.num_streams < 0) {
+            os << "auto";
+        } else {
+            os << config.num_streams;
+        }
+    }
+    if (config.inference_num_threads > 0) {
+        os << ", threads " << config.inference_num_threads;
+    }
+    if (config.enable_cpu_pinning.has_value()) {
+        os << ", pinning " << (*config.enable_cpu_pinning ? "on" : "off");
+    }
+    if (!config.cpu_affinity.empty()) {
+        os << ", cpus " << config.cpu_affinity;
+    }
+    if (!config.inference_precision.empty()) {
+        os << ", precision " << config.inference_precision;
+    }
+    if (!config.cache_dir.empty()) {
+        os << ", cache " << config.cache_dir;
+    }
+    return os;
+}
+
+std::ostream& operator<<(std::ostream& os, const ModelLoadReport& report) {
+    if (report.shared) {
+        return os << "shared";
+    }
+
+    os << "read " << report.read_time_ms << " ms, compile " << report.compile_time_ms << " ms";
+    if (report.loaded_from_cache) {
+        os << " (from cache)";
+    }
+    if (report.num_streams > 0) {
+        os << ", streams " << report.num_streams;
+    }
+    if (report.optimal_num_requests > 0) {
+        os << ", optimal requests " << report.optimal_num_requests;
+    }
+    return os;
+}
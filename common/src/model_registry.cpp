@@ -0,0 +1,60 @@
+#include "model_registry.hpp"
+
+ModelRegistry& ModelRegistry::get_instance(void) {
+    static ModelRegistry instance;
+    return instance;
+}
+
+ov::Core& ModelRegistry::get_core(void) { return core; }
+
+std::shared_ptr<CompiledModelEntry> ModelRegistry::get_or_compile(const std::string& key,
+                                                                  const Factory& factory,
+                                                                  bool& shared) {
+    shared = false;
+    if (key.empty()) {
+        return std::make_shared<CompiledModelEntry>(factory(core));
+    }
+
+    std::shared_ptr<Entry> entry;
+    {
+        std::lock_guard<std::mutex> lock(entries_mutex);
+
+        // 利用者がいなくなった登録を削除（コンパイル中の登録は他の呼び出し元が参照している）
+        for (auto it = entries.begin(); it != entries.end();) {
+            if (it->second.use_count() == 1 && it->second->compiled.expired()) {
+                it = entries.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        std::shared_ptr<Entry>& slot = entries[key];
+        if (!slot) {
+            slot = std::make_shared<Entry>();
+        }
+        entry = slot;
+    }
+
+    // 同じキーのコンパイルは1回だけ行い、他の呼び出し元は完了を待って共有する
+    std::lock_guard<std::mutex> lock(entry->mutex);
+    if (std::shared_ptr<CompiledModelEntry> compiled = entry->compiled.lock()) {
+        shared = true;
+        return compiled;
+    }
+    auto compiled = std::make_shared<CompiledModelEntry>(factory(core));
+    entry->compiled = compiled;
+    return compiled;
+}
+
+std::size_t ModelRegistry::get_num_models(void) {
+    std::lock_guard<std::mutex> lock(entries_mutex);
+    std::size_t num_models = 0;
+    for (const auto& [key, entry] : entries) {
+        // コンパイル中の登録は数えない
+        std::unique_lock<std::mutex> entry_lock(entry->mutex, std::try_to_lock);
+        if (entry_lock.owns_lock() && !entry->compiled.expired()) {
+            num_models++;
+        }
+    }
+    return num_models;
+}
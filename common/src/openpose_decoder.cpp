@@ -0,0 +1,401 @@
+#include "postprocess.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+// 肢ごとにつなぐ関節（OpenPoseの18点の番号）
+constexpr std::array<std::pair<int, int>, OpenPoseDecoder::NUM_LIMBS> BODY_PARTS_KPT_IDS = {{
+    {1, 2}, {1, 5}, {2, 3}, {3, 4}, {5, 6}, {6, 7}, {1, 8}, {8, 9}, {9, 10}, {1, 11},
+    {11, 12}, {12, 13}, {1, 0}, {0, 14}, {14, 16}, {0, 15}, {15, 17}, {2, 16}, {5, 17},
+}};
+
+// 肢ごとのPAFのチャンネル（x方向、続くチャンネルがy方向）
+constexpr std::array<int, OpenPoseDecoder::NUM_LIMBS> BODY_PARTS_PAF_IDS = {
+    12, 20, 14, 16, 22, 24, 0, 2, 4, 6, 8, 10, 28, 30, 34, 32, 36, 18, 26,
+};
+
+// OpenPoseの関節番号からCOCO形式の番号への対応（-1は首でCOCO形式にはない）
+constexpr std::array<int, OpenPoseDecoder::NUM_JOINTS> COCO_REORDER_MAP = {
+    0, -1, 6, 8, 10, 5, 7, 9, 12, 14, 16, 11, 13, 15, 2, 1, 4, 3,
+};
+
+// COCO形式のキーポイント数
+constexpr std::size_t NUM_COCO_KEYPOINTS = 17;
+
+// 肢の上でPAFを調べる点の数
+constexpr int POINTS_PER_LIMB = 10;
+
+// 人物の骨格の要素数（関節ごとの候補の通し番号 + スコア + 関節数）
+constexpr std::size_t POSE_ENTRY_SIZE = OpenPoseDecoder::NUM_JOINTS + 2;
+constexpr std::size_t POSE_SCORE = OpenPoseDecoder::NUM_JOINTS;
+constexpr std::size_t POSE_COUNT = OpenPoseDecoder::NUM_JOINTS + 1;
+
+/**
+ * @brief 肢の候補（関節候補のペア）
+ *
+ */
+struct Connection {
+    int a;  // 始点の関節候補
+    int b;  // 終点の関節候補
+    float score;
+};
+
+/**
+ * @brief 同じ関節候補を共有する肢の候補のうち、スコアが最も高いものだけを残す
+ *
+ * @param connections 肢の候補
+ * @return std::vector<Connection> 残った肢の候補（スコアの高い順）
+ */
+std::vector<Connection> connections_nms(std::vector<Connection> connections) {
+    std::stable_sort(
+        connections.begin(), connections.end(),
+        [](const Connection& lhs, const Connection& rhs) { return lhs.score > rhs.score; });
+
+    std::vector<Connection> kept;
+    std::vector<int> used_a;
+    std::vector<int> used_b;
+    for (const Connection& connection : connections) {
+        if (std::find(used_a.begin(), used_a.end(), connection.a) == used_a.end() &&
+            std::find(used_b.begin(), used_b.end(), connection.b) == used_b.end()) {
+            kept.push_back(connection);
+            used_a.push_back(connection.a);
+            used_b.push_back(connection.b);
+        }
+    }
+    return kept;
+}
+
+/**
+ * @brief 2人の骨格が同じ関節に別の候補を持たないかどうか
+ *
+ */
+bool is_disjoint(const std::vector<float>& pose_a, const std::vector<float>& pose_b) {
+    for (std::size_t k = 0; k < OpenPoseDecoder::NUM_JOINTS; k++) {
+        if (pose_a[k] >= 0 && pose_b[k] >= 0 && pose_a[k] != pose_b[k]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief ヒートマップとPAFのサイズを確認する
+ *
+ * @param heatmaps_shape ヒートマップのサイズ
+ * @param pafs_shape PAFのサイズ
+ */
+void check_output_shapes(const ov::Shape& heatmaps_shape, const ov::Shape& pafs_shape) {
+    if (heatmaps_shape.size() != 4 || pafs_shape.size() != 4 ||
+        heatmaps_shape[0] != pafs_shape[0] || heatmaps_shape[1] < OpenPoseDecoder::NUM_JOINTS ||
+        pafs_shape[1] < 2 * OpenPoseDecoder::NUM_LIMBS || heatmaps_shape[2] != pafs_shape[2] ||
+        heatmaps_shape[3] != pafs_shape[3]) {
+        throw std::invalid_argument("OpenPoseDecoder expects heatmaps [N, 19, H, W] and "
+                                    "pafs [N, 38, H, W]");
+    }
+}
+
+}  // namespace
+
+OpenPoseDecoder::OpenPoseDecoder(const std::size_t max_points, const float score_threshold,
+                                 const float min_paf_alignment_score, const float delta)
+    : max_points(max_points),
+      score_threshold(score_threshold),
+      min_paf_alignment_score(min_paf_alignment_score),
+      delta(delta) {}
+
+std::vector<std::vector<OpenPoseDecoder::Candidate>> OpenPoseDecoder::extract_points(
+    const float* heatmaps, const std::size_t height, const std::size_t width) const {
+    const int h = static_cast<int>(height);
+    const int w = static_cast<int>(width);
+    const std::size_t plane_size = height * width;
+
+    std::vector<std::vector<Candidate>> candidates(NUM_JOINTS);
+    int keypoint_id = 0;
+    for (std::size_t k = 0; k < NUM_JOINTS; k++) {
+        const cv::Mat heatmap(h, w, CV_32FC1, const_cast<float*>(heatmaps + k * plane_size));
+
+        // 3x3の最大値フィルタと一致し、閾値を超える画素を極大点とする（OpenCVのSIMD実装を使う）
+        cv::Mat pooled;
+        cv::dilate(heatmap, pooled, cv::Mat());
+        const cv::Mat mask = (heatmap == pooled) & (heatmap > score_threshold);
+        std::vector<cv::Point> points;
+        cv::findNonZero(mask, points);
+
+        // スコアの高い順に最大max_points個を残す
+        auto by_score = [&heatmap](const cv::Point& lhs, const cv::Point& rhs) {
+            return heatmap.at<float>(lhs) > heatmap.at<float>(rhs);
+        };
+        if (points.size() > max_points) {
+            std::partial_sort(points.begin(), points.begin() + max_points, points.end(),
+                              by_score);
+            points.resize(max_points);
+        } else {
+            std::stable_sort(points.begin(), points.end(), by_score);
+        }
+
+        for (const cv::Point& point : points) {
+            float x = static_cast<float>(point.x);
+            float y = static_cast<float>(point.y);
+
+            // 隣接画素の大小に応じて0.25画素ずらし、位置の精度を上げる
+            if (0 < point.x && point.x < w - 1 && 0 < point.y && point.y < h - 1) {
+                const float dx = heatmap.at<float>(point.y, point.x + 1) -
+                                 heatmap.at<float>(point.y, point.x - 1);
+                const float dy = heatmap.at<float>(point.y + 1, point.x) -
+                                 heatmap.at<float>(point.y - 1, point.x);
+                x += dx > 0.0f ? 0.25f : (dx < 0.0f ? -0.25f : 0.0f);
+                y += dy > 0.0f ? 0.25f : (dy < 0.0f ? -0.25f : 0.0f);
+            }
+            x = std::clamp(x + delta, 0.0f, static_cast<float>(w - 1));
+            y = std::clamp(y + delta, 0.0f, static_cast<float>(h - 1));
+
+            candidates[k].push_back({x, y, heatmap.at<float>(point), keypoint_id++});
+        }
+    }
+    return candidates;
+}
+
+std::vector<std::vector<float>> OpenPoseDecoder::group_keypoints(
+    const std::vector<std::vector<Candidate>>& candidates, const float* pafs,
+    const std::size_t height, const std::size_t width) const {
+    const std::size_t plane_size = height * width;
+    const float max_x = static_cast<float>(width - 1);
+    const float max_y = static_cast<float>(height - 1);
+
+    // 通し番号から関節候補のスコアを引けるようにする
+    std::vector<float> scores;
+    for (const auto& joint_candidates : candidates) {
+        for (const Candidate& candidate : joint_candidates) {
+            scores.push_back(candidate.score);
+        }
+    }
+
+    std::vector<std::vector<float>> pose_entries;
+    for (std::size_t part_id = 0; part_id < NUM_LIMBS; part_id++) {
+        const int kpt_a_id = BODY_PARTS_KPT_IDS[part_id].first;
+        const int kpt_b_id = BODY_PARTS_KPT_IDS[part_id].second;
+        const std::vector<Candidate>& kpts_a = candidates[kpt_a_id];
+        const std::vector<Candidate>& kpts_b = candidates[kpt_b_id];
+        if (kpts_a.empty() || kpts_b.empty()) {
+            continue;
+        }
+
+        const float* paf_x = pafs + BODY_PARTS_PAF_IDS[part_id] * plane_size;
+        const float* paf_y = paf_x + plane_size;
+
+        // 関節候補の全ペアについて、ペアを結ぶ線分上のPAFと線分の向きが一致するかを調べる
+        std::vector<Connection> connections;
+        for (std::size_t j = 0; j < kpts_b.size(); j++) {
+            for (std::size_t i = 0; i < kpts_a.size(); i++) {
+                const float vec_x = kpts_b[j].x - kpts_a[i].x;
+                const float vec_y = kpts_b[j].y - kpts_a[i].y;
+                const float norm = std::sqrt(vec_x * vec_x + vec_y * vec_y) + 1e-6f;
+                const float unit_x = vec_x / norm;
+                const float unit_y = vec_y / norm;
+                const float step_x = vec_x / (POINTS_PER_LIMB - 1);
+                const float step_y = vec_y / (POINTS_PER_LIMB - 1);
+
+                float score_sum = 0.0f;
+                int valid_num = 0;
+                for (int p = 0; p < POINTS_PER_LIMB; p++) {
+                    // numpyのround()と同じく偶数丸めで画素を決める
+                    const float sx =
+                        std::clamp(std::nearbyint(kpts_a[i].x + step_x * p), 0.0f, max_x);
+                    const float sy =
+                        std::clamp(std::nearbyint(kpts_a[i].y + step_y * p), 0.0f, max_y);
+                    const std::size_t index = static_cast<std::size_t>(sy) * width +
+                                              static_cast<std::size_t>(sx);
+                    const float score = paf_x[index] * unit_x + paf_y[index] * unit_y;
+                    if (score > min_paf_alignment_score) {
+                        score_sum += score;
+                        valid_num++;
+                    }
+                }
+
+                const float affinity_score = score_sum / (valid_num + 1e-6f);
+                const float success_ratio = static_cast<float>(valid_num) / POINTS_PER_LIMB;
+                if (affinity_score > 0.0f && success_ratio > 0.8f) {
+                    connections.push_back({kpts_a[i].id, kpts_b[j].id, affinity_score});
+                }
+            }
+        }
+        if (connections.empty()) {
+            continue;
+        }
+
+        // 肢の候補を人物の骨格へ追加する
+        for (const Connection& connection : connections_nms(std::move(connections))) {
+            int pose_a_idx = -1;
+            int pose_b_idx = -1;
+            for (std::size_t p = 0; p < pose_entries.size(); p++) {
+                if (pose_entries[p][kpt_a_id] == connection.a) {
+                    pose_a_idx = static_cast<int>(p);
+                }
+                if (pose_entries[p][kpt_b_id] == connection.b) {
+                    pose_b_idx = static_cast<int>(p);
+                }
+            }
+
+            if (pose_a_idx < 0 && pose_b_idx < 0) {
+                // 新しい人物
+                std::vector<float> pose_entry(POSE_ENTRY_SIZE, -1.0f);
+                pose_entry[kpt_a_id] = static_cast<float>(connection.a);
+                pose_entry[kpt_b_id] = static_cast<float>(connection.b);
+                pose_entry[POSE_COUNT] = 2.0f;
+                pose_entry[POSE_SCORE] =
+                    scores[connection.a] + scores[connection.b] + connection.score;
+                pose_entries.push_back(std::move(pose_entry));
+            } else if (pose_a_idx >= 0 && pose_b_idx >= 0 && pose_a_idx != pose_b_idx) {
+                // 2人の骨格が矛盾しなければ1人にまとめる
+                std::vector<float>& pose_a = pose_entries[pose_a_idx];
+                const std::vector<float>& pose_b = pose_entries[pose_b_idx];
+                if (is_disjoint(pose_a, pose_b)) {
+                    for (std::size_t k = 0; k < NUM_JOINTS; k++) {
+                        if (pose_a[k] < 0) {
+                            pose_a[k] = pose_b[k];
+                        }
+                    }
+                    pose_a[POSE_SCORE] += pose_b[POSE_SCORE] + connection.score;
+                    pose_a[POSE_COUNT] += pose_b[POSE_COUNT];
+                    pose_entries.erase(pose_entries.begin() + pose_b_idx);
+                }
+            } else if (pose_a_idx >= 0 && pose_b_idx >= 0) {
+                // 既に同じ人物に含まれている肢
+                pose_entries[pose_a_idx][POSE_SCORE] += connection.score;
+            } else if (pose_a_idx >= 0) {
+                // 始点を含む人物に終点を追加する
+                std::vector<float>& pose = pose_entries[pose_a_idx];
+                if (pose[kpt_b_id] < 0) {
+                    pose[POSE_SCORE] += scores[connection.b];
+                }
+                pose[kpt_b_id] = static_cast<float>(connection.b);
+                pose[POSE_SCORE] += connection.score;
+                pose[POSE_COUNT] += 1.0f;
+            } else {
+                // 終点を含む人物に始点を追加する
+                std::vector<float>& pose = pose_entries[pose_b_idx];
+                if (pose[kpt_a_id] < 0) {
+                    pose[POSE_SCORE] += scores[connection.a];
+                }
+                pose[kpt_a_id] = static_cast<float>(connection.a);
+                pose[POSE_SCORE] += connection.score;
+                pose[POSE_COUNT] += 1.0f;
+            }
+        }
+    }
+
+    // 関節が3点未満の人物は除外する
+    pose_entries.erase(std::remove_if(pose_entries.begin(), pose_entries.end(),
+                                      [](const std::vector<float>& pose) {
+                                          return pose[POSE_COUNT] < 3.0f;
+                                      }),
+                       pose_entries.end());
+    return pose_entries;
+}
+
+void OpenPoseDecoder::get_output_tensors(ov::InferRequest& infer_request,
+                                         ov::Tensor& heatmaps_tensor, ov::Tensor& pafs_tensor) {
+    heatmaps_tensor = infer_request.get_output_tensor(0);
+    pafs_tensor = infer_request.get_output_tensor(1);
+    if (heatmaps_tensor.get_shape()[1] == 2 * NUM_LIMBS) {
+        std::swap(heatmaps_tensor, pafs_tensor);
+    }
+}
+
+std::vector<Pose> OpenPoseDecoder::postprocess(const OpenVINOModel& model,
+                                               ov::InferRequest& infer_request) {
+    // 結果を取得
+    ov::Tensor heatmaps_tensor;
+    ov::Tensor pafs_tensor;
+    get_output_tensors(infer_request, heatmaps_tensor, pafs_tensor);
+    return postprocess(heatmaps_tensor, pafs_tensor);
+}
+
+void OpenPoseDecoder::postprocess(const OpenVINOModel& model, ov::InferRequest& infer_request,
+                                  std::vector<Pose>& poses) {
+    poses = postprocess(model, infer_request);
+}
+
+std::vector<Pose> OpenPoseDecoder::postprocess(const ov::Tensor& heatmaps_tensor,
+                                               const ov::Tensor& pafs_tensor) {
+    const ov::Shape heatmaps_shape = heatmaps_tensor.get_shape();
+    check_output_shapes(heatmaps_shape, pafs_tensor.get_shape());
+
+    return decode(heatmaps_tensor.data<const float>(), pafs_tensor.data<const float>(),
+                  heatmaps_shape[2], heatmaps_shape[3]);
+}
+
+void OpenPoseDecoder::postprocess_batch(const OpenVINOModel& model,
+                                        ov::InferRequest& infer_request,
+                                        std::vector<Pose>* poses_list) {
+    ov::Tensor heatmaps_tensor;
+    ov::Tensor pafs_tensor;
+    get_output_tensors(infer_request, heatmaps_tensor, pafs_tensor);
+    const ov::Shape heatmaps_shape = heatmaps_tensor.get_shape();
+    const ov::Shape pafs_shape = pafs_tensor.get_shape();
+    check_output_shapes(heatmaps_shape, pafs_shape);
+
+    const std::size_t height = heatmaps_shape[2];
+    const std::size_t width = heatmaps_shape[3];
+    const std::size_t heatmaps_size = heatmaps_shape[1] * height * width;
+    const std::size_t pafs_size = pafs_shape[1] * height * width;
+    const float* heatmaps = heatmaps_tensor.data<const float>();
+    const float* pafs = pafs_tensor.data<const float>();
+
+    // バッチ要素ごとに独立なので複数スレッドで分担する
+    const int batch_size = static_cast<int>(heatmaps_shape[0]);
+    cv::parallel_for_(cv::Range(0, batch_size), [&](const cv::Range& range) {
+        for (int n = range.start; n < range.end; n++) {
+            poses_list[n] =
+                decode(heatmaps + n * heatmaps_size, pafs + n * pafs_size, height, width);
+        }
+    });
+}
+
+std::vector<Pose> OpenPoseDecoder::decode(const float* heatmaps, const float* pafs,
+                                          const std::size_t height,
+                                          const std::size_t width) const {
+    // 関節候補を抽出し、人物ごとにまとめる
+    const auto candidates = extract_points(heatmaps, height, width);
+    const auto pose_entries = group_keypoints(candidates, pafs, height, width);
+
+    std::vector<const Candidate*> candidates_by_id;
+    for (const auto& joint_candidates : candidates) {
+        for (const Candidate& candidate : joint_candidates) {
+            candidates_by_id.push_back(&candidate);
+        }
+    }
+
+    // COCO形式の17点へ並べ替え、座標を0〜1に正規化する
+    std::vector<Pose> poses;
+    poses.reserve(pose_entries.size());
+    for (const auto& pose_entry : pose_entries) {
+        std::array<cv::Point3f, NUM_COCO_KEYPOINTS> coco{};
+        for (std::size_t k = 0; k < NUM_JOINTS; k++) {
+            const int target_id = COCO_REORDER_MAP[k];
+            if (target_id < 0 || pose_entry[k] < 0) {
+                continue;
+            }
+            const Candidate& candidate = *candidates_by_id[static_cast<int>(pose_entry[k])];
+            coco[target_id] = cv::Point3f(candidate.x / width, candidate.y / height,
+                                          candidate.score);
+        }
+
+        std::vector<KeyPoint> keypoints;
+        keypoints.reserve(NUM_COCO_KEYPOINTS);
+        for (const cv::Point3f& point : coco) {
+            keypoints.emplace_back(point.x, point.y, point.z);
+        }
+        // 首はCOCO形式にないため、関節数から除いてスコアを重み付けする
+        const float score =
+            pose_entry[POSE_SCORE] * std::max(0.0f, pose_entry[POSE_COUNT] - 1.0f);
+        poses.emplace_back(std::move(keypoints), score);
+    }
+
+    return poses;
+}
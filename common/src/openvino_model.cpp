@@ -1,30 +1,359 @@
 #include "openvino_model.hpp"
 
-OpenVINOModel::OpenVINOModel(const std::string model_path, const std::string device) {
+#include <sstream>
+
+#include "cpu_topology.hpp"
+
+/**
+ * @brief 読み込み設定からコンパイル時に渡すプロパティを作る（既定値のままの項目は渡さない）
+ *
+ * @param config 読み込み設定
+ * @return ov::AnyMap プロパティ
+ */
+static ov::AnyMap make_compile_properties(const ModelConfig& config) {
+    ov::AnyMap properties;
+    if (!config.cache_dir.empty()) {
+        properties.insert(ov::cache_dir(config.cache_dir));
+    }
+    if (config.performance_mode != PerformanceMode::Default) {
+        const ov::hint::PerformanceMode mode =
+            config.performance_mode == PerformanceMode::Latency
+                ? ov::hint::PerformanceMode::LATENCY
+                : (config.performance_mode == PerformanceMode::Throughput
+                       ? ov::hint::PerformanceMode::THROUGHPUT
+                       : ov::hint::PerformanceMode::CUMULATIVE_THROUGHPUT);
+        properties.insert(ov::hint::performance_mode(mode));
+        // 同時に実行する推論数を伝え、使われないストリームを作らせない
+        properties.insert(ov::hint::num_requests(static_cast<std::uint32_t>(config.num_requests)));
+    }
+    if (config.num_streams != 0) {
+        properties.insert(ov::num_streams(config.num_streams < 0
+                                              ? ov::streams::AUTO
+                                              : ov::streams::Num(config.num_streams)));
+    }
+    // CPUを指定した場合は、指定したCPUの数だけスレッドを作る
+    const int num_affinity_cpus = static_cast<int>(parse_cpu_list(config.cpu_affinity).size());
+    if (config.inference_num_threads > 0) {
+        properties.insert(ov::inference_num_threads(config.inference_num_threads));
+    } else if (num_affinity_cpus > 0) {
+        properties.insert(ov::inference_num_threads(num_affinity_cpus));
+    }
+    if (config.enable_cpu_pinning.has_value()) {
+        properties.insert(ov::hint::enable_cpu_pinning(*config.enable_cpu_pinning));
+    } else if (num_affinity_cpus > 0) {
+        // OpenVINO自身の固定は指定外のCPUを選ぶことがあるため、作成元スレッドの固定を引き継がせる
+        properties.insert(ov::hint::enable_cpu_pinning(false));
+    }
+    if (!config.inference_precision.empty()) {
+        properties.insert(
+            ov::hint::inference_precision(ov::element::Type(config.inference_precision)));
+    }
+    return properties;
+}
+
+/**
+ * @brief モデルを読み込み、バッチ次元の変更と前処理の組み込みを行ってコンパイルする
+ *
+ * @param core コンパイルに使用するov::Core
+ * @param model_path モデルのパス
+ * @param config 読み込み設定
+ * @param embed_preprocess モデルへ組み込む前処理
+ * @return CompiledModelEntry コンパイル済みモデル
+ */
+static CompiledModelEntry load_compiled_model(
+    ov::Core& core, const std::string& model_path, const ModelConfig& config,
+    const OpenVINOModel::EmbedPreprocess& embed_preprocess) {
+    CompiledModelEntry entry;
+
+    // モデルの読み込み
+    auto start = std::chrono::steady_clock::now();
+    std::shared_ptr<ov::Model> model = core.read_model(model_path);
+    auto end = std::chrono::steady_clock::now();
+    entry.load_report.read_time_ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+    // バッチ次元を動的にし、入力の高さと幅を変更する（NCHWのモデルを前提とする）
+    ov::PartialShape input_shape = model->input().get_partial_shape();
+    const ov::PartialShape original_shape = input_shape;
+    if (config.max_batch_size > 1) {
+        input_shape[0] = ov::Dimension(1, static_cast<std::int64_t>(config.max_batch_size));
+    }
+    if (input_shape.rank().is_static() && input_shape.size() == 4) {
+        const std::size_t sizes[] = {config.input_height, config.input_width};
+        for (std::size_t i = 0; i < 2; i++) {
+            const std::int64_t size = static_cast<std::int64_t>(sizes[i]);
+            if (config.dynamic_input_size) {
+                input_shape[2 + i] = size > 0 ? ov::Dimension(1, size) : ov::Dimension::dynamic();
+            } else if (size > 0) {
+                input_shape[2 + i] = ov::Dimension(size);
+            }
+        }
+    } else if (config.input_height > 0 || config.input_width > 0 || config.dynamic_input_size) {
+        throw std::invalid_argument("Input size can be changed only for 4D (NCHW) inputs");
+    }
+    if (input_shape != original_shape) {
+        model->reshape(input_shape);
+    }
+    entry.network_input_shape = model->input().get_partial_shape();
+
+    // 前処理をモデルへ組み込む
+    if (embed_preprocess) {
+        ov::preprocess::PrePostProcessor ppp(model);
+        embed_preprocess(ppp);
+        model = ppp.build();
+    }
+
+    // コンパイル（キャッシュがあればキャッシュから読み込む）
+    const ov::AnyMap properties = make_compile_properties(config);
+    start = std::chrono::steady_clock::now();
+    entry.compiled_model = core.compile_model(model, config.device, properties);
+    end = std::chrono::steady_clock::now();
+    entry.load_report.compile_time_ms =
+        std::chrono::duration<double, std::milli>(end - start).count();
+    if (!config.cache_dir.empty()) {
+        try {
+            entry.load_report.loaded_from_cache =
+                entry.compiled_model.get_property(ov::loaded_from_cache);
+        } catch (const ov::Exception&) {
+            // デバイスが対応していない場合はキャッシュ未使用として扱う
+            entry.load_report.loaded_from_cache = false;
+        }
+    }
+
+    // デバイスが実際に選んだ並列度（デバイスが対応していなければ0のまま）
+    try {
+        entry.load_report.num_streams = entry.compiled_model.get_property(ov::num_streams).num;
+    } catch (const ov::Exception&) {
+    }
+    try {
+        entry.load_report.optimal_num_requests =
+            entry.compiled_model.get_property(ov::optimal_number_of_infer_requests);
+    } catch (const ov::Exception&) {
+    }
+
+    return entry;
+}
+
+/**
+ * @brief コンパイル済みモデルを共有するためのキーを作る
+ *
+ * モデルファイルと重みファイル（IRの.bin）の更新日時とサイズを含めるため、再学習したモデルで
+ * ファイルが置き換えられると別のキーになる
+ *
+ * @param model_path モデルのパス
+ * @param config 読み込み設定
+ * @param embed_preprocess モデルへ組み込む前処理
+ * @param embed_key 組み込む前処理を識別する文字列
+ * @return std::string キー（共有できない場合は空）
+ */
+static std::string make_registry_key(const std::string& model_path, const ModelConfig& config,
+                                     const OpenVINOModel::EmbedPreprocess& embed_preprocess,
+                                     const std::string& embed_key) {
+    // 識別できない前処理を組み込む場合は共有しない
+    if (embed_preprocess && embed_key.empty()) {
+        return "";
+    }
+
+    const std::filesystem::path path = std::filesystem::canonical(model_path);
+    std::ostringstream key;
+    key << path.string() << '|' << std::filesystem::last_write_time(path).time_since_epoch().count()
+        << '|' << std::filesystem::file_size(path) << '|';
+    std::filesystem::path weights_path = path;
+    weights_path.replace_extension(".bin");
+    std::error_code error;
+    if (weights_path != path && std::filesystem::is_regular_file(weights_path, error)) {
+        key << std::filesystem::last_write_time(weights_path).time_since_epoch().count() << '|'
+            << std::filesystem::file_size(weights_path);
+    }
+    key << '|' << config.device << '|' << config.max_batch_size << '|' << config.input_height
+        << 'x' << config.input_width << (config.dynamic_input_size ? "d" : "") << '|'
+        << config.cache_dir << '|' << get_performance_mode_name(config.performance_mode) << '|'
+        << config.num_streams << '|' << config.inference_num_threads << '|'
+        << (config.enable_cpu_pinning.has_value() ? (*config.enable_cpu_pinning ? "on" : "off")
+                                                  : "default")
+        << '|' << config.cpu_affinity << '|' << config.inference_precision << '|' << embed_key;
+    return key.str();
+}
+
+OpenVINOModel::OpenVINOModel(const std::string model_path, const ModelConfig& config,
+                             const EmbedPreprocess& embed_preprocess, const std::string& embed_key)
+    : max_batch_size(config.max_batch_size) {
     // ファイル存在チェック
     if (!std::filesystem::is_regular_file(model_path)) {
         throw std::runtime_error("No such model file: " + model_path);
     }
+    if (config.num_requests == 0) {
+        throw std::invalid_argument("num_requests must be greater than 0");
+    }
+    if (config.max_batch_size == 0) {
+        throw std::invalid_argument("max_batch_size must be greater than 0");
+    }
 
-    // モデルの読み込み
-    model = core.read_model(model_path);
-    compiled_model = core.compile_model(model, device);
-    infer_request = compiled_model.create_infer_request();
+    const auto load = [&]() {
+        // コンパイル済みモデルを取得（同じ設定のモデルがあれば共有する）
+        bool shared = false;
+        compiled = ModelRegistry::get_instance().get_or_compile(
+            make_registry_key(model_path, config, embed_preprocess, embed_key),
+            [&](ov::Core& core) {
+                return load_compiled_model(core, model_path, config, embed_preprocess);
+            },
+            shared);
+        if (shared) {
+            load_report.shared = true;
+        } else {
+            load_report = compiled->load_report;
+        }
+
+        // 推論リクエストのプールを作成
+        idle_requests.reserve(config.num_requests);
+        for (std::size_t i = 0; i < config.num_requests; i++) {
+            infer_requests.push_back(compiled->compiled_model.create_infer_request());
+            idle_requests.push_back(i);
+        }
+    };
+
+    if (config.cpu_affinity.empty()) {
+        load();
+    } else {
+        // 推論スレッドは作成元スレッドのCPU固定を引き継ぐため、指定したCPUへ固定したスレッドで作る
+        run_on_cpus(parse_cpu_list(config.cpu_affinity), load);
+    }
 }
 
-OpenVINOModel::~OpenVINOModel(void) {}
+OpenVINOModel::~OpenVINOModel(void) {
+    // 実行中の推論がすべて完了し、推論リクエストが返却されるまで待機
+    {
+        std::unique_lock<std::mutex> lock(idle_mutex);
+        idle_cv.wait(lock, [this] { return idle_requests.size() == infer_requests.size(); });
+    }
 
-ov::Shape OpenVINOModel::get_input_shape(void) const { return compiled_model.input().get_shape(); }
+    // 返却した推論スレッドはまだコールバックの中にいるため、戻りきるまで待ってから破棄する
+    for (ov::InferRequest& infer_request : infer_requests) {
+        try {
+            infer_request.wait();
+        } catch (...) {
+            // 推論の例外は完了時のコールバックへ渡し済み
+        }
+    }
+}
+
+ov::Shape OpenVINOModel::get_input_shape(void) const {
+    const ov::PartialShape& partial_shape = compiled->network_input_shape;
+    ov::Shape input_shape(partial_shape.size());
+    for (std::size_t i = 1; i < partial_shape.size(); i++) {
+        if (partial_shape[i].is_static()) {
+            input_shape[i] = static_cast<std::size_t>(partial_shape[i].get_length());
+        }
+    }
+    input_shape[0] = 1;
+    return input_shape;
+}
+
+ov::PartialShape OpenVINOModel::get_input_partial_shape(void) const {
+    return compiled->network_input_shape;
+}
+
+bool OpenVINOModel::has_dynamic_input_size(void) const {
+    const ov::PartialShape& input_shape = compiled->network_input_shape;
+    return input_shape.size() == 4 && (input_shape[2].is_dynamic() || input_shape[3].is_dynamic());
+}
+
+std::size_t OpenVINOModel::get_max_batch_size(void) const { return max_batch_size; }
 
 ov::element::Type OpenVINOModel::get_elementtype(void) const {
-    return compiled_model.input().get_element_type();
+    return compiled->compiled_model.input().get_element_type();
 }
 
-void OpenVINOModel::infer(ov::Tensor& input_tensor) {
-    infer_request.set_input_tensor(input_tensor);
-    infer_request.infer();
+std::size_t OpenVINOModel::get_num_requests(void) const { return infer_requests.size(); }
+
+ModelLoadReport OpenVINOModel::get_load_report(void) const { return load_report; }
+
+std::exception_ptr OpenVINOModel::take_callback_exception(void) {
+    std::lock_guard<std::mutex> lock(idle_mutex);
+    std::exception_ptr exception = callback_exception;
+    callback_exception = nullptr;
+    return exception;
 }
 
-ov::Tensor OpenVINOModel::get_output_tensor(const int index) {
-    return infer_request.get_output_tensor(index);
+std::size_t OpenVINOModel::clear_cache(const std::string& cache_dir) {
+    if (!std::filesystem::is_directory(cache_dir)) {
+        return 0;
+    }
+
+    // コンパイル済みモデル（*.blob）のみ削除する
+    std::size_t num_removed = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(cache_dir)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".blob") {
+            num_removed += std::filesystem::remove(entry.path()) ? 1 : 0;
+        }
+    }
+    return num_removed;
+}
+
+std::size_t OpenVINOModel::acquire_request(void) {
+    std::unique_lock<std::mutex> lock(idle_mutex);
+    idle_cv.wait(lock, [this] { return !idle_requests.empty(); });
+    const std::size_t index = idle_requests.back();
+    idle_requests.pop_back();
+    return index;
+}
+
+void OpenVINOModel::release_request(const std::size_t index) {
+    // デストラクタは返却を見た時点でidle_cvを破棄しうるため、排他したまま通知する
+    std::lock_guard<std::mutex> lock(idle_mutex);
+    idle_requests.push_back(index);
+    idle_cv.notify_all();
+}
+
+void OpenVINOModel::infer(const ov::Tensor& input_tensor, const InferDone callback) {
+    infer(
+        [&input_tensor](ov::InferRequest& infer_request) {
+            infer_request.set_input_tensor(input_tensor);
+        },
+        callback);
+}
+
+void OpenVINOModel::infer_async(const ov::Tensor& input_tensor, InferCallback callback) {
+    infer_async(
+        [&input_tensor](ov::InferRequest& infer_request) {
+            infer_request.set_input_tensor(input_tensor);
+        },
+        std::move(callback));
+}
+
+void OpenVINOModel::infer(const PrepareInput prepare, const InferDone callback) {
+    const std::size_t index = acquire_request();
+    ov::InferRequest& infer_request = infer_requests[index];
+    try {
+        prepare(infer_request);
+        infer_request.infer();
+        callback(infer_request);
+    } catch (...) {
+        release_request(index);
+        throw;
+    }
+    release_request(index);
+}
+
+void OpenVINOModel::infer_async(const PrepareInput prepare, InferCallback callback) {
+    const std::size_t index = acquire_request();
+    ov::InferRequest& infer_request = infer_requests[index];
+    try {
+        infer_request.set_callback([this, index, callback](std::exception_ptr exception) {
+            // 推論スレッドへは例外を投げず、最初の例外を保持して呼び出し元へ伝える
+            try {
+                callback(infer_requests[index], exception);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(idle_mutex);
+                if (!callback_exception) {
+                    callback_exception = std::current_exception();
+                }
+            }
+            release_request(index);
+        });
+        prepare(infer_request);
+        infer_request.start_async();
+    } catch (...) {
+        release_request(index);
+        throw;
+    }
 }
@@ -1,35 +1,234 @@
 #include "openvino_task.hpp"
 
+#include <algorithm>
+#include <typeinfo>
+
+namespace {
+
+// 後処理のバッファをタスクの出力の型へ変換する
+
+std::vector<BBox> to_output(const BBoxList& bboxes) { return bboxes.to_vector(); }
+
+std::vector<KeyPoint> to_output(const KeyPointList& keypoints) { return keypoints.to_vector(); }
+
+std::vector<Pose> to_output(std::vector<Pose>& poses) { return std::move(poses); }
+
+}  // namespace
+
 template <typename Preprocess, typename Postprocess>
-OpenVINOTask<Preprocess, Postprocess>::OpenVINOTask(const std::string model_path) {
-    model = std::make_unique<OpenVINOModel>(model_path);
+OpenVINOTask<Preprocess, Postprocess>::OpenVINOTask(const std::string model_path,
+                                                    const ModelConfig& config) {
+    model = std::make_unique<OpenVINOModel>(
+        model_path, config,
+        [this](ov::preprocess::PrePostProcessor& ppp) { preprocessor.embed(ppp); },
+        typeid(Preprocess).name());
     preprocessor = Preprocess();
     postprocessor = Postprocess();
 }
 
-DetectorBBox5Label1::DetectorBBox5Label1(const std::string model_path) : OpenVINOTask(model_path) {}
+template <typename Preprocess, typename Postprocess>
+OpenVINOTask<Preprocess, Postprocess>::~OpenVINOTask(void) {
+    // コールバックが前処理・後処理を参照するため、先にモデルを解放して推論完了を待つ
+    model.reset();
+}
+
+template <typename Preprocess, typename Postprocess>
+ModelLoadReport OpenVINOTask<Preprocess, Postprocess>::get_load_report(void) const {
+    return model->get_load_report();
+}
+
+template <typename Preprocess, typename Postprocess>
+std::exception_ptr OpenVINOTask<Preprocess, Postprocess>::take_callback_exception(void) {
+    return model->take_callback_exception();
+}
+
+template <typename Preprocess, typename Postprocess>
+TaskProfile OpenVINOTask<Preprocess, Postprocess>::get_profile(void) const {
+    return profiler.get_profile();
+}
+
+template <typename Preprocess, typename Postprocess>
+TaskProfiler& OpenVINOTask<Preprocess, Postprocess>::get_profiler(void) {
+    return profiler;
+}
+
+template <typename Preprocess, typename Postprocess>
+Postprocess& OpenVINOTask<Preprocess, Postprocess>::get_postprocessor(void) {
+    return postprocessor;
+}
+
+template <typename Preprocess, typename Postprocess>
+typename OpenVINOTask<Preprocess, Postprocess>::Output OpenVINOTask<Preprocess, Postprocess>::task(
+    const cv::Mat& image) {
+    const ProfileTimePoint started = profile_now();
+    ProfileTimePoint preprocessed;
+    ProfileTimePoint inferred;
+    Output output;
+    model->infer(
+        [&](ov::InferRequest& infer_request) {
+            // 推論リクエストの入力テンソルへ直接書き込む
+            preprocessor.preprocess_into(*model, image, infer_request);
+            preprocessed = profile_now();
+        },
+        [&](ov::InferRequest& infer_request) {
+            inferred = profile_now();
+            output = postprocessor.postprocess(*model, infer_request);
+        });
+
+    profiler.record(started, preprocessed, inferred, profile_now());
+    return output;
+}
+
+template <typename Preprocess, typename Postprocess>
+void OpenVINOTask<Preprocess, Postprocess>::task(const cv::Mat& image, Buffer& output) {
+    const ProfileTimePoint started = profile_now();
+    ProfileTimePoint preprocessed;
+    ProfileTimePoint inferred;
+    model->infer(
+        [&](ov::InferRequest& infer_request) {
+            preprocessor.preprocess_into(*model, image, infer_request);
+            preprocessed = profile_now();
+        },
+        [&](ov::InferRequest& infer_request) {
+            inferred = profile_now();
+            postprocessor.postprocess(*model, infer_request, output);
+        });
+
+    profiler.record(started, preprocessed, inferred, profile_now());
+}
+
+template <typename Preprocess, typename Postprocess>
+std::vector<typename OpenVINOTask<Preprocess, Postprocess>::Output>
+OpenVINOTask<Preprocess, Postprocess>::task(const std::vector<cv::Mat>& images) {
+    std::vector<Buffer> buffers;
+    task(images, buffers);
 
-std::vector<BBox> DetectorBBox5Label1::task(const cv::Mat& image) {
-    ov::Tensor input_tensor = preprocessor.preprocess(*model, image);
-    model->infer(input_tensor);
-    std::vector<BBox> bboxes = postprocessor.postprocess(*model);
-    return bboxes;
+    std::vector<Output> outputs;
+    outputs.reserve(buffers.size());
+    for (Buffer& buffer : buffers) {
+        outputs.push_back(to_output(buffer));
+    }
+    return outputs;
 }
 
-DetectorBBox7::DetectorBBox7(const std::string model_path) : OpenVINOTask(model_path) {}
+template <typename Preprocess, typename Postprocess>
+void OpenVINOTask<Preprocess, Postprocess>::task(const std::vector<cv::Mat>& images,
+                                                 std::vector<Buffer>& outputs) {
+    // 要素を減らすときだけ解放されるため、画像数が変わらなければ確保済みのメモリを使い回す
+    outputs.resize(images.size());
+
+    // 最大バッチサイズごとにまとめて推論
+    const std::size_t max_batch_size = model->get_max_batch_size();
+    for (std::size_t begin = 0; begin < images.size(); begin += max_batch_size) {
+        const std::size_t end = std::min(begin + max_batch_size, images.size());
 
-std::vector<BBox> DetectorBBox7::task(const cv::Mat& image) {
-    ov::Tensor input_tensor = preprocessor.preprocess(*model, image);
-    model->infer(input_tensor);
-    std::vector<BBox> bboxes = postprocessor.postprocess(*model);
-    return bboxes;
+        const ProfileTimePoint started = profile_now();
+        ProfileTimePoint preprocessed;
+        ProfileTimePoint inferred;
+        model->infer(
+            [&](ov::InferRequest& infer_request) {
+                if (begin == 0 && end == images.size()) {
+                    // 1回で収まる場合は画像のリストをコピーせずに渡す
+                    preprocessor.preprocess_into(*model, images, infer_request);
+                } else {
+                    const std::vector<cv::Mat> batch(images.begin() + begin,
+                                                     images.begin() + end);
+                    preprocessor.preprocess_into(*model, batch, infer_request);
+                }
+                preprocessed = profile_now();
+            },
+            [&](ov::InferRequest& infer_request) {
+                inferred = profile_now();
+                postprocessor.postprocess_batch(*model, infer_request, outputs.data() + begin);
+            });
+
+        // バッチ1回を1タスクとして記録する
+        profiler.record(started, preprocessed, inferred, profile_now(), end - begin);
+    }
+}
+
+template <typename Preprocess, typename Postprocess>
+std::future<typename OpenVINOTask<Preprocess, Postprocess>::Output>
+OpenVINOTask<Preprocess, Postprocess>::task_async(const cv::Mat& image) {
+    auto promise = std::make_shared<std::promise<Output>>();
+    std::future<Output> future = promise->get_future();
+    task_async(image, [promise](Output output, std::exception_ptr exception) {
+        if (exception) {
+            promise->set_exception(exception);
+        } else {
+            promise->set_value(std::move(output));
+        }
+    });
+    return future;
 }
 
-PoseDetector::PoseDetector(const std::string model_path) : OpenVINOTask(model_path) {}
+template <typename Preprocess, typename Postprocess>
+void OpenVINOTask<Preprocess, Postprocess>::task_async(const cv::Mat& image,
+                                                       TaskCallback callback) {
+    const ProfileTimePoint started = profile_now();
+    // 前処理の完了時刻はコールバックの作成後に決まるため、コールバックと共有する
+    auto preprocessed = std::make_shared<ProfileTimePoint>();
+
+    // テンソルが画像のメモリを参照する場合に備え、推論完了まで画像を保持する
+    model->infer_async(
+        [this, &image, preprocessed](ov::InferRequest& infer_request) {
+            preprocessor.preprocess_into(*model, image, infer_request);
+            *preprocessed = profile_now();
+        },
+        [this, callback, image, started, preprocessed](ov::InferRequest& infer_request,
+                                                       std::exception_ptr exception) {
+            if (exception) {
+                callback(Output(), exception);
+                return;
+            }
 
-std::vector<KeyPoint> PoseDetector::task(const cv::Mat& image) {
-    ov::Tensor input_tensor = preprocessor.preprocess(*model, image);
-    model->infer(input_tensor);
-    std::vector<KeyPoint> bboxes = postprocessor.postprocess(*model);
-    return bboxes;
+            const ProfileTimePoint inferred = profile_now();
+            Output output;
+            try {
+                output = postprocessor.postprocess(*model, infer_request);
+            } catch (...) {
+                callback(Output(), std::current_exception());
+                return;
+            }
+            profiler.record(started, *preprocessed, inferred, profile_now());
+            callback(std::move(output), nullptr);
+        });
 }
+
+template <typename Preprocess>
+BasicDetectorBBox5Label1<Preprocess>::BasicDetectorBBox5Label1(const std::string model_path,
+                                                               const ModelConfig& config)
+    : OpenVINOTask<Preprocess, BBox5Label1>(model_path, config) {}
+
+template <typename Preprocess>
+BasicDetectorBBox7<Preprocess>::BasicDetectorBBox7(const std::string model_path,
+                                                   const ModelConfig& config)
+    : OpenVINOTask<Preprocess, BBox7>(model_path, config) {}
+
+template <typename Preprocess>
+BasicPoseDetector<Preprocess>::BasicPoseDetector(const std::string model_path,
+                                                 const ModelConfig& config)
+    : OpenVINOTask<Preprocess, KeyPoints>(model_path, config) {}
+
+template <typename Preprocess>
+BasicMultiPoseDetector<Preprocess>::BasicMultiPoseDetector(const std::string model_path,
+                                                           const ModelConfig& config)
+    : OpenVINOTask<Preprocess, OpenPoseDecoder>(model_path, config) {}
+
+template class OpenVINOTask<FloatCHW, BBox5Label1>;
+template class OpenVINOTask<FloatCHW, BBox7>;
+template class OpenVINOTask<FloatCHW, KeyPoints>;
+template class OpenVINOTask<FloatCHW, OpenPoseDecoder>;
+template class OpenVINOTask<U8NHWCEmbedded, BBox5Label1>;
+template class OpenVINOTask<U8NHWCEmbedded, BBox7>;
+template class OpenVINOTask<U8NHWCEmbedded, KeyPoints>;
+template class OpenVINOTask<U8NHWCEmbedded, OpenPoseDecoder>;
+
+template class BasicDetectorBBox5Label1<FloatCHW>;
+template class BasicDetectorBBox7<FloatCHW>;
+template class BasicPoseDetector<FloatCHW>;
+template class BasicMultiPoseDetector<FloatCHW>;
+template class BasicDetectorBBox5Label1<U8NHWCEmbedded>;
+template class BasicDetectorBBox7<U8NHWCEmbedded>;
+template class BasicPoseDetector<U8NHWCEmbedded>;
+template class BasicMultiPoseDetector<U8NHWCEmbedded>;
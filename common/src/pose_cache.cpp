@@ -0,0 +1,94 @@
+#include "pose_cache.hpp"
+
+#include <cmath>
+#include <stdexcept>
+
+PoseCache::PoseCache(const PoseCacheConfig& config) : config(config) {
+    if (config.thumbnail_size <= 0) {
+        throw std::invalid_argument("thumbnail_size must be greater than 0");
+    }
+}
+
+void PoseCache::make_thumbnail(const cv::Mat& crop, cv::Mat& thumbnail) {
+    cv::resize(crop, resized_crop, cv::Size(config.thumbnail_size, config.thumbnail_size), 0, 0,
+               cv::INTER_AREA);
+    if (resized_crop.channels() == 1) {
+        resized_crop.copyTo(thumbnail);
+    } else {
+        cv::cvtColor(resized_crop, thumbnail, cv::COLOR_BGR2GRAY);
+    }
+}
+
+void PoseCache::begin_frame(void) {
+    frame++;
+    for (auto it = entries.begin(); it != entries.end();) {
+        if (frame - it->second.seen_frame > config.max_unseen) {
+            it = entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+bool PoseCache::find(const std::uint64_t track_id, const cv::Mat& image, const cv::Rect& rect,
+                     KeyPointList& keypoints) {
+    Entry& entry = entries[track_id];
+    entry.seen_frame = frame;
+    if (config.max_age == 0) {
+        num_misses++;
+        return false;
+    }
+
+    // 推論したときの枠と比べる（前フレームと比べると少しずつの移動が積み重なるため）
+    bool reusable = entry.valid && frame - entry.inferred_frame < config.max_age &&
+                    entry.rect.width > 0 && entry.rect.height > 0;
+    if (reusable) {
+        const float width = static_cast<float>(entry.rect.width);
+        const float height = static_cast<float>(entry.rect.height);
+        const float shift_x = std::abs((rect.x + rect.width / 2.0f) -
+                                       (entry.rect.x + entry.rect.width / 2.0f)) / width;
+        const float shift_y = std::abs((rect.y + rect.height / 2.0f) -
+                                       (entry.rect.y + entry.rect.height / 2.0f)) / height;
+        const float scale_x = std::abs(rect.width / width - 1.0f);
+        const float scale_y = std::abs(rect.height / height - 1.0f);
+        reusable = shift_x <= config.max_shift && shift_y <= config.max_shift &&
+                   scale_x <= config.max_scale_change && scale_y <= config.max_scale_change;
+    }
+
+    // 枠がほとんど動いていなくても、姿勢が変わっていれば推論する
+    make_thumbnail(image(rect), entry.candidate);
+    if (reusable) {
+        const double difference = cv::norm(entry.candidate, entry.thumbnail, cv::NORM_L1) /
+                                  static_cast<double>(entry.candidate.total());
+        reusable = difference <= config.max_crop_difference;
+    }
+
+    if (reusable) {
+        keypoints = entry.keypoints;
+        num_hits++;
+    } else {
+        num_misses++;
+    }
+    return reusable;
+}
+
+void PoseCache::store(const std::uint64_t track_id, const cv::Rect& rect,
+                      const KeyPointList& keypoints) {
+    auto it = entries.find(track_id);
+    if (it == entries.end() || it->second.seen_frame != frame) {
+        throw std::logic_error("PoseCache::store() must follow find() in the same frame");
+    }
+    Entry& entry = it->second;
+    entry.rect = rect;
+    std::swap(entry.thumbnail, entry.candidate);
+    entry.keypoints = keypoints;
+    entry.valid = true;
+    entry.inferred_frame = frame;
+}
+
+void PoseCache::clear(void) { entries.clear(); }
+
+double PoseCache::get_hit_ratio(void) const {
+    const std::uint64_t num_lookups = num_hits + num_misses;
+    return num_lookups > 0 ? static_cast<double>(num_hits) / num_lookups : 0.0;
+}
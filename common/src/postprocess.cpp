@@ -1,11 +1,141 @@
 #include "postprocess.hpp"
 
-std::vector<BBox> BBox5Label1::postprocess(OpenVINOModel& model) {
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+float DetectionFilter::get_threshold(const int label) const {
+    if (0 <= label && static_cast<std::size_t>(label) < class_thresholds.size()) {
+        return class_thresholds[label];
+    }
+    return confidence_threshold;
+}
+
+bool DetectionFilter::needs_suppression(void) const {
+    return nms_threshold < 1.0f || top_k_per_class > 0;
+}
+
+void suppress_detections(BBoxList& bboxes, const DetectionFilter& filter) {
+    bboxes.sort_by_confidence();
+    const std::size_t num_bboxes = bboxes.size();
+    const std::size_t max_detections = filter.max_detections > 0 ? filter.max_detections
+                                                                 : num_bboxes;
+    const bool nms = filter.nms_threshold < 1.0f;
+
+    // 残した検知枠の座標を成分ごとの配列に持ち、IoUの計算をベクトル化できるようにする
+    thread_local std::vector<float> kept_x1, kept_y1, kept_x2, kept_y2, kept_areas;
+    thread_local std::vector<std::size_t> kept_indices, label_counts;
+    kept_x1.clear();
+    kept_y1.clear();
+    kept_x2.clear();
+    kept_y2.clear();
+    kept_areas.clear();
+    kept_indices.clear();
+    label_counts.clear();
+
+    const std::vector<cv::Rect2f>& rects = bboxes.get_rects();
+    const std::vector<int>& labels = bboxes.get_labels();
+    for (std::size_t i = 0; i < num_bboxes && kept_indices.size() < max_detections; i++) {
+        const cv::Rect2f& rect = rects[i];
+        const int label = labels[i];
+
+        // ラベルごとの上限
+        if (filter.top_k_per_class > 0 && label >= 0) {
+            if (label_counts.size() <= static_cast<std::size_t>(label)) {
+                label_counts.resize(label + 1, 0);
+            }
+            if (label_counts[label] >= filter.top_k_per_class) {
+                continue;
+            }
+        }
+
+        // 正規化座標は0〜1のため、ラベルごとに2ずつずらせば異なるラベルの検知枠は重ならない
+        const float offset = filter.class_aware_nms ? 2.0f * label : 0.0f;
+        const float x1 = rect.x + offset;
+        const float y1 = rect.y;
+        const float x2 = rect.x + rect.width + offset;
+        const float y2 = rect.y + rect.height;
+        const float area = rect.width * rect.height;
+
+        if (nms) {
+            // IoU > 閾値 を 交差面積 > 閾値 * 和集合の面積 として割り算と分岐をなくす
+            const float threshold = filter.nms_threshold;
+            const std::size_t num_kept = kept_indices.size();
+            const float* kx1 = kept_x1.data();
+            const float* ky1 = kept_y1.data();
+            const float* kx2 = kept_x2.data();
+            const float* ky2 = kept_y2.data();
+            const float* kareas = kept_areas.data();
+            int suppressed = 0;
+            for (std::size_t k = 0; k < num_kept; k++) {
+                const float w = std::max(0.0f, std::min(x2, kx2[k]) - std::max(x1, kx1[k]));
+                const float h = std::max(0.0f, std::min(y2, ky2[k]) - std::max(y1, ky1[k]));
+                const float inter = w * h;
+                suppressed |= inter > threshold * (area + kareas[k] - inter);
+            }
+            if (suppressed) {
+                continue;
+            }
+        }
+
+        kept_x1.push_back(x1);
+        kept_y1.push_back(y1);
+        kept_x2.push_back(x2);
+        kept_y2.push_back(y2);
+        kept_areas.push_back(area);
+        kept_indices.push_back(i);
+        if (filter.top_k_per_class > 0 && label >= 0) {
+            label_counts[label]++;
+        }
+    }
+
+    bboxes.retain(kept_indices);
+}
+
+BBox5Label1::BBox5Label1(void) { filter.max_detections = DEFAULT_MAX_DETECTION; }
+
+void BBox5Label1::set_filter(const DetectionFilter& filter) { this->filter = filter; }
+
+const DetectionFilter& BBox5Label1::get_filter(void) const { return filter; }
+
+std::vector<BBox> BBox5Label1::postprocess(const OpenVINOModel& model,
+                                          ov::InferRequest& infer_request) {
+    BBoxList bboxes;
+    postprocess(model, infer_request, bboxes);
+    return bboxes.to_vector();
+}
+
+std::vector<BBox> BBox5Label1::postprocess(const ov::Shape& input_shape,
+                                          const ov::Tensor& boxes_tensor,
+                                          const ov::Tensor& labels_tensor) {
+    BBoxList bboxes;
+    postprocess(input_shape, boxes_tensor, labels_tensor, bboxes);
+    return bboxes.to_vector();
+}
+
+void BBox5Label1::postprocess(const OpenVINOModel& model, ov::InferRequest& infer_request,
+                              BBoxList& bboxes) {
+    // 高さ・幅が動的なモデルは、実際に入力したテンソル[N, C, H, W]のサイズで座標を正規化する
+    const ov::Shape input_shape = model.has_dynamic_input_size()
+                                      ? infer_request.get_input_tensor().get_shape()
+                                      : model.get_input_shape();
+
     // 結果の取得
-    const ov::Shape input_shape = model.get_input_shape();
-    const ov::Tensor& boxes_tensor = model.get_output_tensor(0);
-    const ov::Tensor& labels_tensor = model.get_output_tensor(1);
+    postprocess(input_shape, infer_request.get_output_tensor(0),
+                infer_request.get_output_tensor(1), bboxes);
+}
 
+void BBox5Label1::postprocess_batch(const OpenVINOModel& model, ov::InferRequest& infer_request,
+                                    BBoxList* bboxes_list) {
+    if (infer_request.get_input_tensor().get_shape()[0] != 1) {
+        throw std::invalid_argument(
+            "BBox5Label1 outputs have no image index, so only batch size 1 is supported");
+    }
+    postprocess(model, infer_request, bboxes_list[0]);
+}
+
+void BBox5Label1::postprocess(const ov::Shape& input_shape, const ov::Tensor& boxes_tensor,
+                              const ov::Tensor& labels_tensor, BBoxList& bboxes) {
     // プリミティブ型の配列に変換
     const float* boxes = boxes_tensor.data<const float>();
     const std::int64_t* labels = labels_tensor.data<const std::int64_t>();
@@ -15,9 +145,15 @@ std::vector<BBox> BBox5Label1::postprocess(OpenVINOModel& model) {
     const std::size_t num_boxes = output_shape[0];
     const std::size_t num_data_each_box = output_shape[1];
 
+    // 並べ替えて絞り込まない場合は、出力テンソルの順に上限まで取得する
+    const bool suppress = filter.needs_suppression();
+    const std::size_t max_detections =
+        !suppress && filter.max_detections > 0 ? filter.max_detections : num_boxes;
+
     // 推論結果を基に、検出された矩形領域を取得
-    std::vector<BBox> bboxes;
-    for (int idx = 0, size = std::min(num_boxes, MAX_DETECTION); idx < size; idx++) {
+    bboxes.clear();
+    bboxes.reserve(std::min(num_boxes, max_detections));
+    for (std::size_t idx = 0; idx < num_boxes && bboxes.size() < max_detections; idx++) {
         const int label = labels[idx];                                // ラベルの取得
         const float confidence = boxes[idx * num_data_each_box + 4];  // 確信度の取得
 
@@ -26,24 +162,63 @@ std::vector<BBox> BBox5Label1::postprocess(OpenVINOModel& model) {
             break;
         }
 
+        // 閾値未満の検知枠は座標を読まずに捨てる
+        if (confidence < filter.get_threshold(label)) {
+            continue;
+        }
+
         // 検出されたバウンディングボックスの座標を取得
         const float xmin = static_cast<float>(boxes[idx * num_data_each_box + 0] / input_shape[3]);
         const float ymin = static_cast<float>(boxes[idx * num_data_each_box + 1] / input_shape[2]);
         const float xmax = static_cast<float>(boxes[idx * num_data_each_box + 2] / input_shape[3]);
         const float ymax = static_cast<float>(boxes[idx * num_data_each_box + 3] / input_shape[2]);
 
-        bboxes.emplace_back(cv::Rect2f(cv::Point2f(xmin, ymin), cv::Point2f(xmax, ymax)), label,
-                            confidence);
+        bboxes.push_back(cv::Rect2f(cv::Point2f(xmin, ymin), cv::Point2f(xmax, ymax)), label,
+                         confidence);
+    }
+
+    if (suppress) {
+        suppress_detections(bboxes, filter);
     }
+}
+
+BBox7::BBox7(void) { filter.max_detections = DEFAULT_MAX_DETECTION; }
+
+void BBox7::set_filter(const DetectionFilter& filter) { this->filter = filter; }
+
+const DetectionFilter& BBox7::get_filter(void) const { return filter; }
+
+std::vector<BBox> BBox7::postprocess(const OpenVINOModel& model,
+                                    ov::InferRequest& infer_request) {
+    // 結果の取得
+    return postprocess(infer_request.get_output_tensor(0));
+}
 
-    return bboxes;
+std::vector<BBox> BBox7::postprocess(const ov::Tensor& boxes_tensor) {
+    BBoxList bboxes;
+    postprocess(boxes_tensor, bboxes);
+    return bboxes.to_vector();
 }
 
-std::vector<BBox> BBox7::postprocess(OpenVINOModel& model) {
+void BBox7::postprocess(const OpenVINOModel& model, ov::InferRequest& infer_request,
+                        BBoxList& bboxes) {
     // 結果の取得
-    const ov::Shape input_shape = model.get_input_shape();
-    const ov::Tensor& boxes_tensor = model.get_output_tensor(0);
+    postprocess(infer_request.get_output_tensor(0), bboxes);
+}
+
+void BBox7::postprocess(const ov::Tensor& boxes_tensor, BBoxList& bboxes) {
+    postprocess_batch(boxes_tensor, 1, &bboxes);
+}
+
+void BBox7::postprocess_batch(const OpenVINOModel& model, ov::InferRequest& infer_request,
+                              BBoxList* bboxes_list) {
+    // 結果の取得
+    postprocess_batch(infer_request.get_output_tensor(0),
+                      infer_request.get_input_tensor().get_shape()[0], bboxes_list);
+}
 
+void BBox7::postprocess_batch(const ov::Tensor& boxes_tensor, const std::size_t batch_size,
+                              BBoxList* bboxes_list) {
     // プリミティブ型の配列に変換
     const float* boxes = boxes_tensor.data<const float>();
 
@@ -52,9 +227,18 @@ std::vector<BBox> BBox7::postprocess(OpenVINOModel& model) {
     const std::size_t num_boxes = output_shape[2];
     const std::size_t num_data_each_box = output_shape[3];
 
-    // 推論結果を基に、検出された矩形領域を取得
-    std::vector<BBox> bboxes;
-    for (int idx = 0, size = std::min(num_boxes, MAX_DETECTION); idx < size; idx++) {
+    // 並べ替えて絞り込まない場合は、出力テンソルの順に上限まで取得する
+    const bool suppress = filter.needs_suppression();
+    const std::size_t max_detections =
+        !suppress && filter.max_detections > 0 ? filter.max_detections : num_boxes;
+
+    for (std::size_t n = 0; n < batch_size; n++) {
+        bboxes_list[n].clear();
+        bboxes_list[n].reserve(std::min(num_boxes, max_detections));
+    }
+
+    // 推論結果を基に、検出された矩形領域を画像IDごとに取得
+    for (std::size_t idx = 0; idx < num_boxes; idx++) {
         const int image_id = boxes[idx * num_data_each_box + 0];      // 画像IDの取得
         const int label = boxes[idx * num_data_each_box + 1];         // ラベルの取得
         const float confidence = boxes[idx * num_data_each_box + 2];  // 確信度の取得
@@ -64,38 +248,204 @@ std::vector<BBox> BBox7::postprocess(OpenVINOModel& model) {
             break;
         }
 
+        // バッチ外の画像IDと、上限を超えた検知枠は無視
+        if (static_cast<std::size_t>(image_id) >= batch_size ||
+            bboxes_list[image_id].size() >= max_detections) {
+            continue;
+        }
+
+        // 閾値未満の検知枠は座標を読まずに捨てる
+        if (confidence < filter.get_threshold(label)) {
+            continue;
+        }
+
         // 検出されたバウンディングボックスの座標を取得
         const float xmin = static_cast<float>(boxes[idx * num_data_each_box + 3]);
         const float ymin = static_cast<float>(boxes[idx * num_data_each_box + 4]);
         const float xmax = static_cast<float>(boxes[idx * num_data_each_box + 5]);
         const float ymax = static_cast<float>(boxes[idx * num_data_each_box + 6]);
 
-        bboxes.emplace_back(cv::Rect2f(cv::Point2f(xmin, ymin), cv::Point2f(xmax, ymax)), label,
-                            confidence);
+        bboxes_list[image_id].push_back(
+            cv::Rect2f(cv::Point2f(xmin, ymin), cv::Point2f(xmax, ymax)), label, confidence);
+    }
+
+    if (suppress) {
+        for (std::size_t n = 0; n < batch_size; n++) {
+            suppress_detections(bboxes_list[n], filter);
+        }
+    }
+}
+
+namespace {
+
+/**
+ * @brief 最大値の位置をサブピクセル精度へ補正する
+ *
+ * @param heatmap 1チャンネル分のヒートマップ[H, W]
+ * @param width 幅W
+ * @param height 高さH
+ * @param x 最大値のx座標（補正後の値で上書きする）
+ * @param y 最大値のy座標（補正後の値で上書きする）
+ * @param refine 補正の方法
+ */
+void refine_peak(const float* heatmap, const std::size_t width, const std::size_t height,
+                 float& x, float& y, const KeyPointRefine refine) {
+    const std::size_t px = static_cast<std::size_t>(x);
+    const std::size_t py = static_cast<std::size_t>(y);
+    auto at = [&](const std::size_t ix, const std::size_t iy) { return heatmap[iy * width + ix]; };
+
+    if (refine == KeyPointRefine::QuarterOffset) {
+        // 端の画素は片側の隣接画素がないため、その方向には補正しない
+        if (0 < px && px + 1 < width) {
+            const float diff = at(px + 1, py) - at(px - 1, py);
+            x += diff > 0.0f ? 0.25f : (diff < 0.0f ? -0.25f : 0.0f);
+        }
+        if (0 < py && py + 1 < height) {
+            const float diff = at(px, py + 1) - at(px, py - 1);
+            y += diff > 0.0f ? 0.25f : (diff < 0.0f ? -0.25f : 0.0f);
+        }
+        return;
+    }
+
+    if (refine == KeyPointRefine::Taylor) {
+        if (px == 0 || py == 0 || px + 1 >= width || py + 1 >= height) {
+            return;
+        }
+        // 勾配とヘッセ行列を中心差分で求め、極値までの変位 -H^-1 * g を計算する
+        const float center = at(px, py);
+        const float dx = 0.5f * (at(px + 1, py) - at(px - 1, py));
+        const float dy = 0.5f * (at(px, py + 1) - at(px, py - 1));
+        const float dxx = at(px + 1, py) - 2.0f * center + at(px - 1, py);
+        const float dyy = at(px, py + 1) - 2.0f * center + at(px, py - 1);
+        const float dxy = 0.25f * (at(px + 1, py + 1) - at(px + 1, py - 1) -
+                                   at(px - 1, py + 1) + at(px - 1, py - 1));
+        const float det = dxx * dyy - dxy * dxy;
+        // 極大（ヘッセ行列が負定値）でなければ補正しない
+        if (dxx >= 0.0f || det <= 1e-12f) {
+            return;
+        }
+        const float offset_x = -(dyy * dx - dxy * dy) / det;
+        const float offset_y = -(dxx * dy - dxy * dx) / det;
+        // 最大値の画素から外れる補正は誤差とみなす
+        if (std::abs(offset_x) <= 0.5f && std::abs(offset_y) <= 0.5f) {
+            x += offset_x;
+            y += offset_y;
+        }
+    }
+}
+
+}  // namespace
+
+void KeyPoints::decode(const float* heatmaps, const ov::Shape& output_shape,
+                       const KeyPointRefine refine, KeyPointList& keypoints) {
+    const std::size_t num_keypoints = output_shape[1];
+    const std::size_t height = output_shape[2];
+    const std::size_t width = output_shape[3];
+    const std::size_t plane_size = height * width;
+
+    // 全キーポイントのヒートマップの最大値を1回の走査で求める
+    // （作業領域はスレッドごとに使い回し、呼び出しのたびに確保しない）
+    thread_local std::vector<std::size_t> max_indices;
+    thread_local std::vector<float> max_values;
+    max_indices.resize(num_keypoints);
+    max_values.resize(num_keypoints);
+    argmax_channels(heatmaps, num_keypoints, plane_size, max_indices.data(), max_values.data());
+
+    // キーポイントを検出
+    keypoints.resize(num_keypoints);
+    for (std::size_t i = 0; i < num_keypoints; i++) {
+        float x = static_cast<float>(max_indices[i] % width);
+        float y = static_cast<float>(max_indices[i] / width);
+        if (refine != KeyPointRefine::None) {
+            refine_peak(heatmaps + i * plane_size, width, height, x, y, refine);
+        }
+        keypoints.set(i, x / width, y / height, max_values[i]);
+    }
+}
+
+void KeyPoints::set_refine(const KeyPointRefine refine) { this->refine = refine; }
+
+void KeyPoints::set_parallel_batch(const bool parallel_batch) {
+    this->parallel_batch = parallel_batch;
+}
+
+std::vector<KeyPoint> KeyPoints::postprocess(const OpenVINOModel& model,
+                                             ov::InferRequest& infer_request) {
+    // 結果を取得
+    return postprocess(infer_request.get_output_tensor(0));
+}
+
+std::vector<KeyPoint> KeyPoints::postprocess(const ov::Tensor& heatmaps_tensor) {
+    KeyPointList keypoints;
+    postprocess(heatmaps_tensor, keypoints);
+    return keypoints.to_vector();
+}
+
+std::vector<std::vector<KeyPoint>> KeyPoints::postprocess_batch(const OpenVINOModel& model,
+                                                                ov::InferRequest& infer_request) {
+    // 結果を取得
+    return postprocess_batch(infer_request.get_output_tensor(0));
+}
+
+std::vector<std::vector<KeyPoint>> KeyPoints::postprocess_batch(const ov::Tensor& heatmaps_tensor) {
+    std::vector<KeyPointList> keypoints_lists;
+    postprocess_batch(heatmaps_tensor, keypoints_lists);
+
+    std::vector<std::vector<KeyPoint>> keypoints_list;
+    keypoints_list.reserve(keypoints_lists.size());
+    for (const KeyPointList& keypoints : keypoints_lists) {
+        keypoints_list.push_back(keypoints.to_vector());
     }
+    return keypoints_list;
+}
+
+void KeyPoints::postprocess(const OpenVINOModel& model, ov::InferRequest& infer_request,
+                            KeyPointList& keypoints) {
+    // 結果を取得
+    postprocess(infer_request.get_output_tensor(0), keypoints);
+}
+
+void KeyPoints::postprocess(const ov::Tensor& heatmaps_tensor, KeyPointList& keypoints) {
+    const float* heatmaps = reinterpret_cast<float*>(heatmaps_tensor.data());
+    const ov::Shape output_shape = heatmaps_tensor.get_shape();
+
+    decode(heatmaps, output_shape, refine, keypoints);
+}
+
+void KeyPoints::postprocess_batch(const OpenVINOModel& model, ov::InferRequest& infer_request,
+                                  std::vector<KeyPointList>& keypoints_list) {
+    // 結果を取得
+    postprocess_batch(infer_request.get_output_tensor(0), keypoints_list);
+}
 
-    return bboxes;
+void KeyPoints::postprocess_batch(const ov::Tensor& heatmaps_tensor,
+                                  std::vector<KeyPointList>& keypoints_list) {
+    keypoints_list.resize(heatmaps_tensor.get_shape()[0]);
+    postprocess_batch(heatmaps_tensor, keypoints_list.data());
 }
 
-std::vector<KeyPoint> KeyPoints::postprocess(OpenVINOModel& model) {
+void KeyPoints::postprocess_batch(const OpenVINOModel& model, ov::InferRequest& infer_request,
+                                  KeyPointList* keypoints_list) {
     // 結果を取得
-    const ov::Tensor& heatmaps_tensor = model.get_output_tensor(0);
+    postprocess_batch(infer_request.get_output_tensor(0), keypoints_list);
+}
+
+void KeyPoints::postprocess_batch(const ov::Tensor& heatmaps_tensor,
+                                  KeyPointList* keypoints_list) {
     const float* heatmaps = reinterpret_cast<float*>(heatmaps_tensor.data());
     const ov::Shape output_shape = heatmaps_tensor.get_shape();
+    const std::size_t heatmaps_size = output_shape[1] * output_shape[2] * output_shape[3];
 
-    // キーポイントを検出
-    std::vector<KeyPoint> keypoints;
-    for (int i = 0; i < output_shape[1]; i++) {
-        const int max_index =
-            std::max_element(heatmaps + i * output_shape[2] * output_shape[3],
-                             heatmaps + (i + 1) * output_shape[2] * output_shape[3]) -
-            (heatmaps + i * output_shape[2] * output_shape[3]);
-        const float x = (float)(max_index % output_shape[2]) / output_shape[3];
-        const float y = (float)(max_index / output_shape[2]) / output_shape[2];
-        const float confidence = heatmaps[max_index + i * output_shape[2] * output_shape[3]];
-
-        keypoints.emplace_back(x, y, confidence);
+    // バッチ要素ごとにキーポイントを検出（要素ごとに独立なので複数スレッドで分担できる）
+    const int batch_size = static_cast<int>(output_shape[0]);
+    auto decode_range = [&](const cv::Range& range) {
+        for (int n = range.start; n < range.end; n++) {
+            decode(heatmaps + n * heatmaps_size, output_shape, refine, keypoints_list[n]);
+        }
+    };
+    if (parallel_batch && batch_size > 1) {
+        cv::parallel_for_(cv::Range(0, batch_size), decode_range);
+    } else {
+        decode_range(cv::Range(0, batch_size));
     }
-
-    return keypoints;
 }
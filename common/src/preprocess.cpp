@@ -1,20 +1,238 @@
 #include "preprocess.hpp"
 
-ov::Tensor FloatCHW::preprocess(const OpenVINOModel& model, const cv::Mat& image) {
-    cv::Mat input_image;
-    const ov::Shape input_shape = model.get_input_shape();
+#include <algorithm>
+
+/**
+ * @brief 画像をモデルの入力サイズへ変換し、float型のCHW配列として書き込む
+ *
+ * @param image 入力画像
+ * @param input_shape モデルの入力サイズ
+ * @param chw_data 書き込み先（C * H * W要素）
+ */
+static void write_float_chw(const cv::Mat& image, const ov::Shape& input_shape, float* chw_data) {
+    const int channels = static_cast<int>(input_shape[1]);
+    const int height = static_cast<int>(input_shape[2]);
+    const int width = static_cast<int>(input_shape[3]);
+
+    // resize（リサイズ先はスレッドごとに使い回し、サイズが同じならメモリを確保しない）
+    thread_local cv::Mat resized_image;
+    cv::Mat input_image = image;
+    if (image.cols != width || image.rows != height) {
+        cv::resize(image, resized_image, cv::Size(width, height));
+        input_image = resized_image;
+    }
+
+    // int -> float, HWC -> CHW（u8の3チャンネル画像は1パスで変換する）
+    if (input_image.type() == CV_8UC3) {
+        convert_hwc2chw(input_image, chw_data);
+        return;
+    }
 
-    // resize
-    cv::resize(image, input_image, cv::Size(input_shape[3], input_shape[2]));
     // int -> float
-    input_image.convertTo(input_image, CV_32FC3);
-    // HWC -> CHW
-    input_image = convert_hwc2chw(input_image);
-
-    // Mat -> Tensor
-    allocated_image = input_image;
-    ov::Tensor input_tensor(ov::element::f32, {1, input_shape[1], input_shape[2], input_shape[3]},
-                            allocated_image.data);
+    input_image.convertTo(input_image, CV_32FC(channels));
+
+    // HWC -> CHW（書き込み先のメモリを各チャンネルの出力として直接分離する）
+    std::vector<cv::Mat> chw_channels;
+    for (int c = 0; c < channels; c++) {
+        chw_channels.emplace_back(height, width, CV_32FC1, chw_data + c * height * width);
+    }
+    cv::split(input_image, chw_channels);
+}
+
+/**
+ * @brief 画像を入力するサイズ[1, C, H, W]を求める
+ *
+ * 高さ・幅が動的なモデルでは画像の解像度のまま入力する。上限を超える場合は縦横比を保って縮小する
+ *
+ * @param model モデル
+ * @param image 入力画像
+ * @return ov::Shape 入力サイズ
+ */
+static ov::Shape get_input_shape(const OpenVINOModel& model, const cv::Mat& image) {
+    ov::Shape input_shape = model.get_input_shape();
+    if (!model.has_dynamic_input_size()) {
+        return input_shape;
+    }
+
+    const ov::PartialShape partial_shape = model.get_input_partial_shape();
+    const ov::Dimension& height_dim = partial_shape[2];
+    const ov::Dimension& width_dim = partial_shape[3];
+    double ratio = 1.0;
+    if (height_dim.is_dynamic() && height_dim.get_max_length() > 0) {
+        ratio = std::min(ratio, static_cast<double>(height_dim.get_max_length()) / image.rows);
+    }
+    if (width_dim.is_dynamic() && width_dim.get_max_length() > 0) {
+        ratio = std::min(ratio, static_cast<double>(width_dim.get_max_length()) / image.cols);
+    }
+    if (height_dim.is_dynamic()) {
+        input_shape[2] = std::max<std::size_t>(1, static_cast<std::size_t>(image.rows * ratio));
+    }
+    if (width_dim.is_dynamic()) {
+        input_shape[3] = std::max<std::size_t>(1, static_cast<std::size_t>(image.cols * ratio));
+    }
+    return input_shape;
+}
+
+ov::Tensor FloatCHW::preprocess(const OpenVINOModel& model, const cv::Mat& image) {
+    return preprocess(get_input_shape(model, image), image);
+}
+
+ov::Tensor FloatCHW::preprocess(const ov::Shape& input_shape, const cv::Mat& image) {
+    ov::Tensor input_tensor(ov::element::f32, {1, input_shape[1], input_shape[2], input_shape[3]});
+    write_float_chw(image, input_shape, input_tensor.data<float>());
+
+    return input_tensor;
+}
+
+ov::Tensor FloatCHW::preprocess(const OpenVINOModel& model, const std::vector<cv::Mat>& images) {
+    if (images.empty() || images.size() > model.get_max_batch_size()) {
+        throw std::invalid_argument("Batch size must be between 1 and " +
+                                    std::to_string(model.get_max_batch_size()));
+    }
+
+    // 高さ・幅が動的なモデルでは、バッチ内の画像を先頭の画像から求めたサイズへ揃える
+    const ov::Shape input_shape = get_input_shape(model, images.front());
+    const std::size_t image_size = input_shape[1] * input_shape[2] * input_shape[3];
+    ov::Tensor input_tensor(ov::element::f32,
+                            {images.size(), input_shape[1], input_shape[2], input_shape[3]});
+    float* input_data = input_tensor.data<float>();
+    for (std::size_t n = 0; n < images.size(); n++) {
+        write_float_chw(images[n], input_shape, input_data + n * image_size);
+    }
+
+    return input_tensor;
+}
+
+/**
+ * @brief 推論リクエストが保持する入力テンソルを、指定したサイズで取得する
+ *
+ * @param infer_request 推論リクエスト
+ * @param input_shape 入力サイズ
+ * @return ov::Tensor 入力テンソル（推論リクエストとメモリを共有する）
+ */
+static ov::Tensor get_request_input_tensor(ov::InferRequest& infer_request,
+                                           const ov::Shape& input_shape) {
+    ov::Tensor input_tensor = infer_request.get_input_tensor();
+    if (input_tensor.get_element_type() != ov::element::f32) {
+        throw std::invalid_argument("FloatCHW expects a model with an f32 input");
+    }
+    // 静的なモデルでは常に同じサイズのため、確保済みのメモリをそのまま使う
+    if (input_tensor.get_shape() != input_shape) {
+        input_tensor.set_shape(input_shape);
+    }
+    return input_tensor;
+}
+
+void FloatCHW::preprocess_into(const OpenVINOModel& model, const cv::Mat& image,
+                               ov::InferRequest& infer_request) {
+    ov::Tensor input_tensor =
+        get_request_input_tensor(infer_request, get_input_shape(model, image));
+    preprocess_into(image, input_tensor);
+}
+
+void FloatCHW::preprocess_into(const OpenVINOModel& model, const std::vector<cv::Mat>& images,
+                               ov::InferRequest& infer_request) {
+    if (images.empty() || images.size() > model.get_max_batch_size()) {
+        throw std::invalid_argument("Batch size must be between 1 and " +
+                                    std::to_string(model.get_max_batch_size()));
+    }
+
+    ov::Shape input_shape = get_input_shape(model, images.front());
+    input_shape[0] = images.size();
+    ov::Tensor input_tensor = get_request_input_tensor(infer_request, input_shape);
+    preprocess_into(images, input_tensor);
+}
+
+void FloatCHW::preprocess_into(const std::vector<cv::Mat>& images, ov::Tensor& input_tensor) {
+    const ov::Shape input_shape = input_tensor.get_shape();
+    if (input_shape.size() != 4 || input_shape[0] != images.size()) {
+        throw std::invalid_argument("Input tensor must be [N, C, H, W] with N = number of images");
+    }
+
+    const std::size_t image_size = input_shape[1] * input_shape[2] * input_shape[3];
+    float* input_data = input_tensor.data<float>();
+    for (std::size_t n = 0; n < images.size(); n++) {
+        write_float_chw(images[n], input_shape, input_data + n * image_size);
+    }
+}
+
+void FloatCHW::preprocess_into(const cv::Mat& image, ov::Tensor& input_tensor) {
+    const ov::Shape input_shape = input_tensor.get_shape();
+    if (input_shape.size() != 4 || input_shape[0] != 1) {
+        throw std::invalid_argument("Input tensor must be [1, C, H, W]");
+    }
+    write_float_chw(image, input_shape, input_tensor.data<float>());
+}
+
+void U8NHWCEmbedded::embed(ov::preprocess::PrePostProcessor& ppp) const {
+    ppp.input()
+        .tensor()
+        .set_element_type(ov::element::u8)
+        .set_layout("NHWC")
+        .set_color_format(ov::preprocess::ColorFormat::BGR)
+        .set_spatial_dynamic_shape();
+    ppp.input()
+        .preprocess()
+        .convert_element_type(ov::element::f32)
+        .resize(ov::preprocess::ResizeAlgorithm::RESIZE_LINEAR);
+    ppp.input().model().set_layout("NCHW");
+}
+
+/**
+ * @brief 画像がembed()で組み込んだ入力形式（u8型3チャンネルのBGR）であることを確認する
+ *
+ * @param image 入力画像
+ */
+static void check_u8_bgr_image(const cv::Mat& image) {
+    if (image.type() != CV_8UC3) {
+        throw std::invalid_argument("U8NHWCEmbedded expects CV_8UC3 (BGR) images");
+    }
+}
+
+ov::Tensor U8NHWCEmbedded::preprocess(const OpenVINOModel& model, const cv::Mat& image) {
+    check_u8_bgr_image(image);
+    const ov::Shape tensor_shape = {1, static_cast<std::size_t>(image.rows),
+                                    static_cast<std::size_t>(image.cols),
+                                    static_cast<std::size_t>(image.channels())};
+
+    // 連続メモリならコピーせずに渡す
+    if (image.isContinuous()) {
+        return ov::Tensor(ov::element::u8, tensor_shape, image.data);
+    }
+
+    // ROIなど連続でない画像はテンソルへ詰めてコピーする
+    ov::Tensor input_tensor(ov::element::u8, tensor_shape);
+    cv::Mat input_image(image.rows, image.cols, image.type(), input_tensor.data());
+    image.copyTo(input_image);
+
+    return input_tensor;
+}
+
+ov::Tensor U8NHWCEmbedded::preprocess(const OpenVINOModel& model,
+                                      const std::vector<cv::Mat>& images) {
+    if (images.empty() || images.size() > model.get_max_batch_size()) {
+        throw std::invalid_argument("Batch size must be between 1 and " +
+                                    std::to_string(model.get_max_batch_size()));
+    }
+
+    const cv::Mat& first = images.front();
+    for (const cv::Mat& image : images) {
+        check_u8_bgr_image(image);
+        if (image.size() != first.size() || image.type() != first.type()) {
+            throw std::invalid_argument("All images in a batch must have the same size and type");
+        }
+    }
+
+    // 画像をNHWCテンソルへ詰める
+    const std::size_t image_size = first.total() * first.elemSize();
+    ov::Tensor input_tensor(ov::element::u8, {images.size(), static_cast<std::size_t>(first.rows),
+                                              static_cast<std::size_t>(first.cols),
+                                              static_cast<std::size_t>(first.channels())});
+    std::uint8_t* input_data = input_tensor.data<std::uint8_t>();
+    for (std::size_t n = 0; n < images.size(); n++) {
+        cv::Mat input_image(first.rows, first.cols, first.type(), input_data + n * image_size);
+        images[n].copyTo(input_image);
+    }
 
     return input_tensor;
 }
@@ -1,5 +1,7 @@
 #include "result_objects.hpp"
 
+#include <algorithm>
+
 BBox::BBox(const cv::Rect2f rect, const int label, const float confidence)
     : rect(rect), label(label), confidence(confidence) {}
 
@@ -17,3 +19,158 @@ float KeyPoint::get_x(void) const { return x; }
 float KeyPoint::get_y(void) const { return y; }
 
 float KeyPoint::get_confidence(void) const { return confidence; }
+
+Pose::Pose(std::vector<KeyPoint> keypoints, const float score)
+    : keypoints(std::move(keypoints)), score(score) {}
+
+const std::vector<KeyPoint>& Pose::get_keypoints(void) const { return keypoints; }
+
+float Pose::get_score(void) const { return score; }
+
+void BBoxList::clear(void) {
+    rects.clear();
+    labels.clear();
+    confidences.clear();
+}
+
+void BBoxList::reserve(const std::size_t capacity) {
+    rects.reserve(capacity);
+    labels.reserve(capacity);
+    confidences.reserve(capacity);
+}
+
+void BBoxList::push_back(const cv::Rect2f& rect, const int label, const float confidence) {
+    rects.push_back(rect);
+    labels.push_back(label);
+    confidences.push_back(confidence);
+}
+
+std::size_t BBoxList::size(void) const { return rects.size(); }
+
+bool BBoxList::empty(void) const { return rects.empty(); }
+
+BBox BBoxList::get(const std::size_t index) const {
+    return BBox(rects[index], labels[index], confidences[index]);
+}
+
+const std::vector<cv::Rect2f>& BBoxList::get_rects(void) const { return rects; }
+
+const std::vector<int>& BBoxList::get_labels(void) const { return labels; }
+
+const std::vector<float>& BBoxList::get_confidences(void) const { return confidences; }
+
+void BBoxList::filter(const float confidence_thr) {
+    // 残す要素を前へ詰める
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < rects.size(); i++) {
+        if (confidences[i] < confidence_thr) {
+            continue;
+        }
+        rects[kept] = rects[i];
+        labels[kept] = labels[i];
+        confidences[kept] = confidences[i];
+        kept++;
+    }
+    rects.resize(kept);
+    labels.resize(kept);
+    confidences.resize(kept);
+}
+
+void BBoxList::retain(const std::vector<std::size_t>& indices) {
+    // 添字は昇順のため、前から詰めても未処理の要素を上書きしない
+    for (std::size_t i = 0; i < indices.size(); i++) {
+        rects[i] = rects[indices[i]];
+        labels[i] = labels[indices[i]];
+        confidences[i] = confidences[indices[i]];
+    }
+    rects.resize(indices.size());
+    labels.resize(indices.size());
+    confidences.resize(indices.size());
+}
+
+void BBoxList::sort_by_confidence(void) {
+    // 並べ替えは添字だけで行い、最後に各配列を1回ずつ並べ直す
+    // （std::stable_sortは作業領域を確保するため、同順位は添字で比較してstd::sortを使う）
+    const std::size_t num_boxes = rects.size();
+    order.resize(num_boxes);
+    for (std::size_t i = 0; i < num_boxes; i++) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [this](const std::size_t a, const std::size_t b) {
+        return confidences[a] > confidences[b] || (confidences[a] == confidences[b] && a < b);
+    });
+
+    // 交換後も同じ要素数まで追加できるよう、作業領域の容量を揃えておく
+    sorted_rects.reserve(rects.capacity());
+    sorted_labels.reserve(labels.capacity());
+    sorted_confidences.reserve(confidences.capacity());
+    sorted_rects.resize(num_boxes);
+    sorted_labels.resize(num_boxes);
+    sorted_confidences.resize(num_boxes);
+    for (std::size_t i = 0; i < num_boxes; i++) {
+        sorted_rects[i] = rects[order[i]];
+        sorted_labels[i] = labels[order[i]];
+        sorted_confidences[i] = confidences[order[i]];
+    }
+    // 交換すれば、どちらの配列も確保済みのメモリを次回以降に使い回せる
+    rects.swap(sorted_rects);
+    labels.swap(sorted_labels);
+    confidences.swap(sorted_confidences);
+}
+
+std::vector<BBox> BBoxList::to_vector(void) const {
+    std::vector<BBox> bboxes;
+    bboxes.reserve(rects.size());
+    for (std::size_t i = 0; i < rects.size(); i++) {
+        bboxes.emplace_back(rects[i], labels[i], confidences[i]);
+    }
+    return bboxes;
+}
+
+void KeyPointList::clear(void) {
+    xs.clear();
+    ys.clear();
+    confidences.clear();
+}
+
+void KeyPointList::resize(const std::size_t size) {
+    xs.resize(size);
+    ys.resize(size);
+    confidences.resize(size);
+}
+
+void KeyPointList::push_back(const float x, const float y, const float confidence) {
+    xs.push_back(x);
+    ys.push_back(y);
+    confidences.push_back(confidence);
+}
+
+void KeyPointList::set(const std::size_t index, const float x, const float y,
+                       const float confidence) {
+    xs[index] = x;
+    ys[index] = y;
+    confidences[index] = confidence;
+}
+
+std::size_t KeyPointList::size(void) const { return xs.size(); }
+
+bool KeyPointList::empty(void) const { return xs.empty(); }
+
+KeyPoint KeyPointList::get(const std::size_t index) const {
+    return KeyPoint(xs[index], ys[index], confidences[index]);
+}
+
+const std::vector<float>& KeyPointList::get_xs(void) const { return xs; }
+
+const std::vector<float>& KeyPointList::get_ys(void) const { return ys; }
+
+const std::vector<float>& KeyPointList::get_confidences(void) const { return confidences; }
+
+std::vector<KeyPoint> KeyPointList::to_vector(void) const {
+    std::vector<KeyPoint> keypoints;
+    keypoints.reserve(xs.size());
+    for (std::size_t i = 0; i < xs.size(); i++) {
+        keypoints.emplace_back(xs[i], ys[i], confidences[i]);
+    }
+    return keypoints;
+}
@@ -0,0 +1,457 @@
+#include "result_sink.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+namespace {
+
+const char FILE_MAGIC[4] = {'O', 'V', 'R', 'S'};
+
+std::runtime_error make_system_error(const std::string& message, const std::string& path) {
+    return std::runtime_error(message + ": " + path + " (" + std::strerror(errno) + ")");
+}
+
+/**
+ * @brief レコード内の各配列の位置（レコードの先頭からのオフセット[byte]）
+ *
+ */
+struct RecordLayout {
+    std::size_t track_ids = 0;
+    std::size_t xs = 0;
+    std::size_t ys = 0;
+    std::size_t widths = 0;
+    std::size_t heights = 0;
+    std::size_t labels = 0;
+    std::size_t confidences = 0;
+    std::size_t keypoint_offsets = 0;
+    std::size_t keypoint_xs = 0;
+    std::size_t keypoint_ys = 0;
+    std::size_t keypoint_confidences = 0;
+    std::size_t source = 0;
+    std::size_t size = 0;  // 8byte境界へ切り上げたレコード全体のサイズ
+};
+
+/**
+ * @brief レコードのレイアウトを求める（書き込みと読み込みで同じ計算を使う）
+ *
+ * @param header レコードの先頭
+ * @param num_keypoints キーポイントの総数T
+ * @return RecordLayout レイアウト
+ */
+RecordLayout get_record_layout(const ResultSink::RecordHeader& header,
+                               const std::size_t num_keypoints) {
+    const std::size_t n = header.num_bboxes;
+    RecordLayout layout;
+    std::size_t offset = sizeof(ResultSink::RecordHeader);
+    layout.track_ids = offset;
+    if (header.flags & ResultSink::HAS_TRACK_IDS) {
+        offset += n * sizeof(std::uint64_t);
+    }
+    layout.xs = offset;
+    layout.ys = layout.xs + n * sizeof(float);
+    layout.widths = layout.ys + n * sizeof(float);
+    layout.heights = layout.widths + n * sizeof(float);
+    layout.labels = layout.heights + n * sizeof(float);
+    layout.confidences = layout.labels + n * sizeof(std::int32_t);
+    layout.keypoint_offsets = layout.confidences + n * sizeof(float);
+    layout.keypoint_xs =
+        layout.keypoint_offsets + (header.num_poses + 1) * sizeof(std::uint32_t);
+    layout.keypoint_ys = layout.keypoint_xs + num_keypoints * sizeof(float);
+    layout.keypoint_confidences = layout.keypoint_ys + num_keypoints * sizeof(float);
+    layout.source = layout.keypoint_confidences + num_keypoints * sizeof(float);
+    layout.size = (layout.source + header.source_length + 7) / 8 * 8;
+    return layout;
+}
+
+/**
+ * @brief 配列をバッファの指定位置へコピーする
+ *
+ */
+template <typename T>
+void store(std::vector<char>& buffer, const std::size_t offset, const T* data,
+           const std::size_t count) {
+    if (count > 0) {
+        std::memcpy(buffer.data() + offset, data, count * sizeof(T));
+    }
+}
+
+/**
+ * @brief JSONの数値を追加する（有限でなければnull）
+ *
+ */
+void append_number(std::vector<char>& buffer, const float value) {
+    if (!std::isfinite(value)) {
+        buffer.insert(buffer.end(), {'n', 'u', 'l', 'l'});
+        return;
+    }
+    char text[32];
+    const int length = std::snprintf(text, sizeof(text), "%.6g", value);
+    buffer.insert(buffer.end(), text, text + length);
+}
+
+/**
+ * @brief 整数を追加する
+ *
+ */
+void append_integer(std::vector<char>& buffer, const long long value) {
+    char text[32];
+    const int length = std::snprintf(text, sizeof(text), "%lld", value);
+    buffer.insert(buffer.end(), text, text + length);
+}
+
+/**
+ * @brief 文字列を追加する
+ *
+ */
+void append_text(std::vector<char>& buffer, const char* text) {
+    buffer.insert(buffer.end(), text, text + std::strlen(text));
+}
+
+/**
+ * @brief JSONの文字列としてエスケープして追加する
+ *
+ */
+void append_json_string(std::vector<char>& buffer, const std::string& value) {
+    buffer.push_back('"');
+    for (const char c : value) {
+        if (c == '"' || c == '\\') {
+            buffer.push_back('\\');
+            buffer.push_back(c);
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char text[8];
+            std::snprintf(text, sizeof(text), "\\u%04x", static_cast<unsigned char>(c));
+            buffer.insert(buffer.end(), text, text + 6);
+        } else {
+            buffer.push_back(c);
+        }
+    }
+    buffer.push_back('"');
+}
+
+}  // namespace
+
+ResultFormat get_result_format(const std::string& path) {
+    return std::filesystem::path(path).extension() == ".jsonl" ? ResultFormat::JSONL
+                                                                : ResultFormat::Binary;
+}
+
+ResultSink::ResultSink(const std::string& path, const ResultFormat format)
+    : path(path), format(format) {
+    // バイナリ形式は、途中まで書かれた末尾のレコードを切り詰めてから追記する
+    std::size_t valid_size = 0;
+    if (format == ResultFormat::Binary && std::filesystem::exists(path) &&
+        std::filesystem::file_size(path) > 0) {
+        valid_size = ResultReader(path).get_valid_size();
+    }
+
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw make_system_error("Could not open result file", path);
+    }
+    if (valid_size > 0 && ::ftruncate(fd, static_cast<off_t>(valid_size)) != 0) {
+        const auto error = make_system_error("Could not truncate result file", path);
+        ::close(fd);
+        throw error;
+    }
+
+    buffer.reserve(FLUSH_SIZE * 2);
+    if (format == ResultFormat::Binary && valid_size == 0) {
+        FileHeader header;
+        std::memcpy(header.magic, FILE_MAGIC, sizeof(header.magic));
+        header.version = VERSION;
+        const char* bytes = reinterpret_cast<const char*>(&header);
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(header));
+    }
+}
+
+ResultSink::~ResultSink(void) {
+    try {
+        flush();
+    } catch (const std::exception&) {
+        // デストラクタからは例外を投げない（書き出せなかった結果は失われる）
+    }
+    ::close(fd);
+}
+
+void ResultSink::encode_jsonl(const std::string& source, const std::uint64_t frame_index,
+                              const cv::Size& image_size, const BBoxList& bboxes,
+                              const std::vector<std::uint64_t>& track_ids,
+                              const std::vector<KeyPointList>& poses) {
+    append_text(buffer, "{\"source\":");
+    append_json_string(buffer, source);
+    append_text(buffer, ",\"frame\":");
+    append_integer(buffer, static_cast<long long>(frame_index));
+    append_text(buffer, ",\"width\":");
+    append_integer(buffer, image_size.width);
+    append_text(buffer, ",\"height\":");
+    append_integer(buffer, image_size.height);
+
+    append_text(buffer, ",\"bboxes\":[");
+    for (std::size_t i = 0; i < bboxes.size(); i++) {
+        const cv::Rect2f& rect = bboxes.get_rects()[i];
+        append_text(buffer, i == 0 ? "{\"x\":" : ",{\"x\":");
+        append_number(buffer, rect.x);
+        append_text(buffer, ",\"y\":");
+        append_number(buffer, rect.y);
+        append_text(buffer, ",\"width\":");
+        append_number(buffer, rect.width);
+        append_text(buffer, ",\"height\":");
+        append_number(buffer, rect.height);
+        append_text(buffer, ",\"label\":");
+        append_integer(buffer, bboxes.get_labels()[i]);
+        append_text(buffer, ",\"confidence\":");
+        append_number(buffer, bboxes.get_confidences()[i]);
+        if (!track_ids.empty()) {
+            append_text(buffer, ",\"track_id\":");
+            append_integer(buffer, static_cast<long long>(track_ids[i]));
+        }
+        buffer.push_back('}');
+    }
+
+    // 骨格は人物ごとに[x, y, 確信度]の配列
+    append_text(buffer, "],\"poses\":[");
+    for (std::size_t i = 0; i < poses.size(); i++) {
+        const KeyPointList& keypoints = poses[i];
+        append_text(buffer, i == 0 ? "[" : ",[");
+        for (std::size_t k = 0; k < keypoints.size(); k++) {
+            append_text(buffer, k == 0 ? "[" : ",[");
+            append_number(buffer, keypoints.get_xs()[k]);
+            buffer.push_back(',');
+            append_number(buffer, keypoints.get_ys()[k]);
+            buffer.push_back(',');
+            append_number(buffer, keypoints.get_confidences()[k]);
+            buffer.push_back(']');
+        }
+        buffer.push_back(']');
+    }
+    append_text(buffer, "]}\n");
+}
+
+void ResultSink::encode_binary(const std::string& source, const std::uint64_t frame_index,
+                               const cv::Size& image_size, const BBoxList& bboxes,
+                               const std::vector<std::uint64_t>& track_ids,
+                               const std::vector<KeyPointList>& poses) {
+    const std::size_t n = bboxes.size();
+    std::size_t num_keypoints = 0;
+    for (const KeyPointList& keypoints : poses) {
+        num_keypoints += keypoints.size();
+    }
+
+    RecordHeader header;
+    header.magic = RECORD_MAGIC;
+    header.frame_index = frame_index;
+    header.width = static_cast<std::uint32_t>(image_size.width);
+    header.height = static_cast<std::uint32_t>(image_size.height);
+    header.source_length = static_cast<std::uint32_t>(source.size());
+    header.num_bboxes = static_cast<std::uint32_t>(n);
+    header.num_poses = static_cast<std::uint32_t>(poses.size());
+    header.flags = track_ids.empty() ? 0 : HAS_TRACK_IDS;
+    const RecordLayout layout = get_record_layout(header, num_keypoints);
+    if (layout.size > UINT32_MAX) {
+        throw std::runtime_error("Result record is too large: " + path);
+    }
+    header.size = static_cast<std::uint32_t>(layout.size);
+
+    // レコード全体を確保し（詰め物は0）、配列ごとにコピーする
+    const std::size_t begin = buffer.size();
+    buffer.resize(begin + layout.size, 0);
+    std::memcpy(buffer.data() + begin, &header, sizeof(header));
+    if (!track_ids.empty()) {
+        store(buffer, begin + layout.track_ids, track_ids.data(), n);
+    }
+    const std::vector<cv::Rect2f>& rects = bboxes.get_rects();
+    float* xs = reinterpret_cast<float*>(buffer.data() + begin + layout.xs);
+    float* ys = reinterpret_cast<float*>(buffer.data() + begin + layout.ys);
+    float* widths = reinterpret_cast<float*>(buffer.data() + begin + layout.widths);
+    float* heights = reinterpret_cast<float*>(buffer.data() + begin + layout.heights);
+    for (std::size_t i = 0; i < n; i++) {
+        xs[i] = rects[i].x;
+        ys[i] = rects[i].y;
+        widths[i] = rects[i].width;
+        heights[i] = rects[i].height;
+    }
+    static_assert(sizeof(int) == sizeof(std::int32_t), "labels are stored as int32");
+    store(buffer, begin + layout.labels, bboxes.get_labels().data(), n);
+    store(buffer, begin + layout.confidences, bboxes.get_confidences().data(), n);
+
+    std::uint32_t* keypoint_offsets =
+        reinterpret_cast<std::uint32_t*>(buffer.data() + begin + layout.keypoint_offsets);
+    std::size_t offset = 0;
+    for (std::size_t i = 0; i < poses.size(); i++) {
+        const KeyPointList& keypoints = poses[i];
+        keypoint_offsets[i] = static_cast<std::uint32_t>(offset);
+        const std::size_t byte_offset = offset * sizeof(float);
+        store(buffer, begin + layout.keypoint_xs + byte_offset, keypoints.get_xs().data(),
+              keypoints.size());
+        store(buffer, begin + layout.keypoint_ys + byte_offset, keypoints.get_ys().data(),
+              keypoints.size());
+        store(buffer, begin + layout.keypoint_confidences + byte_offset,
+              keypoints.get_confidences().data(), keypoints.size());
+        offset += keypoints.size();
+    }
+    keypoint_offsets[poses.size()] = static_cast<std::uint32_t>(offset);
+    store(buffer, begin + layout.source, source.data(), source.size());
+}
+
+void ResultSink::write(const std::string& source, const std::uint64_t frame_index,
+                       const cv::Size& image_size, const BBoxList& bboxes,
+                       const std::vector<std::uint64_t>& track_ids,
+                       const std::vector<KeyPointList>& poses) {
+    if (!track_ids.empty() && track_ids.size() != bboxes.size()) {
+        throw std::invalid_argument("The number of track IDs must match the number of bboxes");
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (format == ResultFormat::JSONL) {
+        encode_jsonl(source, frame_index, image_size, bboxes, track_ids, poses);
+    } else {
+        encode_binary(source, frame_index, image_size, bboxes, track_ids, poses);
+    }
+    num_written++;
+    if (buffer.size() >= FLUSH_SIZE) {
+        flush_buffer();
+    }
+}
+
+void ResultSink::flush_buffer(void) {
+    // レコードの途中で分割しないよう、たまった分を1回のwrite()で書き出す（短い書き込みは続きから）
+    std::size_t written = 0;
+    while (written < buffer.size()) {
+        const ssize_t result = ::write(fd, buffer.data() + written, buffer.size() - written);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            buffer.erase(buffer.begin(), buffer.begin() + written);
+            throw make_system_error("Could not write result file", path);
+        }
+        written += static_cast<std::size_t>(result);
+    }
+    buffer.clear();
+}
+
+void ResultSink::flush(void) {
+    std::lock_guard<std::mutex> lock(mutex);
+    flush_buffer();
+}
+
+std::size_t ResultSink::get_num_written(void) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return num_written;
+}
+
+void ResultRecordView::get_bboxes(BBoxList& bboxes) const {
+    bboxes.clear();
+    bboxes.reserve(num_bboxes);
+    for (std::size_t i = 0; i < num_bboxes; i++) {
+        bboxes.push_back(cv::Rect2f(xs[i], ys[i], widths[i], heights[i]), labels[i],
+                         confidences[i]);
+    }
+}
+
+void ResultRecordView::get_keypoints(const std::size_t index, KeyPointList& keypoints) const {
+    if (index >= num_poses) {
+        throw std::out_of_range("Pose index is out of range");
+    }
+    keypoints.clear();
+    for (std::uint32_t k = keypoint_offsets[index]; k < keypoint_offsets[index + 1]; k++) {
+        keypoints.push_back(keypoint_xs[k], keypoint_ys[k], keypoint_confidences[k]);
+    }
+}
+
+ResultReader::ResultReader(const std::string& path) : file(path) {
+    if (file.size() == 0) {
+        return;
+    }
+    const unsigned char* data = file.data();
+    const std::size_t size = file.size();
+    ResultSink::FileHeader file_header;
+    if (size < sizeof(file_header)) {
+        throw std::runtime_error("Result file is too short: " + path);
+    }
+    std::memcpy(&file_header, data, sizeof(file_header));
+    if (std::memcmp(file_header.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0) {
+        throw std::runtime_error("Not a result file: " + path);
+    }
+    if (file_header.version != ResultSink::VERSION) {
+        throw std::runtime_error("Unsupported result file version " +
+                                 std::to_string(file_header.version) + ": " + path);
+    }
+
+    // ヘッダとキーポイントの開始位置が矛盾しない完全なレコードだけを数える
+    std::size_t offset = sizeof(file_header);
+    valid_size = offset;
+    while (offset + sizeof(ResultSink::RecordHeader) <= size) {
+        ResultSink::RecordHeader header;
+        std::memcpy(&header, data + offset, sizeof(header));
+        if (header.magic != ResultSink::RECORD_MAGIC || header.size % 8 != 0 ||
+            header.size > size - offset) {
+            break;
+        }
+        const RecordLayout empty_layout = get_record_layout(header, 0);
+        if (empty_layout.size > header.size) {
+            break;
+        }
+        const std::uint32_t* keypoint_offsets = reinterpret_cast<const std::uint32_t*>(
+            data + offset + empty_layout.keypoint_offsets);
+        bool valid = keypoint_offsets[0] == 0;
+        for (std::size_t i = 0; valid && i < header.num_poses; i++) {
+            valid = keypoint_offsets[i] <= keypoint_offsets[i + 1];
+        }
+        if (!valid ||
+            get_record_layout(header, keypoint_offsets[header.num_poses]).size != header.size) {
+            break;
+        }
+        offsets.push_back(offset);
+        offset += header.size;
+        valid_size = offset;
+    }
+}
+
+std::size_t ResultReader::size(void) const { return offsets.size(); }
+
+ResultRecordView ResultReader::get(const std::size_t index) const {
+    if (index >= offsets.size()) {
+        throw std::out_of_range("Result record index is out of range");
+    }
+    const unsigned char* record = file.data() + offsets[index];
+    ResultSink::RecordHeader header;
+    std::memcpy(&header, record, sizeof(header));
+    const std::uint32_t* keypoint_offsets = reinterpret_cast<const std::uint32_t*>(
+        record + get_record_layout(header, 0).keypoint_offsets);
+    const RecordLayout layout = get_record_layout(header, keypoint_offsets[header.num_poses]);
+
+    // レコードは8byte境界から始まり、配列は型の境界に揃っているため直接参照できる
+    ResultRecordView view;
+    view.frame_index = header.frame_index;
+    view.image_size = cv::Size(static_cast<int>(header.width), static_cast<int>(header.height));
+    view.source = std::string_view(reinterpret_cast<const char*>(record + layout.source),
+                                   header.source_length);
+    view.num_bboxes = header.num_bboxes;
+    view.xs = reinterpret_cast<const float*>(record + layout.xs);
+    view.ys = reinterpret_cast<const float*>(record + layout.ys);
+    view.widths = reinterpret_cast<const float*>(record + layout.widths);
+    view.heights = reinterpret_cast<const float*>(record + layout.heights);
+    view.labels = reinterpret_cast<const std::int32_t*>(record + layout.labels);
+    view.confidences = reinterpret_cast<const float*>(record + layout.confidences);
+    if (header.flags & ResultSink::HAS_TRACK_IDS) {
+        view.track_ids = reinterpret_cast<const std::uint64_t*>(record + layout.track_ids);
+    }
+    view.num_poses = header.num_poses;
+    view.keypoint_offsets = keypoint_offsets;
+    view.keypoint_xs = reinterpret_cast<const float*>(record + layout.keypoint_xs);
+    view.keypoint_ys = reinterpret_cast<const float*>(record + layout.keypoint_ys);
+    view.keypoint_confidences =
+        reinterpret_cast<const float*>(record + layout.keypoint_confidences);
+    return view;
+}
+
+std::size_t ResultReader::get_valid_size(void) const { return valid_size; }
@@ -0,0 +1,192 @@
+#include "postprocess.hpp"
+
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ARGMAX_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+/**
+ * @brief 1チャンネル分の最大値の位置を求める関数
+ *
+ * 最大値が複数ある場合は最も前の位置を返す（std::max_elementと同じ）
+ */
+using ArgmaxFunc = std::size_t (*)(const float* data, std::size_t size, float& max_value);
+
+/**
+ * @brief スカラー実装（SIMD非対応環境と端数処理で使用）
+ *
+ */
+std::size_t argmax_scalar(const float* data, const std::size_t size, float& max_value) {
+    std::size_t max_index = 0;
+    float max = data[0];
+    for (std::size_t i = 1; i < size; i++) {
+        if (data[i] > max) {
+            max = data[i];
+            max_index = i;
+        }
+    }
+    max_value = max;
+    return max_index;
+}
+
+/**
+ * @brief レーンごとの最大値・位置と端数の結果から、全体の最大値の位置を求める
+ *
+ * @param lane_max レーンごとの最大値
+ * @param lane_index レーンごとの最大値の位置
+ * @param num_lanes レーン数
+ * @param data 入力
+ * @param begin 端数の開始位置
+ * @param size 要素数
+ * @param max_value 最大値の格納先
+ * @return std::size_t 最大値の位置
+ */
+std::size_t reduce_lanes(const float* lane_max, const std::int32_t* lane_index,
+                         const int num_lanes, const float* data, const std::size_t begin,
+                         const std::size_t size, float& max_value) {
+    float max = lane_max[0];
+    std::size_t max_index = static_cast<std::size_t>(lane_index[0]);
+    for (int lane = 1; lane < num_lanes; lane++) {
+        const std::size_t index = static_cast<std::size_t>(lane_index[lane]);
+        if (lane_max[lane] > max || (lane_max[lane] == max && index < max_index)) {
+            max = lane_max[lane];
+            max_index = index;
+        }
+    }
+    for (std::size_t i = begin; i < size; i++) {
+        if (data[i] > max) {
+            max = data[i];
+            max_index = i;
+        }
+    }
+    max_value = max;
+    return max_index;
+}
+
+#ifdef ARGMAX_X86_SIMD
+
+__attribute__((target("sse4.1"))) std::size_t argmax_sse41(const float* data,
+                                                           const std::size_t size,
+                                                           float& max_value) {
+    if (size < 4) {
+        return argmax_scalar(data, size, max_value);
+    }
+    __m128 vmax = _mm_loadu_ps(data);
+    __m128i vindex = _mm_setr_epi32(0, 1, 2, 3);
+    __m128i current = vindex;
+    const __m128i step = _mm_set1_epi32(4);
+    std::size_t i = 4;
+    for (; i + 4 <= size; i += 4) {
+        current = _mm_add_epi32(current, step);
+        const __m128 v = _mm_loadu_ps(data + i);
+        const __m128 greater = _mm_cmpgt_ps(v, vmax);
+        vmax = _mm_blendv_ps(vmax, v, greater);
+        vindex = _mm_castps_si128(
+            _mm_blendv_ps(_mm_castsi128_ps(vindex), _mm_castsi128_ps(current), greater));
+    }
+
+    alignas(16) float lane_max[4];
+    alignas(16) std::int32_t lane_index[4];
+    _mm_store_ps(lane_max, vmax);
+    _mm_store_si128(reinterpret_cast<__m128i*>(lane_index), vindex);
+    return reduce_lanes(lane_max, lane_index, 4, data, i, size, max_value);
+}
+
+__attribute__((target("avx2"))) std::size_t argmax_avx2(const float* data, const std::size_t size,
+                                                        float& max_value) {
+    if (size < 8) {
+        return argmax_scalar(data, size, max_value);
+    }
+    __m256 vmax = _mm256_loadu_ps(data);
+    __m256i vindex = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i current = vindex;
+    const __m256i step = _mm256_set1_epi32(8);
+    std::size_t i = 8;
+    for (; i + 8 <= size; i += 8) {
+        current = _mm256_add_epi32(current, step);
+        const __m256 v = _mm256_loadu_ps(data + i);
+        const __m256 greater = _mm256_cmp_ps(v, vmax, _CMP_GT_OQ);
+        vmax = _mm256_blendv_ps(vmax, v, greater);
+        vindex = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(vindex),
+                                                      _mm256_castsi256_ps(current), greater));
+    }
+
+    alignas(32) float lane_max[8];
+    alignas(32) std::int32_t lane_index[8];
+    _mm256_store_ps(lane_max, vmax);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lane_index), vindex);
+    return reduce_lanes(lane_max, lane_index, 8, data, i, size, max_value);
+}
+
+__attribute__((target("avx512f"))) std::size_t argmax_avx512(const float* data,
+                                                             const std::size_t size,
+                                                             float& max_value) {
+    if (size < 16) {
+        return argmax_scalar(data, size, max_value);
+    }
+    __m512 vmax = _mm512_loadu_ps(data);
+    __m512i vindex = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m512i current = vindex;
+    const __m512i step = _mm512_set1_epi32(16);
+    std::size_t i = 16;
+    for (; i + 16 <= size; i += 16) {
+        current = _mm512_add_epi32(current, step);
+        const __m512 v = _mm512_loadu_ps(data + i);
+        const __mmask16 greater = _mm512_cmp_ps_mask(v, vmax, _CMP_GT_OQ);
+        vmax = _mm512_mask_mov_ps(vmax, greater, v);
+        vindex = _mm512_mask_mov_epi32(vindex, greater, current);
+    }
+
+    alignas(64) float lane_max[16];
+    alignas(64) std::int32_t lane_index[16];
+    _mm512_store_ps(lane_max, vmax);
+    _mm512_store_si512(lane_index, vindex);
+    return reduce_lanes(lane_max, lane_index, 16, data, i, size, max_value);
+}
+
+#endif  // ARGMAX_X86_SIMD
+
+/**
+ * @brief 実行環境のCPUが対応する最速の実装を選択する
+ *
+ */
+ArgmaxFunc select_argmax(void) {
+#ifdef ARGMAX_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return argmax_avx512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return argmax_avx2;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return argmax_sse41;
+    }
+#endif
+    return argmax_scalar;
+}
+
+}  // namespace
+
+void argmax_channels(const float* data, const std::size_t num_channels,
+                     const std::size_t plane_size, std::size_t* max_indices, float* max_values) {
+    if (plane_size == 0) {
+        throw std::invalid_argument("argmax_channels expects a non-empty plane");
+    }
+    if (plane_size > static_cast<std::size_t>(std::numeric_limits<std::int32_t>::max())) {
+        throw std::invalid_argument("argmax_channels supports planes up to 2^31 elements");
+    }
+
+    static const ArgmaxFunc argmax = select_argmax();
+
+    // チャンネルは連続して並んでいるため、先頭から順に1回走査するだけで済む
+    for (std::size_t c = 0; c < num_channels; c++) {
+        max_indices[c] = argmax(data + c * plane_size, plane_size, max_values[c]);
+    }
+}
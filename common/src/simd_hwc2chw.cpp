@@ -0,0 +1,235 @@
+#include "preprocess.hpp"
+
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HWC2CHW_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+/**
+ * @brief 1行分の変換関数
+ *
+ * src: u8型HWC（3チャンネル）の1行、dst: 各チャンネルの書き込み先（swap_rb適用済みの順）
+ * 出力値は src * mul + add で求める
+ */
+using ConvertRowFunc = void (*)(const std::uint8_t* src, int width, float* const dst[3],
+                                const float mul[3], const float add[3]);
+
+/**
+ * @brief スカラー実装（SIMD非対応環境と行末の端数処理で使用）
+ *
+ */
+void convert_row_scalar(const std::uint8_t* src, int width, float* const dst[3], const float mul[3],
+                        const float add[3]) {
+    for (int x = 0; x < width; x++) {
+        dst[0][x] = src[3 * x + 0] * mul[0] + add[0];
+        dst[1][x] = src[3 * x + 1] * mul[1] + add[1];
+        dst[2][x] = src[3 * x + 2] * mul[2] + add[2];
+    }
+}
+
+#ifdef HWC2CHW_X86_SIMD
+
+/**
+ * @brief 48バイト（16画素）のうち、チャンネルcの値をk番目の16バイトから集めるシャッフルマスク
+ *
+ */
+constexpr std::array<std::int8_t, 16> make_shuffle_mask(const int c, const int k) {
+    std::array<std::int8_t, 16> mask{};
+    for (int i = 0; i < 16; i++) {
+        const int src = 3 * i + c - 16 * k;
+        // 範囲外は最上位ビットを立てて0を出力させる
+        mask[i] = static_cast<std::int8_t>((0 <= src && src < 16) ? src : -1);
+    }
+    return mask;
+}
+
+alignas(16) constexpr std::array<std::array<std::array<std::int8_t, 16>, 3>, 3> SHUFFLE_MASKS = {{
+    {{make_shuffle_mask(0, 0), make_shuffle_mask(0, 1), make_shuffle_mask(0, 2)}},
+    {{make_shuffle_mask(1, 0), make_shuffle_mask(1, 1), make_shuffle_mask(1, 2)}},
+    {{make_shuffle_mask(2, 0), make_shuffle_mask(2, 1), make_shuffle_mask(2, 2)}},
+}};
+
+/**
+ * @brief 16画素分のBGRBGR...をチャンネルごとの16バイトへ分離する
+ *
+ */
+__attribute__((target("ssse3"))) inline void deinterleave16(const std::uint8_t* src,
+                                                            __m128i planes[3]) {
+    const __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+    const __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16));
+    const __m128i a2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 32));
+    for (int c = 0; c < 3; c++) {
+        const auto* masks = reinterpret_cast<const __m128i*>(SHUFFLE_MASKS[c].data());
+        planes[c] = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a0, _mm_load_si128(masks + 0)),
+                                              _mm_shuffle_epi8(a1, _mm_load_si128(masks + 1))),
+                                 _mm_shuffle_epi8(a2, _mm_load_si128(masks + 2)));
+    }
+}
+
+__attribute__((target("ssse3,sse4.1"))) void convert_row_sse41(const std::uint8_t* src,
+                                                               const int width,
+                                                               float* const dst[3],
+                                                               const float mul[3],
+                                                               const float add[3]) {
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i planes[3];
+        deinterleave16(src + 3 * x, planes);
+        for (int c = 0; c < 3; c++) {
+            const __m128 m = _mm_set1_ps(mul[c]);
+            const __m128 a = _mm_set1_ps(add[c]);
+            __m128i v = planes[c];
+            for (int k = 0; k < 4; k++) {
+                const __m128 f = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(v));
+                _mm_storeu_ps(dst[c] + x + 4 * k, _mm_add_ps(_mm_mul_ps(f, m), a));
+                v = _mm_srli_si128(v, 4);
+            }
+        }
+    }
+    float* const tail[3] = {dst[0] + x, dst[1] + x, dst[2] + x};
+    convert_row_scalar(src + 3 * x, width - x, tail, mul, add);
+}
+
+__attribute__((target("ssse3,sse4.1,avx2"))) void convert_row_avx2(const std::uint8_t* src,
+                                                                   const int width,
+                                                                   float* const dst[3],
+                                                                   const float mul[3],
+                                                                   const float add[3]) {
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i planes[3];
+        deinterleave16(src + 3 * x, planes);
+        for (int c = 0; c < 3; c++) {
+            const __m256 m = _mm256_set1_ps(mul[c]);
+            const __m256 a = _mm256_set1_ps(add[c]);
+            const __m256 lo = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(planes[c]));
+            const __m256 hi =
+                _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(planes[c], 8)));
+            _mm256_storeu_ps(dst[c] + x, _mm256_add_ps(_mm256_mul_ps(lo, m), a));
+            _mm256_storeu_ps(dst[c] + x + 8, _mm256_add_ps(_mm256_mul_ps(hi, m), a));
+        }
+    }
+    float* const tail[3] = {dst[0] + x, dst[1] + x, dst[2] + x};
+    convert_row_scalar(src + 3 * x, width - x, tail, mul, add);
+}
+
+__attribute__((target("ssse3,sse4.1,avx2,avx512f"))) void convert_row_avx512(
+    const std::uint8_t* src, const int width, float* const dst[3], const float mul[3],
+    const float add[3]) {
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i planes[3];
+        deinterleave16(src + 3 * x, planes);
+        for (int c = 0; c < 3; c++) {
+            const __m512 f = _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(planes[c]));
+            _mm512_storeu_ps(dst[c] + x, _mm512_add_ps(_mm512_mul_ps(f, _mm512_set1_ps(mul[c])),
+                                                       _mm512_set1_ps(add[c])));
+        }
+    }
+    float* const tail[3] = {dst[0] + x, dst[1] + x, dst[2] + x};
+    convert_row_scalar(src + 3 * x, width - x, tail, mul, add);
+}
+
+#endif  // HWC2CHW_X86_SIMD
+
+/**
+ * @brief 命令セットの実装を返す
+ *
+ */
+ConvertRowFunc get_convert_row(const SimdLevel level) {
+    switch (level) {
+#ifdef HWC2CHW_X86_SIMD
+        case SimdLevel::AVX512:
+            return convert_row_avx512;
+        case SimdLevel::AVX2:
+            return convert_row_avx2;
+        case SimdLevel::SSE41:
+            return convert_row_sse41;
+#endif
+        default:
+            return convert_row_scalar;
+    }
+}
+
+}  // namespace
+
+const char* get_simd_level_name(const SimdLevel level) {
+    switch (level) {
+        case SimdLevel::AVX512:
+            return "avx512";
+        case SimdLevel::AVX2:
+            return "avx2";
+        case SimdLevel::SSE41:
+            return "sse4.1";
+        default:
+            return "scalar";
+    }
+}
+
+SimdLevel get_supported_simd_level(void) {
+#ifdef HWC2CHW_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return SimdLevel::AVX512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return SimdLevel::AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.1") && __builtin_cpu_supports("ssse3")) {
+        return SimdLevel::SSE41;
+    }
+#endif
+    return SimdLevel::Scalar;
+}
+
+void convert_hwc2chw(const cv::Mat& image, float* chw_data, const bool swap_rb,
+                     const cv::Scalar& mean, const cv::Scalar& scale) {
+    static const SimdLevel level = get_supported_simd_level();
+    convert_hwc2chw(image, chw_data, level, swap_rb, mean, scale);
+}
+
+void convert_hwc2chw(const cv::Mat& image, float* chw_data, const SimdLevel level,
+                     const bool swap_rb, const cv::Scalar& mean, const cv::Scalar& scale) {
+    if (image.type() != CV_8UC3) {
+        throw std::invalid_argument("convert_hwc2chw expects a CV_8UC3 image");
+    }
+    if (level > get_supported_simd_level()) {
+        throw std::invalid_argument(std::string("convert_hwc2chw: ") + get_simd_level_name(level) +
+                                    " is not supported by this CPU");
+    }
+    const ConvertRowFunc convert_row = get_convert_row(level);
+
+    const int height = image.rows;
+    const int width = image.cols;
+    const std::size_t plane_size = static_cast<std::size_t>(height) * width;
+
+    // 出力チャンネルごとに (x - mean) / scale を x * mul + add へまとめる
+    float mul[3];
+    float add[3];
+    for (int c = 0; c < 3; c++) {
+        mul[c] = static_cast<float>(1.0 / scale[c]);
+        add[c] = static_cast<float>(-mean[c] / scale[c]);
+    }
+
+    // 入力チャンネルの順に書き込み先・係数を並べる（swap_rbならBとRを入れ替える）
+    float* planes[3] = {chw_data, chw_data + plane_size, chw_data + 2 * plane_size};
+    if (swap_rb) {
+        std::swap(planes[0], planes[2]);
+        std::swap(mul[0], mul[2]);
+        std::swap(add[0], add[2]);
+    }
+
+    for (int y = 0; y < height; y++) {
+        const std::size_t offset = static_cast<std::size_t>(y) * width;
+        float* const dst[3] = {planes[0] + offset, planes[1] + offset, planes[2] + offset};
+        convert_row(image.ptr<std::uint8_t>(y), width, dst, mul, add);
+    }
+}
@@ -0,0 +1,237 @@
+#include "task_profiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+
+namespace {
+
+// 経過時間の基準となる現在時刻[ns]
+std::int64_t steady_now_ns(void) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+StageStats make_stage_stats(const LatencyHistogram& histogram) {
+    StageStats stats;
+    stats.count = histogram.get_count();
+    stats.mean_ms = histogram.get_mean_ms();
+    stats.p50_ms = histogram.get_percentile_ms(50.0);
+    stats.p90_ms = histogram.get_percentile_ms(90.0);
+    stats.p99_ms = histogram.get_percentile_ms(99.0);
+    stats.max_ms = histogram.get_max_ms();
+    return stats;
+}
+
+}  // namespace
+
+const char* get_stage_name(const TaskStage stage) {
+    switch (stage) {
+        case TaskStage::Preprocess:
+            return "preprocess";
+        case TaskStage::Infer:
+            return "infer";
+        case TaskStage::Postprocess:
+            return "postprocess";
+        case TaskStage::Total:
+            return "total";
+    }
+    return "unknown";
+}
+
+std::size_t LatencyHistogram::get_bucket_index(const std::uint64_t value_ns) {
+    constexpr std::uint64_t SUB_BUCKETS = 1ULL << SUB_BUCKET_BITS;
+    if (value_ns < SUB_BUCKETS) {
+        return static_cast<std::size_t>(value_ns);
+    }
+
+    // 最上位ビットで区間を決め、続く SUB_BUCKET_BITS ビットで区間内のビンを決める
+    const std::size_t msb = 63 - __builtin_clzll(value_ns);
+    const std::size_t shift = msb - SUB_BUCKET_BITS;
+    const std::size_t sub = static_cast<std::size_t>(value_ns >> shift) & (SUB_BUCKETS - 1);
+    const std::size_t index = ((shift + 1) << SUB_BUCKET_BITS) + sub;
+    return std::min(index, NUM_BUCKETS - 1);
+}
+
+std::uint64_t LatencyHistogram::get_bucket_lower(const std::size_t index) {
+    constexpr std::uint64_t SUB_BUCKETS = 1ULL << SUB_BUCKET_BITS;
+    if (index < SUB_BUCKETS) {
+        return index;
+    }
+    const std::size_t shift = (index >> SUB_BUCKET_BITS) - 1;
+    const std::uint64_t sub = index & (SUB_BUCKETS - 1);
+    return (SUB_BUCKETS + sub) << shift;
+}
+
+LatencyHistogram::LatencyHistogram(void) { reset(); }
+
+void LatencyHistogram::record(const std::uint64_t value_ns) {
+    buckets[get_bucket_index(value_ns)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    sum_ns.fetch_add(value_ns, std::memory_order_relaxed);
+
+    std::uint64_t current_max = max_ns.load(std::memory_order_relaxed);
+    while (value_ns > current_max &&
+           !max_ns.compare_exchange_weak(current_max, value_ns, std::memory_order_relaxed)) {
+    }
+}
+
+void LatencyHistogram::reset(void) {
+    for (auto& bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    count.store(0, std::memory_order_relaxed);
+    sum_ns.store(0, std::memory_order_relaxed);
+    max_ns.store(0, std::memory_order_relaxed);
+}
+
+std::uint64_t LatencyHistogram::get_count(void) const {
+    return count.load(std::memory_order_relaxed);
+}
+
+double LatencyHistogram::get_mean_ms(void) const {
+    const std::uint64_t n = get_count();
+    if (n == 0) {
+        return 0.0;
+    }
+    return static_cast<double>(sum_ns.load(std::memory_order_relaxed)) / n * 1e-6;
+}
+
+double LatencyHistogram::get_max_ms(void) const {
+    return static_cast<double>(max_ns.load(std::memory_order_relaxed)) * 1e-6;
+}
+
+double LatencyHistogram::get_percentile_ms(const double percentile) const {
+    // 記録中に読み出すとビンの合計とcountがずれるため、ビンを読みながら合計を求める
+    std::array<std::uint64_t, NUM_BUCKETS> snapshot;
+    std::uint64_t total = 0;
+    for (std::size_t i = 0; i < NUM_BUCKETS; i++) {
+        snapshot[i] = buckets[i].load(std::memory_order_relaxed);
+        total += snapshot[i];
+    }
+    if (total == 0) {
+        return 0.0;
+    }
+
+    const double clamped = std::clamp(percentile, 0.0, 100.0);
+    const std::uint64_t rank = std::max<std::uint64_t>(
+        1, static_cast<std::uint64_t>(std::ceil(clamped / 100.0 * total)));
+    std::uint64_t cumulative = 0;
+    for (std::size_t i = 0; i < NUM_BUCKETS; i++) {
+        cumulative += snapshot[i];
+        if (cumulative >= rank) {
+            const double lower = static_cast<double>(get_bucket_lower(i));
+            const double upper = static_cast<double>(get_bucket_lower(i + 1));
+            // ビンの中央値で近似し、実際の最大値を超えないようにする
+            return std::min((lower + upper) / 2.0 * 1e-6, get_max_ms());
+        }
+    }
+    return get_max_ms();
+}
+
+std::ostream& operator<<(std::ostream& os, const TaskProfile& profile) {
+    const auto flags = os.flags();
+    const auto precision = os.precision();
+    os << std::fixed << std::setprecision(3);
+
+    os << "elapsed " << profile.elapsed_s << " s, tasks " << profile.num_tasks << " ("
+       << profile.tasks_per_second << " /s), images " << profile.num_images << " ("
+       << profile.images_per_second << " /s)";
+    for (std::size_t i = 0; i < NUM_TASK_STAGES; i++) {
+        const StageStats& stats = profile.stages[i];
+        os << std::endl
+           << "  " << std::left << std::setw(12) << get_stage_name(static_cast<TaskStage>(i))
+           << std::right << "count " << stats.count << ", mean " << stats.mean_ms << " ms, p50 "
+           << stats.p50_ms << " ms, p90 " << stats.p90_ms << " ms, p99 " << stats.p99_ms
+           << " ms, max " << stats.max_ms << " ms";
+    }
+
+    os.flags(flags);
+    os.precision(precision);
+    return os;
+}
+
+TaskProfiler::TaskProfiler(void) { reset(); }
+
+TaskProfiler::~TaskProfiler(void) { stop_dump(); }
+
+void TaskProfiler::record_stage(const TaskStage stage, const ProfileTimePoint& begin,
+                                const ProfileTimePoint& end) {
+#ifdef OPENVINO_TASK_PROFILING
+    const std::int64_t duration_ns =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+    histograms[static_cast<std::size_t>(stage)].record(
+        static_cast<std::uint64_t>(std::max<std::int64_t>(duration_ns, 0)));
+#else
+    (void)stage;
+    (void)begin;
+    (void)end;
+#endif
+}
+
+TaskProfile TaskProfiler::get_profile(void) const {
+    TaskProfile profile;
+    for (std::size_t i = 0; i < NUM_TASK_STAGES; i++) {
+        profile.stages[i] = make_stage_stats(histograms[i]);
+    }
+    profile.num_tasks = task_count.load(std::memory_order_relaxed);
+    profile.num_images = image_count.load(std::memory_order_relaxed);
+    profile.elapsed_s = (steady_now_ns() - start_time_ns.load(std::memory_order_relaxed)) * 1e-9;
+    if (profile.elapsed_s > 0.0) {
+        profile.tasks_per_second = profile.num_tasks / profile.elapsed_s;
+        profile.images_per_second = profile.num_images / profile.elapsed_s;
+    }
+    return profile;
+}
+
+void TaskProfiler::reset(void) {
+    for (auto& histogram : histograms) {
+        histogram.reset();
+    }
+    task_count.store(0, std::memory_order_relaxed);
+    image_count.store(0, std::memory_order_relaxed);
+    start_time_ns.store(steady_now_ns(), std::memory_order_relaxed);
+}
+
+void TaskProfiler::start_dump(const std::string& path, const std::chrono::milliseconds interval) {
+    if (interval.count() <= 0) {
+        throw std::invalid_argument("Dump interval must be positive");
+    }
+    stop_dump();
+
+    std::ofstream file(path, std::ios::app);
+    if (!file) {
+        throw std::runtime_error("Could not open profile dump file: " + path);
+    }
+
+    dump_stop = false;
+    dump_thread = std::thread([this, file = std::move(file), interval]() mutable {
+        std::unique_lock<std::mutex> lock(dump_mutex);
+        while (!dump_cv.wait_for(lock, interval, [this]() { return dump_stop; })) {
+            // 書き込み中にrecord()を止めないよう、ロックを外してから統計を集める
+            lock.unlock();
+            const TaskProfile profile = get_profile();
+            const std::time_t now = std::time(nullptr);
+            std::tm local_time;
+            localtime_r(&now, &local_time);
+            file << "[" << std::put_time(&local_time, "%Y-%m-%d %H:%M:%S") << "] " << profile
+                 << std::endl;
+            lock.lock();
+        }
+    });
+}
+
+void TaskProfiler::stop_dump(void) {
+    {
+        std::lock_guard<std::mutex> lock(dump_mutex);
+        dump_stop = true;
+    }
+    dump_cv.notify_all();
+    if (dump_thread.joinable()) {
+        dump_thread.join();
+    }
+}
@@ -0,0 +1,332 @@
+#include "tracker.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+// 成分の並び（Track::axesの添字）
+enum { CENTER_X = 0, CENTER_Y = 1, WIDTH = 2, HEIGHT = 3 };
+
+// ノイズの標準偏差（枠の高さに対する比、SORT・DeepSORTと同じ値）
+const float POSITION_NOISE = 1.0f / 20.0f;
+const float VELOCITY_NOISE = 1.0f / 160.0f;
+
+// オプティカルフローで1物体あたりに追跡する点の格子（GRID_SIZE x GRID_SIZE）
+const int GRID_SIZE = 4;
+
+// 移動量を求めるのに必要な、追跡できた点の最小数
+const std::size_t MIN_FLOW_POINTS = 4;
+
+// 枠の幅・高さの下限（正規化座標）
+const float MIN_SIZE = 1e-4f;
+
+void init_axis(Track::Axis& axis, const float value, const float scale) {
+    const float position_std = 2.0f * POSITION_NOISE * scale;
+    const float velocity_std = 10.0f * VELOCITY_NOISE * scale;
+    axis.value = value;
+    axis.velocity = 0.0f;
+    axis.var_value = position_std * position_std;
+    axis.cov = 0.0f;
+    axis.var_velocity = velocity_std * velocity_std;
+}
+
+void predict_axis(Track::Axis& axis, const float scale) {
+    const float position_std = POSITION_NOISE * scale;
+    const float velocity_std = VELOCITY_NOISE * scale;
+    axis.value += axis.velocity;
+    axis.var_value += 2.0f * axis.cov + axis.var_velocity + position_std * position_std;
+    axis.cov += axis.var_velocity;
+    axis.var_velocity += velocity_std * velocity_std;
+}
+
+void correct_axis(Track::Axis& axis, const float measurement, const float scale) {
+    const float measurement_std = POSITION_NOISE * scale;
+    const float innovation_var = axis.var_value + measurement_std * measurement_std;
+    const float gain_value = axis.var_value / innovation_var;
+    const float gain_velocity = axis.cov / innovation_var;
+    const float innovation = measurement - axis.value;
+    axis.value += gain_value * innovation;
+    axis.velocity += gain_velocity * innovation;
+    axis.var_velocity -= gain_velocity * axis.cov;
+    axis.var_value *= 1.0f - gain_value;
+    axis.cov *= 1.0f - gain_value;
+}
+
+cv::Rect2f get_track_rect(const Track& track) {
+    const float width = std::max(track.axes[WIDTH].value, MIN_SIZE);
+    const float height = std::max(track.axes[HEIGHT].value, MIN_SIZE);
+    return cv::Rect2f(track.axes[CENTER_X].value - width / 2.0f,
+                      track.axes[CENTER_Y].value - height / 2.0f, width, height);
+}
+
+/**
+ * @brief ノイズの大きさの基準（枠の高さ）
+ *
+ */
+float get_noise_scale(const Track& track) { return std::max(track.axes[HEIGHT].value, MIN_SIZE); }
+
+void correct_track(Track& track, const cv::Rect2f& rect) {
+    const float scale = get_noise_scale(track);
+    correct_axis(track.axes[CENTER_X], rect.x + rect.width / 2.0f, scale);
+    correct_axis(track.axes[CENTER_Y], rect.y + rect.height / 2.0f, scale);
+    correct_axis(track.axes[WIDTH], rect.width, scale);
+    correct_axis(track.axes[HEIGHT], rect.height, scale);
+}
+
+float compute_iou(const cv::Rect2f& a, const cv::Rect2f& b) {
+    const float intersection = (a & b).area();
+    const float union_area = a.area() + b.area() - intersection;
+    return union_area > 0.0f ? intersection / union_area : 0.0f;
+}
+
+/**
+ * @brief 中央値を求める（値の並びは変わる）
+ *
+ */
+float median(std::vector<float>& values) {
+    const auto middle = values.begin() + values.size() / 2;
+    std::nth_element(values.begin(), middle, values.end());
+    return *middle;
+}
+
+}  // namespace
+
+BBoxTracker::BBoxTracker(const TrackerConfig& config) : config(config) {
+    if (config.detection_interval == 0) {
+        throw std::invalid_argument("detection_interval must be greater than 0");
+    }
+    if (config.optical_flow && config.flow_width <= 0) {
+        throw std::invalid_argument("flow_width must be greater than 0");
+    }
+    reset();
+}
+
+bool BBoxTracker::needs_detection(void) const {
+    if (frames_since_detection + 1 >= config.detection_interval) {
+        return true;
+    }
+    for (const Track& track : tracks) {
+        if (track.num_missed == 0 &&
+            track.confidence < track.detected_confidence * config.min_confidence_ratio) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void BBoxTracker::update_gray(const cv::Mat& image) {
+    std::swap(previous_gray, current_gray);
+    const int height =
+        std::max(1, static_cast<int>(static_cast<long long>(image.rows) * config.flow_width /
+                                     std::max(image.cols, 1)));
+    cv::resize(image, resized_image, cv::Size(config.flow_width, height), 0, 0, cv::INTER_AREA);
+    if (resized_image.channels() == 1) {
+        resized_image.copyTo(current_gray);
+    } else {
+        cv::cvtColor(resized_image, current_gray, cv::COLOR_BGR2GRAY);
+    }
+}
+
+void BBoxTracker::predict_tracks(void) {
+    for (Track& track : tracks) {
+        const float scale = get_noise_scale(track);
+        for (Track::Axis& axis : track.axes) {
+            predict_axis(axis, scale);
+        }
+    }
+}
+
+void BBoxTracker::estimate_flow(void) {
+    track_shifts.assign(tracks.size(), cv::Point2f(0.0f, 0.0f));
+    track_shift_valid.assign(tracks.size(), false);
+    if (previous_gray.empty() || previous_gray.size() != current_gray.size()) {
+        return;
+    }
+
+    // 見えている物体の枠の内側に格子状に点を置く（枠の端は背景を含みやすいため避ける）
+    const float image_width = static_cast<float>(current_gray.cols);
+    const float image_height = static_cast<float>(current_gray.rows);
+    flow_points.clear();
+    for (const Track& track : tracks) {
+        if (track.num_missed > 0) {
+            continue;
+        }
+        const cv::Rect2f rect = get_track_rect(track);
+        for (int gy = 0; gy < GRID_SIZE; gy++) {
+            for (int gx = 0; gx < GRID_SIZE; gx++) {
+                const float x = rect.x + rect.width * (0.2f + 0.6f * (gx + 0.5f) / GRID_SIZE);
+                const float y = rect.y + rect.height * (0.2f + 0.6f * (gy + 0.5f) / GRID_SIZE);
+                flow_points.emplace_back(std::clamp(x, 0.0f, 1.0f) * (image_width - 1.0f),
+                                         std::clamp(y, 0.0f, 1.0f) * (image_height - 1.0f));
+            }
+        }
+    }
+    if (flow_points.empty()) {
+        return;
+    }
+
+    cv::calcOpticalFlowPyrLK(previous_gray, current_gray, flow_points, flow_next_points,
+                             flow_status, flow_errors, cv::Size(15, 15), 2);
+
+    // 物体ごとに、追跡できた点の移動量の中央値を物体の移動量とする
+    std::size_t point = 0;
+    for (std::size_t t = 0; t < tracks.size(); t++) {
+        if (tracks[t].num_missed > 0) {
+            continue;
+        }
+        shifts_x.clear();
+        shifts_y.clear();
+        for (int i = 0; i < GRID_SIZE * GRID_SIZE; i++, point++) {
+            if (flow_status[point]) {
+                shifts_x.push_back(flow_next_points[point].x - flow_points[point].x);
+                shifts_y.push_back(flow_next_points[point].y - flow_points[point].y);
+            }
+        }
+        if (shifts_x.size() >= MIN_FLOW_POINTS) {
+            track_shifts[t] =
+                cv::Point2f(median(shifts_x) / image_width, median(shifts_y) / image_height);
+            track_shift_valid[t] = true;
+        }
+    }
+}
+
+void BBoxTracker::update(const cv::Mat& image, const BBoxList& detections) {
+    if (config.optical_flow) {
+        update_gray(image);
+    }
+    predict_tracks();
+
+    // 同じラベルでIoUが閾値以上の組を、IoUの大きい順に対応付ける
+    const std::vector<cv::Rect2f>& rects = detections.get_rects();
+    const std::vector<int>& labels = detections.get_labels();
+    const std::vector<float>& confidences = detections.get_confidences();
+    candidates.clear();
+    for (std::size_t t = 0; t < tracks.size(); t++) {
+        const cv::Rect2f track_rect = get_track_rect(tracks[t]);
+        for (std::size_t d = 0; d < detections.size(); d++) {
+            if (confidences[d] < config.detection_threshold || labels[d] != tracks[t].label) {
+                continue;
+            }
+            const float iou = compute_iou(track_rect, rects[d]);
+            if (iou >= config.iou_threshold) {
+                candidates.push_back({iou, t, d});
+            }
+        }
+    }
+    std::stable_sort(candidates.begin(), candidates.end(),
+                     [](const Candidate& a, const Candidate& b) { return a.iou > b.iou; });
+
+    track_matched.assign(tracks.size(), false);
+    detection_matched.assign(detections.size(), false);
+    for (const Candidate& candidate : candidates) {
+        if (track_matched[candidate.track] || detection_matched[candidate.detection]) {
+            continue;
+        }
+        track_matched[candidate.track] = true;
+        detection_matched[candidate.detection] = true;
+        Track& track = tracks[candidate.track];
+        correct_track(track, rects[candidate.detection]);
+        track.confidence = confidences[candidate.detection];
+        track.detected_confidence = track.confidence;
+        track.num_missed = 0;
+    }
+
+    // 見つからなかった物体は、一定回数を超えたら追跡をやめる
+    std::size_t num_kept = 0;
+    for (std::size_t t = 0; t < tracks.size(); t++) {
+        if (!track_matched[t] && ++tracks[t].num_missed > config.max_missed) {
+            continue;
+        }
+        if (num_kept != t) {
+            tracks[num_kept] = tracks[t];
+        }
+        num_kept++;
+    }
+    tracks.resize(num_kept);
+
+    // 対応付けられなかった検知結果から追跡を始める
+    for (std::size_t d = 0; d < detections.size(); d++) {
+        if (detection_matched[d] || confidences[d] < config.detection_threshold) {
+            continue;
+        }
+        const cv::Rect2f& rect = rects[d];
+        Track track;
+        track.id = next_id++;
+        track.label = labels[d];
+        track.confidence = confidences[d];
+        track.detected_confidence = track.confidence;
+        const float scale = std::max(rect.height, MIN_SIZE);
+        init_axis(track.axes[CENTER_X], rect.x + rect.width / 2.0f, scale);
+        init_axis(track.axes[CENTER_Y], rect.y + rect.height / 2.0f, scale);
+        init_axis(track.axes[WIDTH], rect.width, scale);
+        init_axis(track.axes[HEIGHT], rect.height, scale);
+        tracks.push_back(track);
+    }
+
+    frames_since_detection = 0;
+    update_output();
+}
+
+void BBoxTracker::predict(const cv::Mat& image) {
+    frames_since_detection++;
+
+    // 移動量は予測前の枠の位置で求める
+    if (config.optical_flow) {
+        update_gray(image);
+        estimate_flow();
+    }
+    previous_rects.clear();
+    if (config.optical_flow) {
+        for (const Track& track : tracks) {
+            previous_rects.push_back(get_track_rect(track));
+        }
+    }
+
+    predict_tracks();
+    for (std::size_t t = 0; t < tracks.size(); t++) {
+        Track& track = tracks[t];
+        track.confidence *= config.confidence_decay;
+        if (!config.optical_flow || track.num_missed > 0) {
+            continue;
+        }
+        if (track_shift_valid[t]) {
+            // 前フレームの中心を移動量だけずらした位置を観測として中心を補正する
+            const float scale = get_noise_scale(track);
+            const cv::Rect2f& rect = previous_rects[t];
+            correct_axis(track.axes[CENTER_X], rect.x + rect.width / 2.0f + track_shifts[t].x,
+                         scale);
+            correct_axis(track.axes[CENTER_Y], rect.y + rect.height / 2.0f + track_shifts[t].y,
+                         scale);
+        } else {
+            // 移動量を求められない（隠れた・画面外へ出た）物体は早めに検知で確かめる
+            track.confidence *= config.flow_failure_decay;
+        }
+    }
+
+    update_output();
+}
+
+void BBoxTracker::reset(void) {
+    tracks.clear();
+    frames_since_detection = config.detection_interval;
+    previous_gray.release();
+    current_gray.release();
+    update_output();
+}
+
+void BBoxTracker::update_output(void) {
+    // 検知で見つからなかった物体はIDを保持するだけで出力しない
+    bboxes.clear();
+    track_ids.clear();
+    for (const Track& track : tracks) {
+        if (track.num_missed == 0) {
+            bboxes.push_back(get_track_rect(track), track.label, track.confidence);
+            track_ids.push_back(track.id);
+        }
+    }
+}
+
+const BBoxList& BBoxTracker::get_bboxes(void) const { return bboxes; }
+
+const std::vector<std::uint64_t>& BBoxTracker::get_track_ids(void) const { return track_ids; }
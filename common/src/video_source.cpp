@@ -0,0 +1,141 @@
+#include "video_source.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <iomanip>
+#include <stdexcept>
+
+std::ostream& operator<<(std::ostream& os, const VideoSourceStats& stats) {
+    const auto flags = os.flags();
+    const auto precision = os.precision();
+    os << std::fixed << std::setprecision(1);
+    os << "captured " << stats.num_captured << " (" << stats.capture_fps << " fps), delivered "
+       << stats.num_delivered << " (" << stats.delivered_fps << " fps), dropped "
+       << stats.num_dropped;
+    os.flags(flags);
+    os.precision(precision);
+    return os;
+}
+
+VideoSource::VideoSource(const std::string& source, const VideoSourceConfig& config)
+    : config(config) {
+    if (config.drop_policy != DropPolicy::LatestFrame && config.queue_capacity == 0) {
+        throw std::invalid_argument("Queue capacity must be at least 1");
+    }
+
+    // 数字だけならカメラ番号として開く
+    const bool is_camera =
+        !source.empty() && std::all_of(source.begin(), source.end(),
+                                       [](unsigned char c) { return std::isdigit(c) != 0; });
+    if (is_camera) {
+        capture.open(std::stoi(source));
+    } else {
+        capture.open(source);
+    }
+    if (!capture.isOpened()) {
+        throw std::runtime_error("Could not open video source: " + source);
+    }
+
+    source_fps = capture.get(cv::CAP_PROP_FPS);
+    frame_size = cv::Size(static_cast<int>(capture.get(cv::CAP_PROP_FRAME_WIDTH)),
+                          static_cast<int>(capture.get(cv::CAP_PROP_FRAME_HEIGHT)));
+
+    start_time = std::chrono::steady_clock::now();
+    capture_thread = std::thread(&VideoSource::run_capture, this);
+}
+
+VideoSource::~VideoSource(void) {
+    stop();
+    if (capture_thread.joinable()) {
+        capture_thread.join();
+    }
+}
+
+void VideoSource::run_capture(void) {
+    const std::size_t capacity =
+        config.drop_policy == DropPolicy::LatestFrame ? 1 : config.queue_capacity;
+    const bool paced = config.realtime && source_fps > 0.0;
+    const auto frame_interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(paced ? 1.0 / source_fps : 0.0));
+    auto next_capture = std::chrono::steady_clock::now();
+
+    std::uint64_t index = 0;
+    while (true) {
+        if (paced) {
+            // 録画ファイルをライブ映像と同じ間隔で取り込む
+            std::this_thread::sleep_until(next_capture);
+            next_capture += frame_interval;
+        }
+
+        VideoFrame frame;
+        if (!capture.read(frame.image) || frame.image.empty()) {
+            break;
+        }
+        frame.index = index++;
+        frame.captured_at = std::chrono::steady_clock::now();
+        num_captured++;
+
+        std::unique_lock<std::mutex> lock(mutex);
+        if (config.drop_policy == DropPolicy::Block) {
+            space_cv.wait(lock, [&]() { return stopped || frames.size() < capacity; });
+        }
+        if (stopped) {
+            break;
+        }
+        while (frames.size() >= capacity) {
+            frames.pop_front();
+            num_dropped++;
+        }
+        frames.push_back(std::move(frame));
+        lock.unlock();
+        frame_cv.notify_one();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished = true;
+    }
+    frame_cv.notify_all();
+    capture.release();
+}
+
+bool VideoSource::read(VideoFrame& frame) {
+    std::unique_lock<std::mutex> lock(mutex);
+    frame_cv.wait(lock, [this]() { return stopped || finished || !frames.empty(); });
+    if (stopped || frames.empty()) {
+        return false;
+    }
+    frame = std::move(frames.front());
+    frames.pop_front();
+    num_delivered++;
+    lock.unlock();
+    space_cv.notify_one();
+    return true;
+}
+
+void VideoSource::stop(void) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopped = true;
+    }
+    frame_cv.notify_all();
+    space_cv.notify_all();
+}
+
+double VideoSource::get_source_fps(void) const { return source_fps; }
+
+cv::Size VideoSource::get_frame_size(void) const { return frame_size; }
+
+VideoSourceStats VideoSource::get_stats(void) const {
+    VideoSourceStats stats;
+    stats.num_captured = num_captured.load();
+    stats.num_delivered = num_delivered.load();
+    stats.num_dropped = num_dropped.load();
+    const double elapsed_s =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    if (elapsed_s > 0.0) {
+        stats.capture_fps = stats.num_captured / elapsed_s;
+        stats.delivered_fps = stats.num_delivered / elapsed_s;
+    }
+    return stats;
+}
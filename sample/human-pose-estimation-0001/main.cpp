@@ -0,0 +1,309 @@
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <opencv2/opencv.hpp>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "image_io.hpp"
+#include "openvino_task.hpp"
+#include "pipeline.hpp"
+#include "result_sink.hpp"
+#include "video_source.hpp"
+
+namespace fs = std::filesystem;
+
+// 同時に推論する画像数の既定値（推論リクエスト数と推論段階のワーカー数、--num-requestsで変更できる）
+const std::size_t NUM_INFER_REQUESTS = 2;
+
+// 段階間のキューの容量
+const std::size_t QUEUE_CAPACITY = 8;
+
+// 推論に先行してデコードしておく画像数
+const std::size_t READAHEAD = 16;
+
+/**
+ * @brief パイプラインを流れる1画像分のデータ
+ *
+ */
+struct Frame {
+    std::uint64_t index = 0;
+    fs::path input_path;
+    fs::path output_path;
+    cv::Mat image;
+    std::vector<Pose> poses;
+};
+
+const std::array<std::pair<int, int>, 19> SKELETON = {{{15, 13},
+                                                       {13, 11},
+                                                       {16, 14},
+                                                       {14, 12},
+                                                       {11, 12},
+                                                       {5, 11},
+                                                       {6, 12},
+                                                       {5, 6},
+                                                       {5, 7},
+                                                       {6, 8},
+                                                       {7, 9},
+                                                       {8, 10},
+                                                       {1, 2},
+                                                       {0, 1},
+                                                       {0, 2},
+                                                       {1, 3},
+                                                       {2, 4},
+                                                       {3, 5},
+                                                       {4, 6}}};
+
+const std::array<cv::Scalar, 19> COLORS = {
+    cv::Scalar(255, 0, 0),   cv::Scalar(255, 0, 0),   cv::Scalar(255, 0, 255),
+    cv::Scalar(170, 0, 255), cv::Scalar(255, 0, 85),  cv::Scalar(255, 0, 170),
+    cv::Scalar(85, 255, 0),  cv::Scalar(255, 170, 0), cv::Scalar(0, 255, 0),
+    cv::Scalar(255, 255, 0), cv::Scalar(0, 255, 85),  cv::Scalar(170, 255, 0),
+    cv::Scalar(0, 85, 255),  cv::Scalar(0, 255, 170), cv::Scalar(0, 0, 255),
+    cv::Scalar(0, 255, 255), cv::Scalar(85, 0, 255),  cv::Scalar(0, 170, 255),
+    cv::Scalar(0, 170, 255)};
+
+void draw_poses(cv::Mat& image, const std::vector<Pose>& poses,
+                const float confidence_thr = 0.1) {
+    const int image_width = image.cols;
+    const int image_height = image.rows;
+
+    for (const Pose& pose : poses) {
+        const std::vector<KeyPoint>& keypoints = pose.get_keypoints();
+        for (std::size_t i = 0; i < SKELETON.size(); i++) {
+            const KeyPoint& keypoint1 = keypoints[SKELETON[i].first];
+            const KeyPoint& keypoint2 = keypoints[SKELETON[i].second];
+            if (keypoint1.get_confidence() < confidence_thr ||
+                keypoint2.get_confidence() < confidence_thr) {
+                continue;
+            }
+
+            // 座標を正規化前に戻して描画
+            const cv::Point pt1(keypoint1.get_x() * image_width, keypoint1.get_y() * image_height);
+            const cv::Point pt2(keypoint2.get_x() * image_width, keypoint2.get_y() * image_height);
+            cv::line(image, pt1, pt2, COLORS[i], 2);
+            cv::circle(image, pt1, 4, COLORS[i], -1, cv::FILLED);
+            cv::circle(image, pt2, 4, COLORS[i], -1, cv::FILLED);
+        }
+    }
+}
+
+void write_results(ResultSink& sink, const std::string& source, const std::uint64_t index,
+                   const cv::Mat& image, const std::vector<Pose>& poses) {
+    // 骨格はすでに画像全体に対する正規化座標のため、KeyPointListへ詰め替えるだけでよい
+    std::vector<KeyPointList> keypoints_list(poses.size());
+    for (std::size_t i = 0; i < poses.size(); i++) {
+        for (const KeyPoint& keypoint : poses[i].get_keypoints()) {
+            keypoints_list[i].push_back(keypoint.get_x(), keypoint.get_y(),
+                                        keypoint.get_confidence());
+        }
+    }
+    sink.write(source, index, image.size(), BBoxList(), std::vector<std::uint64_t>(),
+               keypoints_list);
+}
+
+void process_video(EmbeddedMultiPoseDetector& detector, const std::string& source,
+                   const fs::path& output_dir, ResultSink* sink, const bool render) {
+    // 録画ファイルもライブ映像と同じ間隔で取り込み、推論が遅ければ古いフレームを捨てる
+    VideoSourceConfig source_config;
+    source_config.drop_policy = DropPolicy::LatestFrame;
+    source_config.realtime = true;
+    VideoSource video(source, source_config);
+
+    // 結果の動画（描画しない場合は作らない）
+    const fs::path output_path = output_dir / (fs::path(source).stem().string() + ".avi");
+    const double fps = video.get_source_fps() > 0.0 ? video.get_source_fps() : 30.0;
+    cv::VideoWriter writer;
+    if (render && !writer.open(output_path.string(), cv::VideoWriter::fourcc('M', 'J', 'P', 'G'),
+                               fps, video.get_frame_size())) {
+        throw std::runtime_error("Could not open output video: " + output_path.string());
+    }
+
+    // 1フレームずつ処理
+    VideoFrame frame;
+    while (video.read(frame)) {
+        auto poses = detector.task(frame.image);
+        if (sink != nullptr) {
+            write_results(*sink, source, frame.index, frame.image, poses);
+        }
+        if (render) {
+            draw_poses(frame.image, poses);
+            writer.write(frame.image);
+        }
+    }
+
+    std::cout << "Video: " << video.get_stats() << std::endl;
+}
+
+int main(int argc, char** argv) {
+    // 数値だけの結果の出力先（--results=<path>、拡張子が.jsonlならJSONL、それ以外はバイナリ）と、
+    // 結果を画像に描画して書き出すかどうか（--no-renderで描画・エンコードを省く）
+    std::string results_path;
+    bool render = true;
+    // 読み込み設定（--performance-mode=latencyなど）
+    ModelConfig base_config;
+    base_config.num_requests = NUM_INFER_REQUESTS;
+    ModelConfig config;
+    try {
+        // サンプルの引数を取り除いてから、残りを読み込み設定として解析する
+        int num_remaining = 1;
+        for (int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            if (arg.rfind("--results=", 0) == 0) {
+                results_path = arg.substr(10);
+            } else if (arg == "--no-render") {
+                render = false;
+            } else {
+                argv[num_remaining++] = argv[i];
+            }
+        }
+        argc = num_remaining;
+        config = parse_model_config_args(argc, argv, base_config);
+    } catch (const std::exception& e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (argc != 4) {
+        std::cerr << "Usage: " << argv[0]
+                  << " [--results=<path>] [--no-render] <pose_model_path> <input_dir|video>"
+                     " <output_dir>"
+                  << std::endl
+                  << get_model_config_usage();
+        return EXIT_FAILURE;
+    }
+
+    const fs::path model_path = argv[1];
+    const fs::path input_dir = argv[2];
+    const fs::path output_dir = argv[3];
+
+    // 出力ディレクトリの確認、なければ作成
+    if (!fs::exists(output_dir)) {
+        if (!fs::create_directories(output_dir)) {
+            std::cerr << "Error: Could not create output directory: " << output_dir << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    EmbeddedMultiPoseDetector detector(model_path.string(), config);
+    std::cout << "Model config: " << config << std::endl;
+    std::cout << "Model loaded: " << detector.get_load_report() << std::endl;
+
+    std::unique_ptr<ResultSink> sink;
+    if (!results_path.empty()) {
+        try {
+            sink = std::make_unique<ResultSink>(results_path, get_result_format(results_path));
+        } catch (const std::exception& e) {
+            std::cerr << "Exception: " << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    // 入力がディレクトリでなければ動画（ファイル・ストリームのURL・カメラ番号）として処理
+    if (!fs::is_directory(input_dir)) {
+        try {
+            process_video(detector, input_dir.string(), output_dir, sink.get(), render);
+            if (sink) {
+                sink->flush();
+                std::cout << "Results: " << sink->get_num_written() << " frames" << std::endl;
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Exception: " << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+        std::cout << "Profile: " << detector.get_profile() << std::endl;
+        return EXIT_SUCCESS;
+    }
+
+    // 入力画像の一覧
+    std::vector<std::string> input_paths;
+    for (const auto& entry : fs::directory_iterator(input_dir)) {
+        if (entry.is_regular_file()) {
+            input_paths.push_back(entry.path().string());
+        }
+    }
+
+    // JPEGのデコード・エンコードは推論と並行して複数スレッドで行う
+    const std::size_t num_io_workers = std::max(1U, std::thread::hardware_concurrency() / 2);
+    ImageReader reader(input_paths, num_io_workers, READAHEAD);
+    ImageWriter writer(num_io_workers, QUEUE_CAPACITY,
+                       [](const std::string& path, std::exception_ptr exception) {
+                           try {
+                               std::rethrow_exception(exception);
+                           } catch (const std::exception& e) {
+                               std::cerr << "Exception: " << e.what() << std::endl;
+                           }
+                       });
+
+    Pipeline<Frame> pipeline(QUEUE_CAPACITY);
+    pipeline.add_stage(
+        "infer", [&detector](Frame& frame) { frame.poses = detector.task(frame.image); },
+        config.num_requests);
+    if (render) {
+        pipeline.add_stage(
+            "render", [](Frame& frame) { draw_poses(frame.image, frame.poses); },
+            num_io_workers);
+    }
+
+    pipeline.start([&writer, &sink, render](Frame& frame, std::exception_ptr exception) {
+        try {
+            if (exception) {
+                std::rethrow_exception(exception);
+            }
+            if (sink) {
+                write_results(*sink, frame.input_path.string(), frame.index, frame.image,
+                              frame.poses);
+            }
+            if (render) {
+                // エンコードと書き込みは書き込み用のスレッドで行う
+                writer.write(frame.output_path.string(), frame.image);
+            }
+            std::cout << "Processed file: " << frame.input_path << std::endl;
+        } catch (const ov::Exception& e) {
+            std::cerr << "OpenVINO Exception: " << e.what() << std::endl;
+        } catch (const std::exception& e) {
+            std::cerr << "Exception: " << e.what() << std::endl;
+        }
+    });
+
+    // デコード済みの画像をパイプラインへ投入（詰まっている間は待機する）
+    DecodedImage decoded;
+    std::uint64_t index = 0;
+    while (reader.next(decoded)) {
+        if (decoded.exception) {
+            try {
+                std::rethrow_exception(decoded.exception);
+            } catch (const std::exception& e) {
+                std::cerr << "Exception: " << e.what() << std::endl;
+            }
+            continue;
+        }
+        Frame frame;
+        frame.index = index++;
+        frame.input_path = decoded.path;
+        frame.output_path = output_dir / frame.input_path.filename();
+        frame.image = std::move(decoded.image);
+        pipeline.push(std::move(frame));
+    }
+    pipeline.wait();
+    writer.wait();
+    if (sink) {
+        try {
+            sink->flush();
+        } catch (const std::exception& e) {
+            std::cerr << "Exception: " << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+        std::cout << "Results: " << sink->get_num_written() << " frames" << std::endl;
+    }
+
+    // 処理段階ごとのレイテンシ
+    std::cout << "Profile: " << detector.get_profile() << std::endl;
+
+    return EXIT_SUCCESS;
+}
@@ -1,12 +1,38 @@
+#include <algorithm>
 #include <filesystem>
 #include <iostream>
+#include <memory>
 #include <opencv2/opencv.hpp>
+#include <stdexcept>
+#include <string>
+#include <thread>
 #include <vector>
 
+#include "image_io.hpp"
 #include "openvino_task.hpp"
+#include "pipeline.hpp"
+#include "pose_cache.hpp"
+#include "result_sink.hpp"
+#include "tracker.hpp"
+#include "video_source.hpp"
 
 namespace fs = std::filesystem;
 
+// 骨格抽出で1回の推論にまとめる最大人数
+const std::size_t POSE_BATCH_SIZE = 16;
+
+// 同時に推論する画像数の既定値（推論リクエスト数と推論段階のワーカー数、--num-requestsで変更できる）
+const std::size_t NUM_INFER_REQUESTS = 2;
+
+// 段階間のキューの容量
+const std::size_t QUEUE_CAPACITY = 8;
+
+// 推論に先行してデコードしておく画像数
+const std::size_t READAHEAD = 16;
+
+// 人物とみなす検知結果の確信度の閾値
+const float CONFIDENCE_THRESHOLD = 0.2f;
+
 const std::array<std::pair<int, int>, 19> SKELETON = {{{15, 13},
                                                        {13, 11},
                                                        {16, 14},
@@ -36,7 +62,7 @@ const std::array<cv::Scalar, 19> COLORS = {
     cv::Scalar(0, 255, 255), cv::Scalar(85, 0, 255),  cv::Scalar(0, 170, 255),
     cv::Scalar(0, 170, 255)};
 
-void draw_skeleton(cv::Mat& image, const std::vector<KeyPoint>& keypoints,
+void draw_skeleton(cv::Mat& image, const KeyPointList& keypoints,
                    const float confidence_thr = 0.001) {
     const int image_width = image.cols;
     const int image_height = image.rows;
@@ -44,8 +70,8 @@ void draw_skeleton(cv::Mat& image, const std::vector<KeyPoint>& keypoints,
     for (int i = 0; i < SKELETON.size(); i++) {
         const auto& pair = SKELETON[i];
         const auto& color = COLORS[i];
-        const KeyPoint keypoint1 = keypoints[pair.first];
-        const KeyPoint keypoint2 = keypoints[pair.second];
+        const KeyPoint keypoint1 = keypoints.get(pair.first);
+        const KeyPoint keypoint2 = keypoints.get(pair.second);
         if (keypoint1.get_confidence() < confidence_thr ||
             keypoint2.get_confidence() < confidence_thr) {
             continue;
@@ -64,24 +90,30 @@ void draw_skeleton(cv::Mat& image, const std::vector<KeyPoint>& keypoints,
     }
 }
 
-void process_image(DetectorBBox7& detector, PoseDetector& pose_detector, const fs::path input_path,
-                   const fs::path output_path, const double confidence_thr = 0.2) {
-    // 画像読み込み
-    cv::Mat image = cv::imread(input_path.string());
-    if (image.empty()) {
-        std::cerr << "Error: Could not open or find the image: " << input_path << std::endl;
-        return;
-    }
+/**
+ * @brief パイプラインを流れる1画像分のデータ
+ *
+ */
+struct Frame {
+    std::uint64_t index = 0;
+    fs::path input_path;
+    fs::path output_path;
+    cv::Mat image;
+    BBoxList bboxes;  // 人物の枠（正規化座標、rectsと同じ順）
+    std::vector<cv::Rect> rects;
+    std::vector<std::uint64_t> track_ids;
+    std::vector<KeyPointList> keypoints_list;
+};
 
-    // 可視化用の画像準備
-    cv::Mat image_out = image.clone();
-    const int image_width = image_out.cols;
-    const int image_height = image_out.rows;
+void detect_persons(EmbeddedDetectorBBox7& detector, Frame& frame,
+                    const double confidence_thr = CONFIDENCE_THRESHOLD) {
+    const int image_width = frame.image.cols;
+    const int image_height = frame.image.rows;
 
     // タスク実行
-    auto bboxes = detector.task(image);
+    auto bboxes = detector.task(frame.image);
 
-    // BBoxごとに骨格抽出
+    // BBoxごとに人物の領域を求める
     for (BBox bbox : bboxes) {
         // 確信度が閾値以下なら無視
         if (bbox.get_confidence() < confidence_thr) {
@@ -94,27 +126,169 @@ void process_image(DetectorBBox7& detector, PoseDetector& pose_detector, const f
         const int ymin = static_cast<int>(rect.y * image_height);
         const int xmax = static_cast<int>(rect.width * image_width) + xmin;
         const int ymax = static_cast<int>(rect.height * image_height) + ymin;
-        cv::Rect rect_collect(cv::Point(xmin, ymin), cv::Point(xmax, ymax));
-        cv::Mat cropped_image = image(rect_collect);
+        frame.rects.emplace_back(cv::Point(xmin, ymin), cv::Point(xmax, ymax));
+        frame.bboxes.push_back(rect, bbox.get_label(), bbox.get_confidence());
+    }
+}
 
-        // 骨格抽出
-        std::vector<KeyPoint> keypoints = pose_detector.task(cropped_image);
+void estimate_poses(PoseDetector& pose_detector, Frame& frame) {
+    // 人物を切り出し、全人物の骨格をまとめて抽出
+    std::vector<cv::Mat> cropped_images;
+    for (const cv::Rect& rect : frame.rects) {
+        cropped_images.push_back(frame.image(rect));
+    }
+    frame.keypoints_list.resize(cropped_images.size());
+    pose_detector.task(cropped_images, frame.keypoints_list);
+}
 
-        // 結果の描画
-        cv::Mat roi(image_out, rect_collect);
-        draw_skeleton(roi, keypoints);
-        cropped_image.release();
+void track_persons(TrackingDetector<EmbeddedDetectorBBox7>& tracking_detector, Frame& frame,
+                   const double confidence_thr = CONFIDENCE_THRESHOLD) {
+    // 数フレームごとに検知し、間のフレームは追跡で人物の枠を動かす
+    tracking_detector.process(frame.image);
+    const BBoxList& bboxes = tracking_detector.get_bboxes();
+    const std::vector<std::uint64_t>& track_ids = tracking_detector.get_track_ids();
+
+    const cv::Rect image_rect(0, 0, frame.image.cols, frame.image.rows);
+    for (std::size_t i = 0; i < bboxes.size(); i++) {
+        if (bboxes.get_confidences()[i] < confidence_thr) {
+            continue;
+        }
+
+        // 座標情報を正規化前に戻し、画像内に収める（追跡した枠は画像外へはみ出すことがある）
+        const cv::Rect2f& rect = bboxes.get_rects()[i];
+        const int xmin = static_cast<int>(rect.x * frame.image.cols);
+        const int ymin = static_cast<int>(rect.y * frame.image.rows);
+        const int xmax = static_cast<int>(rect.width * frame.image.cols) + xmin;
+        const int ymax = static_cast<int>(rect.height * frame.image.rows) + ymin;
+        const cv::Rect clipped =
+            cv::Rect(cv::Point(xmin, ymin), cv::Point(xmax, ymax)) & image_rect;
+        if (clipped.empty()) {
+            continue;
+        }
+        frame.rects.push_back(clipped);
+        frame.bboxes.push_back(rect, bboxes.get_labels()[i], bboxes.get_confidences()[i]);
+        frame.track_ids.push_back(track_ids[i]);
     }
+}
 
-    // 結果の書き込み
-    cv::imwrite(output_path.string(), image_out);
+void draw_skeletons(Frame& frame) {
+    // 推論が終わった後なので入力画像へ直接描画する
+    for (std::size_t i = 0; i < frame.rects.size(); i++) {
+        cv::Mat roi(frame.image, frame.rects[i]);
+        draw_skeleton(roi, frame.keypoints_list[i]);
+    }
+}
+
+void write_results(ResultSink& sink, const std::string& source, const Frame& frame) {
+    // 骨格を切り出し画像に対する座標から画像全体に対する正規化座標へ変換する
+    const float image_width = static_cast<float>(frame.image.cols);
+    const float image_height = static_cast<float>(frame.image.rows);
+    std::vector<KeyPointList> poses(frame.keypoints_list.size());
+    for (std::size_t i = 0; i < frame.keypoints_list.size(); i++) {
+        const cv::Rect& rect = frame.rects[i];
+        const KeyPointList& keypoints = frame.keypoints_list[i];
+        for (std::size_t k = 0; k < keypoints.size(); k++) {
+            poses[i].push_back((rect.x + keypoints.get_xs()[k] * rect.width) / image_width,
+                               (rect.y + keypoints.get_ys()[k] * rect.height) / image_height,
+                               keypoints.get_confidences()[k]);
+        }
+    }
+    sink.write(source, frame.index, frame.image.size(), frame.bboxes, frame.track_ids, poses);
+}
+
+void process_video(EmbeddedDetectorBBox7& detector, PoseDetector& pose_detector,
+                   const std::string& source, const fs::path& output_dir,
+                   const TrackerConfig& tracker_config, const PoseCacheConfig& pose_cache_config,
+                   ResultSink* sink, const bool render) {
+    // 録画ファイルもライブ映像と同じ間隔で取り込み、推論が遅ければ古いフレームを捨てる
+    VideoSourceConfig source_config;
+    source_config.drop_policy = DropPolicy::LatestFrame;
+    source_config.realtime = true;
+    VideoSource video(source, source_config);
+
+    // 結果の動画（描画しない場合は作らない）
+    const fs::path output_path = output_dir / (fs::path(source).stem().string() + ".avi");
+    const double fps = video.get_source_fps() > 0.0 ? video.get_source_fps() : 30.0;
+    cv::VideoWriter writer;
+    if (render && !writer.open(output_path.string(), cv::VideoWriter::fourcc('M', 'J', 'P', 'G'),
+                               fps, video.get_frame_size())) {
+        throw std::runtime_error("Could not open output video: " + output_path.string());
+    }
+
+    // 1フレームずつ処理（ほとんど動いていない人物は前に推論した骨格を再利用する）
+    TrackingDetector<EmbeddedDetectorBBox7> tracking_detector(detector, tracker_config);
+    CachedPoseDetector<PoseDetector> cached_pose_detector(pose_detector, pose_cache_config);
+    VideoFrame frame;
+    Frame pose_frame;
+    while (video.read(frame)) {
+        pose_frame.index = frame.index;
+        pose_frame.image = frame.image;
+        pose_frame.bboxes.clear();
+        pose_frame.rects.clear();
+        pose_frame.track_ids.clear();
+        track_persons(tracking_detector, pose_frame);
+        cached_pose_detector.task(pose_frame.image, pose_frame.rects, pose_frame.track_ids,
+                                  pose_frame.keypoints_list);
+        if (sink != nullptr) {
+            write_results(*sink, source, pose_frame);
+        }
+        if (render) {
+            draw_skeletons(pose_frame);
+            writer.write(frame.image);
+        }
+    }
+
+    std::cout << "Video: " << video.get_stats() << ", detection ratio "
+              << tracking_detector.get_detection_ratio() << ", pose reuse ratio "
+              << cached_pose_detector.get_hit_ratio() << std::endl;
 }
 
 int main(int argc, char** argv) {
+    // 動画で人検知するフレーム間隔と、骨格を再利用する最大フレーム数（既定は毎フレーム推論する）
+    TrackerConfig tracker_config;
+    tracker_config.detection_interval = 1;
+    tracker_config.detection_threshold = CONFIDENCE_THRESHOLD;
+    PoseCacheConfig pose_cache_config;
+    pose_cache_config.max_age = 0;
+    // 数値だけの結果の出力先（--results=<path>、拡張子が.jsonlならJSONL、それ以外はバイナリ）と、
+    // 結果を画像に描画して書き出すかどうか（--no-renderで描画・エンコードを省く）
+    std::string results_path;
+    bool render = true;
+    // 読み込み設定（--performance-mode=latencyなど）
+    ModelConfig base_config;
+    base_config.num_requests = NUM_INFER_REQUESTS;
+    ModelConfig config;
+    try {
+        // サンプルの引数を取り除いてから、残りを読み込み設定として解析する
+        int num_remaining = 1;
+        for (int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            if (arg.rfind("--detection-interval=", 0) == 0) {
+                tracker_config.detection_interval = std::stoul(arg.substr(21));
+            } else if (arg.rfind("--pose-max-age=", 0) == 0) {
+                pose_cache_config.max_age = std::stoul(arg.substr(15));
+            } else if (arg.rfind("--results=", 0) == 0) {
+                results_path = arg.substr(10);
+            } else if (arg == "--no-render") {
+                render = false;
+            } else {
+                argv[num_remaining++] = argv[i];
+            }
+        }
+        argc = num_remaining;
+        config = parse_model_config_args(argc, argv, base_config);
+    } catch (const std::exception& e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
     if (argc != 5) {
         std::cerr << "Usage: " << argv[0]
-                  << " <detection_model_path> <pose_model_path> <input_dir> <output_dir>"
-                  << std::endl;
+                  << " [--detection-interval=<n>] [--pose-max-age=<n>] [--results=<path>]"
+                     " [--no-render] <detection_model_path> <pose_model_path> <input_dir|video>"
+                     " <output_dir>"
+                  << std::endl
+                  << get_model_config_usage();
         return EXIT_FAILURE;
     }
 
@@ -123,12 +297,6 @@ int main(int argc, char** argv) {
     const fs::path input_dir = argv[3];
     const fs::path output_dir = argv[4];
 
-    // 入力ディレクトリの確認
-    if (!fs::exists(input_dir) || !fs::is_directory(input_dir)) {
-        std::cerr << "Error: Input directory does not exist: " << input_dir << std::endl;
-        return EXIT_FAILURE;
-    }
-
     // 出力ディレクトリの確認、なければ作成
     if (!fs::exists(output_dir)) {
         if (!fs::create_directories(output_dir)) {
@@ -137,24 +305,133 @@ int main(int argc, char** argv) {
         }
     }
 
-    DetectorBBox7 detector(detection_model_path.string());
-    PoseDetector pose_detector(pose_model_path.string());
+    // 人検知と骨格検出は同じ読み込み設定を使い、骨格検出だけバッチ推論にする
+    const ModelConfig& detection_config = config;
+    EmbeddedDetectorBBox7 detector(detection_model_path.string(), detection_config);
+    // 閾値未満の人物の枠は後処理で作らない（骨格検出でも同じ閾値で捨てるため結果は変わらない）
+    DetectionFilter filter = detector.get_postprocessor().get_filter();
+    filter.confidence_threshold = CONFIDENCE_THRESHOLD;
+    detector.get_postprocessor().set_filter(filter);
+    ModelConfig pose_config = config;
+    pose_config.max_batch_size = POSE_BATCH_SIZE;
+    PoseDetector pose_detector(pose_model_path.string(), pose_config);
+    std::cout << "Model config: " << config << std::endl;
+    std::cout << "Detection model loaded: " << detector.get_load_report() << std::endl;
+    std::cout << "Pose model loaded: " << pose_detector.get_load_report() << std::endl;
+
+    std::unique_ptr<ResultSink> sink;
+    if (!results_path.empty()) {
+        try {
+            sink = std::make_unique<ResultSink>(results_path, get_result_format(results_path));
+        } catch (const std::exception& e) {
+            std::cerr << "Exception: " << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    // 入力がディレクトリでなければ動画（ファイル・ストリームのURL・カメラ番号）として処理
+    if (!fs::is_directory(input_dir)) {
+        try {
+            process_video(detector, pose_detector, input_dir.string(), output_dir, tracker_config,
+                          pose_cache_config, sink.get(), render);
+            if (sink) {
+                sink->flush();
+                std::cout << "Results: " << sink->get_num_written() << " frames" << std::endl;
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Exception: " << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+        std::cout << "Detection profile: " << detector.get_profile() << std::endl;
+        std::cout << "Pose profile: " << pose_detector.get_profile() << std::endl;
+        return EXIT_SUCCESS;
+    }
 
-    // 1画像ずつ読み込んで処理
+    // 入力画像の一覧
+    std::vector<std::string> input_paths;
     for (const auto& entry : fs::directory_iterator(input_dir)) {
+        if (entry.is_regular_file()) {
+            input_paths.push_back(entry.path().string());
+        }
+    }
+
+    // JPEGのデコード・エンコードは推論と並行して複数スレッドで行う
+    const std::size_t num_io_workers = std::max(1U, std::thread::hardware_concurrency() / 2);
+    ImageReader reader(input_paths, num_io_workers, READAHEAD);
+    ImageWriter writer(num_io_workers, QUEUE_CAPACITY,
+                       [](const std::string& path, std::exception_ptr exception) {
+                           try {
+                               std::rethrow_exception(exception);
+                           } catch (const std::exception& e) {
+                               std::cerr << "Exception: " << e.what() << std::endl;
+                           }
+                       });
+
+    Pipeline<Frame> pipeline(QUEUE_CAPACITY);
+    pipeline.add_stage(
+        "detect", [&detector](Frame& frame) { detect_persons(detector, frame); },
+        config.num_requests);
+    pipeline.add_stage(
+        "pose", [&pose_detector](Frame& frame) { estimate_poses(pose_detector, frame); },
+        config.num_requests);
+    if (render) {
+        pipeline.add_stage("render", draw_skeletons, num_io_workers);
+    }
+
+    pipeline.start([&writer, &sink, render](Frame& frame, std::exception_ptr exception) {
         try {
-            if (entry.is_regular_file()) {
-                fs::path input_path = entry.path();
-                fs::path output_path = output_dir / input_path.filename();
-                std::cout << "Processing file: " << input_path << std::endl;
-                process_image(detector, pose_detector, input_path, output_path);
+            if (exception) {
+                std::rethrow_exception(exception);
             }
+            if (sink) {
+                write_results(*sink, frame.input_path.string(), frame);
+            }
+            if (render) {
+                // エンコードと書き込みは書き込み用のスレッドで行う
+                writer.write(frame.output_path.string(), frame.image);
+            }
+            std::cout << "Processed file: " << frame.input_path << std::endl;
         } catch (const ov::Exception& e) {
             std::cerr << "OpenVINO Exception: " << e.what() << std::endl;
         } catch (const std::exception& e) {
             std::cerr << "Exception: " << e.what() << std::endl;
         }
+    });
+
+    // デコード済みの画像をパイプラインへ投入（詰まっている間は待機する）
+    DecodedImage decoded;
+    std::uint64_t index = 0;
+    while (reader.next(decoded)) {
+        if (decoded.exception) {
+            try {
+                std::rethrow_exception(decoded.exception);
+            } catch (const std::exception& e) {
+                std::cerr << "Exception: " << e.what() << std::endl;
+            }
+            continue;
+        }
+        Frame frame;
+        frame.index = index++;
+        frame.input_path = decoded.path;
+        frame.output_path = output_dir / frame.input_path.filename();
+        frame.image = std::move(decoded.image);
+        pipeline.push(std::move(frame));
+    }
+    pipeline.wait();
+    writer.wait();
+    if (sink) {
+        try {
+            sink->flush();
+        } catch (const std::exception& e) {
+            std::cerr << "Exception: " << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+        std::cout << "Results: " << sink->get_num_written() << " frames" << std::endl;
     }
 
+    // 処理段階ごとのレイテンシ
+    std::cout << "Detection profile: " << detector.get_profile() << std::endl;
+    std::cout << "Pose profile: " << pose_detector.get_profile() << std::endl;
+
     return EXIT_SUCCESS;
 }
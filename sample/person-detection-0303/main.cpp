@@ -1,49 +1,143 @@
+#include <algorithm>
 #include <filesystem>
 #include <iostream>
+#include <memory>
 #include <opencv2/opencv.hpp>
+#include <stdexcept>
+#include <string>
+#include <thread>
 #include <vector>
 
+#include "image_io.hpp"
 #include "openvino_task.hpp"
+#include "pipeline.hpp"
+#include "result_sink.hpp"
+#include "tracker.hpp"
+#include "video_source.hpp"
 
 namespace fs = std::filesystem;
 
-void process_image(DetectorBBox5Label1& detector, const fs::path input_path,
-                   const fs::path output_path, const double confidence_thr = 0.2) {
-    // 画像読み込み
-    cv::Mat image = cv::imread(input_path.string());
-    if (image.empty()) {
-        std::cerr << "Error: Could not open or find the image: " << input_path << std::endl;
-        return;
-    }
-    // タスク実行
-    auto bboxes = detector.task(image);
-
-    // 結果の可視化
-    cv::Mat image_out = image.clone();
-    const int image_width = image_out.cols;
-    const int image_height = image_out.rows;
-    for (BBox bbox : bboxes) {
+// 同時に推論する画像数の既定値（推論リクエスト数と推論段階のワーカー数、--num-requestsで変更できる）
+const std::size_t NUM_INFER_REQUESTS = 2;
+
+// 段階間のキューの容量
+const std::size_t QUEUE_CAPACITY = 8;
+
+// 推論に先行してデコードしておく画像数
+const std::size_t READAHEAD = 16;
+
+// 描画する検知結果の確信度の閾値（追跡を始める閾値にも使う）
+const float CONFIDENCE_THRESHOLD = 0.2f;
+
+/**
+ * @brief パイプラインを流れる1画像分のデータ
+ *
+ */
+struct Frame {
+    std::uint64_t index = 0;
+    fs::path input_path;
+    fs::path output_path;
+    cv::Mat image;
+    BBoxList bboxes;
+};
+
+void draw_bboxes(cv::Mat& image, const BBoxList& bboxes,
+                 const double confidence_thr = CONFIDENCE_THRESHOLD) {
+    const int image_width = image.cols;
+    const int image_height = image.rows;
+    for (std::size_t i = 0; i < bboxes.size(); i++) {
         // 確信度が閾値以下なら無視
-        if (bbox.get_confidence() < confidence_thr) {
+        if (bboxes.get_confidences()[i] < confidence_thr) {
             continue;
         }
-        cv::Rect2f rect = bbox.get_rect();
+        const cv::Rect2f& rect = bboxes.get_rects()[i];
         const int xmin = static_cast<int>(rect.x * image_width);
         const int ymin = static_cast<int>(rect.y * image_height);
         const int xmax = static_cast<int>(rect.width * image_width) + xmin;
         const int ymax = static_cast<int>(rect.height * image_height) + ymin;
-        cv::rectangle(image_out, cv::Point(xmin, ymin), cv::Point(xmax, ymax),
-                      cv::Scalar(255, 0, 0), 5);
+        cv::rectangle(image, cv::Point(xmin, ymin), cv::Point(xmax, ymax), cv::Scalar(255, 0, 0),
+                      5);
+    }
+}
+
+void process_video(EmbeddedDetectorBBox5Label1& detector, const std::string& source,
+                   const fs::path& output_dir, const TrackerConfig& tracker_config,
+                   ResultSink* sink, const bool render) {
+    // 録画ファイルもライブ映像と同じ間隔で取り込み、推論が遅ければ古いフレームを捨てる
+    VideoSourceConfig source_config;
+    source_config.drop_policy = DropPolicy::LatestFrame;
+    source_config.realtime = true;
+    VideoSource video(source, source_config);
+
+    // 結果の動画（描画しない場合は作らない）
+    const fs::path output_path = output_dir / (fs::path(source).stem().string() + ".avi");
+    const double fps = video.get_source_fps() > 0.0 ? video.get_source_fps() : 30.0;
+    cv::VideoWriter writer;
+    if (render && !writer.open(output_path.string(), cv::VideoWriter::fourcc('M', 'J', 'P', 'G'),
+                               fps, video.get_frame_size())) {
+        throw std::runtime_error("Could not open output video: " + output_path.string());
+    }
+
+    // 1フレームずつ処理（検知は数フレームごとに行い、間のフレームは追跡で枠を動かす）
+    TrackingDetector<EmbeddedDetectorBBox5Label1> tracking_detector(detector, tracker_config);
+    VideoFrame frame;
+    while (video.read(frame)) {
+        tracking_detector.process(frame.image);
+        if (sink != nullptr) {
+            sink->write(source, frame.index, frame.image.size(), tracking_detector.get_bboxes(),
+                        tracking_detector.get_track_ids());
+        }
+        if (render) {
+            draw_bboxes(frame.image, tracking_detector.get_bboxes());
+            writer.write(frame.image);
+        }
     }
 
-    // 結果の書き込み
-    cv::imwrite(output_path.string(), image_out);
+    std::cout << "Video: " << video.get_stats() << ", detection ratio "
+              << tracking_detector.get_detection_ratio() << std::endl;
 }
 
 int main(int argc, char** argv) {
+    // 動画で検知するフレーム間隔（--detection-interval=5なら5フレームに1回検知し、間は追跡する）
+    TrackerConfig tracker_config;
+    tracker_config.detection_interval = 1;
+    tracker_config.detection_threshold = CONFIDENCE_THRESHOLD;
+    // 数値だけの結果の出力先（--results=<path>、拡張子が.jsonlならJSONL、それ以外はバイナリ）と、
+    // 結果を画像に描画して書き出すかどうか（--no-renderで描画・エンコードを省く）
+    std::string results_path;
+    bool render = true;
+    // 読み込み設定（--performance-mode=latencyなど）
+    ModelConfig base_config;
+    base_config.num_requests = NUM_INFER_REQUESTS;
+    ModelConfig config;
+    try {
+        // サンプルの引数を取り除いてから、残りを読み込み設定として解析する
+        int num_remaining = 1;
+        for (int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            if (arg.rfind("--detection-interval=", 0) == 0) {
+                tracker_config.detection_interval = std::stoul(arg.substr(21));
+            } else if (arg.rfind("--results=", 0) == 0) {
+                results_path = arg.substr(10);
+            } else if (arg == "--no-render") {
+                render = false;
+            } else {
+                argv[num_remaining++] = argv[i];
+            }
+        }
+        argc = num_remaining;
+        config = parse_model_config_args(argc, argv, base_config);
+    } catch (const std::exception& e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
     if (argc != 4) {
-        std::cerr << "Usage: " << argv[0] << " <detection_model_path> <input_dir> <output_dir>"
-                  << std::endl;
+        std::cerr << "Usage: " << argv[0]
+                  << " [--detection-interval=<n>] [--results=<path>] [--no-render]"
+                     " <detection_model_path> <input_dir|video> <output_dir>"
+                  << std::endl
+                  << get_model_config_usage();
         return EXIT_FAILURE;
     }
 
@@ -51,12 +145,6 @@ int main(int argc, char** argv) {
     const fs::path input_dir = argv[2];
     const fs::path output_dir = argv[3];
 
-    // 入力ディレクトリの確認
-    if (!fs::exists(input_dir) || !fs::is_directory(input_dir)) {
-        std::cerr << "Error: Input directory does not exist: " << input_dir << std::endl;
-        return EXIT_FAILURE;
-    }
-
     // 出力ディレクトリの確認、なければ作成
     if (!fs::exists(output_dir)) {
         if (!fs::create_directories(output_dir)) {
@@ -65,23 +153,125 @@ int main(int argc, char** argv) {
         }
     }
 
-    DetectorBBox5Label1 detector(model_path.string());
+    EmbeddedDetectorBBox5Label1 detector(model_path.string(), config);
+    // 閾値未満の検知枠は後処理で作らない（描画でも同じ閾値で捨てるため結果は変わらない）
+    DetectionFilter filter = detector.get_postprocessor().get_filter();
+    filter.confidence_threshold = CONFIDENCE_THRESHOLD;
+    detector.get_postprocessor().set_filter(filter);
+    std::cout << "Model config: " << config << std::endl;
+    std::cout << "Model loaded: " << detector.get_load_report() << std::endl;
+
+    std::unique_ptr<ResultSink> sink;
+    if (!results_path.empty()) {
+        try {
+            sink = std::make_unique<ResultSink>(results_path, get_result_format(results_path));
+        } catch (const std::exception& e) {
+            std::cerr << "Exception: " << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    // 入力がディレクトリでなければ動画（ファイル・ストリームのURL・カメラ番号）として処理
+    if (!fs::is_directory(input_dir)) {
+        try {
+            process_video(detector, input_dir.string(), output_dir, tracker_config, sink.get(),
+                          render);
+            if (sink) {
+                sink->flush();
+                std::cout << "Results: " << sink->get_num_written() << " frames" << std::endl;
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Exception: " << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+        std::cout << "Profile: " << detector.get_profile() << std::endl;
+        return EXIT_SUCCESS;
+    }
 
-    // 1画像ずつ読み込んで処理
+    // 入力画像の一覧
+    std::vector<std::string> input_paths;
     for (const auto& entry : fs::directory_iterator(input_dir)) {
+        if (entry.is_regular_file()) {
+            input_paths.push_back(entry.path().string());
+        }
+    }
+
+    // JPEGのデコード・エンコードは推論と並行して複数スレッドで行う
+    const std::size_t num_io_workers = std::max(1U, std::thread::hardware_concurrency() / 2);
+    ImageReader reader(input_paths, num_io_workers, READAHEAD);
+    ImageWriter writer(num_io_workers, QUEUE_CAPACITY,
+                       [](const std::string& path, std::exception_ptr exception) {
+                           try {
+                               std::rethrow_exception(exception);
+                           } catch (const std::exception& e) {
+                               std::cerr << "Exception: " << e.what() << std::endl;
+                           }
+                       });
+
+    Pipeline<Frame> pipeline(QUEUE_CAPACITY);
+    pipeline.add_stage(
+        "infer", [&detector](Frame& frame) { detector.task(frame.image, frame.bboxes); },
+        config.num_requests);
+    if (render) {
+        pipeline.add_stage(
+            "render", [](Frame& frame) { draw_bboxes(frame.image, frame.bboxes); },
+            num_io_workers);
+    }
+
+    pipeline.start([&writer, &sink, render](Frame& frame, std::exception_ptr exception) {
         try {
-            if (entry.is_regular_file()) {
-                fs::path input_path = entry.path();
-                fs::path output_path = output_dir / input_path.filename();
-                std::cout << "Processing file: " << input_path << std::endl;
-                process_image(detector, input_path, output_path);
+            if (exception) {
+                std::rethrow_exception(exception);
+            }
+            if (sink) {
+                sink->write(frame.input_path.string(), frame.index, frame.image.size(),
+                            frame.bboxes);
             }
+            if (render) {
+                // エンコードと書き込みは書き込み用のスレッドで行う
+                writer.write(frame.output_path.string(), frame.image);
+            }
+            std::cout << "Processed file: " << frame.input_path << std::endl;
         } catch (const ov::Exception& e) {
             std::cerr << "OpenVINO Exception: " << e.what() << std::endl;
         } catch (const std::exception& e) {
             std::cerr << "Exception: " << e.what() << std::endl;
         }
+    });
+
+    // デコード済みの画像をパイプラインへ投入（詰まっている間は待機する）
+    DecodedImage decoded;
+    std::uint64_t index = 0;
+    while (reader.next(decoded)) {
+        if (decoded.exception) {
+            try {
+                std::rethrow_exception(decoded.exception);
+            } catch (const std::exception& e) {
+                std::cerr << "Exception: " << e.what() << std::endl;
+            }
+            continue;
+        }
+        Frame frame;
+        frame.index = index++;
+        frame.input_path = decoded.path;
+        frame.output_path = output_dir / frame.input_path.filename();
+        frame.image = std::move(decoded.image);
+        pipeline.push(std::move(frame));
+    }
+    pipeline.wait();
+    writer.wait();
+    if (sink) {
+        try {
+            sink->flush();
+        } catch (const std::exception& e) {
+            std::cerr << "Exception: " << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+        std::cout << "Results: " << sink->get_num_written() << " frames" << std::endl;
     }
 
+    // 処理段階ごとのレイテンシ
+    std::cout << "Profile: " << detector.get_profile() << std::endl;
+
     return EXIT_SUCCESS;
 }
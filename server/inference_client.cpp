@@ -0,0 +1,209 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "image_io.hpp"
+#include "inference_protocol.hpp"
+
+// 既定のソケットファイルのパス
+const std::string DEFAULT_SOCKET_PATH = "/tmp/openvino_inference.sock";
+
+/**
+ * @brief 負荷の設定
+ *
+ */
+struct LoadConfig {
+    std::string socket_path = DEFAULT_SOCKET_PATH;
+    std::size_t num_connections = 4;   // 同時に接続するクライアント数
+    std::size_t num_in_flight = 1;     // 接続ごとに結果を待たずに送る要求数
+    std::size_t num_requests = 1000;   // 接続ごとに送る要求数
+    bool encode = false;               // JPEGにエンコードして送るかどうか
+};
+
+/**
+ * @brief 接続ごとの計測結果
+ *
+ */
+struct ConnectionResult {
+    std::vector<double> latencies_ms;  // 要求ごとのレイテンシ[ms]
+    std::size_t num_failed = 0;        // サーバーでエラーになった要求数
+    std::string error;                 // 接続のエラー（正常終了時は空）
+};
+
+/**
+ * @brief 1接続分の負荷をかける
+ *
+ * @param config 負荷の設定
+ * @param image 送る画像
+ * @param encoded エンコード済みの画像（config.encodeの場合）
+ * @param result 計測結果の格納先
+ */
+void run_connection(const LoadConfig& config, const cv::Mat& image,
+                    const std::vector<unsigned char>& encoded, ConnectionResult& result) {
+    using Clock = std::chrono::steady_clock;
+    try {
+        InferenceClient client(config.socket_path);
+        InferenceResult output;
+
+        // 要求の番号は0から順に振られるため、番号を添字にして送信時刻を覚える
+        std::vector<Clock::time_point> sent_at(config.num_requests);
+        result.latencies_ms.reserve(config.num_requests);
+        std::size_t num_sent = 0;
+        std::size_t num_received = 0;
+        while (num_received < config.num_requests) {
+            while (num_sent < config.num_requests &&
+                   num_sent - num_received < config.num_in_flight) {
+                sent_at[num_sent] = Clock::now();
+                if (config.encode) {
+                    client.send(encoded);
+                } else {
+                    client.send(image);
+                }
+                num_sent++;
+            }
+
+            std::uint64_t request_id = 0;
+            try {
+                request_id = client.receive(output);
+            } catch (const InferenceError& e) {
+                // サーバーで失敗した要求も応答が届いたものとして数える
+                if (result.num_failed == 0) {
+                    std::cerr << e.what() << std::endl;
+                }
+                result.num_failed++;
+                num_received++;
+                continue;
+            }
+            const std::chrono::duration<double, std::milli> latency =
+                Clock::now() - sent_at.at(request_id);
+            result.latencies_ms.push_back(latency.count());
+            num_received++;
+        }
+    } catch (const std::exception& e) {
+        result.error = e.what();
+    }
+}
+
+/**
+ * @brief 昇順に並べたレイテンシのパーセンタイルを返す
+ *
+ * @param sorted 昇順に並べたレイテンシ
+ * @param percentile パーセンタイル（0〜100）
+ * @return double レイテンシ[ms]
+ */
+double get_percentile(const std::vector<double>& sorted, const double percentile) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    const std::size_t index = static_cast<std::size_t>(percentile / 100.0 * (sorted.size() - 1));
+    return sorted[index];
+}
+
+int main(int argc, char** argv) {
+    // 負荷の設定を引数から取り出す
+    LoadConfig config;
+    try {
+        int num_remaining = 1;
+        for (int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            if (arg.rfind("--socket=", 0) == 0) {
+                config.socket_path = arg.substr(9);
+            } else if (arg.rfind("--connections=", 0) == 0) {
+                config.num_connections = std::stoul(arg.substr(14));
+            } else if (arg.rfind("--in-flight=", 0) == 0) {
+                config.num_in_flight = std::stoul(arg.substr(12));
+            } else if (arg.rfind("--requests=", 0) == 0) {
+                config.num_requests = std::stoul(arg.substr(11));
+            } else if (arg == "--encode") {
+                config.encode = true;
+            } else {
+                argv[num_remaining++] = argv[i];
+            }
+        }
+        argc = num_remaining;
+        if (config.num_connections == 0 || config.num_in_flight == 0) {
+            throw std::invalid_argument("--connections and --in-flight must be at least 1");
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (argc > 2) {
+        std::cerr << "Usage: " << argv[0]
+                  << " [--socket=<path>] [--connections=<n>] [--in-flight=<n>] [--requests=<n>]"
+                     " [--encode] [image_path]"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // 画像を指定しなければ720pの乱数画像を送る
+    cv::Mat image;
+    std::vector<unsigned char> encoded;
+    try {
+        if (argc == 2) {
+            image = read_image(argv[1]);
+        } else {
+            image.create(720, 1280, CV_8UC3);
+            cv::randu(image, cv::Scalar::all(0), cv::Scalar::all(255));
+        }
+        if (config.encode && !cv::imencode(".jpg", image, encoded)) {
+            throw std::runtime_error("Could not encode the image");
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Connections: " << config.num_connections << ", in flight "
+              << config.num_in_flight << ", requests " << config.num_requests
+              << (config.encode ? ", jpeg " : ", raw ") << image.cols << "x" << image.rows
+              << std::endl;
+
+    const auto started = std::chrono::steady_clock::now();
+    std::vector<ConnectionResult> results(config.num_connections);
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < config.num_connections; i++) {
+        threads.emplace_back(run_connection, std::cref(config), std::cref(image),
+                             std::cref(encoded), std::ref(results[i]));
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started;
+
+    // 全接続のレイテンシをまとめる
+    std::vector<double> latencies;
+    std::size_t num_failed = 0;
+    for (const ConnectionResult& result : results) {
+        if (!result.error.empty()) {
+            std::cerr << "Connection error: " << result.error << std::endl;
+        }
+        latencies.insert(latencies.end(), result.latencies_ms.begin(), result.latencies_ms.end());
+        num_failed += result.num_failed;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    double total = 0.0;
+    for (const double latency : latencies) {
+        total += latency;
+    }
+
+    std::cout << "Completed: " << latencies.size() << ", failed " << num_failed << ", "
+              << latencies.size() / elapsed.count() << " req/s" << std::endl;
+    std::cout << "Latency [ms]: mean " << (latencies.empty() ? 0.0 : total / latencies.size())
+              << ", p50 " << get_percentile(latencies, 50.0) << ", p90 "
+              << get_percentile(latencies, 90.0) << ", p99 " << get_percentile(latencies, 99.0)
+              << ", max " << (latencies.empty() ? 0.0 : latencies.back()) << std::endl;
+
+    bool failed = num_failed > 0;
+    for (const ConnectionResult& result : results) {
+        failed = failed || !result.error.empty();
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
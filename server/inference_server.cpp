@@ -0,0 +1,358 @@
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "dynamic_batcher.hpp"
+#include "inference_protocol.hpp"
+#include "openvino_task.hpp"
+#include "reloadable_task.hpp"
+
+// 既定のソケットファイルのパス
+const std::string DEFAULT_SOCKET_PATH = "/tmp/openvino_inference.sock";
+
+// 同時に推論するバッチ数の既定値（推論リクエスト数、--num-requestsで変更できる）
+const std::size_t NUM_INFER_REQUESTS = 2;
+
+// 1回の推論にまとめる最大画像数の既定値（--max-batch-sizeで変更できる）
+const std::size_t MAX_BATCH_SIZE = 8;
+
+/**
+ * @brief クライアントとの接続
+ *
+ * 結果の送信は推論スレッドから行うため、接続は最後の結果を送り終えるまで破棄しない
+ */
+struct Connection {
+    int fd = -1;
+    std::mutex send_mutex;
+    std::thread reader;
+    std::atomic<bool> finished{false};
+
+    ~Connection(void) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+
+    /**
+     * @brief 結果のメッセージを送る（複数の推論スレッドから呼べる）
+     *
+     * @param request_id 要求の番号
+     * @param status 状態（0なら成功）
+     * @param payload データ
+     */
+    void send(const std::uint64_t request_id, const std::uint32_t status,
+              const std::vector<char>& payload) {
+        MessageHeader header;
+        header.type = static_cast<std::uint32_t>(MessageType::Result);
+        header.request_id = request_id;
+        header.status = status;
+        std::lock_guard<std::mutex> lock(send_mutex);
+        send_message(fd, header, payload.data(), payload.size());
+    }
+};
+
+/**
+ * @brief Unixドメインソケットで画像を受け取り、動的バッチングで推論して結果を返すサーバー
+ *
+ * @tparam Task タスク
+ */
+template <typename Task>
+class InferenceServer {
+   private:
+    DynamicBatcher<Task>& batcher;
+    int listen_fd = -1;
+    std::list<std::shared_ptr<Connection>> connections;
+    std::thread acceptor;
+
+    /**
+     * @brief 接続ごとのスレッドの処理（要求を読んで推論を要求する）
+     *
+     * @param connection 接続
+     */
+    void run_reader(const std::shared_ptr<Connection>& connection) {
+        pthread_setname_np(pthread_self(), "reader");
+        try {
+            while (true) {
+                // Rawの画像はデータを参照するため、データは推論が終わるまで保持する
+                auto payload = std::make_shared<std::vector<char>>();
+                MessageHeader header;
+                if (!receive_message(connection->fd, header, *payload)) {
+                    break;
+                }
+                const std::uint64_t request_id = header.request_id;
+                cv::Mat image;
+                try {
+                    if (header.type != static_cast<std::uint32_t>(MessageType::Infer)) {
+                        throw std::runtime_error("Unexpected message type: " +
+                                                 std::to_string(header.type));
+                    }
+                    image = decode_image(*payload);
+                } catch (const std::exception& e) {
+                    const std::string message = e.what();
+                    connection->send(request_id, 1,
+                                     std::vector<char>(message.begin(), message.end()));
+                    continue;
+                }
+
+                batcher.submit(image, [connection, payload, request_id](
+                                          const typename Task::Buffer& output,
+                                          std::exception_ptr exception) {
+                    std::vector<char> response;
+                    std::uint32_t status = 0;
+                    try {
+                        if (exception) {
+                            std::rethrow_exception(exception);
+                        }
+                        encode_result(output, response);
+                    } catch (const std::exception& e) {
+                        const std::string message = e.what();
+                        response.assign(message.begin(), message.end());
+                        status = 1;
+                    }
+                    try {
+                        connection->send(request_id, status, response);
+                    } catch (const std::exception&) {
+                        // 結果を待たずに切断したクライアントには送らない
+                    }
+                });
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Connection error: " << e.what() << std::endl;
+        }
+        connection->finished = true;
+    }
+
+    /**
+     * @brief 接続を受け付けるスレッドの処理
+     *
+     */
+    void run_acceptor(void) {
+        pthread_setname_np(pthread_self(), "acceptor");
+        while (true) {
+            const int fd = ::accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+                // 待ち受けソケットを閉じたら終了する
+                break;
+            }
+
+            // 切断済みの接続を片付ける
+            for (auto it = connections.begin(); it != connections.end();) {
+                if ((*it)->finished) {
+                    (*it)->reader.join();
+                    it = connections.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+
+            auto connection = std::make_shared<Connection>();
+            connection->fd = fd;
+            connection->reader = std::thread(&InferenceServer::run_reader, this, connection);
+            connections.push_back(connection);
+        }
+    }
+
+   public:
+    /**
+     * @brief 待ち受けを始める
+     *
+     * @param batcher 動的バッチング
+     * @param socket_path ソケットファイルのパス
+     */
+    InferenceServer(DynamicBatcher<Task>& batcher, const std::string& socket_path)
+        : batcher(batcher), listen_fd(listen_unix_socket(socket_path)) {
+        acceptor = std::thread(&InferenceServer::run_acceptor, this);
+    }
+
+    /**
+     * @brief 待ち受けを止め、すべての接続の要求を読み終えるまで待つ
+     *
+     */
+    ~InferenceServer(void) {
+        ::shutdown(listen_fd, SHUT_RDWR);
+        acceptor.join();
+        ::close(listen_fd);
+        for (auto& connection : connections) {
+            ::shutdown(connection->fd, SHUT_RD);
+        }
+        for (auto& connection : connections) {
+            connection->reader.join();
+        }
+    }
+
+    InferenceServer(const InferenceServer&) = delete;
+    InferenceServer& operator=(const InferenceServer&) = delete;
+};
+
+/**
+ * @brief モデルの入れ替えの結果を表示する
+ *
+ * @param result 入れ替えの結果
+ */
+void print_reload_result(const ReloadResult& result) {
+    if (result.exception) {
+        try {
+            std::rethrow_exception(result.exception);
+        } catch (const std::exception& e) {
+            std::cerr << "Model reload failed, keeping the current model: " << e.what()
+                      << std::endl;
+        }
+        return;
+    }
+    std::cout << "Model reloaded: " << result.model_path << " (" << result.load_report
+              << ", warmup " << result.warmup_time_ms << " ms)" << std::endl;
+}
+
+/**
+ * @brief モデルを読み込み、SIGINT・SIGTERMを受け取るまで推論サーバーを動かす
+ *
+ * SIGHUPを受け取るとモデルファイルを読み直し、推論を止めずに入れ替える
+ *
+ * @tparam Task タスク
+ * @param model_path モデルのパス
+ * @param config 読み込み設定
+ * @param batching 動的バッチングの設定
+ * @param reload_config モデルの入れ替えの設定
+ * @param socket_path ソケットファイルのパス
+ * @param signals 待つシグナル（全スレッドでブロック済みであること）
+ */
+template <typename Task>
+void run_server(const std::string& model_path, const ModelConfig& config,
+                const BatchingConfig& batching, const ReloadConfig& reload_config,
+                const std::string& socket_path, const sigset_t& signals) {
+    ReloadableTask<Task> task(model_path, config, reload_config, nullptr, print_reload_result);
+    std::cout << "Model config: " << config << std::endl;
+    std::cout << "Model loaded: " << task.get_load_report() << std::endl;
+
+    DynamicBatcher<ReloadableTask<Task>> batcher(task, batching);
+    {
+        InferenceServer<ReloadableTask<Task>> server(batcher, socket_path);
+        std::cout << "Listening on " << socket_path << " (max batch " << batching.max_batch_size
+                  << ", max wait " << batching.max_wait.count() << " us)" << std::endl;
+        if (reload_config.watch_interval.count() > 0) {
+            std::cout << "Watching " << model_path << " every "
+                      << reload_config.watch_interval.count() << " ms" << std::endl;
+        }
+        int signal_number = 0;
+        while (sigwait(&signals, &signal_number) == 0 && signal_number == SIGHUP) {
+            std::cout << "Reloading " << task.get_model_path() << std::endl;
+            task.reload();
+        }
+        std::cout << "Shutting down" << std::endl;
+    }
+    ::unlink(socket_path.c_str());
+
+    const BatchingStats stats = batcher.get_stats();
+    std::cout << "Requests: " << stats.num_requests << ", batches " << stats.num_batches
+              << ", average batch size " << stats.get_average_batch_size() << std::endl;
+    std::cout << "Profile: " << task.get_profile() << ", reloads " << task.get_num_reloads()
+              << std::endl;
+}
+
+int main(int argc, char** argv) {
+    // ソケットファイルのパス（--socket=<path>）と、バッチが埋まるのを待つ最大時間（--max-wait-us=<n>）、
+    // モデルファイルの更新を確かめる間隔（--watch-interval-ms=<n>、0なら監視しない）
+    std::string socket_path = DEFAULT_SOCKET_PATH;
+    BatchingConfig batching;
+    ReloadConfig reload_config;
+    // 読み込み設定（--performance-mode=throughputなど）
+    ModelConfig base_config;
+    base_config.num_requests = NUM_INFER_REQUESTS;
+    base_config.max_batch_size = MAX_BATCH_SIZE;
+    ModelConfig config;
+    try {
+        // サーバーの引数を取り除いてから、残りを読み込み設定として解析する
+        int num_remaining = 1;
+        for (int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            if (arg.rfind("--socket=", 0) == 0) {
+                socket_path = arg.substr(9);
+            } else if (arg.rfind("--max-wait-us=", 0) == 0) {
+                batching.max_wait = std::chrono::microseconds(std::stoul(arg.substr(14)));
+            } else if (arg.rfind("--watch-interval-ms=", 0) == 0) {
+                reload_config.watch_interval =
+                    std::chrono::milliseconds(std::stoul(arg.substr(20)));
+            } else {
+                argv[num_remaining++] = argv[i];
+            }
+        }
+        argc = num_remaining;
+        config = parse_model_config_args(argc, argv, base_config);
+    } catch (const std::exception& e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0]
+                  << " [--socket=<path>] [--max-wait-us=<n>] [--watch-interval-ms=<n>]"
+                     " <bbox7|bbox5label1|pose|multipose> <model_path>"
+                  << std::endl
+                  << get_model_config_usage();
+        return EXIT_FAILURE;
+    }
+    const std::string task_name = argv[1];
+    const std::string model_path = argv[2];
+
+    // BBox5Label1の出力には画像番号がないため、バッチ推論できない
+    if (task_name == "bbox5label1" && config.max_batch_size > 1) {
+        std::cout << "bbox5label1 does not support batching, max batch size is set to 1"
+                  << std::endl;
+        config.max_batch_size = 1;
+    }
+
+    // バッチの大きさはモデルの最大バッチサイズ、同時に推論するバッチ数は推論リクエスト数に合わせる
+    batching.max_batch_size = config.max_batch_size;
+    batching.num_workers = config.num_requests;
+    batching.queue_capacity = 4 * config.max_batch_size * config.num_requests;
+
+    // シグナルはsigwait()で受け取るため、スレッドを作る前に全スレッドでブロックする
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    try {
+        if (task_name == "bbox7") {
+            run_server<EmbeddedDetectorBBox7>(model_path, config, batching, reload_config,
+                                              socket_path, signals);
+        } else if (task_name == "bbox5label1") {
+            run_server<EmbeddedDetectorBBox5Label1>(model_path, config, batching, reload_config,
+                                                    socket_path, signals);
+        } else if (task_name == "pose") {
+            run_server<EmbeddedPoseDetector>(model_path, config, batching, reload_config,
+                                             socket_path, signals);
+        } else if (task_name == "multipose") {
+            run_server<EmbeddedMultiPoseDetector>(model_path, config, batching, reload_config,
+                                                  socket_path, signals);
+        } else {
+            std::cerr << "Unknown task: " << task_name << std::endl;
+            return EXIT_FAILURE;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,134 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <opencv2/opencv.hpp>
+#include <string>
+
+#include "frame_ring.hpp"
+
+// スロット数の既定値
+const std::size_t NUM_SLOTS = 8;
+
+// 空きを待つ間に停止の要求を確かめる間隔
+const std::chrono::milliseconds POLL_INTERVAL(100);
+
+namespace {
+
+std::atomic<bool> stop_requested{false};
+
+void request_stop(int) { stop_requested = true; }
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    // リングの設定（--slots=<n>・--width=<n>・--height=<n>）と、推論が追いつかないときに
+    // フレームを捨てるかどうか（--drop）を引数から取り出す
+    FrameRingConfig config;
+    config.num_slots = NUM_SLOTS;
+    bool drop = false;
+    try {
+        int num_remaining = 1;
+        for (int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            if (arg.rfind("--slots=", 0) == 0) {
+                config.num_slots = std::stoul(arg.substr(8));
+            } else if (arg.rfind("--width=", 0) == 0) {
+                config.width = std::stoi(arg.substr(8));
+            } else if (arg.rfind("--height=", 0) == 0) {
+                config.height = std::stoi(arg.substr(9));
+            } else if (arg == "--drop") {
+                drop = true;
+            } else {
+                argv[num_remaining++] = argv[i];
+            }
+        }
+        argc = num_remaining;
+    } catch (const std::exception& e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0]
+                  << " [--slots=<n>] [--width=<n>] [--height=<n>] [--drop] <source> <ring_name>"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+    const std::string source = argv[1];
+    const std::string ring_name = argv[2];
+
+    std::signal(SIGINT, request_stop);
+    std::signal(SIGTERM, request_stop);
+
+    try {
+        // 数字だけならカメラ番号として開く
+        cv::VideoCapture capture;
+        const bool is_camera =
+            std::all_of(source.begin(), source.end(),
+                        [](unsigned char c) { return std::isdigit(c) != 0; });
+        if (is_camera) {
+            capture.open(std::stoi(source));
+        } else {
+            capture.open(source);
+        }
+        if (!capture.isOpened()) {
+            throw std::runtime_error("Could not open video source: " + source);
+        }
+        if (config.width <= 0 || config.height <= 0) {
+            config.width = static_cast<int>(capture.get(cv::CAP_PROP_FRAME_WIDTH));
+            config.height = static_cast<int>(capture.get(cv::CAP_PROP_FRAME_HEIGHT));
+        }
+
+        FrameRingProducer ring(ring_name, config);
+        std::cout << "Ring " << ring_name << ": " << config.num_slots << " slots of "
+                  << config.width << "x" << config.height << std::endl;
+
+        const auto started = std::chrono::steady_clock::now();
+        std::uint64_t frame_index = 0;
+        std::uint64_t num_written = 0;
+        std::uint64_t num_dropped = 0;
+        while (!stop_requested) {
+            cv::Mat slot = drop ? ring.try_acquire() : ring.acquire(POLL_INTERVAL);
+            if (slot.empty()) {
+                // 空きがなければデコードせずに読み飛ばす
+                if (drop) {
+                    if (!capture.grab()) {
+                        break;
+                    }
+                    frame_index++;
+                    num_dropped++;
+                }
+                continue;
+            }
+
+            // スロットへ直接デコードする（大きさが違うフレームだけ縮小してスロットへ書く）
+            cv::Mat image = slot;
+            if (!capture.read(image)) {
+                break;
+            }
+            if (image.data != slot.data) {
+                if (image.type() != slot.type()) {
+                    throw std::runtime_error("Frame type does not match the ring");
+                }
+                cv::resize(image, slot, slot.size());
+            }
+            ring.commit(frame_index++);
+            num_written++;
+        }
+        ring.close();
+
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started;
+        std::cout << "Written: " << num_written << " (" << num_written / elapsed.count()
+                  << " fps), dropped " << num_dropped << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
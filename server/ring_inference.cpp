@@ -0,0 +1,175 @@
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+
+#include "frame_ring.hpp"
+#include "openvino_task.hpp"
+#include "result_sink.hpp"
+
+// 1回に推論する最大フレーム数の既定値（--max-batch-sizeで変更できる）
+const std::size_t MAX_BATCH_SIZE = 4;
+
+// フレームを待つ間に停止の要求を確かめる間隔
+const std::chrono::milliseconds POLL_INTERVAL(100);
+
+namespace {
+
+std::atomic<bool> stop_requested{false};
+
+void request_stop(int) { stop_requested = true; }
+
+}  // namespace
+
+/**
+ * @brief 検知枠を結果ファイルへ書き込む
+ *
+ */
+void write_results(ResultSink& sink, const std::string& source, const RingFrame& frame,
+                   const BBoxList& bboxes) {
+    sink.write(source, frame.frame_index, frame.image.size(), bboxes);
+}
+
+/**
+ * @brief 複数人の骨格を結果ファイルへ書き込む
+ *
+ */
+void write_results(ResultSink& sink, const std::string& source, const RingFrame& frame,
+                   const std::vector<Pose>& poses) {
+    std::vector<KeyPointList> keypoints_list(poses.size());
+    for (std::size_t i = 0; i < poses.size(); i++) {
+        for (const KeyPoint& keypoint : poses[i].get_keypoints()) {
+            keypoints_list[i].push_back(keypoint.get_x(), keypoint.get_y(),
+                                        keypoint.get_confidence());
+        }
+    }
+    sink.write(source, frame.frame_index, frame.image.size(), BBoxList(),
+               std::vector<std::uint64_t>(), keypoints_list);
+}
+
+/**
+ * @brief リングのフレームを書き込み側が閉じるまで推論する
+ *
+ * @tparam Task タスク
+ * @param model_path モデルのパス
+ * @param config 読み込み設定（max_batch_sizeは1回に推論する最大フレーム数）
+ * @param ring_name 共有メモリの名前
+ * @param sink 結果の書き込み先（書き込まない場合はnullptr）
+ */
+template <typename Task>
+void run_consumer(const std::string& model_path, const ModelConfig& config,
+                  const std::string& ring_name, ResultSink* sink) {
+    Task task(model_path, config);
+    std::cout << "Model config: " << config << std::endl;
+    std::cout << "Model loaded: " << task.get_load_report() << std::endl;
+
+    FrameRingConsumer ring(ring_name);
+    const FrameRingConfig& ring_config = ring.get_config();
+    std::cout << "Ring " << ring_name << ": " << ring_config.num_slots << " slots of "
+              << ring_config.width << "x" << ring_config.height << std::endl;
+
+    RingInference<Task> inference(ring, task, config.max_batch_size);
+    const auto started = std::chrono::steady_clock::now();
+    std::uint64_t num_frames = 0;
+    std::uint64_t num_batches = 0;
+    double total_latency_ms = 0.0;
+    while (!stop_requested && !ring.is_finished()) {
+        if (!inference.next(POLL_INTERVAL)) {
+            continue;
+        }
+        // 書き込み側がスロットを書き終えてから推論が終わるまでの時間
+        const std::int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                     std::chrono::steady_clock::now().time_since_epoch())
+                                     .count();
+        const std::vector<RingFrame>& frames = inference.get_frames();
+        for (std::size_t i = 0; i < frames.size(); i++) {
+            total_latency_ms += (now - frames[i].timestamp_ns) / 1e6;
+            if (sink != nullptr) {
+                write_results(*sink, ring_name, frames[i], inference.get_outputs()[i]);
+            }
+        }
+        num_frames += frames.size();
+        num_batches++;
+    }
+    inference.release();
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started;
+    std::cout << "Frames: " << num_frames << " (" << num_frames / elapsed.count()
+              << " fps), batches " << num_batches << ", mean latency "
+              << (num_frames > 0 ? total_latency_ms / num_frames : 0.0) << " ms" << std::endl;
+    std::cout << "Profile: " << task.get_profile() << std::endl;
+}
+
+int main(int argc, char** argv) {
+    // 結果の出力先（--results=<path>）
+    std::unique_ptr<ResultSink> sink;
+    // 読み込み設定（--performance-mode=throughputなど）
+    ModelConfig base_config;
+    base_config.max_batch_size = MAX_BATCH_SIZE;
+    ModelConfig config;
+    try {
+        // 推論プロセスの引数を取り除いてから、残りを読み込み設定として解析する
+        int num_remaining = 1;
+        for (int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            if (arg.rfind("--results=", 0) == 0) {
+                const std::string path = arg.substr(10);
+                sink = std::make_unique<ResultSink>(path, get_result_format(path));
+            } else {
+                argv[num_remaining++] = argv[i];
+            }
+        }
+        argc = num_remaining;
+        config = parse_model_config_args(argc, argv, base_config);
+    } catch (const std::exception& e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (argc != 4) {
+        std::cerr << "Usage: " << argv[0]
+                  << " [--results=<path>] <bbox7|bbox5label1|multipose> <model_path> <ring_name>"
+                  << std::endl
+                  << get_model_config_usage();
+        return EXIT_FAILURE;
+    }
+    const std::string task_name = argv[1];
+    const std::string model_path = argv[2];
+    const std::string ring_name = argv[3];
+
+    // BBox5Label1の出力には画像番号がないため、バッチ推論できない
+    if (task_name == "bbox5label1") {
+        config.max_batch_size = 1;
+    }
+
+    std::signal(SIGINT, request_stop);
+    std::signal(SIGTERM, request_stop);
+
+    try {
+        if (task_name == "bbox7") {
+            run_consumer<EmbeddedDetectorBBox7>(model_path, config, ring_name, sink.get());
+        } else if (task_name == "bbox5label1") {
+            run_consumer<EmbeddedDetectorBBox5Label1>(model_path, config, ring_name, sink.get());
+        } else if (task_name == "multipose") {
+            run_consumer<EmbeddedMultiPoseDetector>(model_path, config, ring_name, sink.get());
+        } else {
+            std::cerr << "Unknown task: " << task_name << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (sink) {
+            sink->flush();
+            std::cout << "Results: " << sink->get_num_written() << " frames" << std::endl;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
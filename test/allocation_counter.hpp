@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstddef>
+
+/**
+ * @brief プログラム開始からのoperator newの呼び出し回数を返す
+ *
+ * allocation_counter.cppをリンクしたプログラムでだけ使える（operator newを置き換えて数える）。
+ * 前後の差を取り、定常状態の処理がメモリを確保しないことを確かめるのに使う
+ *
+ * @return std::size_t 呼び出し回数
+ */
+std::size_t get_num_allocations(void);
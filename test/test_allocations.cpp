@@ -0,0 +1,281 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <opencv2/opencv.hpp>
+#include <openvino/openvino.hpp>
+#include <openvino/opsets/opset8.hpp>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "allocation_counter.hpp"
+#include "openvino_model.hpp"
+#include "openvino_task.hpp"
+#include "postprocess.hpp"
+#include "preprocess.hpp"
+#include "result_objects.hpp"
+#include "test_utils.hpp"
+
+namespace {
+
+// 計測する呼び出し回数（暖機の後）
+const int NUM_ITERATIONS = 10;
+
+/**
+ * @brief 処理をNUM_ITERATIONS回呼び出し、1回あたりのメモリ確保回数を返す
+ *
+ */
+template <typename Function>
+std::size_t count_allocations(Function&& function) {
+    const std::size_t before = get_num_allocations();
+    for (int i = 0; i < NUM_ITERATIONS; i++) {
+        function();
+    }
+    return (get_num_allocations() - before) / NUM_ITERATIONS;
+}
+
+/**
+ * @brief 乱数で埋めたfloat型のテンソルを作る
+ *
+ */
+ov::Tensor make_float_tensor(const ov::Shape& shape, const float min, const float max) {
+    ov::Tensor tensor(ov::element::f32, shape);
+    std::mt19937 engine(0);
+    std::uniform_real_distribution<float> distribution(min, max);
+    float* data = tensor.data<float>();
+    for (std::size_t i = 0; i < tensor.get_size(); i++) {
+        data[i] = distribution(engine);
+    }
+    return tensor;
+}
+
+/**
+ * @brief ov::Tensor::get_shape()1回分のメモリ確保回数（ov::Shapeを値で返すため、後処理でも避けられない）
+ *
+ */
+std::size_t count_shape_allocations(const ov::Tensor& tensor) {
+    return count_allocations([&] { (void)tensor.get_shape(); });
+}
+
+/**
+ * @brief 参照をキャプチャしたラムダ式を、PrepareInput・InferDone（FunctionRef）へメモリ確保せずに渡せること
+ *
+ * 推論は行わず、受け取った関数を呼ぶだけのラムダ式で確かめる
+ */
+void test_function_ref_callbacks(void) {
+    ov::InferRequest infer_request;
+    int num_prepared = 0;
+    int num_done = 0;
+    double started = 0.0;
+    double preprocessed = 0.0;
+    double inferred = 0.0;
+    const auto call = [&](const OpenVINOModel::PrepareInput prepare,
+                          const OpenVINOModel::InferDone done) {
+        prepare(infer_request);
+        done(infer_request);
+    };
+    const std::size_t allocations = count_allocations([&] {
+        call(
+            [&](ov::InferRequest&) {
+                preprocessed = started + 1.0;
+                num_prepared++;
+            },
+            [&](ov::InferRequest&) {
+                inferred = preprocessed + 1.0;
+                num_done++;
+            });
+    });
+    EXPECT_TRUE(allocations == 0);
+    EXPECT_TRUE(num_prepared == NUM_ITERATIONS && num_done == NUM_ITERATIONS);
+    EXPECT_TRUE(inferred == 2.0);
+
+    // 同じラムダ式をstd::functionへ入れると確保することを確かめ、計測できていることを示す
+    const std::size_t function_allocations = count_allocations([&] {
+        const std::function<void(ov::InferRequest&)> prepare = [&](ov::InferRequest&) {
+            preprocessed = started + 1.0;
+            num_prepared++;
+        };
+        prepare(infer_request);
+    });
+    EXPECT_TRUE(function_allocations > 0);
+}
+
+// write_bbox7_model()のモデルが出力する検知数
+const std::size_t NUM_MODEL_DETECTIONS = 5;
+
+/**
+ * @brief 検知枠[1, 1, N, 7]を出力する小さなモデルを作り、IRとして保存する
+ *
+ * 出力は定数の検知枠に入力の平均の0倍を足したもの。先頭のNUM_MODEL_DETECTIONS個が検知枠で、
+ * その次の行の画像IDを-1にして終端とする
+ *
+ * @param xml_path モデルファイルのパス
+ * @param bin_path 重みファイルのパス
+ */
+void write_bbox7_model(const std::string& xml_path, const std::string& bin_path) {
+    const std::size_t num_boxes = 20;
+    std::vector<float> boxes(num_boxes * 7, 0.0f);
+    for (std::size_t i = 0; i < NUM_MODEL_DETECTIONS; i++) {
+        const float x = 0.1f * static_cast<float>(i);
+        const float values[] = {0.0f, static_cast<float>(i % 2), 0.9f, x, 0.1f, x + 0.05f, 0.2f};
+        std::copy(values, values + 7, boxes.begin() + i * 7);
+    }
+    boxes[NUM_MODEL_DETECTIONS * 7] = -1.0f;
+
+    const auto input =
+        std::make_shared<ov::opset8::Parameter>(ov::element::f32, ov::Shape{1, 3, 32, 32});
+    const auto axes = ov::opset8::Constant::create(ov::element::i64, ov::Shape{3}, {1, 2, 3});
+    const auto mean = std::make_shared<ov::opset8::ReduceMean>(input, axes, true);
+    const auto zero = ov::opset8::Constant::create(ov::element::f32, ov::Shape{}, {0.0f});
+    const auto unused = std::make_shared<ov::opset8::Multiply>(mean, zero);
+    const auto constant =
+        ov::opset8::Constant::create(ov::element::f32, ov::Shape{1, 1, num_boxes, 7}, boxes);
+    const auto output = std::make_shared<ov::opset8::Add>(constant, unused);
+    const auto model =
+        std::make_shared<ov::Model>(ov::OutputVector{output}, ov::ParameterVector{input});
+    ov::serialize(model, xml_path, bin_path);
+}
+
+/**
+ * @brief OpenVINOTask::task(image, Buffer&)が、OpenVINOの推論と前処理・後処理の確保のほかに確保しないこと
+ *
+ * 推論リクエストの取得・返却、FunctionRefでのコールバックの受け渡し、統計の記録を含めて確かめる
+ */
+void test_task_buffer(void) {
+    const std::string xml_path = "test_allocations_bbox7.xml";
+    const std::string bin_path = "test_allocations_bbox7.bin";
+    write_bbox7_model(xml_path, bin_path);
+    const cv::Mat image(32, 32, CV_8UC3, cv::Scalar::all(128));
+    {
+        // OpenVINO自身の推論1回分の確保回数
+        ov::Core core;
+        ov::InferRequest raw_request = core.compile_model(xml_path, "CPU").create_infer_request();
+        raw_request.infer();
+        const std::size_t infer_allocations = count_allocations([&] { raw_request.infer(); });
+
+        // 推論リクエストの取得・返却と、参照をキャプチャしたラムダ式の受け渡しは確保しない
+        OpenVINOModel model(xml_path);
+        int num_done = 0;
+        const auto infer = [&] {
+            model.infer([&](ov::InferRequest&) {}, [&](ov::InferRequest&) { num_done++; });
+        };
+        infer();
+        EXPECT_TRUE(count_allocations(infer) == infer_allocations);
+
+        // 推論リクエストへ直接行った前処理・後処理の確保回数（形状の取得など）
+        FloatCHW preprocessor;
+        BBox7 postprocessor;
+        BBoxList bboxes;
+        std::size_t step_allocations = 0;
+        const auto measure_steps = [&] {
+            model.infer(
+                [&](ov::InferRequest& infer_request) {
+                    step_allocations = count_allocations(
+                        [&] { preprocessor.preprocess_into(model, image, infer_request); });
+                },
+                [&](ov::InferRequest& infer_request) {
+                    step_allocations += count_allocations(
+                        [&] { postprocessor.postprocess(model, infer_request, bboxes); });
+                });
+        };
+        // 1回目はバッファを確保するため、暖機後の2回目の値を使う
+        measure_steps();
+        measure_steps();
+
+        DetectorBBox7 detector(xml_path);
+        BBoxList task_bboxes;
+        const auto run = [&] { detector.task(image, task_bboxes); };
+        run();
+        EXPECT_TRUE(count_allocations(run) == infer_allocations + step_allocations);
+        EXPECT_TRUE(task_bboxes.size() == NUM_MODEL_DETECTIONS);
+    }
+    std::remove(xml_path.c_str());
+    std::remove(bin_path.c_str());
+}
+
+/**
+ * @brief BBox7の後処理・絞り込み・並べ替えが、暖機後は検知数によらず形状の取得以外に確保しないこと
+ *
+ */
+void test_bbox7_buffer(void) {
+    const std::size_t num_boxes = 200;
+    ov::Tensor boxes_tensor = make_float_tensor({1, 1, num_boxes, 7}, 0.0f, 1.0f);
+    float* boxes = boxes_tensor.data<float>();
+    for (std::size_t i = 0; i < num_boxes; i++) {
+        boxes[i * 7 + 0] = 0.0f;                       // 画像ID
+        boxes[i * 7 + 1] = static_cast<float>(i % 3);  // ラベル
+    }
+    const std::size_t shape_allocations = count_shape_allocations(boxes_tensor);
+
+    BBox7 postprocessor;
+    DetectionFilter filter;
+    filter.nms_threshold = 0.5f;
+    filter.top_k_per_class = 20;
+    postprocessor.set_filter(filter);
+    BBoxList bboxes;
+    const auto run = [&] {
+        postprocessor.postprocess(boxes_tensor, bboxes);
+        bboxes.filter(0.1f);
+        bboxes.sort_by_confidence();
+    };
+    run();
+    EXPECT_TRUE(count_allocations(run) == shape_allocations);
+
+    // 検知数が減っても確保しない
+    boxes[10 * 7 + 0] = -1.0f;
+    EXPECT_TRUE(count_allocations(run) == shape_allocations);
+}
+
+/**
+ * @brief BBox5Label1の後処理が、暖機後は形状の取得以外に確保しないこと
+ *
+ */
+void test_bbox5label1_buffer(void) {
+    const std::size_t num_boxes = 200;
+    const ov::Shape input_shape = {1, 3, 720, 1280};
+    const ov::Tensor boxes_tensor = make_float_tensor({num_boxes, 5}, 0.0f, 720.0f);
+    ov::Tensor labels_tensor(ov::element::i64, {num_boxes});
+    std::int64_t* labels = labels_tensor.data<std::int64_t>();
+    for (std::size_t i = 0; i < num_boxes; i++) {
+        labels[i] = static_cast<std::int64_t>(i % 2);
+    }
+    const std::size_t shape_allocations = count_shape_allocations(boxes_tensor);
+
+    BBox5Label1 postprocessor;
+    BBoxList bboxes;
+    const auto run = [&] {
+        postprocessor.postprocess(input_shape, boxes_tensor, labels_tensor, bboxes);
+    };
+    run();
+    EXPECT_TRUE(count_allocations(run) == shape_allocations);
+}
+
+/**
+ * @brief KeyPointsの後処理が、暖機後は形状の取得以外に確保しないこと
+ *
+ */
+void test_keypoints_buffer(void) {
+    const ov::Tensor heatmaps_tensor = make_float_tensor({1, 17, 56, 56}, 0.0f, 1.0f);
+    const std::size_t shape_allocations = count_shape_allocations(heatmaps_tensor);
+
+    KeyPoints postprocessor;
+    KeyPointList keypoints;
+    const auto run = [&] { postprocessor.postprocess(heatmaps_tensor, keypoints); };
+    run();
+    EXPECT_TRUE(count_allocations(run) == shape_allocations);
+    EXPECT_TRUE(keypoints.size() == 17);
+}
+
+}  // namespace
+
+int main(void) {
+    test_function_ref_callbacks();
+    test_task_buffer();
+    test_bbox7_buffer();
+    test_bbox5label1_buffer();
+    test_keypoints_buffer();
+    return num_failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,143 @@
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <mutex>
+#include <opencv2/opencv.hpp>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "dynamic_batcher.hpp"
+#include "test_utils.hpp"
+
+namespace {
+
+/**
+ * @brief バッチ推論の代わりに、各画像の番号（先頭の画素値）を出力するタスク
+ *
+ * U8NHWCEmbeddedの複数画像版と同じく、大きさ・型の異なる画像を含むバッチは例外にする
+ */
+class FakeTask {
+   public:
+    using Buffer = int;
+
+    std::mutex mutex;
+    std::vector<std::size_t> batch_sizes;
+
+    void task(const std::vector<cv::Mat>& images, std::vector<Buffer>& outputs) {
+        for (const cv::Mat& image : images) {
+            if (image.size() != images.front().size() || image.type() != images.front().type()) {
+                throw std::invalid_argument("All images in a batch must have the same size");
+            }
+        }
+        outputs.resize(images.size());
+        for (std::size_t i = 0; i < images.size(); i++) {
+            outputs[i] = images[i].data[0];
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        batch_sizes.push_back(images.size());
+    }
+};
+
+/**
+ * @brief 各要求の完了結果
+ *
+ */
+struct Completion {
+    std::vector<int> outputs;
+    std::size_t num_failed = 0;
+    std::mutex mutex;
+
+    DynamicBatcher<FakeTask>::Callback callback(void) {
+        return [this](const int& output, std::exception_ptr exception) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (exception) {
+                num_failed++;
+            } else {
+                outputs.push_back(output);
+            }
+        };
+    }
+};
+
+/**
+ * @brief 番号を先頭の画素値に書き込んだ画像を作る
+ *
+ */
+cv::Mat make_image(const int rows, const int cols, const int type, const int id) {
+    cv::Mat image(rows, cols, type, cv::Scalar::all(0));
+    image.data[0] = static_cast<std::uint8_t>(id);
+    return image;
+}
+
+/**
+ * @brief 解像度・型の異なる要求が混ざっても、同じ大きさ・型ごとにバッチにまとめて推論できること
+ *
+ */
+void test_groups_mixed_resolutions(void) {
+    FakeTask task;
+    Completion completion;
+    {
+        BatchingConfig config;
+        config.max_batch_size = 4;
+        config.max_wait = std::chrono::seconds(1);
+        DynamicBatcher<FakeTask> batcher(task, config);
+
+        // 3種類のクライアントの要求を交互に送る（番号は送った順）
+        const int shapes[][3] = {{720, 1280, CV_8UC3}, {480, 640, CV_8UC3}, {720, 1280, CV_8UC1}};
+        for (int id = 0; id < 12; id++) {
+            const int* shape = shapes[id % 3];
+            batcher.submit(make_image(shape[0], shape[1], shape[2], id), completion.callback());
+        }
+        // デストラクタで処理待ちの要求をすべて処理する
+    }
+
+    EXPECT_TRUE(completion.num_failed == 0);
+    EXPECT_TRUE(completion.outputs.size() == 12);
+    // 同じ大きさ・型の要求は届いた順に処理される
+    for (std::size_t i = 0; i < completion.outputs.size(); i++) {
+        for (std::size_t j = i + 1; j < completion.outputs.size(); j++) {
+            if (completion.outputs[i] % 3 == completion.outputs[j] % 3) {
+                EXPECT_TRUE(completion.outputs[i] < completion.outputs[j]);
+            }
+        }
+    }
+    // 1種類あたり4件のため、max_waitを待たずに1回ずつでまとまる
+    EXPECT_TRUE(task.batch_sizes == std::vector<std::size_t>({4, 4, 4}));
+}
+
+/**
+ * @brief 最も古い要求と異なる大きさの要求があっても、max_waitが経てば古い要求から処理されること
+ *
+ */
+void test_flushes_oldest_first(void) {
+    FakeTask task;
+    Completion completion;
+    {
+        BatchingConfig config;
+        config.max_batch_size = 4;
+        config.max_wait = std::chrono::milliseconds(200);
+        DynamicBatcher<FakeTask> batcher(task, config);
+
+        batcher.submit(make_image(720, 1280, CV_8UC3, 0), completion.callback());
+        batcher.submit(make_image(480, 640, CV_8UC3, 1), completion.callback());
+        batcher.submit(make_image(720, 1280, CV_8UC3, 2), completion.callback());
+        // 停止ではなくmax_waitでバッチを作らせる
+        std::this_thread::sleep_for(std::chrono::milliseconds(600));
+        EXPECT_TRUE(batcher.get_stats().num_pending == 0);
+    }
+
+    EXPECT_TRUE(completion.num_failed == 0);
+    EXPECT_TRUE(completion.outputs == std::vector<int>({0, 2, 1}));
+    EXPECT_TRUE(task.batch_sizes == std::vector<std::size_t>({2, 1}));
+}
+
+}  // namespace
+
+int main(void) {
+    test_groups_mixed_resolutions();
+    test_flushes_oldest_first();
+    return num_failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
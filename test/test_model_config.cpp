@@ -0,0 +1,127 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "model_config.hpp"
+#include "test_utils.hpp"
+
+namespace {
+
+/**
+ * @brief 引数の文字列からmain()と同じ形のargc・argvを作る
+ *
+ */
+class Arguments {
+   private:
+    std::vector<std::string> strings;
+    std::vector<char*> pointers;
+
+   public:
+    int argc = 0;
+
+    explicit Arguments(const std::vector<std::string>& args) : strings(args) {
+        for (std::string& arg : strings) {
+            pointers.push_back(arg.data());
+        }
+        pointers.push_back(nullptr);
+        argc = static_cast<int>(strings.size());
+    }
+
+    char** argv(void) { return pointers.data(); }
+
+    /**
+     * @brief 残った引数を返す
+     *
+     */
+    std::vector<std::string> remaining(void) const {
+        return std::vector<std::string>(pointers.begin(), pointers.begin() + argc);
+    }
+};
+
+/**
+ * @brief 読み込み設定と各プログラムの引数を混ぜても、プログラムの引数が順序を保って残ること
+ *
+ */
+void test_keeps_program_flags(void) {
+    Arguments args({"person_detection", "--device=GPU", "--detection-interval=5",
+                    "--num-requests=3", "--results=out.jsonl", "input.mp4", "--no-render",
+                    "--pose-max-age=2", "--max-batch-size=4", "model.xml"});
+    const ModelConfig config = parse_model_config_args(args.argc, args.argv());
+
+    EXPECT_TRUE(config.device == "GPU");
+    EXPECT_TRUE(config.num_requests == 3);
+    EXPECT_TRUE(config.max_batch_size == 4);
+    EXPECT_TRUE(args.remaining() ==
+                std::vector<std::string>({"person_detection", "--detection-interval=5",
+                                          "--results=out.jsonl", "input.mp4", "--no-render",
+                                          "--pose-max-age=2", "model.xml"}));
+    EXPECT_TRUE(args.argv()[args.argc] == nullptr);
+}
+
+/**
+ * @brief プログラムの引数を先に取り除いてから解析しても同じ設定になること
+ *
+ */
+void test_after_program_flags(void) {
+    Arguments args({"inference_server", "--socket=/tmp/inference.sock", "--num-streams=auto",
+                    "--max-wait-us=500", "bbox7", "model.xml"});
+    // サーバーの引数を先に取り除く
+    int num_remaining = 1;
+    std::string socket_path;
+    for (int i = 1; i < args.argc; i++) {
+        const std::string arg = args.argv()[i];
+        if (arg.rfind("--socket=", 0) == 0) {
+            socket_path = arg.substr(9);
+        } else if (arg.rfind("--max-wait-us=", 0) != 0) {
+            args.argv()[num_remaining++] = args.argv()[i];
+        }
+    }
+    args.argc = num_remaining;
+    const ModelConfig config = parse_model_config_args(args.argc, args.argv());
+
+    EXPECT_TRUE(socket_path == "/tmp/inference.sock");
+    EXPECT_TRUE(config.num_streams == -1);
+    EXPECT_TRUE(args.remaining() ==
+                std::vector<std::string>({"inference_server", "bbox7", "model.xml"}));
+}
+
+/**
+ * @brief 読み込み設定のキーに不正な値を指定した場合は例外を投げること
+ *
+ */
+void test_rejects_invalid_values(void) {
+    Arguments num_requests({"sample", "--num-requests=two", "--results=out.jsonl"});
+    EXPECT_THROW(parse_model_config_args(num_requests.argc, num_requests.argv()),
+                 std::invalid_argument);
+
+    Arguments mode({"sample", "--performance-mode=fast"});
+    EXPECT_THROW(parse_model_config_args(mode.argc, mode.argv()), std::invalid_argument);
+}
+
+/**
+ * @brief 設定ファイルの未知のキーは（引数と違い）例外を投げること
+ *
+ */
+void test_rejects_unknown_file_keys(void) {
+    const std::string path = "test_model_config_unknown.yaml";
+    {
+        std::ofstream file(path);
+        file << "%YAML:1.0\n---\ndevice: GPU\ndetection_interval: 5\n";
+    }
+    Arguments args({"sample", "--model-config=" + path});
+    EXPECT_THROW(parse_model_config_args(args.argc, args.argv()), std::invalid_argument);
+    std::remove(path.c_str());
+}
+
+}  // namespace
+
+int main(void) {
+    test_keeps_program_flags();
+    test_after_program_flags();
+    test_rejects_invalid_values();
+    test_rejects_unknown_file_keys();
+    return num_failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
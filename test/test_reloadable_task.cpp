@@ -0,0 +1,243 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <opencv2/opencv.hpp>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "model_config.hpp"
+#include "reloadable_task.hpp"
+#include "test_utils.hpp"
+
+namespace {
+
+/**
+ * @brief モデルの代わりに「version=<番号>」と「end」の2行のファイルを読み込むタスク
+ *
+ * 「end」の行がなければ書き込み途中や壊れたモデルとして例外を投げる
+ */
+class FakeTask {
+   public:
+    using Output = int;
+    using Buffer = int;
+
+    /**
+     * @brief 暖機の統計をリセットできればよい
+     *
+     */
+    struct Profiler {
+        void reset(void) {}
+    };
+
+    /**
+     * @brief 解放されていないタスクの数
+     *
+     */
+    static inline std::atomic<int> num_alive{0};
+
+    int version = 0;
+
+    FakeTask(const std::string& path, const ModelConfig& config) {
+        (void)config;
+        std::ifstream file(path);
+        std::string line;
+        if (!std::getline(file, line) || line.rfind("version=", 0) != 0) {
+            throw std::runtime_error("Failed to read " + path);
+        }
+        version = std::stoi(line.substr(8));
+        if (!std::getline(file, line) || line != "end") {
+            throw std::runtime_error("Incomplete model file " + path);
+        }
+        num_alive++;
+    }
+
+    ~FakeTask(void) { num_alive--; }
+
+    ModelLoadReport get_load_report(void) const { return ModelLoadReport(); }
+
+    Profiler& get_profiler(void) { return profiler; }
+
+    Output task(const cv::Mat& image) {
+        (void)image;
+        return version;
+    }
+
+    void task(const std::vector<cv::Mat>& images, std::vector<Buffer>& outputs) {
+        outputs.assign(images.size(), version);
+    }
+
+   private:
+    Profiler profiler;
+};
+
+/**
+ * @brief 入れ替えの結果を受け取り、待ち合わせる
+ *
+ */
+class ReloadResults {
+   private:
+    std::vector<ReloadResult> results;
+    std::mutex mutex;
+    std::condition_variable cv;
+
+   public:
+    ReloadableTask<FakeTask>::ReloadCallback callback(void) {
+        return [this](const ReloadResult& result) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                results.push_back(result);
+            }
+            cv.notify_all();
+        };
+    }
+
+    /**
+     * @brief 指定した数の結果が届くまで待つ
+     *
+     * @return std::vector<ReloadResult> 届いた結果（時間切れなら指定した数より少ない）
+     */
+    std::vector<ReloadResult> wait(const std::size_t count) {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait_for(lock, std::chrono::seconds(5), [this, count]() {
+            return results.size() >= count;
+        });
+        return results;
+    }
+};
+
+/**
+ * @brief モデルのファイルを書く
+ *
+ */
+void write_model(const std::string& path, const std::string& content) {
+    std::ofstream file(path, std::ios::trunc);
+    file << content;
+}
+
+/**
+ * @brief 古いタスクが専用スレッドで解放されるまで待つ
+ *
+ */
+bool wait_until_alive(const int count) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (FakeTask::num_alive != count) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return true;
+}
+
+/**
+ * @brief 入れ替え後の推論は新しいモデルで行い、入れ替え前に取り出したタスクは古いモデルのまま使えること
+ *
+ */
+void test_swaps_model_and_keeps_in_flight_task(void) {
+    const std::string old_path = "test_reloadable_task_old.txt";
+    const std::string new_path = "test_reloadable_task_new.txt";
+    write_model(old_path, "version=1\nend\n");
+    write_model(new_path, "version=2\nend\n");
+    {
+        ReloadResults results;
+        ReloadableTask<FakeTask> task(old_path, ModelConfig(), ReloadConfig(), nullptr,
+                                      results.callback());
+        EXPECT_TRUE(task.task(cv::Mat()) == 1);
+
+        // 入れ替え前に始まった推論の代わり
+        std::shared_ptr<FakeTask> in_flight = task.acquire();
+        task.reload(new_path);
+        const std::vector<ReloadResult> reloaded = results.wait(1);
+        EXPECT_TRUE(reloaded.size() == 1 && !reloaded[0].exception);
+        EXPECT_TRUE(task.task(cv::Mat()) == 2);
+        EXPECT_TRUE(task.get_model_path() == new_path);
+        EXPECT_TRUE(task.get_num_reloads() == 1);
+        EXPECT_TRUE(in_flight->task(cv::Mat()) == 1);
+
+        // 古いタスクは参照がなくなってから解放される
+        EXPECT_TRUE(FakeTask::num_alive == 2);
+        in_flight.reset();
+        EXPECT_TRUE(wait_until_alive(1));
+    }
+    EXPECT_TRUE(FakeTask::num_alive == 0);
+    std::remove(old_path.c_str());
+    std::remove(new_path.c_str());
+}
+
+/**
+ * @brief 新しいモデルの読み込みに失敗しても、例外を通知して古いモデルを使い続けること
+ *
+ */
+void test_failed_reload_keeps_model(void) {
+    const std::string path = "test_reloadable_task_model.txt";
+    const std::string broken_path = "test_reloadable_task_broken.txt";
+    write_model(path, "version=1\nend\n");
+    write_model(broken_path, "version=2\n");
+    {
+        ReloadResults results;
+        ReloadableTask<FakeTask> task(path, ModelConfig(), ReloadConfig(), nullptr,
+                                      results.callback());
+        // 要求は1件ずつしか保持されないため、結果を待ってから次を要求する
+        task.reload(broken_path);
+        results.wait(1);
+        task.reload("test_reloadable_task_missing.txt");
+        const std::vector<ReloadResult> reloaded = results.wait(2);
+        EXPECT_TRUE(reloaded.size() == 2);
+        for (const ReloadResult& result : reloaded) {
+            EXPECT_TRUE(result.exception);
+        }
+        EXPECT_TRUE(task.task(cv::Mat()) == 1);
+        EXPECT_TRUE(task.get_model_path() == path);
+        EXPECT_TRUE(task.get_num_reloads() == 0);
+    }
+    std::remove(path.c_str());
+    std::remove(broken_path.c_str());
+}
+
+/**
+ * @brief 監視しているファイルは、書き込み途中の内容を読まず、書き終えてから入れ替えること
+ *
+ */
+void test_watch_waits_for_complete_file(void) {
+    const std::string path = "test_reloadable_task_watched.txt";
+    write_model(path, "version=1\nend\n");
+    {
+        ReloadResults results;
+        ReloadConfig reload_config;
+        reload_config.watch_interval = std::chrono::milliseconds(400);
+        ReloadableTask<FakeTask> task(path, ModelConfig(), reload_config, nullptr,
+                                      results.callback());
+
+        // 最初に確かめる時刻（構築から監視の間隔の後）をまたいで、間隔より短い間だけ書き込み途中にする
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        write_model(path, "version=22\n");
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        write_model(path, "version=22\nend\n");
+
+        const std::vector<ReloadResult> reloaded = results.wait(1);
+        EXPECT_TRUE(reloaded.size() == 1 && !reloaded[0].exception);
+        EXPECT_TRUE(task.task(cv::Mat()) == 22);
+        EXPECT_TRUE(task.get_num_reloads() == 1);
+
+        // 更新されていないファイルは読み直さない
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        EXPECT_TRUE(results.wait(1).size() == 1);
+    }
+    std::remove(path.c_str());
+}
+
+}  // namespace
+
+int main(void) {
+    test_swaps_model_and_keeps_in_flight_task();
+    test_failed_reload_keeps_model();
+    test_watch_waits_for_complete_file();
+    return num_failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
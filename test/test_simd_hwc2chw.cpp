@@ -0,0 +1,213 @@
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <opencv2/opencv.hpp>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "preprocess.hpp"
+#include "test_utils.hpp"
+
+namespace {
+
+// 16画素ずつ処理する実装の、端数0〜15画素をすべて含む最大の幅
+const int MAX_WIDTH = 5 * 16 + 15;
+
+// 画像の高さ
+const int HEIGHT = 3;
+
+// 書き込み先の末尾に置く、書き込まれてはいけない領域の要素数
+const std::size_t GUARD_SIZE = 64;
+
+/**
+ * @brief 正規化の設定
+ *
+ */
+struct Normalization {
+    cv::Scalar mean;
+    cv::Scalar scale;
+};
+
+/**
+ * @brief 画素ごとに変換するスカラーの参照実装
+ *
+ * convert_hwc2chw()と同じく、出力チャンネルごとに (x - mean) / scale を x * mul + add で求める
+ */
+std::vector<float> convert_reference(const cv::Mat& image, const bool swap_rb,
+                                     const Normalization& normalization) {
+    const std::size_t plane_size = static_cast<std::size_t>(image.rows) * image.cols;
+    std::vector<float> chw(3 * plane_size);
+    for (int c = 0; c < 3; c++) {
+        const float mul = static_cast<float>(1.0 / normalization.scale[c]);
+        const float add = static_cast<float>(-normalization.mean[c] / normalization.scale[c]);
+        const int src_c = swap_rb ? 2 - c : c;
+        for (int y = 0; y < image.rows; y++) {
+            const std::uint8_t* row = image.ptr<std::uint8_t>(y);
+            for (int x = 0; x < image.cols; x++) {
+                chw[c * plane_size + y * image.cols + x] = row[3 * x + src_c] * mul + add;
+            }
+        }
+    }
+    return chw;
+}
+
+/**
+ * @brief 画像を乱数で埋める（各行の先頭には0と255を置く）
+ *
+ */
+void fill_random(cv::Mat& image, std::mt19937& random) {
+    std::uniform_int_distribution<int> distribution(0, 255);
+    for (int y = 0; y < image.rows; y++) {
+        std::uint8_t* row = image.ptr<std::uint8_t>(y);
+        for (int i = 0; i < 3 * image.cols; i++) {
+            row[i] = static_cast<std::uint8_t>(distribution(random));
+        }
+        row[0] = 0;
+        row[3 * image.cols - 1] = 255;
+    }
+}
+
+/**
+ * @brief 1つの実装の出力が参照実装とビット単位で一致し、書き込み先の外を書き換えないこと
+ *
+ */
+bool check_convert(const cv::Mat& image, const SimdLevel level, const bool swap_rb,
+                   const Normalization& normalization) {
+    const std::vector<float> expected = convert_reference(image, swap_rb, normalization);
+    std::vector<float> actual(expected.size() + GUARD_SIZE,
+                              std::numeric_limits<float>::quiet_NaN());
+    convert_hwc2chw(image, actual.data(), level, swap_rb, normalization.mean,
+                    normalization.scale);
+
+    for (std::size_t i = 0; i < expected.size(); i++) {
+        if (std::memcmp(&actual[i], &expected[i], sizeof(float)) != 0) {
+            std::cerr << get_simd_level_name(level) << ": " << image.cols << "x" << image.rows
+                      << (image.isContinuous() ? "" : " roi") << (swap_rb ? " swap_rb" : "")
+                      << ": element " << i << " is " << actual[i] << ", expected "
+                      << expected[i] << std::endl;
+            return false;
+        }
+    }
+    for (std::size_t i = expected.size(); i < actual.size(); i++) {
+        if (!std::isnan(actual[i])) {
+            std::cerr << get_simd_level_name(level) << ": " << image.cols << "x" << image.rows
+                      << ": wrote past the end at element " << i << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 全実装・全端数の幅・連続/非連続の画像・swap_rb・正規化の組み合わせを確かめる
+ *
+ */
+void test_matches_reference(const SimdLevel level) {
+    const std::vector<Normalization> normalizations = {
+        {cv::Scalar::all(0), cv::Scalar::all(1)},
+        {cv::Scalar(123.675, 116.28, 103.53), cv::Scalar(58.395, 57.12, 57.375)},
+        {cv::Scalar(0.5, 127.5, 255), cv::Scalar(255, 127.5, 0.25)},
+    };
+    std::mt19937 random(static_cast<unsigned int>(level));
+    for (int width = 1; width <= MAX_WIDTH; width++) {
+        cv::Mat image(HEIGHT, width, CV_8UC3);
+        fill_random(image, random);
+
+        // 行の間に隙間があり、先頭が16バイト境界にない画像
+        cv::Mat parent(HEIGHT + 2, width + 5, CV_8UC3);
+        fill_random(parent, random);
+        const cv::Mat roi = parent(cv::Rect(3, 1, width, HEIGHT));
+        EXPECT_TRUE(!roi.isContinuous());
+
+        for (const cv::Mat& input : {image, roi}) {
+            for (const bool swap_rb : {false, true}) {
+                for (const Normalization& normalization : normalizations) {
+                    EXPECT_TRUE(check_convert(input, level, swap_rb, normalization));
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief 正規化・BとRの入れ替えをしない場合、cv::Matを返す従来のconvert_hwc2chw()と一致すること
+ *
+ */
+void test_matches_legacy(const SimdLevel level) {
+    std::mt19937 random(static_cast<unsigned int>(level));
+    for (int width = 1; width <= MAX_WIDTH; width++) {
+        cv::Mat image(HEIGHT, width, CV_8UC3);
+        fill_random(image, random);
+        cv::Mat parent(HEIGHT + 2, width + 5, CV_8UC3);
+        fill_random(parent, random);
+        const cv::Mat roi = parent(cv::Rect(3, 1, width, HEIGHT));
+
+        for (const cv::Mat& input : {image, roi}) {
+            const cv::Mat expected = convert_hwc2chw(input);
+            std::vector<float> actual(3 * static_cast<std::size_t>(HEIGHT) * width);
+            convert_hwc2chw(input, actual.data(), level, false, cv::Scalar::all(0),
+                            cv::Scalar::all(1));
+
+            const bool matched = expected.isContinuous() && expected.total() == actual.size() &&
+                                 std::memcmp(expected.data, actual.data(),
+                                             actual.size() * sizeof(float)) == 0;
+            if (!matched) {
+                std::cerr << get_simd_level_name(level) << ": " << width << "x" << HEIGHT
+                          << (input.isContinuous() ? "" : " roi")
+                          << ": differs from the cv::Mat version" << std::endl;
+            }
+            EXPECT_TRUE(matched);
+        }
+    }
+}
+
+/**
+ * @brief 既定の実装（実行環境で最速の実装）も参照実装と一致すること
+ *
+ */
+void test_default_dispatch(void) {
+    std::mt19937 random(0);
+    cv::Mat image(HEIGHT, MAX_WIDTH, CV_8UC3);
+    fill_random(image, random);
+    const Normalization normalization = {cv::Scalar(123.675, 116.28, 103.53),
+                                         cv::Scalar(58.395, 57.12, 57.375)};
+    const std::vector<float> expected = convert_reference(image, true, normalization);
+    std::vector<float> actual(expected.size());
+    convert_hwc2chw(image, actual.data(), true, normalization.mean, normalization.scale);
+    EXPECT_TRUE(std::memcmp(actual.data(), expected.data(), expected.size() * sizeof(float)) ==
+                0);
+}
+
+/**
+ * @brief CV_8UC3以外の画像は例外を投げること
+ *
+ */
+void test_rejects_other_types(void) {
+    std::vector<float> chw(3 * HEIGHT * MAX_WIDTH);
+    const cv::Mat gray(HEIGHT, MAX_WIDTH, CV_8UC1);
+    EXPECT_THROW(convert_hwc2chw(gray, chw.data(), SimdLevel::Scalar), std::invalid_argument);
+}
+
+}  // namespace
+
+int main(void) {
+    const SimdLevel supported = get_supported_simd_level();
+    for (const SimdLevel level :
+         {SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2, SimdLevel::AVX512}) {
+        if (level > supported) {
+            std::cout << get_simd_level_name(level) << ": not supported by this CPU, skipped"
+                      << std::endl;
+            continue;
+        }
+        std::cout << get_simd_level_name(level) << std::endl;
+        test_matches_reference(level);
+        test_matches_legacy(level);
+    }
+    test_default_dispatch();
+    test_rejects_other_types();
+    return num_failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <iostream>
+
+/**
+ * @brief 失敗した確認の数（テストのmain()はこれが0でなければ失敗で終了する）
+ *
+ */
+inline int num_failures = 0;
+
+/**
+ * @brief 条件が成り立つことを確認する（成り立たなければ位置を出力して続ける）
+ *
+ */
+#define EXPECT_TRUE(condition)                                                   \
+    do {                                                                         \
+        if (!(condition)) {                                                      \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": expected " #condition \
+                      << std::endl;                                              \
+            num_failures++;                                                      \
+        }                                                                        \
+    } while (false)
+
+/**
+ * @brief 式が指定した型の例外を投げることを確認する
+ *
+ */
+#define EXPECT_THROW(expression, exception_type)                                      \
+    do {                                                                              \
+        bool thrown = false;                                                          \
+        try {                                                                         \
+            expression;                                                               \
+        } catch (const exception_type&) {                                             \
+            thrown = true;                                                            \
+        } catch (...) {                                                               \
+        }                                                                             \
+        if (!thrown) {                                                                \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": expected " #exception_type \
+                      << " from " #expression << std::endl;                           \
+            num_failures++;                                                           \
+        }                                                                             \
+    } while (false)